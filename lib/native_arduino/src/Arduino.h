@@ -0,0 +1,151 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Test Support - Arduino Core
+ *
+ * Host stand-ins for the parts of the Arduino core the data layer uses, so
+ * it can be built and tested on the development machine
+ */
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <string>
+
+#define HEX 16
+#define DEC 10
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+/**
+ * Serial port stand-in. Debug output is dropped, as the tests report
+ * their own failures
+ */
+class NativeSerial {
+public:
+    template <typename T> size_t print(const T&) { return 0; }
+    template <typename T> size_t println(const T&) { return 0; }
+    size_t println() { return 0; }
+    size_t printf(const char*, ...) { return 0; }
+};
+
+extern NativeSerial Serial;
+
+/**
+ * Arduino String over std::string, with the members the data layer uses
+ */
+class String {
+public:
+    String(const char* text = "") : _text(text ? text : "") {}
+    explicit String(char c) : _text(1, c) {}
+    explicit String(int value, unsigned char base = DEC) : _text(format((long long)value, base)) {}
+    explicit String(unsigned int value, unsigned char base = DEC) : _text(format((unsigned long long)value, base)) {}
+    explicit String(long value, unsigned char base = DEC) : _text(format((long long)value, base)) {}
+    explicit String(unsigned long value, unsigned char base = DEC) : _text(format((unsigned long long)value, base)) {}
+    explicit String(long long value, unsigned char base = DEC) : _text(format(value, base)) {}
+    explicit String(unsigned long long value, unsigned char base = DEC) : _text(format(value, base)) {}
+    explicit String(double value, unsigned char decimals = 2) : _text(format(value, decimals)) {}
+
+    String& operator=(const char* text) { _text = text ? text : ""; return *this; }
+
+    unsigned int length() const { return _text.size(); }
+    const char* c_str() const { return _text.c_str(); }
+    bool isEmpty() const { return _text.empty(); }
+    bool reserve(unsigned int size) { _text.reserve(size); return true; }
+
+    char charAt(unsigned int index) const { return index < _text.size() ? _text[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return _text[index]; }
+
+    String substring(unsigned int from) const { return substring(from, _text.size()); }
+    String substring(unsigned int from, unsigned int to) const {
+        String result;
+        if (from < to && from < _text.size()) {
+            result._text = _text.substr(from, to - from);
+        }
+        return result;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(_text.find(c, from)); }
+    int indexOf(const String& text, unsigned int from = 0) const { return position(_text.find(text._text, from)); }
+    int lastIndexOf(char c) const { return position(_text.rfind(c)); }
+    bool startsWith(const String& prefix) const { return _text.compare(0, prefix._text.size(), prefix._text) == 0; }
+    bool endsWith(const String& suffix) const {
+        return _text.size() >= suffix._text.size() &&
+               _text.compare(_text.size() - suffix._text.size(), suffix._text.size(), suffix._text) == 0;
+    }
+
+    bool equals(const String& other) const { return _text == other._text; }
+    bool equalsIgnoreCase(const String& other) const { return strcasecmp(c_str(), other.c_str()) == 0; }
+    bool operator==(const String& other) const { return _text == other._text; }
+    bool operator==(const char* other) const { return _text == (other ? other : ""); }
+    bool operator!=(const String& other) const { return _text != other._text; }
+    bool operator<(const String& other) const { return _text < other._text; }
+
+    long toInt() const { return atol(c_str()); }
+    float toFloat() const { return atof(c_str()); }
+    void toLowerCase() { for (char& c : _text) c = tolower((unsigned char)c); }
+    void toUpperCase() { for (char& c : _text) c = toupper((unsigned char)c); }
+    void trim() {
+        size_t first = _text.find_first_not_of(" \t\r\n");
+        size_t last = _text.find_last_not_of(" \t\r\n");
+        _text = first == std::string::npos ? "" : _text.substr(first, last - first + 1);
+    }
+    void replace(const String& from, const String& to) {
+        if (from._text.empty()) return;
+        for (size_t i = _text.find(from._text); i != std::string::npos; i = _text.find(from._text, i + to._text.size())) {
+            _text.replace(i, from._text.size(), to._text);
+        }
+    }
+    void remove(unsigned int index, unsigned int count = 1) { if (index < _text.size()) _text.erase(index, count); }
+
+    bool concat(const String& text) { _text += text._text; return true; }
+    bool concat(const char* text) { _text += text ? text : ""; return true; }
+    bool concat(const char* text, unsigned int length) { _text.append(text, length); return true; }
+    bool concat(char c) { _text += c; return true; }
+    String& operator+=(const String& text) { concat(text); return *this; }
+    String& operator+=(const char* text) { concat(text); return *this; }
+    String& operator+=(char c) { concat(c); return *this; }
+    String& operator+=(int value) { _text += format((long long)value, DEC); return *this; }
+    String& operator+=(unsigned int value) { _text += format((unsigned long long)value, DEC); return *this; }
+    String& operator+=(long value) { _text += format((long long)value, DEC); return *this; }
+    String& operator+=(unsigned long value) { _text += format((unsigned long long)value, DEC); return *this; }
+
+    friend String operator+(const String& a, const String& b) { String result(a); result += b; return result; }
+    friend String operator+(const String& a, const char* b) { String result(a); result += b; return result; }
+    friend String operator+(const char* a, const String& b) { String result(a); result += b; return result; }
+    friend String operator+(const String& a, char b) { String result(a); result += b; return result; }
+
+private:
+    std::string _text;
+
+    static int position(size_t found) { return found == std::string::npos ? -1 : (int)found; }
+
+    static std::string format(long long value, unsigned char base) {
+        return base == HEX ? format((unsigned long long)value, base) : std::to_string(value);
+    }
+
+    static std::string format(unsigned long long value, unsigned char base) {
+        char buffer[24];
+        snprintf(buffer, sizeof(buffer), base == HEX ? "%llx" : "%llu", value);
+        return buffer;
+    }
+
+    static std::string format(double value, unsigned char decimals) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+        return buffer;
+    }
+};
+
+#endif // NATIVE_ARDUINO_H
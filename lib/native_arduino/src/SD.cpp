@@ -0,0 +1,226 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Test Support - SD Card Implementation
+ */
+
+#include "SD.h"
+#include <dirent.h>
+#include <unistd.h>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+SDClass SD;
+
+static std::string root;
+static long writeBudget = -1;
+static uint64_t bytesWritten = 0;
+
+static const std::string& rootPath() {
+    if (root.empty()) {
+        fs::path path = fs::temp_directory_path() / ("lpl_native_sd_" + std::to_string(getpid()));
+        NativeStorage::setRoot(path.c_str());
+    }
+    return root;
+}
+
+static std::string hostPath(const char* path) {
+    return rootPath() + (path[0] == '/' ? "" : "/") + path;
+}
+
+static std::string snapshotPath(const char* name) {
+    return rootPath() + ".snapshot." + name;
+}
+
+// Create, truncate, remove, rename and mkdir each take one unit of budget
+static bool spendMetadata() {
+    if (writeBudget < 0) {
+        return true;
+    }
+    if (writeBudget == 0) {
+        return false;
+    }
+    writeBudget--;
+    return true;
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    if (!_file) {
+        return 0;
+    }
+    if (writeBudget >= 0 && (long)size > writeBudget) {
+        size = writeBudget;
+    }
+    size_t written = fwrite(buffer, 1, size, _file.get());
+    fflush(_file.get());
+    if (writeBudget >= 0) {
+        writeBudget -= written;
+    }
+    bytesWritten += written;
+    return written;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    return _file ? fread(buffer, 1, size, _file.get()) : 0;
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::available() {
+    return _file ? (int)(size() - position()) : 0;
+}
+
+void File::flush() {
+    if (_file) {
+        fflush(_file.get());
+    }
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+    static const int whence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+    return _file && fseek(_file.get(), position, whence[mode]) == 0;
+}
+
+size_t File::position() const {
+    return _file ? ftell(_file.get()) : 0;
+}
+
+size_t File::size() const {
+    std::error_code error;
+    uintmax_t size = fs::file_size(_path, error);
+    return error ? 0 : size;
+}
+
+void File::close() {
+    _file.reset();
+    _dir.reset();
+}
+
+File File::openNextFile() {
+    File next;
+    if (!_dir) {
+        return next;
+    }
+
+    while (struct dirent* entry = readdir((DIR*)_dir.get())) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::string path = _path + "/" + entry->d_name;
+        next._path = path;
+        next._name = entry->d_name;
+        if (fs::is_directory(path)) {
+            next._dir.reset(opendir(path.c_str()), [](void* dir) { closedir((DIR*)dir); });
+        } else {
+            next._file.reset(fopen(path.c_str(), "rb"), fclose);
+        }
+        break;
+    }
+    return next;
+}
+
+File SDClass::open(const char* path, const char* mode) {
+    File file;
+    file._path = hostPath(path);
+    const char* name = strrchr(path, '/');
+    file._name = name ? name + 1 : path;
+
+    if (fs::is_directory(file._path)) {
+        file._dir.reset(opendir(file._path.c_str()), [](void* dir) { closedir((DIR*)dir); });
+        return file;
+    }
+
+    bool writing = strcmp(mode, FILE_READ) != 0;
+    if (writing && !spendMetadata()) {
+        return File();
+    }
+
+    FILE* handle = fopen(file._path.c_str(), !writing ? "rb" : strcmp(mode, FILE_APPEND) == 0 ? "ab" : "wb");
+    if (!handle) {
+        return File();
+    }
+    file._file.reset(handle, fclose);
+    return file;
+}
+
+bool SDClass::exists(const char* path) {
+    return fs::exists(hostPath(path));
+}
+
+bool SDClass::remove(const char* path) {
+    std::string host = hostPath(path);
+    if (!fs::is_regular_file(host) || !spendMetadata()) {
+        return false;
+    }
+    return ::remove(host.c_str()) == 0;
+}
+
+bool SDClass::rename(const char* pathFrom, const char* pathTo) {
+    // FAT does not rename over an existing file
+    if (exists(pathTo) || !exists(pathFrom) || !spendMetadata()) {
+        return false;
+    }
+    return ::rename(hostPath(pathFrom).c_str(), hostPath(pathTo).c_str()) == 0;
+}
+
+bool SDClass::mkdir(const char* path) {
+    std::string host = hostPath(path);
+    if (fs::exists(host) || !spendMetadata()) {
+        return false;
+    }
+    std::error_code error;
+    return fs::create_directory(host, error);
+}
+
+bool SDClass::rmdir(const char* path) {
+    return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+void NativeStorage::setRoot(const char* path) {
+    root = path;
+    fs::create_directories(root);
+}
+
+const std::string& NativeStorage::getRoot() {
+    return rootPath();
+}
+
+void NativeStorage::wipe() {
+    const std::string& path = rootPath();
+    fs::remove_all(path);
+    fs::create_directories(path);
+}
+
+bool NativeStorage::save(const char* name) {
+    std::error_code error;
+    std::string snapshot = snapshotPath(name);
+    fs::remove_all(snapshot, error);
+    fs::copy(rootPath(), snapshot, fs::copy_options::recursive, error);
+    return !error;
+}
+
+bool NativeStorage::load(const char* name) {
+    std::error_code error;
+    std::string snapshot = snapshotPath(name);
+    if (!fs::is_directory(snapshot)) {
+        return false;
+    }
+    fs::remove_all(rootPath(), error);
+    fs::copy(snapshot, rootPath(), fs::copy_options::recursive, error);
+    return !error;
+}
+
+void NativeStorage::setWriteBudget(long units) {
+    writeBudget = units;
+}
+
+long NativeStorage::getWriteBudget() {
+    return writeBudget;
+}
+
+uint64_t NativeStorage::getBytesWritten() {
+    return bytesWritten;
+}
@@ -0,0 +1,133 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Test Support - SD Card
+ *
+ * SD card stand-in over a directory of the host file system. Writes go
+ * straight through, so a write budget running out leaves the files exactly
+ * as a power cut at that point would (see NativeStorage)
+ */
+
+#ifndef NATIVE_SD_H
+#define NATIVE_SD_H
+
+#include "Arduino.h"
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+class File {
+public:
+    File() {}
+
+    operator bool() const { return _file || _dir; }
+
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t write(uint8_t data) { return write(&data, 1); }
+    size_t read(uint8_t* buffer, size_t size);
+    int read();
+    int available();
+    void flush();
+    bool seek(uint32_t position, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void close();
+
+    const char* name() const { return _name.c_str(); }
+    bool isDirectory() const { return _dir != nullptr; }
+    File openNextFile();
+
+private:
+    friend class SDClass;
+
+    std::shared_ptr<FILE> _file;
+    std::shared_ptr<void> _dir;
+    std::string _path;
+    std::string _name;
+};
+
+class SDClass {
+public:
+    bool begin(uint8_t ssPin = 0) { return true; }
+    void end() {}
+
+    File open(const char* path, const char* mode = FILE_READ);
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool rename(const char* pathFrom, const char* pathTo);
+    bool mkdir(const char* path);
+    bool rmdir(const char* path);
+
+    uint64_t cardSize() { return 1ull << 32; }
+    uint64_t totalBytes() { return 1ull << 32; }
+    uint64_t usedBytes() { return 0; }
+};
+
+extern SDClass SD;
+
+/**
+ * Control over the emulated card, for tests
+ */
+class NativeStorage {
+public:
+    /**
+     * Use a host directory as the card, creating it if needed. Without this
+     * a fresh temporary directory is used
+     * @param path host directory
+     */
+    static void setRoot(const char* path);
+
+    /**
+     * Get the host directory behind the card
+     * @return host path
+     */
+    static const std::string& getRoot();
+
+    /**
+     * Remove everything on the card
+     */
+    static void wipe();
+
+    /**
+     * Copy the whole card aside under a name, replacing an earlier copy
+     * @param name snapshot name
+     * @return true if successful, false otherwise
+     */
+    static bool save(const char* name);
+
+    /**
+     * Replace the whole card with a snapshot taken by save
+     * @param name snapshot name
+     * @return true if successful, false otherwise
+     */
+    static bool load(const char* name);
+
+    /**
+     * Limit how much more may be written before the card stops taking
+     * writes, as if power were cut. Each byte costs one unit and so does
+     * each create, truncate, remove, rename and mkdir
+     * @param units write units left, negative for no limit
+     */
+    static void setWriteBudget(long units);
+
+    /**
+     * Get the write units left
+     * @return units left, negative if there is no limit
+     */
+    static long getWriteBudget();
+
+    /**
+     * Get the bytes written to the card so far
+     * @return bytes written
+     */
+    static uint64_t getBytesWritten();
+};
+
+#endif // NATIVE_SD_H
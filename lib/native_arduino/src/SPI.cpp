@@ -0,0 +1,8 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Test Support - SPI Bus Implementation
+ */
+
+#include "SPI.h"
+
+SPIClass SPI;
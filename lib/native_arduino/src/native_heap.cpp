@@ -0,0 +1,113 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Test Support - Heap Counters Implementation
+ *
+ * Replaces the global operator new and delete. Each block carries its size
+ * in a header, so frees are counted by size too
+ */
+
+#include "native_heap.h"
+#include <stdlib.h>
+#include <new>
+
+// Keeps the memory after the header aligned for any type
+static const size_t HEADER_SIZE = alignof(max_align_t);
+
+static size_t allocations = 0;
+static size_t inUse = 0;
+static size_t peak = 0;
+static size_t cap = 0;
+
+void NativeHeap::reset() {
+    allocations = 0;
+    peak = inUse;
+}
+
+size_t NativeHeap::getAllocations() {
+    return allocations;
+}
+
+size_t NativeHeap::getInUse() {
+    return inUse;
+}
+
+size_t NativeHeap::getPeak() {
+    return peak;
+}
+
+void NativeHeap::setCap(size_t bytes) {
+    cap = bytes;
+}
+
+static void* allocate(size_t size) {
+    if (cap != 0 && inUse + size > cap) {
+        return nullptr;
+    }
+
+    char* block = (char*)malloc(HEADER_SIZE + size);
+    if (!block) {
+        return nullptr;
+    }
+
+    *(size_t*)block = size;
+    allocations++;
+    inUse += size;
+    if (inUse > peak) {
+        peak = inUse;
+    }
+    return block + HEADER_SIZE;
+}
+
+static void release(void* memory) {
+    if (!memory) {
+        return;
+    }
+
+    char* block = (char*)memory - HEADER_SIZE;
+    inUse -= *(size_t*)block;
+    free(block);
+}
+
+void* operator new(size_t size) {
+    void* memory = allocate(size);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+    release(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    release(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    release(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    release(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    release(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    release(memory);
+}
@@ -0,0 +1,53 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Test Support - Heap Counters
+ *
+ * Counts what goes through operator new and delete, so tests can assert
+ * allocation counts and peak heap use, and can cap the heap the way a
+ * device with little RAM would
+ */
+
+#ifndef NATIVE_HEAP_H
+#define NATIVE_HEAP_H
+
+#include <stddef.h>
+
+/**
+ * Counters over operator new and delete. Memory taken with malloc, such as
+ * text arena blocks, is not counted
+ */
+class NativeHeap {
+public:
+    /**
+     * Start counting afresh: allocations from zero and the peak from the
+     * bytes in use now
+     */
+    static void reset();
+
+    /**
+     * Get the number of allocations since the last reset
+     * @return allocations
+     */
+    static size_t getAllocations();
+
+    /**
+     * Get the bytes allocated and not yet freed
+     * @return bytes in use
+     */
+    static size_t getInUse();
+
+    /**
+     * Get the most bytes in use at once since the last reset
+     * @return peak bytes in use
+     */
+    static size_t getPeak();
+
+    /**
+     * Limit the bytes in use. An allocation beyond the limit throws
+     * std::bad_alloc, as operator new does when the heap runs out
+     * @param bytes limit, 0 for none
+     */
+    static void setCap(size_t bytes);
+};
+
+#endif // NATIVE_HEAP_H
@@ -0,0 +1,82 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Test Support - RTC Implementation
+ *
+ * Stands in for hal/rtc.cpp on the host. The clock holds whatever time was
+ * last set and does not move on its own, so tests decide what "now" is
+ */
+
+#include <Arduino.h>
+#include "hal/rtc.h"
+
+bool RtcHAL::_initialized = false;
+const char* RtcHAL::_timeZone = "UTC";
+
+static time_t clockTime = 0;
+
+bool RtcHAL::init() {
+    if (_initialized) {
+        return true;
+    }
+
+    setenv("TZ", _timeZone, 1);
+    tzset();
+
+    // Like the device, start from a default time if none was set
+    if (clockTime == 0) {
+        setTime(2023, 1, 1, 0, 0, 0);
+    }
+
+    _initialized = true;
+    return true;
+}
+
+time_t RtcHAL::getTime() {
+    return clockTime;
+}
+
+bool RtcHAL::getTimeInfo(struct tm* timeinfo) {
+    time_t now = getTime();
+    return localtime_r(&now, timeinfo) != nullptr;
+}
+
+bool RtcHAL::setTime(time_t time) {
+    clockTime = time;
+    return true;
+}
+
+bool RtcHAL::setTime(int year, int month, int day, int hour, int minute, int second) {
+    struct tm timeinfo = {0};
+    timeinfo.tm_year = year - 1900;
+    timeinfo.tm_mon = month - 1;
+    timeinfo.tm_mday = day;
+    timeinfo.tm_hour = hour;
+    timeinfo.tm_min = minute;
+    timeinfo.tm_sec = second;
+
+    return setTime(mktime(&timeinfo));
+}
+
+bool RtcHAL::syncWithNTP(const char* ntpServer) {
+    return false;
+}
+
+String RtcHAL::formatTime(time_t time, const char* format) {
+    char buffer[64];
+    formatTime(time, format, buffer, sizeof(buffer));
+    return String(buffer);
+}
+
+size_t RtcHAL::formatTime(time_t time, const char* format, char* buffer, size_t size) {
+    struct tm timeinfo;
+    localtime_r(&time, &timeinfo);
+    size_t length = strftime(buffer, size, format, &timeinfo);
+    if (length == 0 && size > 0) {
+        buffer[0] = '\0';
+    }
+    return length;
+}
+
+String RtcHAL::formatCurrentTime(const char* format) {
+    return formatTime(getTime(), format);
+}
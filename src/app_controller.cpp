@@ -131,7 +131,7 @@ void AppController::handleScreenChange(ScreenType screenType) {
     }
 }
 
-LogEntry AppController::getCurrentEntry() {
+const LogEntry& AppController::getCurrentEntry() {
     return _currentEntry;
 }
 
@@ -260,6 +260,26 @@ void AppController::_runPeriodicTasks() {
         _checkPower();
     }
     
+    // Write changes held by group commit once their commit window is up, so
+    // saving an entry never waits on the SD card
+    if (Database::needsFlush()) {
+        Database::flush();
+    }
+    
+    // Archive old entries and fold sealed database segments in short steps
+    // while the user is idle or the device is charging, so the UI never
+    // waits on storage maintenance
+    if (PowerHAL::isCharging() || lv_disp_get_inactive_time(NULL) >= DATABASE_MAINTENANCE_IDLE_MS) {
+        // Going idle is a sync point for anything still held
+        Database::flush();
+        
+        if (Database::needsArchive()) {
+            Database::archiveStep();
+        } else if (Database::needsCompaction()) {
+            Database::compactStep();
+        }
+    }
+    
     // Auto-save entry every 30 seconds if in entry flow
     if (currentTime - _lastAutoSaveTime >= 30000) {
         _lastAutoSaveTime = currentTime;
@@ -277,8 +297,13 @@ void AppController::_checkPower() {
     // Check battery level
     int batteryLevel = PowerHAL::getBatteryLevel();
     
+    bool critical = batteryLevel < 10 && !PowerHAL::isCharging();
+    
+    // Write every change through while power may be lost at any moment
+    Database::setCommitWindow(critical ? 0 : DATABASE_COMMIT_WINDOW_MS);
+    
     // If battery level is critically low, show warning
-    if (batteryLevel < 10 && !PowerHAL::isCharging()) {
+    if (critical) {
         UIManager::showAlert("Low Battery Warning", 
                            "Battery level is critically low. Please connect charger soon.", 
                            "OK");
@@ -55,7 +55,7 @@ public:
      * Get current log entry
      * @return current log entry
      */
-    static LogEntry getCurrentEntry();
+    static const LogEntry& getCurrentEntry();
     
     /**
      * Set current log entry
@@ -0,0 +1,594 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Entry Archive Implementation
+ */
+
+#include "archive.h"
+#include "compression.h"
+#include <algorithm>
+#include <limits>
+
+// Static member initialization
+bool Archive::_pending = false;
+Archive::SegmentInfo Archive::_pendingInfo;
+bool Archive::_countKnown = false;
+size_t Archive::_entryCount = 0;
+bool Archive::_replacing = false;
+
+// Segment file header: magic followed by uint16 format version and uint16 reserved,
+// then the segment info and the compressed entries
+static const uint8_t ARCHIVE_MAGIC[4] = {'L', 'P', 'A', 'R'};
+static const uint16_t ARCHIVE_FORMAT_VERSION = 1;
+static const size_t ARCHIVE_HEADER_SIZE = 8;
+
+// Count, first and last timestamp, raw size, raw CRC and stored size,
+// followed by a CRC of those fields
+static const size_t SEGMENT_INFO_SIZE = 4 + 8 + 8 + 4 + 4 + 4 + 4;
+
+static void putUint(std::vector<uint8_t>& out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static uint64_t getUint(const uint8_t* p, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+bool Archive::recover(const EntryTable& hotEntries) {
+    // Finish replacing the archive if the new catalog was complete, otherwise
+    // drop whatever the replacement had staged
+    if (StorageHAL::fileExists(ARCHIVE_RESTORE_FILENAME)) {
+        DEBUG_PRINT("Completing interrupted archive replacement");
+        _replacing = true;
+        if (!installReplacement()) {
+            DEBUG_PRINT("Failed to complete archive replacement");
+            return false;
+        }
+    } else {
+        discardStaged();
+    }
+    
+    // Finish a catalog repair that was interrupted
+    if (!StorageHAL::recoverFile(ARCHIVE_CATALOG_FILENAME)) {
+        DEBUG_PRINT("Failed to recover archive catalog");
+    }
+    
+    String path = segmentName(getSegmentCount());
+    if (!StorageHAL::fileExists(path.c_str())) {
+        return true;
+    }
+    
+    // A segment that was not written completely never had its entries retired
+    SegmentInfo info;
+    bool retired = readSegmentInfo(path, info);
+    
+    if (retired && info.count <= hotEntries.size()) {
+        std::vector<LogEntry> front;
+        hotEntries.getRange(0, info.count, front);
+        
+        std::vector<uint8_t> raw;
+        encodeEntries(front.data(), info.count, raw);
+        retired = raw.size() != info.rawSize || StorageHAL::crc32(raw.data(), raw.size()) != info.rawCrc;
+    }
+    
+    if (!retired) {
+        DEBUG_PRINT("Dropping archive segment whose entries are still in the database");
+        StorageHAL::deleteFile(path.c_str());
+        return true;
+    }
+    
+    DEBUG_PRINT("Committing archive segment left by an interrupted retirement");
+    return appendCatalog(info);
+}
+
+bool Archive::writeSegment(const LogEntry* entries, size_t count) {
+    if (count == 0) {
+        return false;
+    }
+    
+    if (!StorageHAL::fileExists(ARCHIVE_DIR)) {
+        StorageHAL::createDir(ARCHIVE_DIR);
+    }
+    
+    // It would go to the same path as the segment still waiting to be committed
+    if (_pending) {
+        DEBUG_PRINT("Archive segment still pending, not writing another");
+        return false;
+    }
+    if (!settleReplacement()) {
+        return false;
+    }
+    
+    SegmentInfo info;
+    if (!writeBlock(segmentName(getSegmentCount()), entries, count, info)) {
+        return false;
+    }
+    
+    _pending = true;
+    _pendingInfo = info;
+    
+    DEBUG_PRINTF("Archived %d entries, %d bytes compressed to %d", count, info.rawSize, info.storedSize);
+    return true;
+}
+
+bool Archive::commitSegment() {
+    if (!_pending) {
+        return false;
+    }
+    
+    if (!appendCatalog(_pendingInfo)) {
+        return false;
+    }
+    
+    _pending = false;
+    return true;
+}
+
+bool Archive::hasPendingSegment() {
+    return _pending;
+}
+
+bool Archive::clear() {
+    if (!settleReplacement()) {
+        return false;
+    }
+    size_t segments = getSegmentCount();
+    
+    // Include a segment that was written but never committed
+    for (size_t segment = 0; segment <= segments; segment++) {
+        String path = segmentName(segment);
+        if (StorageHAL::fileExists(path.c_str())) {
+            StorageHAL::deleteFile(path.c_str());
+        }
+    }
+    
+    if (StorageHAL::fileExists(ARCHIVE_CATALOG_FILENAME) && !StorageHAL::deleteFile(ARCHIVE_CATALOG_FILENAME)) {
+        DEBUG_PRINT("Failed to delete archive catalog");
+        return false;
+    }
+    
+    _pending = false;
+    _countKnown = true;
+    _entryCount = 0;
+    return true;
+}
+
+size_t Archive::getEntryCount() {
+    if (!settleReplacement()) {
+        return 0;
+    }
+    if (_countKnown) {
+        return _entryCount;
+    }
+    
+    // Summed once from the catalog on first use rather than at boot
+    _entryCount = 0;
+    if (StorageHAL::fileExists(ARCHIVE_CATALOG_FILENAME)) {
+        StorageReader catalog;
+        if (!catalog.open(ARCHIVE_CATALOG_FILENAME)) {
+            return 0;
+        }
+        
+        uint8_t record[SEGMENT_INFO_SIZE];
+        while (catalog.read(record, sizeof(record)) == sizeof(record)) {
+            SegmentInfo info;
+            if (decodeInfo(record, info)) {
+                _entryCount += info.count;
+            }
+        }
+    }
+    
+    _countKnown = true;
+    return _entryCount;
+}
+
+size_t Archive::getSegmentCount() {
+    if (!settleReplacement() || !StorageHAL::fileExists(ARCHIVE_CATALOG_FILENAME)) {
+        return 0;
+    }
+    
+    int size = StorageHAL::getFileSize(ARCHIVE_CATALOG_FILENAME);
+    return size > 0 ? size / SEGMENT_INFO_SIZE : 0;
+}
+
+bool Archive::writeBlock(const String& path, const LogEntry* entries, size_t count, SegmentInfo& info) {
+    std::vector<uint8_t> raw;
+    encodeEntries(entries, count, raw);
+    
+    info.count = count;
+    info.firstTime = count > 0 ? entries[0].getTimestamp() : 0;
+    info.lastTime = info.firstTime;
+    for (size_t i = 1; i < count; i++) {
+        info.firstTime = std::min(info.firstTime, entries[i].getTimestamp());
+        info.lastTime = std::max(info.lastTime, entries[i].getTimestamp());
+    }
+    info.rawSize = raw.size();
+    info.rawCrc = StorageHAL::crc32(raw.data(), raw.size());
+    
+    std::vector<uint8_t> compressed;
+    Compression::compress(raw.data(), raw.size(), compressed);
+    info.storedSize = compressed.size();
+    
+    std::vector<uint8_t> content;
+    content.insert(content.end(), ARCHIVE_MAGIC, ARCHIVE_MAGIC + sizeof(ARCHIVE_MAGIC));
+    putUint(content, ARCHIVE_FORMAT_VERSION, 2);
+    putUint(content, 0, 2);
+    encodeInfo(info, content);
+    content.insert(content.end(), compressed.begin(), compressed.end());
+    
+    if (StorageHAL::writeFile(path.c_str(), (const char*)content.data(), content.size()) != (int)content.size()) {
+        DEBUG_PRINTF("Failed to write archive block: %s", path.c_str());
+        return false;
+    }
+    
+    return true;
+}
+
+bool Archive::readBlock(const String& path, std::function<bool(const LogEntry&)> callback) {
+    SegmentInfo info;
+    std::vector<uint8_t> raw;
+    
+    if (!readSegmentInfo(path, info) || !readSegment(path, info, raw)) {
+        DEBUG_PRINTF("Failed to read archive block: %s", path.c_str());
+        return false;
+    }
+    
+    return decodeEntries(raw, std::numeric_limits<time_t>::min(), std::numeric_limits<time_t>::max(), callback);
+}
+
+bool Archive::checkSegment(const String& path, SegmentInfo& info) {
+    std::vector<uint8_t> raw;
+    return readSegmentInfo(path, info) && readSegment(path, info, raw);
+}
+
+bool Archive::replace(const std::vector<String>& paths) {
+    // A replacement left half installed can only be finished
+    if (StorageHAL::fileExists(ARCHIVE_RESTORE_FILENAME) && !installReplacement()) {
+        return false;
+    }
+    
+    if (!StorageHAL::fileExists(ARCHIVE_DIR)) {
+        StorageHAL::createDir(ARCHIVE_DIR);
+    }
+    
+    // Each segment is staged as the temporary file of its final name
+    std::vector<uint8_t> catalog;
+    bool staged = true;
+    for (size_t segment = 0; staged && segment < paths.size(); segment++) {
+        SegmentInfo info;
+        String stagedPath = StorageHAL::getTempPath(segmentName(segment).c_str());
+        staged = readSegmentInfo(paths[segment], info) && StorageHAL::copyFile(paths[segment].c_str(), stagedPath.c_str());
+        if (staged) {
+            encodeInfo(info, catalog);
+        }
+    }
+    
+    // The catalog is renamed into place once written in full, which is the
+    // point from which the replacement is finished rather than dropped
+    String stagedCatalog = StorageHAL::getTempPath(ARCHIVE_RESTORE_FILENAME);
+    staged = staged &&
+             StorageHAL::writeFile(stagedCatalog.c_str(), (const char*)catalog.data(), catalog.size()) == (int)catalog.size() &&
+             StorageHAL::renameFile(stagedCatalog.c_str(), ARCHIVE_RESTORE_FILENAME);
+    
+    if (!staged) {
+        DEBUG_PRINT("Failed to stage archive replacement");
+        discardStaged();
+        return false;
+    }
+    
+    _replacing = true;
+    return installReplacement();
+}
+
+bool Archive::installReplacement() {
+    int size = StorageHAL::getFileSize(ARCHIVE_RESTORE_FILENAME);
+    size_t count = size > 0 ? size / SEGMENT_INFO_SIZE : 0;
+    
+    // Segments past the end of the new archive belong to the old one. They go
+    // last first, so any left by an interruption still follow on from count
+    size_t end = count;
+    while (StorageHAL::fileExists(segmentName(end).c_str())) {
+        end++;
+    }
+    for (size_t segment = end; segment-- > count;) {
+        if (!StorageHAL::deleteFile(segmentName(segment).c_str())) {
+            return false;
+        }
+    }
+    
+    for (size_t segment = 0; segment < count; segment++) {
+        String path = segmentName(segment);
+        if (StorageHAL::fileExists(StorageHAL::getTempPath(path.c_str()).c_str()) && !StorageHAL::commitTempFile(path.c_str())) {
+            return false;
+        }
+    }
+    
+    if ((StorageHAL::fileExists(ARCHIVE_CATALOG_FILENAME) && !StorageHAL::deleteFile(ARCHIVE_CATALOG_FILENAME)) ||
+        !StorageHAL::renameFile(ARCHIVE_RESTORE_FILENAME, ARCHIVE_CATALOG_FILENAME)) {
+        DEBUG_PRINT("Failed to install archive catalog");
+        return false;
+    }
+    
+    _pending = false;
+    _countKnown = false;
+    _replacing = false;
+    return true;
+}
+
+bool Archive::settleReplacement() {
+    // Until an interrupted install is finished the catalog may not describe
+    // the segments beside it, so nothing is read from them before then
+    if (_replacing && !installReplacement()) {
+        DEBUG_PRINT("Archive replacement still incomplete");
+        return false;
+    }
+    return true;
+}
+
+void Archive::discardStaged() {
+    // Staged segments are copied in order, so they end at the first gap
+    for (size_t segment = 0;; segment++) {
+        String stagedPath = StorageHAL::getTempPath(segmentName(segment).c_str());
+        if (!StorageHAL::fileExists(stagedPath.c_str())) {
+            break;
+        }
+        StorageHAL::deleteFile(stagedPath.c_str());
+    }
+    
+    String stagedCatalog = StorageHAL::getTempPath(ARCHIVE_RESTORE_FILENAME);
+    if (StorageHAL::fileExists(stagedCatalog.c_str())) {
+        StorageHAL::deleteFile(stagedCatalog.c_str());
+    }
+}
+
+bool Archive::forEachSegment(size_t first, std::function<bool(size_t, const String&, const SegmentInfo&)> callback) {
+    if (!settleReplacement()) {
+        return false;
+    }
+    if (!StorageHAL::fileExists(ARCHIVE_CATALOG_FILENAME)) {
+        return true;
+    }
+    
+    StorageReader catalog;
+    if (!catalog.open(ARCHIVE_CATALOG_FILENAME)) {
+        DEBUG_PRINT("Failed to read archive catalog");
+        return false;
+    }
+    
+    uint8_t record[SEGMENT_INFO_SIZE];
+    for (size_t segment = 0; catalog.read(record, sizeof(record)) == sizeof(record); segment++) {
+        SegmentInfo info;
+        if (segment < first) {
+            continue;
+        }
+        if (!decodeInfo(record, info)) {
+            return false;
+        }
+        if (!callback(segment, segmentName(segment), info)) {
+            break;
+        }
+    }
+    
+    return true;
+}
+
+bool Archive::forEach(time_t startTime, time_t endTime, std::function<bool(const LogEntry&)> callback) {
+    if (!settleReplacement()) {
+        return false;
+    }
+    if (!StorageHAL::fileExists(ARCHIVE_CATALOG_FILENAME)) {
+        return true;
+    }
+    
+    StorageReader catalog;
+    if (!catalog.open(ARCHIVE_CATALOG_FILENAME)) {
+        DEBUG_PRINT("Failed to read archive catalog");
+        return false;
+    }
+    
+    std::vector<uint8_t> raw;
+    uint8_t record[SEGMENT_INFO_SIZE];
+    bool complete = true;
+    
+    for (size_t segment = 0; catalog.read(record, sizeof(record)) == sizeof(record); segment++) {
+        SegmentInfo info;
+        if (!decodeInfo(record, info)) {
+            complete = false;
+            continue;
+        }
+        
+        // Skip segments entirely outside the range without opening them
+        if (info.lastTime < startTime || info.firstTime > endTime) {
+            continue;
+        }
+        
+        if (!readSegment(segmentName(segment), info, raw)) {
+            DEBUG_PRINTF("Failed to read archive segment %d", segment);
+            complete = false;
+            continue;
+        }
+        
+        bool stopped = false;
+        decodeEntries(raw, startTime, endTime, [&callback, &stopped](const LogEntry& entry) {
+            stopped = !callback(entry);
+            return !stopped;
+        });
+        if (stopped) {
+            return true;
+        }
+    }
+    
+    return complete;
+}
+
+bool Archive::forEachInRange(size_t first, size_t count, std::function<bool(const LogEntry&)> callback) {
+    size_t end = first + count;
+    size_t segmentStart = 0;
+    bool complete = true;
+    bool stopped = false;
+    std::vector<uint8_t> raw;
+    
+    bool read = forEachSegment(0, [&](size_t segment, const String& path, const SegmentInfo& info) {
+        size_t segmentEnd = segmentStart + info.count;
+        if (segmentEnd > first) {
+            if (!readSegment(path, info, raw)) {
+                DEBUG_PRINTF("Failed to read archive segment %d", segment);
+                complete = false;
+            } else {
+                // Entries are counted from the start of the segment to skip
+                // those before the range
+                size_t place = segmentStart;
+                decodeEntries(raw, std::numeric_limits<time_t>::min(), std::numeric_limits<time_t>::max(),
+                              [&](const LogEntry& entry) {
+                    if (place >= end) {
+                        return false;
+                    }
+                    stopped = place++ >= first && !callback(entry);
+                    return !stopped;
+                });
+            }
+        }
+        segmentStart = segmentEnd;
+        return !stopped && segmentStart < end;
+    });
+    
+    return read && complete;
+}
+
+bool Archive::findEntry(uint64_t id, LogEntry& entry) {
+    bool found = false;
+    forEach(std::numeric_limits<time_t>::min(), std::numeric_limits<time_t>::max(), [&](const LogEntry& archived) {
+        if (archived.getId() != id) {
+            return true;
+        }
+        entry = archived;
+        found = true;
+        return false;
+    });
+    return found;
+}
+
+String Archive::segmentName(size_t segment) {
+    return String(ARCHIVE_SEGMENT_PREFIX) + String((unsigned int)segment) + ".lpa";
+}
+
+void Archive::encodeEntries(const LogEntry* entries, size_t count, std::vector<uint8_t>& raw) {
+    for (size_t i = 0; i < count; i++) {
+        size_t size = entries[i].getBinarySize();
+        putUint(raw, size, 2);
+        raw.resize(raw.size() + size);
+        entries[i].serializeBinary(&raw[raw.size() - size], size);
+    }
+}
+
+void Archive::encodeInfo(const SegmentInfo& info, std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    putUint(out, info.count, 4);
+    putUint(out, (uint64_t)(int64_t)info.firstTime, 8);
+    putUint(out, (uint64_t)(int64_t)info.lastTime, 8);
+    putUint(out, info.rawSize, 4);
+    putUint(out, info.rawCrc, 4);
+    putUint(out, info.storedSize, 4);
+    putUint(out, StorageHAL::crc32(&out[start], out.size() - start), 4);
+}
+
+bool Archive::decodeInfo(const uint8_t* data, SegmentInfo& info) {
+    if (getUint(data + SEGMENT_INFO_SIZE - 4, 4) != StorageHAL::crc32(data, SEGMENT_INFO_SIZE - 4)) {
+        return false;
+    }
+    
+    info.count = getUint(data, 4);
+    info.firstTime = (time_t)(int64_t)getUint(data + 4, 8);
+    info.lastTime = (time_t)(int64_t)getUint(data + 12, 8);
+    info.rawSize = getUint(data + 20, 4);
+    info.rawCrc = getUint(data + 24, 4);
+    info.storedSize = getUint(data + 28, 4);
+    return true;
+}
+
+bool Archive::readSegmentInfo(const String& path, SegmentInfo& info) {
+    StorageReader reader;
+    if (!reader.open(path.c_str())) {
+        return false;
+    }
+    
+    uint8_t header[ARCHIVE_HEADER_SIZE + SEGMENT_INFO_SIZE];
+    if (reader.read(header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 ||
+        !decodeInfo(header + ARCHIVE_HEADER_SIZE, info)) {
+        return false;
+    }
+    
+    return reader.getSize() == sizeof(header) + info.storedSize;
+}
+
+bool Archive::readSegment(const String& path, const SegmentInfo& info, std::vector<uint8_t>& raw) {
+    StorageReader reader;
+    if (!reader.open(path.c_str())) {
+        return false;
+    }
+    
+    uint8_t header[ARCHIVE_HEADER_SIZE + SEGMENT_INFO_SIZE];
+    if (reader.read(header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) {
+        return false;
+    }
+    
+    std::vector<uint8_t> compressed(info.storedSize);
+    if (reader.read(compressed.data(), compressed.size()) != compressed.size()) {
+        return false;
+    }
+    
+    raw.resize(info.rawSize);
+    return Compression::decompress(compressed.data(), compressed.size(), raw.data(), raw.size()) &&
+           StorageHAL::crc32(raw.data(), raw.size()) == info.rawCrc;
+}
+
+bool Archive::decodeEntries(const std::vector<uint8_t>& raw, time_t startTime, time_t endTime,
+                            std::function<bool(const LogEntry&)> callback) {
+    LogEntry entry((time_t)0);
+    const uint8_t* p = raw.data();
+    const uint8_t* end = p + raw.size();
+    
+    while (end - p >= 2) {
+        size_t len = getUint(p, 2);
+        p += 2;
+        if (len > (size_t)(end - p) || !entry.deserializeBinary(p, len)) {
+            return false;
+        }
+        p += len;
+        
+        if (entry.getTimestamp() >= startTime && entry.getTimestamp() <= endTime && !callback(entry)) {
+            break;
+        }
+    }
+    
+    return true;
+}
+
+bool Archive::appendCatalog(const SegmentInfo& info) {
+    // Drop a record torn by an interrupted append before adding after it
+    int size = StorageHAL::fileExists(ARCHIVE_CATALOG_FILENAME) ? StorageHAL::getFileSize(ARCHIVE_CATALOG_FILENAME) : 0;
+    if (size > 0 && size % SEGMENT_INFO_SIZE != 0 &&
+        !StorageHAL::truncateFile(ARCHIVE_CATALOG_FILENAME, size - size % SEGMENT_INFO_SIZE)) {
+        DEBUG_PRINT("Failed to repair archive catalog");
+        return false;
+    }
+    
+    std::vector<uint8_t> record;
+    encodeInfo(info, record);
+    if (StorageHAL::appendFile(ARCHIVE_CATALOG_FILENAME, (const char*)record.data(), record.size()) != (int)record.size()) {
+        DEBUG_PRINT("Failed to append to archive catalog");
+        return false;
+    }
+    
+    if (_countKnown) {
+        _entryCount += info.count;
+    }
+    return true;
+}
@@ -0,0 +1,186 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Entry Archive
+ * 
+ * This file contains the cold storage tier for entries retired from the
+ * in-memory database, kept as compressed segments on the SD card
+ */
+
+#ifndef DATA_ARCHIVE_H
+#define DATA_ARCHIVE_H
+
+#include <Arduino.h>
+#include <vector>
+#include <functional>
+#include "log_entry.h"
+#include "entry_table.h"
+#include "../hal/storage.h"
+#include "../config.h"
+
+/**
+ * Append-only store of retired entries. Each segment file holds a run of
+ * consecutive entries compressed as one block; a catalog file lists the
+ * committed segments with their time span, so nothing but the catalog size
+ * is read at boot and date queries open only the segments they overlap
+ */
+class Archive {
+public:
+    // Segment description, stored both in the segment header and the catalog
+    struct SegmentInfo {
+        uint32_t count;
+        time_t firstTime;
+        time_t lastTime;
+        uint32_t rawSize;
+        uint32_t rawCrc;
+        uint32_t storedSize;
+    };
+    
+    /**
+     * Settle a segment left uncommitted by a crash during retirement. If its
+     * entries are still at the front of the hot tier the segment is dropped,
+     * otherwise it is committed. A replacement interrupted by a crash is
+     * finished or dropped first, see replace
+     * @param hotEntries entries held in memory by the database
+     * @return true if successful, false otherwise
+     */
+    static bool recover(const EntryTable& hotEntries);
+    
+    /**
+     * Write entries to a new segment without committing it yet
+     * @param entries first entry to archive
+     * @param count number of entries
+     * @return true if successful, false otherwise
+     */
+    static bool writeSegment(const LogEntry* entries, size_t count);
+    
+    /**
+     * Commit the segment written by writeSegment, once the entries have been
+     * retired from the hot tier. The segment stays pending if this fails
+     * @return true if successful, false otherwise
+     */
+    static bool commitSegment();
+    
+    /**
+     * Check if a segment written by writeSegment is still uncommitted. No
+     * other segment can be written until it is
+     * @return true if a segment is pending, false otherwise
+     */
+    static bool hasPendingSegment();
+    
+    /**
+     * Delete every archived entry
+     * @return true if successful, false otherwise
+     */
+    static bool clear();
+    
+    /**
+     * Get the number of archived entries
+     * @return number of entries
+     */
+    static size_t getEntryCount();
+    
+    /**
+     * Get the number of committed segments
+     * @return number of segments
+     */
+    static size_t getSegmentCount();
+    
+    /**
+     * Visit archived entries in a date range, oldest segment first, holding
+     * one decompressed segment in memory at a time
+     * @param startTime start of date range
+     * @param endTime end of date range
+     * @param callback called for each entry, returns false to stop
+     * @return true if every matching segment was read, false otherwise
+     */
+    static bool forEach(time_t startTime, time_t endTime, std::function<bool(const LogEntry&)> callback);
+    
+    /**
+     * Visit archived entries by their place in the archive, oldest first,
+     * opening only the segments the range overlaps
+     * @param first place of the first entry, 0 being the first archived
+     * @param count number of entries
+     * @param callback called for each entry, returns false to stop
+     * @return true if every overlapping segment was read, false otherwise
+     */
+    static bool forEachInRange(size_t first, size_t count, std::function<bool(const LogEntry&)> callback);
+    
+    /**
+     * Find an archived entry by ID. Segments are read one after another, so
+     * this suits a single lookup such as opening an entry
+     * @param id entry ID
+     * @param entry reference to store the entry
+     * @return true if found, false otherwise
+     */
+    static bool findEntry(uint64_t id, LogEntry& entry);
+    
+    /**
+     * Visit the committed segments in order
+     * @param first index of the first segment to visit
+     * @param callback called with each segment index, file path and info, returns false to stop
+     * @return true if the catalog was read, false otherwise
+     */
+    static bool forEachSegment(size_t first, std::function<bool(size_t, const String&, const SegmentInfo&)> callback);
+    
+    /**
+     * Check a segment file, such as one kept by a backup, without reading
+     * its entries
+     * @param path segment file
+     * @param info set to the description of the segment
+     * @return true if the header is valid and the block matches its CRC
+     */
+    static bool checkSegment(const String& path, SegmentInfo& info);
+    
+    /**
+     * Replace every archived entry with segment files, such as those kept by
+     * a backup. The new archive is staged beside the live one, which is left
+     * as it is unless the new catalog is complete; recover finishes a
+     * replacement interrupted after that
+     * @param paths segment files to copy in, in order
+     * @return true if successful, false otherwise
+     */
+    static bool replace(const std::vector<String>& paths);
+    
+    /**
+     * Write entries to a standalone file in the segment format
+     * @param path file path
+     * @param entries first entry to write
+     * @param count number of entries
+     * @param info set to the description of the written block
+     * @return true if successful, false otherwise
+     */
+    static bool writeBlock(const String& path, const LogEntry* entries, size_t count, SegmentInfo& info);
+    
+    /**
+     * Visit the entries of a file in the segment format
+     * @param path file path
+     * @param callback called for each entry, returns false to stop
+     * @return true if the whole file was valid, false otherwise
+     */
+    static bool readBlock(const String& path, std::function<bool(const LogEntry&)> callback);
+
+private:
+    // Host tests drop what a reboot loses (see test/test_support.h)
+    friend class DatabaseTestHooks;
+    
+    static bool _pending;
+    static SegmentInfo _pendingInfo;
+    static bool _countKnown;
+    static size_t _entryCount;
+    static bool _replacing;
+    
+    static String segmentName(size_t segment);
+    static void encodeEntries(const LogEntry* entries, size_t count, std::vector<uint8_t>& raw);
+    static void encodeInfo(const SegmentInfo& info, std::vector<uint8_t>& out);
+    static bool decodeInfo(const uint8_t* data, SegmentInfo& info);
+    static bool readSegmentInfo(const String& path, SegmentInfo& info);
+    static bool readSegment(const String& path, const SegmentInfo& info, std::vector<uint8_t>& raw);
+    static bool decodeEntries(const std::vector<uint8_t>& raw, time_t startTime, time_t endTime,
+                              std::function<bool(const LogEntry&)> callback);
+    static bool appendCatalog(const SegmentInfo& info);
+    static bool installReplacement();
+    static bool settleReplacement();
+    static void discardStaged();
+};
+
+#endif // DATA_ARCHIVE_H
@@ -0,0 +1,385 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Incremental Backup Implementation
+ */
+
+#include "backup.h"
+#include "../hal/rtc.h"
+
+// Manifest header: magic followed by uint16 format version and uint16 reserved
+static const uint8_t MANIFEST_MAGIC[4] = {'L', 'P', 'B', 'M'};
+static const uint16_t MANIFEST_FORMAT_VERSION = 1;
+static const size_t MANIFEST_HEADER_SIZE = 8 + 4 + 4 + 4 + 8 + 4 + 4 + 8 + 4 + 4;
+
+// Index record: uint32 sequence, int64 time and a CRC of both
+static const size_t INDEX_RECORD_SIZE = 4 + 8 + 4;
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static uint64_t fnv1a(const uint8_t* data, size_t len, uint64_t hash = FNV_OFFSET) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static void putUint(std::vector<uint8_t>& out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static uint64_t getUint(const uint8_t* p, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+bool Backup::create(const EntryTable& hotEntries) {
+    if (!StorageHAL::fileExists(BACKUP_DIR)) {
+        StorageHAL::createDir(BACKUP_DIR);
+    }
+    if (!StorageHAL::fileExists(BACKUP_CHUNK_DIR) && !StorageHAL::createDir(BACKUP_CHUNK_DIR)) {
+        DEBUG_PRINT("Failed to create backup chunk directory");
+        return false;
+    }
+    
+    std::vector<IndexRecord> index;
+    readIndex(index);
+    
+    Manifest manifest;
+    manifest.sequence = index.empty() ? 1 : index.back().sequence + 1;
+    manifest.entryCount = Archive::getEntryCount() + hotEntries.size();
+    manifest.time = RtcHAL::getTime();
+    
+    // Chain onto the previous backup unless the chain is already long
+    Manifest parent;
+    bool chained = !index.empty() && readManifest(index.back().sequence, parent) &&
+                   parent.depth + 1 < BACKUP_FULL_INTERVAL;
+    
+    if (!backupArchive(chained ? &parent : nullptr, manifest) || !backupHot(hotEntries, manifest)) {
+        DEBUG_PRINT("Failed to store backup chunks");
+        return false;
+    }
+    
+    if (!writeManifest(manifest)) {
+        DEBUG_PRINT("Failed to write backup manifest");
+        return false;
+    }
+    
+    // The index record commits the backup; drop a record torn by an interrupted append first
+    int size = StorageHAL::fileExists(BACKUP_INDEX_FILENAME) ? StorageHAL::getFileSize(BACKUP_INDEX_FILENAME) : 0;
+    if (size != (int)(index.size() * INDEX_RECORD_SIZE) &&
+        !StorageHAL::truncateFile(BACKUP_INDEX_FILENAME, index.size() * INDEX_RECORD_SIZE)) {
+        DEBUG_PRINT("Failed to repair backup index");
+        return false;
+    }
+    
+    std::vector<uint8_t> records;
+    putUint(records, manifest.sequence, 4);
+    putUint(records, (uint64_t)manifest.time, 8);
+    putUint(records, StorageHAL::crc32(records.data(), records.size()), 4);
+    if (StorageHAL::appendFile(BACKUP_INDEX_FILENAME, (const char*)records.data(), records.size()) != (int)records.size()) {
+        DEBUG_PRINT("Failed to append to backup index");
+        return false;
+    }
+    
+    DEBUG_PRINTF("Backup %d created: %d entries, %d archive segments added, %d hot chunks",
+                 manifest.sequence, manifest.entryCount, manifest.archiveKeys.size(), manifest.hotKeys.size());
+    return true;
+}
+
+bool Backup::restore(time_t pointInTime, std::vector<LogEntry>& hotEntries) {
+    std::vector<IndexRecord> index;
+    readIndex(index);
+    
+    uint32_t sequence = 0;
+    for (const IndexRecord& record : index) {
+        if (record.time <= pointInTime) {
+            sequence = record.sequence;
+        }
+    }
+    
+    Manifest manifest;
+    if (sequence == 0 || !readManifest(sequence, manifest)) {
+        DEBUG_PRINT("No backup found for the requested time");
+        return false;
+    }
+    
+    // Gather archive segments from the whole chain, oldest manifest first
+    std::vector<std::vector<uint64_t>> links;
+    links.push_back(manifest.archiveKeys);
+    for (Manifest link = manifest; link.parent != 0; ) {
+        if (!readManifest(link.parent, link)) {
+            DEBUG_PRINTF("Backup chain of %d is broken", sequence);
+            return false;
+        }
+        links.push_back(link.archiveKeys);
+    }
+    
+    std::vector<uint64_t> archiveKeys;
+    for (size_t i = links.size(); i > 0; i--) {
+        archiveKeys.insert(archiveKeys.end(), links[i - 1].begin(), links[i - 1].end());
+    }
+    
+    // Every chunk is checked before the live archive is touched
+    std::vector<String> segments;
+    size_t archived = 0;
+    for (uint64_t key : archiveKeys) {
+        Archive::SegmentInfo info;
+        String path = chunkName('a', key);
+        if (!Archive::checkSegment(path, info)) {
+            DEBUG_PRINTF("Backup %d has a missing or corrupt archive segment", sequence);
+            return false;
+        }
+        segments.push_back(path);
+        archived += info.count;
+    }
+    
+    std::vector<LogEntry> entries;
+    for (uint64_t key : manifest.hotKeys) {
+        bool read = Archive::readBlock(chunkName('h', key), [&entries](const LogEntry& entry) {
+            entries.push_back(entry);
+            return true;
+        });
+        if (!read) {
+            DEBUG_PRINTF("Backup %d has a missing or corrupt chunk", sequence);
+            return false;
+        }
+    }
+    
+    if (archived + entries.size() != manifest.entryCount) {
+        DEBUG_PRINTF("Backup %d holds %d entries, expected %d", sequence, archived + entries.size(), manifest.entryCount);
+        return false;
+    }
+    
+    if (!Archive::replace(segments)) {
+        DEBUG_PRINT("Failed to restore archive");
+        return false;
+    }
+    
+    hotEntries.swap(entries);
+    DEBUG_PRINTF("Restored backup %d with %d entries", sequence, manifest.entryCount);
+    return true;
+}
+
+size_t Backup::getBackupCount() {
+    std::vector<IndexRecord> index;
+    readIndex(index);
+    return index.size();
+}
+
+String Backup::manifestName(uint32_t sequence) {
+    return String(BACKUP_MANIFEST_PREFIX) + String(sequence) + ".lpm";
+}
+
+String Backup::chunkName(char kind, uint64_t key) {
+    char name[24];
+    snprintf(name, sizeof(name), "/%c%08lx%08lx.lpa", kind, (unsigned long)(key >> 32), (unsigned long)(key & 0xFFFFFFFF));
+    return String(BACKUP_CHUNK_DIR) + name;
+}
+
+uint64_t Backup::archiveKey(size_t segment, const Archive::SegmentInfo& info) {
+    // Segments are immutable, so position and content CRC identify one even across archive resets
+    return ((uint64_t)segment << 32) | info.rawCrc;
+}
+
+bool Backup::readIndex(std::vector<IndexRecord>& records) {
+    records.clear();
+    
+    // Finish an index repair that was interrupted
+    StorageHAL::recoverFile(BACKUP_INDEX_FILENAME);
+    
+    if (!StorageHAL::fileExists(BACKUP_INDEX_FILENAME)) {
+        return true;
+    }
+    
+    StorageReader reader;
+    if (!reader.open(BACKUP_INDEX_FILENAME)) {
+        DEBUG_PRINT("Failed to read backup index");
+        return false;
+    }
+    
+    uint8_t record[INDEX_RECORD_SIZE];
+    while (reader.read(record, sizeof(record)) == sizeof(record)) {
+        if (StorageHAL::crc32(record, INDEX_RECORD_SIZE - 4) != getUint(record + INDEX_RECORD_SIZE - 4, 4)) {
+            break;
+        }
+        IndexRecord entry;
+        entry.sequence = getUint(record, 4);
+        entry.time = (time_t)(int64_t)getUint(record + 4, 8);
+        records.push_back(entry);
+    }
+    
+    return true;
+}
+
+bool Backup::readManifest(uint32_t sequence, Manifest& manifest) {
+    String path = manifestName(sequence);
+    int size = StorageHAL::fileExists(path.c_str()) ? StorageHAL::getFileSize(path.c_str()) : 0;
+    if (size < (int)(MANIFEST_HEADER_SIZE + 4)) {
+        return false;
+    }
+    
+    std::vector<uint8_t> data(size);
+    StorageReader reader;
+    if (!reader.open(path.c_str()) || reader.read(data.data(), data.size()) != data.size()) {
+        return false;
+    }
+    
+    const uint8_t* p = data.data();
+    if (memcmp(p, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) != 0 || getUint(p + 4, 2) != MANIFEST_FORMAT_VERSION ||
+        StorageHAL::crc32(p, size - 4) != getUint(p + size - 4, 4)) {
+        DEBUG_PRINTF("Corrupt backup manifest: %s", path.c_str());
+        return false;
+    }
+    
+    p += 8;
+    manifest.sequence = getUint(p, 4);
+    manifest.parent = getUint(p + 4, 4);
+    manifest.depth = getUint(p + 8, 4);
+    manifest.time = (time_t)(int64_t)getUint(p + 12, 8);
+    manifest.entryCount = getUint(p + 20, 4);
+    manifest.archiveSegments = getUint(p + 24, 4);
+    manifest.lastArchiveKey = getUint(p + 28, 8);
+    size_t archiveCount = getUint(p + 36, 4);
+    size_t hotCount = getUint(p + 40, 4);
+    p += 44;
+    
+    if (manifest.sequence != sequence || size != (int)(MANIFEST_HEADER_SIZE + (archiveCount + hotCount) * 8 + 4)) {
+        DEBUG_PRINTF("Corrupt backup manifest: %s", path.c_str());
+        return false;
+    }
+    
+    manifest.archiveKeys.resize(archiveCount);
+    for (size_t i = 0; i < archiveCount; i++, p += 8) {
+        manifest.archiveKeys[i] = getUint(p, 8);
+    }
+    manifest.hotKeys.resize(hotCount);
+    for (size_t i = 0; i < hotCount; i++, p += 8) {
+        manifest.hotKeys[i] = getUint(p, 8);
+    }
+    
+    return true;
+}
+
+bool Backup::writeManifest(const Manifest& manifest) {
+    std::vector<uint8_t> data;
+    data.insert(data.end(), MANIFEST_MAGIC, MANIFEST_MAGIC + sizeof(MANIFEST_MAGIC));
+    putUint(data, MANIFEST_FORMAT_VERSION, 2);
+    putUint(data, 0, 2);
+    putUint(data, manifest.sequence, 4);
+    putUint(data, manifest.parent, 4);
+    putUint(data, manifest.depth, 4);
+    putUint(data, (uint64_t)manifest.time, 8);
+    putUint(data, manifest.entryCount, 4);
+    putUint(data, manifest.archiveSegments, 4);
+    putUint(data, manifest.lastArchiveKey, 8);
+    putUint(data, manifest.archiveKeys.size(), 4);
+    putUint(data, manifest.hotKeys.size(), 4);
+    for (uint64_t key : manifest.archiveKeys) {
+        putUint(data, key, 8);
+    }
+    for (uint64_t key : manifest.hotKeys) {
+        putUint(data, key, 8);
+    }
+    putUint(data, StorageHAL::crc32(data.data(), data.size()), 4);
+    
+    // Not referenced until its index record is appended, so a torn manifest is simply overwritten
+    String path = manifestName(manifest.sequence);
+    return StorageHAL::writeFile(path.c_str(), (const char*)data.data(), data.size()) == (int)data.size();
+}
+
+bool Backup::backupArchive(const Manifest* parent, Manifest& manifest) {
+    manifest.parent = 0;
+    manifest.depth = 0;
+    manifest.archiveSegments = 0;
+    manifest.lastArchiveKey = 0;
+    manifest.archiveKeys.clear();
+    
+    // The parent's segments can be shared only if the archive still starts with them
+    if (parent != nullptr && parent->archiveSegments <= Archive::getSegmentCount()) {
+        uint64_t key = 0;
+        if (parent->archiveSegments > 0) {
+            Archive::forEachSegment(parent->archiveSegments - 1, [&key](size_t segment, const String& path, const Archive::SegmentInfo& info) {
+                key = archiveKey(segment, info);
+                return false;
+            });
+        }
+        
+        if (key == parent->lastArchiveKey) {
+            manifest.parent = parent->sequence;
+            manifest.depth = parent->depth + 1;
+            manifest.archiveSegments = parent->archiveSegments;
+            manifest.lastArchiveKey = parent->lastArchiveKey;
+        }
+    }
+    
+    bool stored = true;
+    bool read = Archive::forEachSegment(manifest.archiveSegments, [&manifest, &stored](size_t segment, const String& path, const Archive::SegmentInfo& info) {
+        uint64_t key = archiveKey(segment, info);
+        String chunk = chunkName('a', key);
+        if (!StorageHAL::fileExists(chunk.c_str())) {
+            String temp = chunk + ".tmp";
+            stored = StorageHAL::copyFile(path.c_str(), temp.c_str()) &&
+                     StorageHAL::renameFile(temp.c_str(), chunk.c_str());
+            if (!stored) {
+                return false;
+            }
+        }
+        
+        manifest.archiveKeys.push_back(key);
+        manifest.archiveSegments = segment + 1;
+        manifest.lastArchiveKey = key;
+        return true;
+    });
+    
+    return read && stored;
+}
+
+bool Backup::backupHot(const EntryTable& hotEntries, Manifest& manifest) {
+    manifest.hotKeys.clear();
+    
+    std::vector<uint8_t> buffer;
+    std::vector<LogEntry> chunk;
+    uint64_t chunkHash = FNV_OFFSET;
+    
+    for (size_t i = 0; i < hotEntries.size(); i++) {
+        chunk.emplace_back((time_t)0);
+        hotEntries.get(i, chunk.back());
+        buffer.resize(chunk.back().getBinarySize());
+        chunk.back().serializeBinary(buffer.data(), buffer.size());
+        
+        // Cut after entries whose hash hits the boundary, so cuts move with the content
+        uint64_t entryHash = fnv1a(buffer.data(), buffer.size());
+        chunkHash = fnv1a((const uint8_t*)&entryHash, sizeof(entryHash), chunkHash);
+        
+        if (entryHash % BACKUP_CHUNK_ENTRIES != 0 && chunk.size() < BACKUP_CHUNK_MAX_ENTRIES && i + 1 < hotEntries.size()) {
+            continue;
+        }
+        
+        if (!storeChunk(chunkName('h', chunkHash), chunk.data(), chunk.size())) {
+            return false;
+        }
+        manifest.hotKeys.push_back(chunkHash);
+        
+        chunk.clear();
+        chunkHash = FNV_OFFSET;
+    }
+    
+    return true;
+}
+
+bool Backup::storeChunk(const String& path, const LogEntry* entries, size_t count) {
+    // Named by content, so a chunk already in the store holds these entries
+    if (StorageHAL::fileExists(path.c_str())) {
+        return true;
+    }
+    
+    Archive::SegmentInfo info;
+    String temp = path + ".tmp";
+    return Archive::writeBlock(temp, entries, count, info) && StorageHAL::renameFile(temp.c_str(), path.c_str());
+}
@@ -0,0 +1,89 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Incremental Backup
+ * 
+ * This file contains deduplicated, incremental backups of the database and
+ * point-in-time restore from them
+ */
+
+#ifndef DATA_BACKUP_H
+#define DATA_BACKUP_H
+
+#include <Arduino.h>
+#include <vector>
+#include "log_entry.h"
+#include "entry_table.h"
+#include "archive.h"
+#include "../hal/storage.h"
+#include "../config.h"
+
+/**
+ * Backups share a store of immutable chunks. Archive segments never change
+ * once committed, so each is copied once and later backups only copy the
+ * segments past the previous backup's watermark. The hot tier is cut into
+ * content-defined chunks at entries whose hash hits a boundary, so an edit
+ * rewrites one chunk and retiring entries from the front leaves the rest
+ * untouched; a chunk already in the store is never written again.
+ *
+ * Each backup writes a manifest listing its hot chunks and the archive
+ * segments added since its parent. Restore walks the chain back to the
+ * last full manifest, and a full manifest is written periodically to keep
+ * chains short
+ */
+class Backup {
+public:
+    /**
+     * Back up the archive and the given hot entries
+     * @param hotEntries entries held in memory by the database
+     * @return true if successful, false otherwise
+     */
+    static bool create(const EntryTable& hotEntries);
+    
+    /**
+     * Restore the newest backup taken at or before a point in time. The
+     * archive is replaced in place and the hot entries are returned; nothing
+     * is changed unless the whole chain is present and valid
+     * @param pointInTime latest backup time to accept
+     * @param hotEntries set to the hot entries of the backup
+     * @return true if successful, false otherwise
+     */
+    static bool restore(time_t pointInTime, std::vector<LogEntry>& hotEntries);
+    
+    /**
+     * Get the number of backups taken
+     * @return number of backups
+     */
+    static size_t getBackupCount();
+
+private:
+    // Manifest header fields, followed by the chunk keys
+    struct Manifest {
+        uint32_t sequence;
+        uint32_t parent;
+        uint32_t depth;
+        time_t time;
+        uint32_t entryCount;
+        uint32_t archiveSegments;
+        uint64_t lastArchiveKey;
+        std::vector<uint64_t> archiveKeys;
+        std::vector<uint64_t> hotKeys;
+    };
+    
+    // Backup index record
+    struct IndexRecord {
+        uint32_t sequence;
+        time_t time;
+    };
+    
+    static String manifestName(uint32_t sequence);
+    static String chunkName(char kind, uint64_t key);
+    static uint64_t archiveKey(size_t segment, const Archive::SegmentInfo& info);
+    static bool readIndex(std::vector<IndexRecord>& records);
+    static bool readManifest(uint32_t sequence, Manifest& manifest);
+    static bool writeManifest(const Manifest& manifest);
+    static bool backupArchive(const Manifest* parent, Manifest& manifest);
+    static bool backupHot(const EntryTable& hotEntries, Manifest& manifest);
+    static bool storeChunk(const String& path, const LogEntry* entries, size_t count);
+};
+
+#endif // DATA_BACKUP_H
@@ -0,0 +1,288 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Compressed Bitmap Implementation
+ */
+
+#include "bitmap.h"
+#include <algorithm>
+
+// Saved indexes are written in native byte order and layout, since they are
+// only read back by the firmware that wrote them
+static void putRaw(std::vector<uint8_t>& out, const void* data, size_t len) {
+    out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + len);
+}
+
+static bool getRaw(const uint8_t*& p, const uint8_t* end, void* data, size_t len) {
+    if ((size_t)(end - p) < len) {
+        return false;
+    }
+    memcpy(data, p, len);
+    p += len;
+    return true;
+}
+
+Bitmap::Bitmap() : _dense(false), _cardinality(0) {
+}
+
+void Bitmap::clear() {
+    _dense = false;
+    _cardinality = 0;
+    _positions.clear();
+    _words.clear();
+}
+
+void Bitmap::add(uint32_t position) {
+    if (_dense) {
+        size_t word = position / 32;
+        if (word >= _words.size()) {
+            _words.resize(word + 1, 0);
+        }
+        
+        uint32_t mask = 1u << (position % 32);
+        if (!(_words[word] & mask)) {
+            _words[word] |= mask;
+            _cardinality++;
+        }
+        return;
+    }
+    
+    // Positions are normally appended in order
+    if (_positions.empty() || position > _positions.back()) {
+        _positions.push_back(position);
+    } else {
+        auto it = std::lower_bound(_positions.begin(), _positions.end(), position);
+        if (it != _positions.end() && *it == position) {
+            return;
+        }
+        _positions.insert(it, position);
+    }
+    _cardinality++;
+    
+    // Switch to a bit array once it is smaller than the position list
+    if (_cardinality > _positions.back() / 32 + 1) {
+        toDense();
+    }
+}
+
+void Bitmap::addRange(uint32_t count) {
+    clear();
+    if (count == 0) {
+        return;
+    }
+    
+    _dense = true;
+    _words.assign((count + 31) / 32, 0xFFFFFFFF);
+    if (count % 32) {
+        _words.back() = (1u << (count % 32)) - 1;
+    }
+    _cardinality = count;
+}
+
+void Bitmap::remove(uint32_t position) {
+    if (_dense) {
+        size_t word = position / 32;
+        uint32_t mask = 1u << (position % 32);
+        if (word < _words.size() && (_words[word] & mask)) {
+            _words[word] &= ~mask;
+            _cardinality--;
+        }
+    } else {
+        auto it = std::lower_bound(_positions.begin(), _positions.end(), position);
+        if (it != _positions.end() && *it == position) {
+            _positions.erase(it);
+            _cardinality--;
+        }
+    }
+}
+
+void Bitmap::removeAndShift(uint32_t position) {
+    remove(position);
+    
+    if (!_dense) {
+        auto it = std::upper_bound(_positions.begin(), _positions.end(), position);
+        for (; it != _positions.end(); ++it) {
+            (*it)--;
+        }
+        return;
+    }
+    
+    size_t word = position / 32;
+    if (word >= _words.size()) {
+        return;
+    }
+    
+    // Within the first word, keep the bits below the position and move the rest down
+    uint32_t bit = position % 32;
+    uint32_t lowMask = bit ? ((1u << bit) - 1) : 0;
+    uint32_t high = (_words[word] >> 1) & ~lowMask;
+    _words[word] = (_words[word] & lowMask) | high;
+    
+    // Every later word moves down one bit, borrowing the lowest bit of the next word
+    for (size_t i = word; i < _words.size(); i++) {
+        if (i + 1 < _words.size()) {
+            _words[i] |= (_words[i + 1] & 1u) << 31;
+            _words[i + 1] >>= 1;
+        }
+    }
+}
+
+bool Bitmap::contains(uint32_t position) const {
+    if (_dense) {
+        size_t word = position / 32;
+        return word < _words.size() && (_words[word] & (1u << (position % 32)));
+    }
+    return std::binary_search(_positions.begin(), _positions.end(), position);
+}
+
+size_t Bitmap::cardinality() const {
+    return _cardinality;
+}
+
+bool Bitmap::isEmpty() const {
+    return _cardinality == 0;
+}
+
+void Bitmap::intersectWith(const Bitmap& other) {
+    if (_dense && other._dense) {
+        // Word-wise AND
+        if (_words.size() > other._words.size()) {
+            _words.resize(other._words.size());
+        }
+        
+        _cardinality = 0;
+        for (size_t i = 0; i < _words.size(); i++) {
+            _words[i] &= other._words[i];
+            _cardinality += __builtin_popcount(_words[i]);
+        }
+    } else if (!_dense) {
+        // Probe the other bitmap for each of our positions
+        size_t kept = 0;
+        for (uint32_t position : _positions) {
+            if (other.contains(position)) {
+                _positions[kept++] = position;
+            }
+        }
+        _positions.resize(kept);
+        _cardinality = kept;
+    } else {
+        // Result can only be as large as the sparse side
+        std::vector<uint32_t> positions;
+        positions.reserve(other._positions.size());
+        for (uint32_t position : other._positions) {
+            if (contains(position)) {
+                positions.push_back(position);
+            }
+        }
+        
+        _dense = false;
+        _words.clear();
+        _positions.swap(positions);
+        _cardinality = _positions.size();
+    }
+    
+    optimize();
+}
+
+void Bitmap::unionWith(const Bitmap& other) {
+    if (other._dense) {
+        toDense();
+        if (_words.size() < other._words.size()) {
+            _words.resize(other._words.size(), 0);
+        }
+        
+        _cardinality = 0;
+        for (size_t i = 0; i < _words.size(); i++) {
+            if (i < other._words.size()) {
+                _words[i] |= other._words[i];
+            }
+            _cardinality += __builtin_popcount(_words[i]);
+        }
+    } else {
+        for (uint32_t position : other._positions) {
+            add(position);
+        }
+    }
+    
+    optimize();
+}
+
+void Bitmap::toPositions(std::vector<uint32_t>& positions) const {
+    positions.clear();
+    positions.reserve(_cardinality);
+    forEach([&positions](uint32_t position) {
+        positions.push_back(position);
+    });
+}
+
+size_t Bitmap::getMemoryUsage() const {
+    return (_positions.capacity() + _words.capacity()) * sizeof(uint32_t);
+}
+
+void Bitmap::serialize(std::vector<uint8_t>& out) const {
+    const std::vector<uint32_t>& values = _dense ? _words : _positions;
+    uint32_t header[3] = {_dense ? 1u : 0u, (uint32_t)_cardinality, (uint32_t)values.size()};
+    
+    putRaw(out, header, sizeof(header));
+    putRaw(out, values.data(), values.size() * sizeof(uint32_t));
+}
+
+bool Bitmap::deserialize(const uint8_t*& p, const uint8_t* end) {
+    uint32_t header[3];
+    if (!getRaw(p, end, header, sizeof(header)) || header[2] > (size_t)(end - p) / sizeof(uint32_t)) {
+        return false;
+    }
+    
+    clear();
+    _dense = header[0] != 0;
+    _cardinality = header[1];
+    
+    // Copied straight into the array the bitmap was using
+    std::vector<uint32_t>& values = _dense ? _words : _positions;
+    values.resize(header[2]);
+    return getRaw(p, end, values.data(), values.size() * sizeof(uint32_t));
+}
+
+void Bitmap::toDense() {
+    if (_dense) {
+        return;
+    }
+    
+    _words.assign(_positions.empty() ? 0 : _positions.back() / 32 + 1, 0);
+    for (uint32_t position : _positions) {
+        _words[position / 32] |= 1u << (position % 32);
+    }
+    
+    _positions.clear();
+    _positions.shrink_to_fit();
+    _dense = true;
+}
+
+void Bitmap::toSparse() {
+    if (!_dense) {
+        return;
+    }
+    
+    std::vector<uint32_t> positions;
+    toPositions(positions);
+    
+    _words.clear();
+    _words.shrink_to_fit();
+    _positions.swap(positions);
+    _dense = false;
+}
+
+void Bitmap::optimize() {
+    if (!_dense) {
+        return;
+    }
+    
+    // Trim empty trailing words, then fall back to a position list if that is
+    // less than half the size of the bit array
+    while (!_words.empty() && _words.back() == 0) {
+        _words.pop_back();
+    }
+    
+    if (_cardinality * 2 < _words.size()) {
+        toSparse();
+    }
+}
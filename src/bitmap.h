@@ -0,0 +1,146 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Compressed Bitmap
+ * 
+ * This file contains a compressed bitmap over entry positions, used by the
+ * database indexes to combine filters without materializing entries
+ */
+
+#ifndef DATA_BITMAP_H
+#define DATA_BITMAP_H
+
+#include <Arduino.h>
+#include <vector>
+#include "../config.h"
+
+/**
+ * Set of entry positions stored either as a sorted position array (sparse)
+ * or as a plain bit array (dense), whichever is smaller, like a single
+ * roaring container
+ */
+class Bitmap {
+public:
+    Bitmap();
+    
+    /**
+     * Remove all positions
+     */
+    void clear();
+    
+    /**
+     * Add a position
+     * @param position position to add
+     */
+    void add(uint32_t position);
+    
+    /**
+     * Add all positions in [0, count)
+     * @param count number of positions
+     */
+    void addRange(uint32_t count);
+    
+    /**
+     * Remove a position
+     * @param position position to remove
+     */
+    void remove(uint32_t position);
+    
+    /**
+     * Remove a position and move every later position down by one,
+     * following an erase from the entry list
+     * @param position position to remove
+     */
+    void removeAndShift(uint32_t position);
+    
+    /**
+     * Check if a position is set
+     * @param position position to check
+     * @return true if set, false otherwise
+     */
+    bool contains(uint32_t position) const;
+    
+    /**
+     * Get the number of positions set
+     * @return number of positions
+     */
+    size_t cardinality() const;
+    
+    /**
+     * Check if no position is set
+     * @return true if empty, false otherwise
+     */
+    bool isEmpty() const;
+    
+    /**
+     * Keep only positions also set in another bitmap
+     * @param other bitmap to intersect with
+     */
+    void intersectWith(const Bitmap& other);
+    
+    /**
+     * Add all positions set in another bitmap
+     * @param other bitmap to merge
+     */
+    void unionWith(const Bitmap& other);
+    
+    /**
+     * Copy the positions out in ascending order
+     * @param positions vector to fill
+     */
+    void toPositions(std::vector<uint32_t>& positions) const;
+    
+    /**
+     * Get the heap memory used by the bitmap
+     * @return bytes used
+     */
+    size_t getMemoryUsage() const;
+    
+    /**
+     * Append the bitmap to a buffer saved with the database file
+     * @param out buffer to append to
+     */
+    void serialize(std::vector<uint8_t>& out) const;
+    
+    /**
+     * Read a bitmap written by serialize
+     * @param p read position, advanced past the bitmap
+     * @param end end of the buffer
+     * @return true if successful, false if the data is truncated
+     */
+    bool deserialize(const uint8_t*& p, const uint8_t* end);
+    
+    /**
+     * Call a function for each position in ascending order
+     * @param func function taking a uint32_t position
+     */
+    template <typename Func>
+    void forEach(Func func) const {
+        if (!_dense) {
+            for (uint32_t position : _positions) {
+                func(position);
+            }
+            return;
+        }
+        
+        for (size_t i = 0; i < _words.size(); i++) {
+            uint32_t word = _words[i];
+            while (word) {
+                uint32_t bit = __builtin_ctz(word);
+                func((uint32_t)(i * 32 + bit));
+                word &= word - 1;
+            }
+        }
+    }
+
+private:
+    bool _dense;
+    size_t _cardinality;
+    std::vector<uint32_t> _positions;   // Sorted positions when sparse
+    std::vector<uint32_t> _words;       // Bit array when dense
+    
+    void toDense();
+    void toSparse();
+    void optimize();
+};
+
+#endif // DATA_BITMAP_H
@@ -0,0 +1,286 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Color Grid Index Implementation
+ */
+
+#include "color_grid.h"
+#include <algorithm>
+#include <math.h>
+
+// Cells along each CIELAB axis: L spans 0 to 100, a and b stay within
+// -128 to 127 for any sRGB color. Values past the ends fall in the edge cells
+static const int L_CELLS = 100 / COLOR_GRID_CELL_SIZE + 1;
+static const int AB_CELLS = 256 / COLOR_GRID_CELL_SIZE + 1;
+static const float AB_OFFSET = 128.0f;
+
+// Saved indexes are written in native byte order and layout, since they are
+// only read back by the firmware that wrote them
+static void putRaw(std::vector<uint8_t>& out, const void* data, size_t len) {
+    out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + len);
+}
+
+static bool getRaw(const uint8_t*& p, const uint8_t* end, void* data, size_t len) {
+    if ((size_t)(end - p) < len) {
+        return false;
+    }
+    memcpy(data, p, len);
+    p += len;
+    return true;
+}
+
+static int axisCell(float value, int cells) {
+    int cell = (int)floorf(value / COLOR_GRID_CELL_SIZE);
+    return cell < 0 ? 0 : (cell >= cells ? cells - 1 : cell);
+}
+
+static uint32_t makeCell(int l, int a, int b) {
+    return (uint32_t)((l * AB_CELLS + a) * AB_CELLS + b);
+}
+
+ColorGrid::ColorGrid() {
+    clear();
+}
+
+void ColorGrid::clear() {
+    _keys.clear();
+    _l.clear();
+    _a.clear();
+    _b.clear();
+    _starts.assign(1, 0);
+    _positions.clear();
+}
+
+void ColorGrid::add(uint32_t rgb, uint32_t position) {
+    rgb &= 0xFFFFFF;
+    LabColor lab = ColorLab::fromRgb(rgb);
+    uint32_t cell = cellOf(lab);
+    
+    auto it = std::lower_bound(_keys.begin(), _keys.end(), cell, [rgb](const ColorKey& key, uint32_t cell) {
+        return key.cell < cell || (key.cell == cell && key.rgb < rgb);
+    });
+    size_t index = it - _keys.begin();
+    if (it == _keys.end() || it->cell != cell || it->rgb != rgb) {
+        // A new color, with no positions yet
+        _keys.insert(it, {cell, rgb});
+        _l.insert(_l.begin() + index, lab.l);
+        _a.insert(_a.begin() + index, lab.a);
+        _b.insert(_b.begin() + index, lab.b);
+        _starts.insert(_starts.begin() + index, _starts[index]);
+    }
+    
+    // Positions are normally appended in order, at the end of the color's run
+    auto first = _positions.begin() + _starts[index];
+    auto last = _positions.begin() + _starts[index + 1];
+    auto at = std::lower_bound(first, last, position);
+    if (at != last && *at == position) {
+        return;
+    }
+    _positions.insert(at, position);
+    for (size_t i = index + 1; i < _starts.size(); i++) {
+        _starts[i]++;
+    }
+}
+
+void ColorGrid::remove(uint32_t rgb, uint32_t position) {
+    rgb &= 0xFFFFFF;
+    size_t index = findKey(rgb, cellOf(ColorLab::fromRgb(rgb)));
+    if (index == _keys.size()) {
+        return;
+    }
+    
+    auto first = _positions.begin() + _starts[index];
+    auto last = _positions.begin() + _starts[index + 1];
+    auto at = std::lower_bound(first, last, position);
+    if (at == last || *at != position) {
+        return;
+    }
+    _positions.erase(at);
+    for (size_t i = index + 1; i < _starts.size(); i++) {
+        _starts[i]--;
+    }
+    
+    if (_starts[index] == _starts[index + 1]) {
+        eraseKey(index);
+    }
+}
+
+void ColorGrid::removeAndShift(uint32_t position) {
+    // One pass over all positions, shifting the later ones down; emptied
+    // colors are dropped in the same pass
+    size_t kept = 0;
+    size_t keptKeys = 0;
+    for (size_t i = 0; i < _keys.size(); i++) {
+        size_t start = kept;
+        for (uint32_t j = _starts[i]; j < _starts[i + 1]; j++) {
+            uint32_t p = _positions[j];
+            if (p != position) {
+                _positions[kept++] = p > position ? p - 1 : p;
+            }
+        }
+        if (kept == start) {
+            continue;
+        }
+        
+        _starts[keptKeys] = start;
+        if (keptKeys != i) {
+            _keys[keptKeys] = _keys[i];
+            _l[keptKeys] = _l[i];
+            _a[keptKeys] = _a[i];
+            _b[keptKeys] = _b[i];
+        }
+        keptKeys++;
+    }
+    _keys.resize(keptKeys);
+    _l.resize(keptKeys);
+    _a.resize(keptKeys);
+    _b.resize(keptKeys);
+    _starts.resize(keptKeys + 1);
+    _starts[keptKeys] = kept;
+    _positions.resize(kept);
+}
+
+void ColorGrid::find(const LabColor& target, float maxDistance, Bitmap& positions) const {
+    std::vector<uint32_t> sorted;
+    forEachMatch(target, maxDistance, [this, &sorted](size_t index) {
+        sorted.insert(sorted.end(), _positions.begin() + _starts[index], _positions.begin() + _starts[index + 1]);
+    });
+    
+    // Added in entry order, which keeps a sparse bitmap appending
+    std::sort(sorted.begin(), sorted.end());
+    positions.clear();
+    for (uint32_t position : sorted) {
+        positions.add(position);
+    }
+}
+
+size_t ColorGrid::count(const LabColor& target, float maxDistance) const {
+    // Each entry has one color per attribute, so the matching runs are disjoint
+    size_t total = 0;
+    forEachMatch(target, maxDistance, [this, &total](size_t index) {
+        total += _starts[index + 1] - _starts[index];
+    });
+    return total;
+}
+
+size_t ColorGrid::getMemoryUsage() const {
+    return _keys.capacity() * sizeof(ColorKey) + (_l.capacity() + _a.capacity() + _b.capacity()) * sizeof(float) +
+           (_starts.capacity() + _positions.capacity()) * sizeof(uint32_t);
+}
+
+void ColorGrid::serialize(std::vector<uint8_t>& out) const {
+    uint32_t count = _keys.size();
+    putRaw(out, &count, sizeof(count));
+    
+    // Cells and CIELAB values are recomputed on load
+    for (size_t i = 0; i < _keys.size(); i++) {
+        uint32_t size = _starts[i + 1] - _starts[i];
+        putRaw(out, &_keys[i].rgb, sizeof(_keys[i].rgb));
+        putRaw(out, &size, sizeof(size));
+        putRaw(out, &_positions[_starts[i]], size * sizeof(uint32_t));
+    }
+}
+
+bool ColorGrid::deserialize(const uint8_t*& p, const uint8_t* end) {
+    clear();
+    
+    uint32_t count;
+    if (!getRaw(p, end, &count, sizeof(count)) || count > (size_t)(end - p) / (2 * sizeof(uint32_t))) {
+        return false;
+    }
+    
+    _keys.resize(count);
+    _l.resize(count);
+    _a.resize(count);
+    _b.resize(count);
+    _starts.resize(count + 1);
+    for (size_t i = 0; i < count; i++) {
+        ColorKey& key = _keys[i];
+        uint32_t size;
+        if (!getRaw(p, end, &key.rgb, sizeof(key.rgb)) || !getRaw(p, end, &size, sizeof(size)) || size == 0 ||
+            size > (size_t)(end - p) / sizeof(uint32_t)) {
+            clear();
+            return false;
+        }
+        
+        _starts[i] = _positions.size();
+        _positions.resize(_positions.size() + size);
+        getRaw(p, end, &_positions[_starts[i]], size * sizeof(uint32_t));
+        
+        LabColor lab = ColorLab::fromRgb(key.rgb);
+        key.cell = cellOf(lab);
+        _l[i] = lab.l;
+        _a[i] = lab.a;
+        _b[i] = lab.b;
+    }
+    _starts[count] = _positions.size();
+    
+    // Written in order, unless the grid was sized differently when saved
+    for (size_t i = 1; i < count; i++) {
+        const ColorKey& x = _keys[i - 1];
+        const ColorKey& y = _keys[i];
+        if (x.cell > y.cell || (x.cell == y.cell && x.rgb >= y.rgb)) {
+            clear();
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+size_t ColorGrid::findKey(uint32_t rgb, uint32_t cell) const {
+    auto it = std::lower_bound(_keys.begin(), _keys.end(), cell, [rgb](const ColorKey& key, uint32_t cell) {
+        return key.cell < cell || (key.cell == cell && key.rgb < rgb);
+    });
+    return it != _keys.end() && it->cell == cell && it->rgb == rgb ? it - _keys.begin() : _keys.size();
+}
+
+void ColorGrid::eraseKey(size_t index) {
+    // Only called once the color's run is empty
+    _starts.erase(_starts.begin() + index);
+    _keys.erase(_keys.begin() + index);
+    _l.erase(_l.begin() + index);
+    _a.erase(_a.begin() + index);
+    _b.erase(_b.begin() + index);
+}
+
+template <typename Func>
+void ColorGrid::forEachMatch(const LabColor& target, float maxDistance, Func func) const {
+    if (_keys.empty() || !(maxDistance >= 0)) {
+        return;
+    }
+    
+    // Cells the distance can reach; the b cells of each (L, a) pair are
+    // adjacent in the key order, so each pair is one run of colors
+    int l0 = axisCell(target.l - maxDistance, L_CELLS);
+    int l1 = axisCell(target.l + maxDistance, L_CELLS);
+    int a0 = axisCell(target.a + AB_OFFSET - maxDistance, AB_CELLS);
+    int a1 = axisCell(target.a + AB_OFFSET + maxDistance, AB_CELLS);
+    int b0 = axisCell(target.b + AB_OFFSET - maxDistance, AB_CELLS);
+    int b1 = axisCell(target.b + AB_OFFSET + maxDistance, AB_CELLS);
+    
+    auto cellLess = [](const ColorKey& key, uint32_t cell) {
+        return key.cell < cell;
+    };
+    std::vector<uint32_t> matches;
+    for (int l = l0; l <= l1; l++) {
+        for (int a = a0; a <= a1; a++) {
+            auto first = std::lower_bound(_keys.begin(), _keys.end(), makeCell(l, a, b0), cellLess);
+            auto last = std::lower_bound(first, _keys.end(), makeCell(l, a, b1) + 1, cellLess);
+            size_t start = first - _keys.begin();
+            size_t run = last - first;
+            if (run == 0) {
+                continue;
+            }
+            
+            matches.resize(run);
+            size_t found = ColorLab::findWithin(&_l[start], &_a[start], &_b[start], run, target, maxDistance, matches.data());
+            for (size_t i = 0; i < found; i++) {
+                func(start + matches[i]);
+            }
+        }
+    }
+}
+
+uint32_t ColorGrid::cellOf(const LabColor& color) {
+    return makeCell(axisCell(color.l, L_CELLS), axisCell(color.a + AB_OFFSET, AB_CELLS), axisCell(color.b + AB_OFFSET, AB_CELLS));
+}
@@ -0,0 +1,124 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Color Grid Index
+ * 
+ * This file contains the index of recorded RGB colors used for color
+ * similarity search
+ */
+
+#ifndef DATA_COLOR_GRID_H
+#define DATA_COLOR_GRID_H
+
+#include <Arduino.h>
+#include <vector>
+#include "bitmap.h"
+#include "color_lab.h"
+#include "../config.h"
+
+/**
+ * Index from the distinct RGB values of one clothing attribute to the
+ * entries recorded with them, laid out on a grid of CIELAB cells of
+ * COLOR_GRID_CELL_SIZE. Colors are kept sorted by cell, with their L, a and b
+ * values in separate arrays, so a query only measures the colors of the
+ * cells its distance reaches, a few contiguous runs at a time with the
+ * ColorLab batch kernels. The entry positions of all colors share one array,
+ * grouped in color order, since most custom colors are recorded only once
+ */
+class ColorGrid {
+public:
+    ColorGrid();
+    
+    /**
+     * Remove all indexed entries
+     */
+    void clear();
+    
+    /**
+     * Index the color of an entry
+     * @param rgb color as 0xRRGGBB
+     * @param position position of the entry
+     */
+    void add(uint32_t rgb, uint32_t position);
+    
+    /**
+     * Remove the color of an entry replaced in place
+     * @param rgb color the entry had
+     * @param position position of the entry
+     */
+    void remove(uint32_t rgb, uint32_t position);
+    
+    /**
+     * Remove an entry and shift the positions of the entries after it
+     * @param position position of the removed entry
+     */
+    void removeAndShift(uint32_t position);
+    
+    /**
+     * Get positions of entries with a color within a distance of a target
+     * @param target color to look for
+     * @param maxDistance largest CIELAB distance matched
+     * @param positions bitmap to fill
+     */
+    void find(const LabColor& target, float maxDistance, Bitmap& positions) const;
+    
+    /**
+     * Count entries with a color within a distance of a target
+     * @param target color to look for
+     * @param maxDistance largest CIELAB distance matched
+     * @return number of entries
+     */
+    size_t count(const LabColor& target, float maxDistance) const;
+    
+    /**
+     * Get the number of distinct colors indexed
+     * @return number of colors
+     */
+    size_t getColorCount() const {
+        return _keys.size();
+    }
+    
+    /**
+     * Get the heap memory used by the index
+     * @return bytes used
+     */
+    size_t getMemoryUsage() const;
+    
+    /**
+     * Append the index to a buffer saved with the database file
+     * @param out buffer to append to
+     */
+    void serialize(std::vector<uint8_t>& out) const;
+    
+    /**
+     * Read an index written by serialize
+     * @param p read position, advanced past the index
+     * @param end end of the buffer
+     * @return true if successful, false if the data is truncated
+     */
+    bool deserialize(const uint8_t*& p, const uint8_t* end);
+
+private:
+    struct ColorKey {
+        uint32_t cell;
+        uint32_t rgb;
+    };
+    
+    // Sorted by cell, then RGB value; the CIELAB components and the start of
+    // each color's positions run in parallel
+    std::vector<ColorKey> _keys;
+    std::vector<float> _l;
+    std::vector<float> _a;
+    std::vector<float> _b;
+    std::vector<uint32_t> _starts;      // One more than the colors, ending at _positions.size()
+    std::vector<uint32_t> _positions;   // Sorted within each color
+    
+    size_t findKey(uint32_t rgb, uint32_t cell) const;
+    void eraseKey(size_t index);
+    
+    template <typename Func>
+    void forEachMatch(const LabColor& target, float maxDistance, Func func) const;
+    
+    static uint32_t cellOf(const LabColor& color);
+};
+
+#endif // DATA_COLOR_GRID_H
@@ -0,0 +1,92 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - CIELAB Colors Implementation
+ */
+
+#include "color_lab.h"
+#include <math.h>
+
+// Colors handled per pass of findWithin: distances go to a buffer on the
+// stack in one vectorizable loop, then matches are picked out of it
+static const size_t KERNEL_BATCH = 32;
+
+// D65 reference white
+static const float WHITE_X = 0.95047f;
+static const float WHITE_Y = 1.0f;
+static const float WHITE_Z = 1.08883f;
+
+// sRGB channel value to linear light, computed once per channel value
+static const float* linearTable() {
+    static float table[256];
+    static bool built = false;
+    if (!built) {
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+        }
+        built = true;
+    }
+    return table;
+}
+
+static float labCurve(float t) {
+    return t > 0.008856f ? cbrtf(t) : 7.787f * t + 16.0f / 116.0f;
+}
+
+LabColor ColorLab::fromRgb(uint32_t rgb) {
+    const float* linear = linearTable();
+    float r = linear[(rgb >> 16) & 0xFF];
+    float g = linear[(rgb >> 8) & 0xFF];
+    float b = linear[rgb & 0xFF];
+    
+    float x = labCurve((0.4124564f * r + 0.3575761f * g + 0.1804375f * b) / WHITE_X);
+    float y = labCurve((0.2126729f * r + 0.7151522f * g + 0.0721750f * b) / WHITE_Y);
+    float z = labCurve((0.0193339f * r + 0.1191920f * g + 0.9503041f * b) / WHITE_Z);
+    
+    LabColor lab;
+    lab.l = 116.0f * y - 16.0f;
+    lab.a = 500.0f * (x - y);
+    lab.b = 200.0f * (y - z);
+    return lab;
+}
+
+float ColorLab::distance(const LabColor& x, const LabColor& y) {
+    float dl = x.l - y.l;
+    float da = x.a - y.a;
+    float db = x.b - y.b;
+    return sqrtf(dl * dl + da * da + db * db);
+}
+
+void ColorLab::distancesSquared(const float* l, const float* a, const float* b, size_t count,
+                                const LabColor& target, float* distances) {
+    const float tl = target.l;
+    const float ta = target.a;
+    const float tb = target.b;
+    for (size_t i = 0; i < count; i++) {
+        float dl = l[i] - tl;
+        float da = a[i] - ta;
+        float db = b[i] - tb;
+        distances[i] = dl * dl + da * da + db * db;
+    }
+}
+
+size_t ColorLab::findWithin(const float* l, const float* a, const float* b, size_t count,
+                            const LabColor& target, float maxDistance, uint32_t* matches) {
+    float limit = maxDistance * maxDistance;
+    float distances[KERNEL_BATCH];
+    size_t found = 0;
+    
+    for (size_t first = 0; first < count; first += KERNEL_BATCH) {
+        size_t n = count - first < KERNEL_BATCH ? count - first : KERNEL_BATCH;
+        distancesSquared(l + first, a + first, b + first, n, target, distances);
+        
+        // Written unconditionally and kept only on a match, so the loop has
+        // no branch to mispredict
+        for (size_t i = 0; i < n; i++) {
+            matches[found] = (uint32_t)(first + i);
+            found += distances[i] <= limit;
+        }
+    }
+    
+    return found;
+}
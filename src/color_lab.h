@@ -0,0 +1,73 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - CIELAB Colors
+ * 
+ * This file contains the conversion of recorded RGB colors to CIELAB and
+ * the distance kernels used by color similarity search
+ */
+
+#ifndef DATA_COLOR_LAB_H
+#define DATA_COLOR_LAB_H
+
+#include <Arduino.h>
+#include "../config.h"
+
+// A color in CIELAB: lightness 0 to 100, a green to red, b blue to yellow
+struct LabColor {
+    float l;
+    float a;
+    float b;
+};
+
+/**
+ * CIELAB conversion and distances. Distance is the CIE76 color difference,
+ * the straight-line distance in CIELAB, where about 2.3 is the smallest
+ * difference most people notice and colors that get the same name are
+ * usually within 20 or so. The batch kernels work on separate arrays of L,
+ * a and b values, so the compiler can vectorize them
+ */
+class ColorLab {
+public:
+    /**
+     * Convert a 24-bit sRGB color (D65 white point)
+     * @param rgb color as 0xRRGGBB
+     * @return color in CIELAB
+     */
+    static LabColor fromRgb(uint32_t rgb);
+    
+    /**
+     * Get the CIE76 distance between two colors
+     * @param x first color
+     * @param y second color
+     * @return color difference
+     */
+    static float distance(const LabColor& x, const LabColor& y);
+    
+    /**
+     * Get the squared distances from a color to a batch of colors
+     * @param l lightness of each color
+     * @param a a component of each color
+     * @param b b component of each color
+     * @param count number of colors
+     * @param target color to measure from
+     * @param distances set to count squared distances
+     */
+    static void distancesSquared(const float* l, const float* a, const float* b, size_t count,
+                                 const LabColor& target, float* distances);
+    
+    /**
+     * Find the colors of a batch within a distance of a color
+     * @param l lightness of each color
+     * @param a a component of each color
+     * @param b b component of each color
+     * @param count number of colors
+     * @param target color to measure from
+     * @param maxDistance largest distance matched
+     * @param matches set to the indexes of the matching colors, room for count needed
+     * @return number of matches
+     */
+    static size_t findWithin(const float* l, const float* a, const float* b, size_t count,
+                             const LabColor& target, float maxDistance, uint32_t* matches);
+};
+
+#endif // DATA_COLOR_LAB_H
@@ -149,21 +149,21 @@ void ColorScreen::update(lv_obj_t* screen) {
     // Update selected color based on screen type
     switch (_currentType) {
         case COLOR_SCREEN_SHIRT: {
-            ColorInfo color = _currentEntry.getShirtColor();
+            const ColorInfo& color = _currentEntry.getShirtColor();
             if (!color.name.isEmpty()) {
                 ColorPicker::setSelectedColor(colorPicker, color.name);
             }
             break;
         }
         case COLOR_SCREEN_PANTS: {
-            ColorInfo color = _currentEntry.getPantsColor();
+            const ColorInfo& color = _currentEntry.getPantsColor();
             if (!color.name.isEmpty()) {
                 ColorPicker::setSelectedColor(colorPicker, color.name);
             }
             break;
         }
         case COLOR_SCREEN_SHOES: {
-            ColorInfo color = _currentEntry.getShoesColor();
+            const ColorInfo& color = _currentEntry.getShoesColor();
             if (!color.name.isEmpty()) {
                 ColorPicker::setSelectedColor(colorPicker, color.name);
             }
@@ -176,7 +176,7 @@ void ColorScreen::setCurrentEntry(const LogEntry& entry) {
     _currentEntry = entry;
 }
 
-LogEntry ColorScreen::getCurrentEntry() {
+const LogEntry& ColorScreen::getCurrentEntry() {
     return _currentEntry;
 }
 
@@ -0,0 +1,143 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Block Compression Implementation
+ */
+
+#include "compression.h"
+
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+static const size_t HASH_BITS = 12;
+static const uint32_t NO_POSITION = 0xFFFFFFFF;
+
+// Each sequence starts with a token holding the literal count in the high
+// nibble and the match length minus MIN_MATCH in the low nibble; a nibble of
+// 15 continues in extra bytes. The last sequence has literals only
+static const uint8_t NIBBLE_MAX = 15;
+
+static uint32_t hashAt(const uint8_t* p) {
+    uint32_t value = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void Compression::compress(const uint8_t* data, size_t len, std::vector<uint8_t>& out) {
+    // Most recent position of each 4-byte hash
+    std::vector<uint32_t> table((size_t)1 << HASH_BITS, NO_POSITION);
+    
+    size_t anchor = 0;
+    size_t pos = 0;
+    
+    while (pos + MIN_MATCH <= len) {
+        uint32_t hash = hashAt(data + pos);
+        uint32_t candidate = table[hash];
+        table[hash] = pos;
+        
+        if (candidate == NO_POSITION || pos - candidate > MAX_OFFSET ||
+            memcmp(data + candidate, data + pos, MIN_MATCH) != 0) {
+            pos++;
+            continue;
+        }
+        
+        size_t matchLen = MIN_MATCH;
+        while (pos + matchLen < len && data[candidate + matchLen] == data[pos + matchLen]) {
+            matchLen++;
+        }
+        
+        size_t literals = pos - anchor;
+        size_t extra = matchLen - MIN_MATCH;
+        out.push_back((uint8_t)((literals < NIBBLE_MAX ? literals : NIBBLE_MAX) << 4 |
+                                (extra < NIBBLE_MAX ? extra : NIBBLE_MAX)));
+        if (literals >= NIBBLE_MAX) {
+            putLength(out, literals - NIBBLE_MAX);
+        }
+        out.insert(out.end(), data + anchor, data + pos);
+        
+        size_t offset = pos - candidate;
+        out.push_back((uint8_t)offset);
+        out.push_back((uint8_t)(offset >> 8));
+        if (extra >= NIBBLE_MAX) {
+            putLength(out, extra - NIBBLE_MAX);
+        }
+        
+        pos += matchLen;
+        anchor = pos;
+    }
+    
+    // Trailing literals
+    size_t literals = len - anchor;
+    out.push_back((uint8_t)((literals < NIBBLE_MAX ? literals : NIBBLE_MAX) << 4));
+    if (literals >= NIBBLE_MAX) {
+        putLength(out, literals - NIBBLE_MAX);
+    }
+    out.insert(out.end(), data + anchor, data + len);
+}
+
+bool Compression::decompress(const uint8_t* data, size_t len, uint8_t* out, size_t outLen) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    size_t written = 0;
+    
+    while (p < end) {
+        uint8_t token = *p++;
+        
+        size_t literals = token >> 4;
+        if (literals == NIBBLE_MAX && !getLength(p, end, literals)) {
+            return false;
+        }
+        if (literals > (size_t)(end - p) || literals > outLen - written) {
+            return false;
+        }
+        memcpy(out + written, p, literals);
+        p += literals;
+        written += literals;
+        
+        if (p == end) {
+            break;
+        }
+        
+        if (end - p < 2) {
+            return false;
+        }
+        size_t offset = (size_t)p[0] | ((size_t)p[1] << 8);
+        p += 2;
+        
+        size_t matchLen = token & NIBBLE_MAX;
+        if (matchLen == NIBBLE_MAX && !getLength(p, end, matchLen)) {
+            return false;
+        }
+        matchLen += MIN_MATCH;
+        
+        if (offset == 0 || offset > written || matchLen > outLen - written) {
+            return false;
+        }
+        
+        // Byte by byte, since a match may overlap the bytes it produces
+        for (size_t i = 0; i < matchLen; i++) {
+            out[written + i] = out[written - offset + i];
+        }
+        written += matchLen;
+    }
+    
+    return written == outLen;
+}
+
+void Compression::putLength(std::vector<uint8_t>& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back((uint8_t)length);
+}
+
+bool Compression::getLength(const uint8_t*& p, const uint8_t* end, size_t& length) {
+    uint8_t byte;
+    do {
+        if (p >= end) {
+            return false;
+        }
+        byte = *p++;
+        length += byte;
+    } while (byte == 255);
+    
+    return true;
+}
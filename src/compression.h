@@ -0,0 +1,46 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Block Compression
+ * 
+ * This file contains a small LZ77 block codec used to shrink archived entries
+ * on the SD card
+ */
+
+#ifndef DATA_COMPRESSION_H
+#define DATA_COMPRESSION_H
+
+#include <Arduino.h>
+#include <vector>
+#include "../config.h"
+
+/**
+ * LZ4-style block codec: a sequence of literal runs and back references
+ * into the previous 64 KB. Compression is greedy and single-pass, which
+ * suits the repetitive color names and item text in log entries
+ */
+class Compression {
+public:
+    /**
+     * Compress a block of data
+     * @param data data to compress
+     * @param len length of data
+     * @param out vector the compressed block is appended to
+     */
+    static void compress(const uint8_t* data, size_t len, std::vector<uint8_t>& out);
+    
+    /**
+     * Decompress a block produced by compress
+     * @param data compressed block
+     * @param len length of compressed block
+     * @param out buffer for the original data
+     * @param outLen exact length of the original data
+     * @return true if successful, false if the block is corrupt
+     */
+    static bool decompress(const uint8_t* data, size_t len, uint8_t* out, size_t outLen);
+
+private:
+    static void putLength(std::vector<uint8_t>& out, size_t length);
+    static bool getLength(const uint8_t*& p, const uint8_t* end, size_t& length);
+};
+
+#endif // DATA_COMPRESSION_H
@@ -34,8 +34,51 @@
 // Data management configuration
 #define DATABASE_FILENAME "/loss_prevention.db"
 #define LOG_FILENAME "/loss_prevention_log.txt"
-#define MAX_LOG_ENTRIES 1000
+#define DATABASE_JOURNAL_FILENAME "/loss_prevention.jnl"
+#define DATABASE_STATS_FILENAME "/loss_prevention.sts"  // Counters of archived entries, see EntryStats
+#define DATABASE_SEGMENT_PREFIX "/loss_prevention.s"  // Sealed journal segments, numbered by sequence
+#define DATABASE_IMPORT_PREFIX "/loss_prevention.i"  // Archive blocks staged by an import, numbered in file order
+#define DATABASE_COMPACT_FILENAME DATABASE_FILENAME STORAGE_TEMP_SUFFIX  // Compaction output, installed like an atomic write
+#define DATABASE_SEGMENT_RECORDS 200  // Journal records before the journal is sealed as a segment
+#define DATABASE_COMPACT_SEGMENTS 4  // Sealed segments before compaction is wanted
+#define DATABASE_MAX_SEGMENTS 16  // Sealed segments before a blocking checkpoint is forced
+#define DATABASE_COMPACT_STEP_MS 4  // Time budget for one compaction step
+#define DATABASE_COMPACT_CHUNK_SIZE 2048  // Bytes written per compaction append
+#define DATABASE_BATCH_CHUNK_SIZE 8192  // Bytes written per batch journal append
+#define DATABASE_BATCH_REBUILD_DELETES 8  // Deletes in one batch past which the indexes are rebuilt instead
+#define DATABASE_COMMIT_WINDOW_MS 2000  // Longest a change is held in memory before it is written, the most a power loss can lose
+#define DATABASE_COMMIT_MAX_RECORDS 32  // Journal records held in memory before the main loop writes them early
+#define DATABASE_MAINTENANCE_IDLE_MS 5000  // UI inactivity before compaction and archiving run on battery
+#define MAX_LOG_ENTRIES 1000  // Entries kept in memory before the oldest are archived
+#define MAX_COLOR_NAME_LENGTH 31  // Bytes kept of a color name, longer names are truncated
+#define MAX_ITEM_DESCRIPTION_LENGTH 127  // Bytes kept of an item description, longer text is truncated
+#define MAX_NOTES_LENGTH 255  // Bytes kept of an entry's notes, longer text is truncated
+#define ENTRY_TEXT_COMPACT_BYTES 4096  // Freed description and notes bytes before the text arena is compacted
+#define TEXT_ARENA_BLOCK_SIZE 4096  // Bytes per entry text block, allocated from PSRAM when the board has it
+#define RETENTION_HOT_DAYS 90  // Age after which entries are archived even below MAX_LOG_ENTRIES
+#define STATS_COLOR_SLOTS 16  // Colors counted apart per clothing attribute, the last slot shared by any further colors
+#define TRENDS_COUNTERS 32  // Descriptions or color combinations tracked per trend bucket
+#define TRENDS_LABEL_LENGTH 47  // Bytes kept of a trend label
+#define TRENDS_SHIFT_HOURS 8  // Hourly buckets in the last shift trend window, the current hour included
+#define TRENDS_WEEK_DAYS 7  // Daily buckets in the last week trend window, the current day included
+#define COLOR_GRID_CELL_SIZE 10  // Edge of a color index grid cell, in CIELAB distance units
+#define COLOR_NEAR_DISTANCE 20  // CIELAB distance within which colors count as similar by default
+#define ARCHIVE_DIR "/archive"
+#define ARCHIVE_CATALOG_FILENAME "/archive/catalog.lpc"
+#define ARCHIVE_SEGMENT_PREFIX "/archive/lp_"
+#define ARCHIVE_RESTORE_FILENAME "/archive/restore.lpc"  // Catalog of a staged replacement, installed by Archive::recover if interrupted
+#define ARCHIVE_SEGMENT_ENTRIES 200  // Entries per compressed archive segment
+#define ARCHIVE_MIN_AGED_ENTRIES 50  // Aged entries needed before they are archived on age alone
+#define STORAGE_READ_BUFFER_SIZE 4096  // Chunk size for streaming file reads
+#define STORAGE_TEMP_SUFFIX ".new"  // Temporary file an atomic write goes to before the rename
 #define BACKUP_INTERVAL 86400000  // 24 hours in ms
+#define BACKUP_DIR "/backup"
+#define BACKUP_CHUNK_DIR "/backup/chunks"
+#define BACKUP_MANIFEST_PREFIX "/backup/manifest_"
+#define BACKUP_INDEX_FILENAME "/backup/backups.lpi"
+#define BACKUP_CHUNK_ENTRIES 32  // Average hot entries per deduplicated backup chunk
+#define BACKUP_CHUNK_MAX_ENTRIES 128  // Hot entries after which a backup chunk is always cut
+#define BACKUP_FULL_INTERVAL 16  // Backups chained onto a parent before a full manifest is written
 
 // WiFi configuration
 #define MAX_WIFI_NETWORKS 5
@@ -159,7 +159,7 @@ void ConfirmScreen::setCurrentEntry(const LogEntry& entry) {
     _currentEntry = entry;
 }
 
-LogEntry ConfirmScreen::getCurrentEntry() {
+const LogEntry& ConfirmScreen::getCurrentEntry() {
     return _currentEntry;
 }
 
@@ -167,6 +167,11 @@ void ConfirmScreen::_saveBtnClickHandler(lv_event_t* e) {
     // Set current timestamp
     _currentEntry.setTimestamp(RtcHAL::getCurrentTime());
     
+    // Give the entry its ID here, so the copy queued for sync carries it
+    if (_currentEntry.getId() == 0) {
+        _currentEntry.setId(Database::generateId());
+    }
+    
     // Save entry to database
     if (Database::addEntry(_currentEntry)) {
         // Queue for sync if WiFi is connected
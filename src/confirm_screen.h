@@ -42,7 +42,7 @@ public:
      * Get current log entry
      * @return current log entry
      */
-    static LogEntry getCurrentEntry();
+    static const LogEntry& getCurrentEntry();
 
 private:
     static LogEntry _currentEntry;
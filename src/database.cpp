@@ -4,11 +4,162 @@
  */
 
 #include "database.h"
+#include "../hal/rtc.h"
+#include <algorithm>
+#include <limits>
 
 // Static member initialization
 bool Database::_initialized = false;
-std::vector<LogEntry> Database::_entries;
+EntryTable Database::_entries;
+EntryIndex Database::_index;
+uint32_t Database::_generation = 0;
 bool Database::_dirty = false;
+size_t Database::_journalRecords = 0;
+uint32_t Database::_fileCrc = 0;
+size_t Database::_fileLength = 0;
+bool Database::_needsMigration = false;
+uint32_t Database::_baseSequence = 0;
+uint32_t Database::_sequence = 0;
+uint64_t Database::_lastId = 0;
+EntryStats Database::_stats;
+EntryStats Database::_archiveStats;
+EntryTrends Database::_trends;
+size_t Database::_statsSegments = 0;
+uint32_t Database::_statsSegmentCrc = 0;
+std::vector<uint8_t> Database::_pendingJournal;
+size_t Database::_pendingRecords = 0;
+uint32_t Database::_pendingSince = 0;
+uint32_t Database::_commitWindowMs = DATABASE_COMMIT_WINDOW_MS;
+CommitStats Database::_commitStats = {};
+bool Database::_compacting = false;
+uint32_t Database::_compactSequence = 0;
+size_t Database::_compactCursor = 0;
+size_t Database::_compactEnd = 0;
+size_t Database::_compactLength = 0;
+uint32_t Database::_compactCrc = 0;
+std::vector<uint8_t> Database::_compactIndex;
+size_t Database::_compactIndexCursor = 0;
+std::vector<Database::CompactGhost> Database::_compactGhosts;
+
+// Database file header: magic followed by uint16 format version and uint16 reserved.
+// Version 2 adds the uint32 sequence of the last segment folded into the file.
+// Version 3 adds the uint32 entry count, and the entries are followed by the
+// saved indexes as [uint32 length][EntryIndex data]
+static const uint8_t DATABASE_MAGIC[4] = {'L', 'P', 'D', 'B'};
+static const uint16_t DATABASE_FORMAT_VERSION = 3;
+static const size_t DATABASE_HEADER_SIZE = 8;
+static const size_t DATABASE_SEQUENCE_SIZE = 4;
+static const size_t DATABASE_COUNT_SIZE = 4;
+
+// Statistics file: magic, uint16 version, uint16 reserved, uint32 archive
+// segments counted, uint32 raw CRC of the last of them, EntryStats data and
+// a CRC-32 of everything before it
+static const uint8_t STATS_MAGIC[4] = {'L', 'P', 'S', 'T'};
+static const uint16_t STATS_FORMAT_VERSION = 2;
+static const size_t STATS_HEADER_SIZE = 16;
+
+// Journal record types
+static const uint8_t JOURNAL_HEADER = 'H';
+static const uint8_t JOURNAL_ADD = 'A';
+static const uint8_t JOURNAL_DELETE = 'D';
+static const uint8_t JOURNAL_UPDATE = 'U';
+static const uint8_t JOURNAL_RETIRE = 'R';
+static const uint8_t JOURNAL_BATCH = 'B';
+
+// Batches hold their operations in journal encoding
+static_assert(BATCH_ADD == JOURNAL_ADD && BATCH_DELETE == JOURNAL_DELETE && BATCH_UPDATE == JOURNAL_UPDATE,
+              "batch operations must use the journal record types");
+
+// Journal records carry a one-byte type before the length
+static const int NO_RECORD_TYPE = -1;
+
+static void putUint(std::vector<uint8_t>& out, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static uint32_t getUint(const uint8_t* p, size_t bytes) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint32_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+// Records are framed as [type][uint16 payload length][payload][uint32 CRC of
+// everything before it]. beginRecord reserves the payload and returns the
+// record start; the caller fills the last payloadLen bytes, then calls endRecord.
+static size_t beginRecord(std::vector<uint8_t>& out, int type, size_t payloadLen) {
+    size_t start = out.size();
+    if (type != NO_RECORD_TYPE) {
+        out.push_back((uint8_t)type);
+    }
+    putUint(out, payloadLen, 2);
+    out.resize(out.size() + payloadLen);
+    return start;
+}
+
+static void appendFileHeader(std::vector<uint8_t>& out, uint32_t sequence, size_t count) {
+    out.insert(out.end(), DATABASE_MAGIC, DATABASE_MAGIC + sizeof(DATABASE_MAGIC));
+    putUint(out, DATABASE_FORMAT_VERSION, 2);
+    putUint(out, 0, 2);
+    putUint(out, sequence, DATABASE_SEQUENCE_SIZE);
+    putUint(out, count, DATABASE_COUNT_SIZE);
+}
+
+static void appendIndexSection(std::vector<uint8_t>& out, const EntryIndex& index) {
+    size_t start = out.size();
+    putUint(out, 0, 4);
+    index.serialize(out);
+    
+    uint32_t len = out.size() - start - 4;
+    for (size_t i = 0; i < 4; i++) {
+        out[start + i] = (uint8_t)(len >> (8 * i));
+    }
+}
+
+static void endRecord(std::vector<uint8_t>& out, size_t start) {
+    putUint(out, StorageHAL::crc32(&out[start], out.size() - start), 4);
+}
+
+static void appendRecord(std::vector<uint8_t>& out, int type, const uint8_t* payload, size_t len) {
+    size_t start = beginRecord(out, type, len);
+    memcpy(&out[out.size() - len], payload, len);
+    endRecord(out, start);
+}
+
+static void appendEntryRecord(std::vector<uint8_t>& out, int type, const LogEntry& entry) {
+    size_t size = entry.getBinarySize();
+    size_t start = beginRecord(out, type, size);
+    entry.serializeBinary(&out[out.size() - size], size);
+    endRecord(out, start);
+}
+
+// Read one framed record into the scratch buffer, returning false if it is
+// truncated or corrupt. payload points into record on success.
+static bool readRecord(StorageReader& reader, bool typed, std::vector<uint8_t>& record,
+                       uint8_t& type, const uint8_t*& payload, size_t& len) {
+    size_t prefix = (typed ? 1 : 0) + 2;
+    record.resize(prefix);
+    if (reader.read(record.data(), prefix) != prefix) {
+        return false;
+    }
+    
+    type = typed ? record[0] : 0;
+    len = getUint(&record[prefix - 2], 2);
+    record.resize(prefix + len + 4);
+    if (reader.read(&record[prefix], len + 4) != len + 4) {
+        return false;
+    }
+    
+    if (getUint(&record[prefix + len], 4) != StorageHAL::crc32(record.data(), prefix + len)) {
+        return false;
+    }
+    
+    payload = &record[prefix];
+    return true;
+}
 
 bool Database::init() {
     DEBUG_PRINT("Initializing database...");
@@ -30,9 +181,44 @@ bool Database::init() {
     if (!loadFromFile()) {
         DEBUG_PRINT("No existing database found, creating new one");
     }
+    _dirty = false;
+    
+    // Indexes saved with the file are used as loaded; older or damaged files
+    // are indexed here, and replay keeps the index current from then on
+    if (_index.size() != _entries.size()) {
+        _index.rebuild(_entries);
+    }
+    
+    // Apply changes journaled since the last checkpoint
+    if (!replayJournal()) {
+        DEBUG_PRINT("Failed to replay database journal");
+    }
+    
+    // Rewrite a legacy text database in the binary format
+    if (_needsMigration) {
+        DEBUG_PRINT("Migrating text database to binary format");
+        _dirty = true;
+        checkpoint();
+    }
+    
+    // Settle an archive segment written just before a crash
+    if (!Archive::recover(_entries)) {
+        DEBUG_PRINT("Failed to recover entry archive");
+    }
+    
+    // Entries saved before IDs existed are given them once and saved
+    size_t assigned = assignMissingIds();
+    if (assigned > 0) {
+        DEBUG_PRINTF("Assigned IDs to %d entries", assigned);
+        _dirty = true;
+        checkpoint();
+    }
+    
+    // Counters of archived entries come from their file; the hot tier is
+    // small enough to count here
+    refreshStats();
     
     _initialized = true;
-    _dirty = false;
     
     DEBUG_PRINTF("Database initialized with %d entries", _entries.size());
     return true;
@@ -45,148 +231,382 @@ bool Database::addEntry(const LogEntry& entry) {
         }
     }
     
-    _entries.push_back(entry);
-    _dirty = true;
+    // The ID is part of the journaled record, so it is settled first
+    size_t existing;
+    if (entry.getId() == 0 || _entries.findId(entry.getId(), existing)) {
+        LogEntry copy = entry;
+        copy.setId(generateId());
+        return addEntry(copy);
+    }
+    _lastId = std::max(_lastId, entry.getId());
+    
+    // Archive inline only when idle-time archiving has fallen far behind
+    if (_entries.size() >= MAX_LOG_ENTRIES + ARCHIVE_SEGMENT_ENTRIES) {
+        retireEntries(ARCHIVE_SEGMENT_ENTRIES);
+    }
+    
+    // Journal the new entry instead of rewriting the database file. It is
+    // added only once journaled, so a failed save leaves memory as stored
+    std::vector<uint8_t> payload(entry.getBinarySize());
+    entry.serializeBinary(payload.data(), payload.size());
     
-    // Save to file
-    if (!saveToFile()) {
+    if (!journalChange(JOURNAL_ADD, payload.data(), payload.size())) {
         DEBUG_PRINT("Failed to save database after adding entry");
         return false;
     }
     
+    _entries.add(entry);
+    _index.add(_entries.size() - 1, entry);
+    _stats.add(entry);
+    _trends.add(entry);
+    _dirty = true;
+    
     DEBUG_PRINTF("Added entry, total entries: %d", _entries.size());
     return true;
 }
 
+bool Database::addEntries(const std::vector<LogEntry>& entries) {
+    DatabaseBatch batch;
+    batch.reserve(entries.size());
+    for (const auto& entry : entries) {
+        batch.add(entry);
+    }
+    
+    return commit(batch);
+}
+
+bool Database::commit(const DatabaseBatch& batch) {
+    if (!_initialized) {
+        if (!init()) {
+            return false;
+        }
+    }
+    
+    if (batch.isEmpty()) {
+        return true;
+    }
+    
+    const std::vector<uint8_t>& operations = batch.getOperations();
+    if (!applyBatch(operations.data(), operations.size())) {
+        DEBUG_PRINT("Invalid batch, not committed");
+        return false;
+    }
+    
+    // Journal the whole batch with one append instead of one per change
+    if (!appendJournalBatch(batch)) {
+        DEBUG_PRINT("Failed to save database after committing batch");
+        return false;
+    }
+    
+    // Archive inline only when idle-time archiving has fallen far behind
+    while (_entries.size() >= MAX_LOG_ENTRIES + ARCHIVE_SEGMENT_ENTRIES) {
+        if (!retireEntries(ARCHIVE_SEGMENT_ENTRIES)) {
+            break;
+        }
+    }
+    
+    DEBUG_PRINTF("Committed %d changes, total entries: %d", batch.size(), _entries.size());
+    return true;
+}
+
 bool Database::getEntry(size_t index, LogEntry& entry) {
     if (!_initialized || index >= _entries.size()) {
         return false;
     }
     
-    entry = _entries[index];
+    _entries.get(index, entry);
     return true;
 }
 
-std::vector<LogEntry> Database::getAllEntries() {
+uint64_t Database::generateId() {
+    // The last ID is known once the entries are loaded
+    if (!_initialized) {
+        init();
+    }
+    
+    // Seconds in the upper half keep IDs in time order; the lower half counts
+    // IDs made within one second, or all of them while the clock is unset
+    time_t now = RtcHAL::getTime();
+    uint64_t id = now > 0 ? (uint64_t)now << 32 : 0;
+    _lastId = std::max(id, _lastId + 1);
+    return _lastId;
+}
+
+bool Database::findEntry(uint64_t id, size_t& index) {
     if (!_initialized) {
         if (!init()) {
-            return std::vector<LogEntry>();
+            return false;
         }
     }
     
-    return _entries;
+    return _entries.findId(id, index);
 }
 
-std::vector<LogEntry> Database::getEntriesByDateRange(time_t startTime, time_t endTime) {
-    std::vector<LogEntry> result;
+bool Database::getEntryById(uint64_t id, LogEntry& entry) {
+    size_t index;
+    if (findEntry(id, index)) {
+        return getEntry(index, entry);
+    }
+    return _initialized && id != 0 && Archive::findEntry(id, entry);
+}
+
+std::vector<LogEntry> Database::getAllEntries() {
+    std::vector<LogEntry> entries;
     
     if (!_initialized) {
         if (!init()) {
-            return result;
+            return entries;
         }
     }
     
-    for (const auto& entry : _entries) {
-        time_t timestamp = entry.getTimestamp();
+    Archive::forEach(std::numeric_limits<time_t>::min(), std::numeric_limits<time_t>::max(), [&entries](const LogEntry& entry) {
+        entries.push_back(entry);
+        return true;
+    });
+    _entries.getRange(0, _entries.size(), entries);
+    return entries;
+}
+
+bool Database::forEachEntry(time_t startTime, time_t endTime, std::function<bool(const LogEntry&)> callback) {
+    if (!_initialized) {
+        if (!init()) {
+            return false;
+        }
+    }
+    
+    bool stopped = false;
+    bool complete = Archive::forEach(startTime, endTime, [&callback, &stopped](const LogEntry& entry) {
+        stopped = !callback(entry);
+        return !stopped;
+    });
+    
+    // Only entries inside the range are materialized, into one reused object
+    LogEntry entry((time_t)0);
+    for (size_t i = 0; !stopped && i < _entries.size(); i++) {
+        time_t timestamp = _entries.getTimestamp(i);
         if (timestamp >= startTime && timestamp <= endTime) {
-            result.push_back(entry);
+            _entries.get(i, entry);
+            stopped = !callback(entry);
         }
     }
     
-    return result;
+    return complete;
 }
 
-std::vector<LogEntry> Database::getEntriesByGender(Gender gender) {
-    std::vector<LogEntry> result;
+bool Database::forEachArchivedEntry(time_t startTime, time_t endTime, std::function<bool(const LogEntry&)> callback) {
+    if (!_initialized) {
+        if (!init()) {
+            return false;
+        }
+    }
+    
+    return Archive::forEach(startTime, endTime, callback);
+}
+
+ResultSet Database::getPage(size_t offset, size_t limit, PageOrder order, EntryFilter filter) {
+    std::vector<uint32_t> positions;
     
     if (!_initialized) {
         if (!init()) {
-            return result;
+            return ResultSet();
         }
     }
     
-    for (const auto& entry : _entries) {
-        if (entry.getGender() == gender) {
-            result.push_back(entry);
+    positions.reserve(limit);
+    
+    // Without a filter the offset maps straight to a rank in timestamp order
+    size_t skipped = 0;
+    size_t rank = filter ? 0 : offset;
+    for (; rank < _entries.size() && positions.size() < limit; rank++) {
+        time_t timestamp;
+        uint32_t position;
+        _index.getByTimeRank(order == ORDER_OLDEST_FIRST ? rank : _entries.size() - 1 - rank, timestamp, position);
+        
+        if (filter) {
+            if (!filter(position, _entries)) {
+                continue;
+            }
+            if (skipped < offset) {
+                skipped++;
+                continue;
+            }
         }
+        
+        positions.push_back(position);
     }
     
-    return result;
+    return ResultSet(std::move(positions), _generation);
+}
+
+// Archived matches come first, then the in-memory ones found through the indexes
+static std::vector<LogEntry> collectEntries(time_t startTime, time_t endTime,
+                                            std::function<bool(const LogEntry&)> match, const ResultSet& hot) {
+    std::vector<LogEntry> entries;
+    
+    Archive::forEach(startTime, endTime, [&entries, &match](const LogEntry& entry) {
+        if (match(entry)) {
+            entries.push_back(entry);
+        }
+        return true;
+    });
+    
+    entries.reserve(entries.size() + hot.size());
+    hot.forEach([&entries](const LogEntry& entry) {
+        entries.push_back(entry);
+    });
+    return entries;
+}
+
+std::vector<LogEntry> Database::getEntriesByDateRange(time_t startTime, time_t endTime) {
+    return collectEntries(startTime, endTime, [](const LogEntry& entry) {
+        return true;
+    }, selectByDateRange(startTime, endTime));
+}
+
+std::vector<LogEntry> Database::getEntriesByGender(Gender gender) {
+    return collectEntries(std::numeric_limits<time_t>::min(), std::numeric_limits<time_t>::max(), [gender](const LogEntry& entry) {
+        return entry.getGender() == gender;
+    }, selectByGender(gender));
 }
 
 std::vector<LogEntry> Database::getEntriesByItemType(ItemType itemType) {
-    std::vector<LogEntry> result;
+    return collectEntries(std::numeric_limits<time_t>::min(), std::numeric_limits<time_t>::max(), [itemType](const LogEntry& entry) {
+        return entry.getItemType() == itemType;
+    }, selectByItemType(itemType));
+}
+
+std::vector<LogEntry> Database::searchEntries(const String& searchText) {
+    return collectEntries(std::numeric_limits<time_t>::min(), std::numeric_limits<time_t>::max(), [&searchText](const LogEntry& entry) {
+        return TrigramIndex::matches(entry, searchText);
+    }, selectByText(searchText));
+}
+
+ResultSet Database::selectAll() {
+    std::vector<uint32_t> positions;
     
     if (!_initialized) {
         if (!init()) {
-            return result;
+            return ResultSet();
         }
     }
     
-    for (const auto& entry : _entries) {
-        if (entry.getItemType() == itemType) {
-            result.push_back(entry);
-        }
+    positions.resize(_entries.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        positions[i] = i;
     }
     
-    return result;
+    return ResultSet(std::move(positions), _generation);
 }
 
-std::vector<LogEntry> Database::searchEntries(const String& searchText) {
-    std::vector<LogEntry> result;
+ResultSet Database::selectByDateRange(time_t startTime, time_t endTime) {
+    std::vector<uint32_t> positions;
     
     if (!_initialized) {
         if (!init()) {
-            return result;
+            return ResultSet();
         }
     }
     
-    String searchLower = searchText;
-    searchLower.toLowerCase();
+    _index.getByDateRange(startTime, endTime, positions);
+    return ResultSet(std::move(positions), _generation);
+}
+
+ResultSet Database::selectByGender(Gender gender) {
+    std::vector<uint32_t> positions;
     
-    for (const auto& entry : _entries) {
-        // Search in item description
-        String desc = entry.getItemDescription();
-        desc.toLowerCase();
-        if (desc.indexOf(searchLower) >= 0) {
-            result.push_back(entry);
-            continue;
-        }
-        
-        // Search in notes
-        String notes = entry.getNotes();
-        notes.toLowerCase();
-        if (notes.indexOf(searchLower) >= 0) {
-            result.push_back(entry);
-            continue;
+    if (!_initialized) {
+        if (!init()) {
+            return ResultSet();
         }
-        
-        // Search in shirt color
-        String shirtColor = entry.getShirtColor().name;
-        shirtColor.toLowerCase();
-        if (shirtColor.indexOf(searchLower) >= 0) {
-            result.push_back(entry);
-            continue;
+    }
+    
+    _index.getByGender(gender).toPositions(positions);
+    return ResultSet(std::move(positions), _generation);
+}
+
+ResultSet Database::selectByItemType(ItemType itemType) {
+    std::vector<uint32_t> positions;
+    
+    if (!_initialized) {
+        if (!init()) {
+            return ResultSet();
         }
-        
-        // Search in pants color
-        String pantsColor = entry.getPantsColor().name;
-        pantsColor.toLowerCase();
-        if (pantsColor.indexOf(searchLower) >= 0) {
-            result.push_back(entry);
-            continue;
+    }
+    
+    _index.getByItemType(itemType).toPositions(positions);
+    return ResultSet(std::move(positions), _generation);
+}
+
+ResultSet Database::selectByText(const String& searchText) {
+    std::vector<uint32_t> positions;
+    
+    if (!_initialized) {
+        if (!init()) {
+            return ResultSet();
         }
-        
-        // Search in shoes color
-        String shoesColor = entry.getShoesColor().name;
-        shoesColor.toLowerCase();
-        if (shoesColor.indexOf(searchLower) >= 0) {
-            result.push_back(entry);
-            continue;
+    }
+    
+    // Only entries sharing every trigram of the text need checking
+    Bitmap candidates;
+    _index.getTextCandidates(searchText, candidates);
+    
+    candidates.forEach([&positions, &searchText](uint32_t position) {
+        if (TrigramIndex::matches(_entries, position, searchText)) {
+            positions.push_back(position);
         }
+    });
+    
+    return ResultSet(std::move(positions), _generation);
+}
+
+const EntryTable& Database::getEntries() {
+    if (!_initialized) {
+        init();
+    }
+    
+    return _entries;
+}
+
+const EntryIndex& Database::getIndex() {
+    if (!_initialized) {
+        init();
+    }
+    
+    return _index;
+}
+
+const EntryStats& Database::getStats() {
+    if (!_initialized) {
+        init();
+    }
+    
+    return _stats;
+}
+
+const EntryTrends& Database::getTrends() {
+    if (!_initialized) {
+        init();
+    }
+    
+    return _trends;
+}
+
+time_t Database::getWindowTime() {
+    if (!_initialized) {
+        init();
     }
     
-    return result;
+    time_t now = RtcHAL::getTime();
+    time_t newest;
+    uint32_t position;
+    if (_entries.size() > 0 && _index.getByTimeRank(_entries.size() - 1, newest, position)) {
+        now = std::max(now, newest);
+    }
+    return now;
+}
+
+uint32_t Database::getGeneration() {
+    return _generation;
 }
 
 size_t Database::getEntryCount() {
@@ -199,24 +619,98 @@ size_t Database::getEntryCount() {
     return _entries.size();
 }
 
-bool Database::deleteEntry(size_t index) {
-    if (!_initialized || index >= _entries.size()) {
+size_t Database::getTotalEntryCount() {
+    return Archive::getEntryCount() + getEntryCount();
+}
+
+bool Database::updateEntry(size_t index, const LogEntry& entry) {
+    if (!_initialized) {
+        if (!init()) {
+            return false;
+        }
+    }
+    
+    if (index >= _entries.size()) {
+        return false;
+    }
+    
+    // Journal the new content instead of rewriting the database file, before
+    // it replaces the old content in memory
+    std::vector<uint8_t> payload;
+    putUint(payload, (uint32_t)index, 4);
+    size_t offset = payload.size();
+    payload.resize(offset + entry.getBinarySize());
+    entry.serializeBinary(&payload[offset], payload.size() - offset);
+    
+    if (!journalChange(JOURNAL_UPDATE, payload.data(), payload.size())) {
+        DEBUG_PRINT("Failed to save database after updating entry");
         return false;
     }
     
-    _entries.erase(_entries.begin() + index);
+    _index.replace(index, _entries.get(index), entry);
+    _stats.remove(_entries, index);
+    _stats.add(entry);
+    _trends.remove(_entries.get(index));
+    _trends.add(entry);
+    _entries.replace(index, entry);
     _dirty = true;
     
-    // Save to file
-    if (!saveToFile()) {
+    // The compacted file will hold the new content, which the indexes saved
+    // when compaction began do not describe, so it is saved without them
+    if (_compacting && index >= _compactCursor && index < _compactEnd) {
+        _compactIndex.clear();
+        putUint(_compactIndex, 0, 4);
+    }
+    
+    DEBUG_PRINTF("Updated entry at index %d", index);
+    return true;
+}
+
+bool Database::deleteEntry(size_t index) {
+    if (!_initialized) {
+        if (!init()) {
+            return false;
+        }
+    }
+    
+    if (index >= _entries.size()) {
+        return false;
+    }
+    
+    // Journal a tombstone instead of rewriting the database file, before the
+    // entry leaves memory
+    std::vector<uint8_t> payload;
+    putUint(payload, (uint32_t)index, 4);
+    
+    if (!journalChange(JOURNAL_DELETE, payload.data(), payload.size())) {
         DEBUG_PRINT("Failed to save database after deleting entry");
         return false;
     }
     
+    _index.remove(index, _entries.get(index));
+    _stats.remove(_entries, index);
+    _trends.remove(_entries.get(index));
+    if (_compacting) {
+        trackCompactionDelete(index);
+    }
+    _entries.remove(index);
+    _generation++;
+    _dirty = true;
+    
     DEBUG_PRINTF("Deleted entry at index %d, total entries: %d", index, _entries.size());
     return true;
 }
 
+bool Database::updateEntryById(uint64_t id, const LogEntry& entry) {
+    size_t index;
+    return findEntry(id, index) && updateEntry(index, entry);
+}
+
+bool Database::deleteEntryById(uint64_t id) {
+    size_t index;
+    return findEntry(id, index) && deleteEntry(index);
+}
+
 bool Database::deleteAllEntries() {
     if (!_initialized) {
         if (!init()) {
@@ -225,14 +719,24 @@ bool Database::deleteAllEntries() {
     }
     
     _entries.clear();
+    _index.clear();
+    _generation++;
     _dirty = true;
     
-    // Save to file
-    if (!saveToFile()) {
+    // Save to file first, so the archive is only dropped once nothing can
+    // bring back the old hot entries without it
+    if (!checkpoint()) {
         DEBUG_PRINT("Failed to save database after deleting all entries");
         return false;
     }
     
+    bool cleared = Archive::clear();
+    refreshStats();
+    if (!cleared) {
+        DEBUG_PRINT("Failed to delete archived entries");
+        return false;
+    }
+    
     DEBUG_PRINT("Deleted all entries");
     return true;
 }
@@ -249,18 +753,41 @@ bool Database::exportToFile(const String& filename) {
     // Add header
     content = "timestamp|gender|shirt_color|shirt_rgb|pants_color|pants_rgb|shoes_color|shoes_rgb|item_type|item_description|notes\n";
     
-    // Add entries
-    for (const auto& entry : _entries) {
-        content += entry.serialize() + "\n";
+    if (StorageHAL::writeFile(filename.c_str(), content.c_str(), content.length()) < 0) {
+        DEBUG_PRINTF("Failed to export database to file: %s", filename.c_str());
+        return false;
     }
     
-    // Write to file
-    if (StorageHAL::writeFile(filename.c_str(), content.c_str(), content.length()) < 0) {
+    // Add entries from every tier, written in chunks so the archive never
+    // has to fit in memory
+    size_t count = 0;
+    bool failed = false;
+    content = "";
+    
+    auto flush = [&content, &failed, &filename]() {
+        if (content.length() > 0 &&
+            StorageHAL::appendFile(filename.c_str(), content.c_str(), content.length()) != (int)content.length()) {
+            failed = true;
+        }
+        content = "";
+    };
+    
+    forEachEntry(std::numeric_limits<time_t>::min(), std::numeric_limits<time_t>::max(), [&](const LogEntry& entry) {
+        content += entry.serialize() + "\n";
+        count++;
+        if (content.length() >= STORAGE_READ_BUFFER_SIZE) {
+            flush();
+        }
+        return !failed;
+    });
+    flush();
+    
+    if (failed) {
         DEBUG_PRINTF("Failed to export database to file: %s", filename.c_str());
         return false;
     }
     
-    DEBUG_PRINTF("Exported %d entries to file: %s", _entries.size(), filename.c_str());
+    DEBUG_PRINTF("Exported %d entries to file: %s", count, filename.c_str());
     return true;
 }
 
@@ -277,99 +804,960 @@ bool Database::importFromFile(const String& filename) {
         return false;
     }
     
-    // Read file content
-    int fileSize = StorageHAL::getFileSize(filename.c_str());
-    if (fileSize <= 0) {
-        DEBUG_PRINTF("Import file is empty: %s", filename.c_str());
+    // Stream file content
+    StorageReader reader;
+    if (!reader.open(filename.c_str())) {
+        DEBUG_PRINTF("Failed to read import file: %s", filename.c_str());
         return false;
     }
     
-    char* buffer = new char[fileSize + 1];
-    if (StorageHAL::readFile(filename.c_str(), buffer, fileSize + 1) < 0) {
-        DEBUG_PRINTF("Failed to read import file: %s", filename.c_str());
-        delete[] buffer;
+    if (reader.getSize() == 0) {
+        DEBUG_PRINTF("Import file is empty: %s", filename.c_str());
         return false;
     }
     
-    // Parse file content
-    String content = String(buffer);
-    delete[] buffer;
+    // Replace current entries, parsing straight into the table and skipping
+    // the header line. Entries past the hot tier are staged as archive blocks
+    // as they are read, oldest first
+    removeImportBlocks();
+    std::vector<String> blocks;
+    _entries.clear();
+    bool staged = parseText(reader, true, _entries, [&blocks]() {
+        return stageImportBlock(blocks);
+    });
+    reader.close();
+    assignMissingIds();
     
-    // Split into lines
-    std::vector<String> lines;
-    int start = 0;
-    int end = content.indexOf('\n');
+    _index.rebuild(_entries);
+    _generation++;
+    _dirty = true;
     
-    while (end >= 0) {
-        lines.push_back(content.substring(start, end));
-        start = end + 1;
-        end = content.indexOf('\n', start);
+    if (!staged) {
+        DEBUG_PRINT("Failed to stage imported entries for the archive");
+        removeImportBlocks();
+        return false;
     }
     
-    if (start < content.length()) {
-        lines.push_back(content.substring(start));
+    // Save to file first, so a failed save leaves the archive in place
+    if (!checkpoint()) {
+        DEBUG_PRINT("Failed to save database after import");
+        removeImportBlocks();
+        return false;
     }
     
-    // Skip header line
-    if (lines.size() > 0) {
-        lines.erase(lines.begin());
+    bool archived = blocks.empty() ? Archive::clear() : Archive::replace(blocks);
+    removeImportBlocks();
+    refreshStats();
+    if (!archived) {
+        DEBUG_PRINT("Failed to replace archived entries");
+        return false;
     }
     
-    // Parse entries
-    std::vector<LogEntry> importedEntries;
-    for (const auto& line : lines) {
-        if (line.length() > 0) {
-            LogEntry entry;
-            if (entry.deserialize(line)) {
-                importedEntries.push_back(entry);
-            } else {
-                DEBUG_PRINT("Failed to parse entry from import file");
-            }
+    DEBUG_PRINTF("Imported %d entries from file: %s", _entries.size(), filename.c_str());
+    return true;
+}
+
+bool Database::backup() {
+    if (!_initialized) {
+        if (!init()) {
+            return false;
+        }
+    }
+    
+    if (!Backup::create(_entries)) {
+        DEBUG_PRINT("Failed to create database backup");
+        return false;
+    }
+    
+    return true;
+}
+
+bool Database::restoreBackup(time_t pointInTime) {
+    if (!_initialized) {
+        if (!init()) {
+            return false;
         }
     }
     
+    std::vector<LogEntry> restoredEntries;
+    if (!Backup::restore(pointInTime, restoredEntries)) {
+        DEBUG_PRINT("Failed to restore database backup");
+        return false;
+    }
+    
     // Replace current entries
-    _entries = importedEntries;
+    _entries.assign(restoredEntries);
+    assignMissingIds();
+    _index.rebuild(_entries);
+    _generation++;
     _dirty = true;
     
-    // Save to file
-    if (!saveToFile()) {
-        DEBUG_PRINT("Failed to save database after import");
+    // The restore replaced the archive as well
+    refreshStats();
+    
+    if (!checkpoint()) {
+        DEBUG_PRINT("Failed to save database after restore");
         return false;
     }
     
-    DEBUG_PRINTF("Imported %d entries from file: %s", _entries.size(), filename.c_str());
     return true;
 }
 
-bool Database::backup() {
+bool Database::checkpoint() {
+    cancelCompaction();
+    
+    // The open journal is folded in too, which uses up its sequence number
+    uint32_t sequence = _journalRecords > 0 ? _sequence + 1 : _sequence;
+    if (!saveToFile(sequence)) {
+        DEBUG_PRINT("Failed to checkpoint database");
+        return false;
+    }
+    
+    // Everything journaled so far is now part of the database file
+    removeSegments(_baseSequence + 1, _sequence);
+    if (StorageHAL::fileExists(DATABASE_JOURNAL_FILENAME)) {
+        StorageHAL::deleteFile(DATABASE_JOURNAL_FILENAME);
+    }
+    _baseSequence = sequence;
+    _sequence = sequence;
+    _journalRecords = 0;
+    _pendingJournal.clear();
+    _pendingRecords = 0;
+    
+    // Entries retired without their removal reaching storage are gone from
+    // the file now, so their archive segment can be committed
+    if (Archive::hasPendingSegment() && Archive::commitSegment()) {
+        foldArchiveStats();
+        saveStats();
+    }
+    
+    DEBUG_PRINT("Database checkpoint complete");
+    return true;
+}
+
+bool Database::needsCompaction() {
+    return _compacting || _sequence - _baseSequence >= DATABASE_COMPACT_SEGMENTS;
+}
+
+bool Database::compactStep(uint32_t budgetMs) {
     if (!_initialized) {
-        if (!init()) {
+        return false;
+    }
+    
+    if (!_compacting) {
+        if (!needsCompaction()) {
+            return true;
+        }
+        if (!beginCompaction()) {
             return false;
         }
+        if (!_compacting) {
+            return true;
+        }
     }
     
-    // Create backup filename with timestamp
-    char timestamp[20];
-    time_t now;
-    time(&now);
-    strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", localtime(&now));
+    uint32_t startTime = millis();
+    std::vector<uint8_t> chunk;
+    LogEntry entry((time_t)0);
+    bool done = false;
     
-    String backupFilename = "/backup/loss_prevention_" + String(timestamp) + ".db";
+    // Copy entries in small chunks until the time budget runs out
+    while (!done && millis() - startTime < budgetMs) {
+        chunk.clear();
+        while (chunk.size() < DATABASE_COMPACT_CHUNK_SIZE) {
+            if (!_compactGhosts.empty() && _compactGhosts.front().position == _compactCursor) {
+                appendEntryRecord(chunk, NO_RECORD_TYPE, _compactGhosts.front().entry);
+                _compactGhosts.erase(_compactGhosts.begin());
+            } else if (_compactCursor < _compactEnd) {
+                _entries.get(_compactCursor++, entry);
+                appendEntryRecord(chunk, NO_RECORD_TYPE, entry);
+            } else if (_compactIndexCursor < _compactIndex.size()) {
+                size_t len = std::min(DATABASE_COMPACT_CHUNK_SIZE - chunk.size(), _compactIndex.size() - _compactIndexCursor);
+                chunk.insert(chunk.end(), _compactIndex.begin() + _compactIndexCursor, _compactIndex.begin() + _compactIndexCursor + len);
+                _compactIndexCursor += len;
+            } else {
+                done = true;
+                break;
+            }
+        }
+        
+        if (!chunk.empty() &&
+            StorageHAL::appendFile(DATABASE_COMPACT_FILENAME, (const char*)chunk.data(), chunk.size()) != (int)chunk.size()) {
+            DEBUG_PRINT("Failed to write compacted database file");
+            cancelCompaction();
+            return false;
+        }
+        _compactLength += chunk.size();
+        _compactCrc = StorageHAL::crc32(chunk.data(), chunk.size(), _compactCrc);
+    }
     
-    // Export to backup file
-    if (!exportToFile(backupFilename)) {
-        DEBUG_PRINT("Failed to create database backup");
+    return done ? finishCompaction() : true;
+}
+
+bool Database::beginCompaction() {
+    // Seal the journal so the entries in memory are exactly the database file
+    // plus the sealed segments, which is what the new file will hold
+    if (_journalRecords > 0 && !sealJournal()) {
+        return false;
+    }
+    if (_sequence == _baseSequence) {
+        // Sealing fell back to a checkpoint, leaving nothing to compact
+        return true;
+    }
+    
+    std::vector<uint8_t> header;
+    appendFileHeader(header, _sequence, _entries.size());
+    if (StorageHAL::writeFile(DATABASE_COMPACT_FILENAME, (const char*)header.data(), header.size()) != (int)header.size()) {
+        DEBUG_PRINT("Failed to start compacted database file");
+        return false;
+    }
+    
+    _compacting = true;
+    _compactSequence = _sequence;
+    _compactCursor = 0;
+    _compactEnd = _entries.size();
+    _compactLength = header.size();
+    _compactCrc = StorageHAL::crc32(header.data(), header.size());
+    _compactGhosts.clear();
+    
+    // Saved after the entries, so they describe the file exactly as of this sequence
+    _compactIndex.clear();
+    appendIndexSection(_compactIndex, _index);
+    _compactIndexCursor = 0;
+    
+    DEBUG_PRINTF("Compacting database segments %u-%u", _baseSequence + 1, _sequence);
+    return true;
+}
+
+bool Database::finishCompaction() {
+    _compacting = false;
+    std::vector<uint8_t>().swap(_compactIndex);
+    
+    // Sealed like an atomic write, so recovery in loadFromFile installs it
+    // only once it is complete
+    if (!StorageHAL::sealTempFile(DATABASE_FILENAME, _compactLength, _compactCrc)) {
+        DEBUG_PRINT("Failed to finish compacted database file");
+        cancelCompaction();
+        return false;
+    }
+    if (!StorageHAL::commitTempFile(DATABASE_FILENAME)) {
+        DEBUG_PRINT("Failed to install compacted database file");
+        return false;
+    }
+    
+    removeSegments(_baseSequence + 1, _compactSequence);
+    _baseSequence = _compactSequence;
+    
+    DEBUG_PRINTF("Database compaction complete, %u segments remaining", _sequence - _baseSequence);
+    return true;
+}
+
+void Database::cancelCompaction() {
+    _compacting = false;
+    _compactGhosts.clear();
+    std::vector<uint8_t>().swap(_compactIndex);
+    
+    if (StorageHAL::fileExists(DATABASE_COMPACT_FILENAME)) {
+        StorageHAL::deleteFile(DATABASE_COMPACT_FILENAME);
+    }
+}
+
+void Database::trackCompactionDelete(size_t index) {
+    // Entries added after compaction began are not part of it
+    if (index >= _compactEnd) {
+        return;
+    }
+    
+    auto it = _compactGhosts.begin();
+    if (index < _compactCursor) {
+        // Already copied; the tombstone is replayed on top of the new file
+        _compactCursor--;
+    } else {
+        // Not copied yet, so keep it until the cursor reaches its place
+        it = std::upper_bound(_compactGhosts.begin(), _compactGhosts.end(), index, [](size_t position, const CompactGhost& ghost) {
+            return position < ghost.position;
+        });
+        it = _compactGhosts.insert(it, CompactGhost{index, _entries.get(index)}) + 1;
+    }
+    _compactEnd--;
+    
+    // Later held entries move down along with the entry list
+    for (; it != _compactGhosts.end(); ++it) {
+        it->position--;
+    }
+}
+
+bool Database::needsArchive() {
+    return _initialized && countRetirable() > 0;
+}
+
+bool Database::archiveStep() {
+    if (!_initialized) {
+        return false;
+    }
+    
+    size_t count = countRetirable();
+    return count == 0 || retireEntries(count);
+}
+
+size_t Database::countRetirable() {
+    if (_entries.size() > MAX_LOG_ENTRIES) {
+        return std::min((size_t)ARCHIVE_SEGMENT_ENTRIES, _entries.size());
+    }
+    
+    // Entries past the hot window age go once a worthwhile batch has built up.
+    // Age is measured up to the newest entry at most, so an unset clock
+    // retires nothing and a clock jumping ahead after boot cannot retire the
+    // whole hot tier at once
+    time_t newest;
+    uint32_t position;
+    if (_entries.size() == 0 || !_index.getByTimeRank(_entries.size() - 1, newest, position)) {
+        return 0;
+    }
+    time_t cutoff = std::min(RtcHAL::getTime(), newest) - (time_t)RETENTION_HOT_DAYS * 86400;
+    size_t aged = 0;
+    while (aged < ARCHIVE_SEGMENT_ENTRIES && aged < _entries.size() && _entries.getTimestamp(aged) < cutoff) {
+        aged++;
+    }
+    
+    return aged >= ARCHIVE_MIN_AGED_ENTRIES ? aged : 0;
+}
+
+bool Database::retireEntries(size_t count) {
+    // An earlier retirement whose removal never reached storage has to be
+    // settled before its segment can be followed by another
+    if (Archive::hasPendingSegment() && !settleRetirement()) {
+        return false;
+    }
+    
+    // The segment is written before the entries leave memory and committed
+    // after their removal is journaled; Archive::recover settles a crash in between
+    std::vector<LogEntry> retired;
+    _entries.getRange(0, count, retired);
+    if (!Archive::writeSegment(retired.data(), count)) {
+        DEBUG_PRINT("Failed to archive entries");
+        return false;
+    }
+    
+    // Last to first, so each earlier position is still valid when tracked
+    for (size_t i = count; _compacting && i-- > 0;) {
+        trackCompactionDelete(i);
+    }
+    _entries.removeFront(count);
+    _index.rebuild(_entries);
+    _generation++;
+    _dirty = true;
+    
+    std::vector<uint8_t> payload;
+    putUint(payload, (uint32_t)count, 4);
+    // Written through, since the segment must not be committed before the
+    // removal is on storage
+    bool journaled = appendJournal(JOURNAL_RETIRE, payload.data(), payload.size()) && flush();
+    
+    // Left pending if the removal is not on storage; the next checkpoint
+    // saves it and commits the segment, or Archive::recover drops the
+    // segment at boot
+    if (!journaled) {
+        DEBUG_PRINT("Failed to save database after archiving entries");
+        return false;
+    }
+    
+    // A checkpoint taken by the flush has committed it already
+    if (Archive::hasPendingSegment() && !Archive::commitSegment()) {
+        DEBUG_PRINT("Failed to commit archive segment");
+        return false;
+    }
+    
+    // The totals are unchanged; the entries are now counted with the archive
+    countArchived(retired);
+    
+    DEBUG_PRINTF("Archived %d entries, %d remain in memory", count, _entries.size());
+    return true;
+}
+
+bool Database::settleRetirement() {
+    // The removal's journal record went with the failed write, so the whole
+    // file is saved, which commits the segment
+    return checkpoint() && !Archive::hasPendingSegment();
+}
+
+void Database::removeSegments(uint32_t first, uint32_t last) {
+    for (uint32_t sequence = first; sequence <= last; sequence++) {
+        String path = segmentName(sequence);
+        if (StorageHAL::fileExists(path.c_str())) {
+            StorageHAL::deleteFile(path.c_str());
+        }
+    }
+}
+
+String Database::segmentName(uint32_t sequence) {
+    return String(DATABASE_SEGMENT_PREFIX) + String(sequence);
+}
+
+void Database::stageJournal(uint8_t op, const uint8_t* payload, size_t len) {
+    // A new journal starts with the sequence number it will have once sealed,
+    // so a journal that was already folded in is recognised after a crash
+    if (_journalRecords == 0) {
+        std::vector<uint8_t> header;
+        putUint(header, _sequence + 1, 4);
+        appendRecord(_pendingJournal, JOURNAL_HEADER, header.data(), header.size());
+    }
+    
+    // Held in memory and written together with the changes that follow it
+    // within the commit window, one storage write for the group
+    if (_pendingRecords == 0) {
+        _pendingSince = millis();
+    }
+    appendRecord(_pendingJournal, op, payload, len);
+    _pendingRecords++;
+    _journalRecords++;
+}
+
+bool Database::appendJournal(uint8_t op, const uint8_t* payload, size_t len) {
+    stageJournal(op, payload, len);
+    
+    // The main loop writes the group. Only write-through, or a journal due
+    // to be sealed, writes here, which also bounds what a loop of changes
+    // with no main loop in between can hold
+    if (_commitWindowMs == 0 || _journalRecords >= DATABASE_SEGMENT_RECORDS) {
+        return flush();
+    }
+    
+    return true;
+}
+
+bool Database::journalChange(uint8_t op, const uint8_t* payload, size_t len) {
+    // A journal filled by an earlier change is sealed while what is stored
+    // still matches memory. One that cannot be sealed stays open and valid
+    if (_journalRecords >= DATABASE_SEGMENT_RECORDS) {
+        flush();
+    }
+    
+    stageJournal(op, payload, len);
+    if (_commitWindowMs != 0 && _journalRecords < DATABASE_SEGMENT_RECORDS) {
+        return true;
+    }
+    
+    // The change is not in memory yet, so the usual checkpoint fallback would
+    // store everything but this change. It stores the earlier changes held
+    // with it instead, and the change is journaled again on its own
+    if (!writePending()) {
+        DEBUG_PRINT("Failed to append to database journal, falling back to full save");
+        if (!checkpoint()) {
+            return false;
+        }
+        
+        stageJournal(op, payload, len);
+        if (!writePending()) {
+            DEBUG_PRINT("Failed to append to database journal, change not applied");
+            checkpoint();
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool Database::flush() {
+    if (!writeJournal()) {
+        return false;
+    }
+    
+    // Seal the journal as a segment once it grows large enough; segments are
+    // folded into the database file later by compactStep
+    if (_journalRecords >= DATABASE_SEGMENT_RECORDS) {
+        return sealJournal();
+    }
+    
+    return true;
+}
+
+bool Database::writeJournal() {
+    if (!writePending()) {
+        DEBUG_PRINT("Failed to append to database journal, falling back to full save");
+        return checkpoint();
+    }
+    
+    return true;
+}
+
+bool Database::writePending() {
+    if (_pendingRecords == 0) {
+        return true;
+    }
+    
+    uint32_t startTime = micros();
+    size_t records = _pendingRecords;
+    bool written = StorageHAL::appendFile(DATABASE_JOURNAL_FILENAME, (const char*)_pendingJournal.data(), _pendingJournal.size()) == (int)_pendingJournal.size();
+    
+    // Cleared without freeing, so the next group reuses the buffer
+    _pendingJournal.clear();
+    _pendingRecords = 0;
+    
+    if (written) {
+        recordFlush(records, micros() - startTime);
+    }
+    return written;
+}
+
+bool Database::needsFlush() {
+    if (_pendingRecords == 0) {
+        return false;
+    }
+    
+    return _pendingRecords >= DATABASE_COMMIT_MAX_RECORDS || millis() - _pendingSince >= _commitWindowMs;
+}
+
+void Database::setCommitWindow(uint32_t windowMs) {
+    _commitWindowMs = windowMs;
+    
+    // Nothing already held may wait longer than the new window allows
+    if (windowMs == 0) {
+        flush();
+    }
+}
+
+const CommitStats& Database::getCommitStats() {
+    return _commitStats;
+}
+
+void Database::recordFlush(size_t records, uint32_t elapsedMicros) {
+    _commitStats.flushes++;
+    _commitStats.records += records;
+    _commitStats.largestFlush = std::max(_commitStats.largestFlush, (uint32_t)records);
+    _commitStats.lastFlushMicros = elapsedMicros;
+    _commitStats.maxFlushMicros = std::max(_commitStats.maxFlushMicros, elapsedMicros);
+    _commitStats.totalFlushMicros += elapsedMicros;
+    
+    DEBUG_PRINTF("Committed %d journal records in %u us", records, elapsedMicros);
+}
+
+bool Database::appendJournalBatch(const DatabaseBatch& batch) {
+    uint32_t startTime = micros();
+    size_t held = _pendingRecords;
+    
+    // Changes held by group commit go out first, in the same write
+    std::vector<uint8_t> records;
+    records.swap(_pendingJournal);
+    records.reserve(DATABASE_BATCH_CHUNK_SIZE + 512);
+    _pendingRecords = 0;
+    
+    if (_journalRecords == 0) {
+        std::vector<uint8_t> header;
+        putUint(header, _sequence + 1, 4);
+        appendRecord(records, JOURNAL_HEADER, header.data(), header.size());
+    }
+    
+    // The batch record gives the number of records that follow, so a batch
+    // cut short by a crash is recognised and dropped as a whole at replay
+    std::vector<uint8_t> count;
+    putUint(count, (uint32_t)batch.size(), 4);
+    appendRecord(records, JOURNAL_BATCH, count.data(), count.size());
+    
+    const std::vector<uint8_t>& operations = batch.getOperations();
+    size_t offset = 0;
+    while (offset < operations.size()) {
+        size_t len = getUint(&operations[offset + 1], 2);
+        appendRecord(records, operations[offset], &operations[offset + 3], len);
+        offset += 3 + len;
+        
+        // Written in chunks so the journal bytes never have to be held twice
+        if (records.size() >= DATABASE_BATCH_CHUNK_SIZE || offset == operations.size()) {
+            if (StorageHAL::appendFile(DATABASE_JOURNAL_FILENAME, (const char*)records.data(), records.size()) != (int)records.size()) {
+                DEBUG_PRINT("Failed to append batch to database journal, falling back to full save");
+                return checkpoint();
+            }
+            records.clear();
+        }
+    }
+    
+    _journalRecords += batch.size();
+    recordFlush(held + batch.size(), micros() - startTime);
+    
+    if (_journalRecords >= DATABASE_SEGMENT_RECORDS) {
+        return sealJournal();
+    }
+    
+    return true;
+}
+
+bool Database::sealJournal() {
+    // Compaction is not getting any idle time, so bound the replay work at
+    // the next boot with a full rewrite instead
+    if (_sequence - _baseSequence >= DATABASE_MAX_SEGMENTS) {
+        return checkpoint();
+    }
+    
+    // Changes still held belong to this segment. A failed write falls back
+    // to a checkpoint, which leaves no journal to seal
+    if (!writeJournal()) {
+        return false;
+    }
+    if (_journalRecords == 0) {
+        return true;
+    }
+    
+    uint32_t sequence = _sequence + 1;
+    if (!StorageHAL::renameFile(DATABASE_JOURNAL_FILENAME, segmentName(sequence).c_str())) {
+        DEBUG_PRINT("Failed to seal database journal, falling back to full save");
+        return checkpoint();
+    }
+    
+    _sequence = sequence;
+    _journalRecords = 0;
+    
+    DEBUG_PRINTF("Sealed database segment %u", sequence);
+    return true;
+}
+
+bool Database::replayJournal() {
+    _journalRecords = 0;
+    _pendingJournal.clear();
+    _pendingRecords = 0;
+    _sequence = _baseSequence;
+    
+    // Finish a truncation of a torn journal that was interrupted
+    if (!StorageHAL::recoverFile(DATABASE_JOURNAL_FILENAME)) {
+        DEBUG_PRINT("Failed to recover database journal");
+    }
+    
+    // Segments left behind by a compaction or checkpoint that was interrupted
+    // before removing them are already part of the database file
+    for (uint32_t sequence = _baseSequence; sequence > 0; sequence--) {
+        String path = segmentName(sequence);
+        if (!StorageHAL::fileExists(path.c_str())) {
+            break;
+        }
+        StorageHAL::deleteFile(path.c_str());
+    }
+    
+    size_t applied = 0;
+    size_t validLength = 0;
+    bool damaged = false;
+    
+    // Sealed segments first, in sequence order, then the open journal
+    while (!damaged && StorageHAL::fileExists(segmentName(_sequence + 1).c_str())) {
+        if (replayLogFile(segmentName(_sequence + 1), applied, validLength)) {
+            _sequence++;
+        } else {
+            damaged = true;
+        }
+    }
+    
+    if (!damaged && StorageHAL::fileExists(DATABASE_JOURNAL_FILENAME)) {
+        size_t segmentRecords = applied;
+        bool torn = !replayLogFile(DATABASE_JOURNAL_FILENAME, applied, validLength);
+        _journalRecords = applied - segmentRecords;
+        
+        if (torn && _journalRecords > 0) {
+            // An append was cut short; keep the records before it so new
+            // ones follow the last good record
+            DEBUG_PRINT("Database journal has a torn tail, truncating");
+            damaged = !StorageHAL::truncateFile(DATABASE_JOURNAL_FILENAME, validLength);
+        }
+        
+        if (!damaged && _journalRecords == 0 && StorageHAL::fileExists(DATABASE_JOURNAL_FILENAME)) {
+            StorageHAL::deleteFile(DATABASE_JOURNAL_FILENAME);
+        }
+    }
+    
+    DEBUG_PRINTF("Replayed %d records from %u segments and the journal", applied, _sequence - _baseSequence);
+    
+    if (damaged) {
+        // Drop the damaged tail and anything after it so new records are not
+        // appended after it
+        DEBUG_PRINT("Database log has a damaged tail, checkpointing");
+        while (StorageHAL::fileExists(segmentName(_sequence + 1).c_str())) {
+            _sequence++;
+        }
+        _journalRecords = 0;
+        return checkpoint();
+    }
+    
+    return true;
+}
+
+bool Database::replayLogFile(const String& path, size_t& applied, size_t& validLength) {
+    validLength = 0;
+    
+    StorageReader reader;
+    if (!reader.open(path.c_str())) {
+        DEBUG_PRINTF("Failed to read database log: %s", path.c_str());
         return false;
     }
     
-    DEBUG_PRINTF("Database backup created: %s", backupFilename.c_str());
+    std::vector<uint8_t> record;
+    bool headerSeen = false;
+    
+    while (reader.peek(1)) {
+        uint8_t op;
+        const uint8_t* payload;
+        size_t len;
+        
+        if (!readRecord(reader, true, record, op, payload, len)) {
+            // Truncated or corrupt record left by an interrupted append
+            return false;
+        }
+        
+        if (!headerSeen) {
+            bool current = false;
+            if (op == JOURNAL_HEADER && len == 4) {
+                current = getUint(payload, 4) > _baseSequence;
+            } else if (op == JOURNAL_HEADER && len == 8) {
+                // Journals from before segments name the database file state instead
+                current = getUint(payload, 4) == _fileLength && getUint(payload + 4, 4) == _fileCrc;
+            }
+            
+            if (!current) {
+                // The database file was rewritten after this log was started,
+                // so its records are already included
+                DEBUG_PRINTF("Stale database log found, discarding: %s", path.c_str());
+                reader.close();
+                StorageHAL::deleteFile(path.c_str());
+                return true;
+            }
+            headerSeen = true;
+            validLength = reader.getPosition();
+            continue;
+        }
+        
+        if (op == JOURNAL_BATCH) {
+            if (len != 4) {
+                return false;
+            }
+            
+            // Collect the batch and apply it only once every record is intact
+            size_t count = getUint(payload, 4);
+            std::vector<uint8_t> operations;
+            for (size_t i = 0; i < count; i++) {
+                if (!readRecord(reader, true, record, op, payload, len)) {
+                    return false;
+                }
+                size_t start = operations.size();
+                operations.resize(start + 3 + len);
+                operations[start] = op;
+                operations[start + 1] = (uint8_t)len;
+                operations[start + 2] = (uint8_t)(len >> 8);
+                memcpy(&operations[start + 3], payload, len);
+            }
+            
+            if (!applyBatch(operations.data(), operations.size())) {
+                return false;
+            }
+            applied += count;
+            validLength = reader.getPosition();
+            continue;
+        }
+        
+        if (!applyJournalRecord(op, payload, len)) {
+            return false;
+        }
+        applied++;
+        validLength = reader.getPosition();
+    }
+    
+    return true;
+}
+
+bool Database::applyBatch(const uint8_t* operations, size_t len) {
+    // Check every position against the entry count it will see before
+    // changing anything, so a batch is rejected whole
+    size_t count = _entries.size();
+    size_t adds = 0;
+    size_t deletes = 0;
+    for (size_t offset = 0; offset < len;) {
+        if (len - offset < 3) {
+            return false;
+        }
+        uint8_t op = operations[offset];
+        size_t payloadLen = getUint(&operations[offset + 1], 2);
+        const uint8_t* payload = &operations[offset + 3];
+        offset += 3 + payloadLen;
+        if (offset > len) {
+            return false;
+        }
+        
+        switch (op) {
+            case BATCH_ADD:
+                adds++;
+                count++;
+                break;
+            case BATCH_DELETE:
+                if (payloadLen != 4 || getUint(payload, 4) >= count) {
+                    return false;
+                }
+                deletes++;
+                count--;
+                break;
+            case BATCH_UPDATE:
+                if (payloadLen < 4 || getUint(payload, 4) >= count) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+    
+    // Each indexed delete shifts every bitmap, so past a few of them one
+    // rebuild at the end is cheaper. Otherwise added entries are indexed in
+    // one pass at the end; entries below indexed are already in the index
+    bool rebuild = deletes > DATABASE_BATCH_REBUILD_DELETES;
+    size_t indexed = _entries.size();
+    _entries.reserve(_entries.size() + adds);
+    
+    LogEntry entry((time_t)0);
+    bool valid = true;
+    for (size_t offset = 0; valid && offset < len;) {
+        uint8_t op = operations[offset];
+        size_t payloadLen = getUint(&operations[offset + 1], 2);
+        const uint8_t* payload = &operations[offset + 3];
+        offset += 3 + payloadLen;
+        
+        switch (op) {
+            case BATCH_ADD:
+                valid = entry.deserializeBinary(payload, payloadLen);
+                if (valid) {
+                    _lastId = std::max(_lastId, entry.getId());
+                    _entries.add(entry);
+                    _stats.add(entry);
+                    _trends.add(entry);
+                }
+                break;
+            case BATCH_DELETE: {
+                size_t index = getUint(payload, 4);
+                if (index < indexed) {
+                    if (!rebuild) {
+                        _index.remove(index, _entries.get(index));
+                    }
+                    indexed--;
+                }
+                _stats.remove(_entries, index);
+                _trends.remove(_entries.get(index));
+                if (_compacting) {
+                    trackCompactionDelete(index);
+                }
+                _entries.remove(index);
+                _generation++;
+                break;
+            }
+            case BATCH_UPDATE: {
+                size_t index = getUint(payload, 4);
+                valid = entry.deserializeBinary(payload + 4, payloadLen - 4);
+                if (!valid) {
+                    break;
+                }
+                if (index < indexed && !rebuild) {
+                    _index.replace(index, _entries.get(index), entry);
+                }
+                _stats.remove(_entries, index);
+                _stats.add(entry);
+                _trends.remove(_entries.get(index));
+                _trends.add(entry);
+                _entries.replace(index, entry);
+                
+                // Same as updateEntry: the saved indexes no longer match
+                if (_compacting && index >= _compactCursor && index < _compactEnd) {
+                    _compactIndex.clear();
+                    putUint(_compactIndex, 0, 4);
+                }
+                break;
+            }
+        }
+    }
+    
+    // An entry that fails to decode stops the batch part way, so the indexes
+    // are rebuilt for whatever was applied
+    if (rebuild || !valid) {
+        _index.rebuild(_entries);
+    } else {
+        _index.addRange(_entries, indexed);
+    }
+    _dirty = true;
+    return valid;
+}
+
+bool Database::applyJournalRecord(uint8_t op, const uint8_t* payload, size_t len) {
+    switch (op) {
+        case JOURNAL_ADD: {
+            LogEntry entry((time_t)0);
+            if (!entry.deserializeBinary(payload, len)) {
+                return false;
+            }
+            _entries.add(entry);
+            _index.add(_entries.size() - 1, entry);
+            break;
+        }
+        case JOURNAL_DELETE: {
+            if (len != 4) {
+                return false;
+            }
+            size_t index = getUint(payload, 4);
+            if (index >= _entries.size()) {
+                return false;
+            }
+            _index.remove(index, _entries.get(index));
+            _entries.remove(index);
+            break;
+        }
+        case JOURNAL_RETIRE: {
+            if (len != 4) {
+                return false;
+            }
+            size_t count = getUint(payload, 4);
+            if (count > _entries.size()) {
+                return false;
+            }
+            _entries.removeFront(count);
+            _index.rebuild(_entries);
+            break;
+        }
+        case JOURNAL_UPDATE: {
+            if (len < 4) {
+                return false;
+            }
+            size_t index = getUint(payload, 4);
+            LogEntry entry((time_t)0);
+            if (index >= _entries.size() || !entry.deserializeBinary(payload + 4, len - 4)) {
+                return false;
+            }
+            _index.replace(index, _entries.get(index), entry);
+            _entries.replace(index, entry);
+            break;
+        }
+        default:
+            DEBUG_PRINT("Unknown database journal record");
+            return false;
+    }
+    
+    _dirty = true;
     return true;
 }
 
 bool Database::loadFromFile() {
     // Clear current entries
     _entries.clear();
+    _index.clear();
+    _fileCrc = 0;
+    _fileLength = 0;
+    _needsMigration = false;
+    _baseSequence = 0;
+    
+    // A compaction cut short before the first save leaves its unsealed output
+    // with no database file beside it, which recoverFile would take for a
+    // finished replacement and install
+    size_t sealedLength;
+    uint32_t sealedCrc;
+    if (!StorageHAL::fileExists(DATABASE_FILENAME) && StorageHAL::fileExists(DATABASE_COMPACT_FILENAME) &&
+        !StorageHAL::readFooter(DATABASE_COMPACT_FILENAME, sealedLength, sealedCrc)) {
+        DEBUG_PRINT("Discarding interrupted database compaction");
+        StorageHAL::deleteFile(DATABASE_COMPACT_FILENAME);
+    }
+    
+    // Finish or discard a save or compaction that was interrupted
+    if (!StorageHAL::recoverFile(DATABASE_FILENAME)) {
+        DEBUG_PRINT("Failed to recover database file");
+    }
     
     // Check if database file exists
     if (!StorageHAL::fileExists(DATABASE_FILENAME)) {
@@ -377,75 +1765,352 @@ bool Database::loadFromFile() {
         return false;
     }
     
-    // Read file content
-    int fileSize = StorageHAL::getFileSize(DATABASE_FILENAME);
-    if (fileSize <= 0) {
+    // Files written before atomic saves have no footer and are read whole
+    size_t dataLength = SIZE_MAX;
+    uint32_t dataCrc = 0;
+    bool hasFooter = StorageHAL::readFooter(DATABASE_FILENAME, dataLength, dataCrc);
+    
+    // Stream file content through a fixed-size buffer
+    StorageReader reader;
+    if (!reader.open(DATABASE_FILENAME, dataLength)) {
+        DEBUG_PRINT("Failed to read database file");
+        return false;
+    }
+    
+    size_t fileSize = hasFooter ? dataLength : reader.getSize();
+    if (fileSize == 0) {
         DEBUG_PRINT("Database file is empty");
         return false;
     }
     
-    char* buffer = new char[fileSize + 1];
-    if (StorageHAL::readFile(DATABASE_FILENAME, buffer, fileSize + 1) < 0) {
-        DEBUG_PRINT("Failed to read database file");
-        delete[] buffer;
+    bool success = true;
+    const uint8_t* header = reader.peek(DATABASE_HEADER_SIZE);
+    if (header && memcmp(header, DATABASE_MAGIC, sizeof(DATABASE_MAGIC)) == 0) {
+        success = parseBinary(reader);
+    } else {
+        // Databases written before the binary format are pipe-delimited text
+        parseText(reader, false, _entries);
+        _needsMigration = true;
+    }
+    
+    // Remember which file state a journal applies to
+    reader.skipToEnd();
+    _fileCrc = reader.getChecksum();
+    _fileLength = fileSize;
+    
+    if (hasFooter && _fileCrc != dataCrc) {
+        DEBUG_PRINT("Database file checksum mismatch, kept entries with valid records");
+        _index.clear();
+    }
+    
+    DEBUG_PRINTF("Loaded %d entries from database file", _entries.size());
+    return success;
+}
+
+bool Database::parseBinary(StorageReader& reader) {
+    uint8_t header[DATABASE_HEADER_SIZE];
+    reader.read(header, sizeof(header));
+    
+    uint16_t version = getUint(header + sizeof(DATABASE_MAGIC), 2);
+    if (version > DATABASE_FORMAT_VERSION) {
+        DEBUG_PRINTF("Unsupported database format version: %d", version);
         return false;
     }
     
-    // Parse file content
-    String content = String(buffer);
-    delete[] buffer;
+    if (version >= 2) {
+        uint8_t sequence[DATABASE_SEQUENCE_SIZE];
+        if (reader.read(sequence, sizeof(sequence)) != sizeof(sequence)) {
+            return false;
+        }
+        _baseSequence = getUint(sequence, DATABASE_SEQUENCE_SIZE);
+    }
+    
+    // Earlier versions run to the end of the file and have no saved indexes
+    size_t count = SIZE_MAX;
+    if (version >= 3) {
+        uint8_t countBytes[DATABASE_COUNT_SIZE];
+        if (reader.read(countBytes, sizeof(countBytes)) != sizeof(countBytes)) {
+            return false;
+        }
+        count = getUint(countBytes, DATABASE_COUNT_SIZE);
+    }
+    
+    // Scratch buffer and entry for one record at a time
+    std::vector<uint8_t> record;
+    LogEntry entry((time_t)0);
+    size_t parsed = 0;
     
-    // Split into lines
-    int start = 0;
-    int end = content.indexOf('\n');
+    while (parsed < count && reader.peek(1)) {
+        uint8_t type;
+        const uint8_t* payload;
+        size_t payloadLen;
+        
+        if (!readRecord(reader, false, record, type, payload, payloadLen)) {
+            DEBUG_PRINT("Database file has a damaged tail, ignoring remainder");
+            break;
+        }
+        
+        if (entry.deserializeBinary(payload, payloadLen)) {
+            _entries.add(entry);
+        } else {
+            DEBUG_PRINT("Failed to parse entry from database file");
+        }
+        parsed++;
+    }
+    
+    // The saved indexes are only used when every entry they describe loaded
+    uint8_t lengthBytes[4];
+    if (count != SIZE_MAX && _entries.size() == count && reader.read(lengthBytes, sizeof(lengthBytes)) == sizeof(lengthBytes)) {
+        size_t len = getUint(lengthBytes, 4);
+        record.resize(std::min(len, reader.getSize() - reader.getPosition()));
+        if (record.size() == len && reader.read(record.data(), len) == len &&
+            _index.deserialize(record.data(), record.size()) && _index.size() == count) {
+            DEBUG_PRINT("Loaded saved database indexes");
+        } else {
+            _index.clear();
+        }
+    }
+    
+    return true;
+}
+
+bool Database::parseText(StorageReader& reader, bool skipHeader, EntryTable& entries,
+                         std::function<bool()> onFull) {
+    const char* line;
+    size_t lineLen;
+    LogEntry entry((time_t)0);
     
-    while (end >= 0) {
-        String line = content.substring(start, end);
-        if (line.length() > 0) {
-            LogEntry entry;
-            if (entry.deserialize(line)) {
-                _entries.push_back(entry);
+    // Parse each line straight out of the read buffer
+    while (reader.readLine(line, lineLen)) {
+        if (skipHeader) {
+            skipHeader = false;
+        } else if (lineLen > 0) {
+            if (entry.deserialize(line, lineLen)) {
+                entries.add(entry);
             } else {
-                DEBUG_PRINT("Failed to parse entry from database file");
+                DEBUG_PRINT("Failed to parse log entry line");
             }
         }
-        start = end + 1;
-        end = content.indexOf('\n', start);
+        
+        if (onFull && entries.size() >= MAX_LOG_ENTRIES + ARCHIVE_SEGMENT_ENTRIES && !onFull()) {
+            return false;
+        }
     }
     
-    if (start < content.length()) {
-        String line = content.substring(start);
-        if (line.length() > 0) {
-            LogEntry entry;
-            if (entry.deserialize(line)) {
-                _entries.push_back(entry);
-            }
+    return true;
+}
+
+size_t Database::assignMissingIds() {
+    for (size_t i = 0; i < _entries.size(); i++) {
+        _lastId = std::max(_lastId, _entries.getId(i));
+    }
+    
+    // Entries without an ID, from text files and files saved before IDs,
+    // take one from their own timestamp so IDs keep to entry order
+    size_t assigned = 0;
+    for (size_t i = 0; i < _entries.size(); i++) {
+        if (_entries.getId(i) == 0) {
+            time_t timestamp = _entries.getTimestamp(i);
+            uint64_t id = timestamp > 0 ? (uint64_t)timestamp << 32 : 0;
+            _lastId = std::max(id, _lastId + 1);
+            _entries.setId(i, _lastId);
+            assigned++;
         }
     }
     
-    DEBUG_PRINTF("Loaded %d entries from database file", _entries.size());
+    return assigned;
+}
+
+bool Database::stageImportBlock(std::vector<String>& blocks) {
+    // IDs follow from entry order, so they are settled before the entries
+    // leave memory
+    assignMissingIds();
+    
+    std::vector<LogEntry> block;
+    _entries.getRange(0, ARCHIVE_SEGMENT_ENTRIES, block);
+    String path = String(DATABASE_IMPORT_PREFIX) + String(blocks.size());
+    Archive::SegmentInfo info;
+    if (!Archive::writeBlock(path, block.data(), block.size(), info)) {
+        return false;
+    }
+    
+    blocks.push_back(path);
+    _entries.removeFront(ARCHIVE_SEGMENT_ENTRIES);
     return true;
 }
 
-bool Database::saveToFile() {
-    if (!_dirty) {
+void Database::removeImportBlocks() {
+    // Blocks are numbered from 0, so the first missing one ends the run
+    for (size_t block = 0;; block++) {
+        String path = String(DATABASE_IMPORT_PREFIX) + String(block);
+        if (!StorageHAL::fileExists(path.c_str()) || !StorageHAL::deleteFile(path.c_str())) {
+            break;
+        }
+    }
+}
+
+void Database::refreshStats() {
+    _archiveStats.clear();
+    _statsSegments = 0;
+    _statsSegmentCrc = 0;
+    
+    int size = StorageHAL::fileExists(DATABASE_STATS_FILENAME) ? StorageHAL::getFileSize(DATABASE_STATS_FILENAME) : 0;
+    if (size >= (int)(STATS_HEADER_SIZE + 4)) {
+        std::vector<uint8_t> data(size);
+        StorageReader reader;
+        bool read = reader.open(DATABASE_STATS_FILENAME) && reader.read(data.data(), data.size()) == data.size();
+        reader.close();
+        
+        const uint8_t* p = data.data();
+        if (read && memcmp(p, STATS_MAGIC, sizeof(STATS_MAGIC)) == 0 && getUint(p + 4, 2) == STATS_FORMAT_VERSION &&
+            StorageHAL::crc32(p, size - 4) == getUint(p + size - 4, 4) &&
+            _archiveStats.deserialize(p + STATS_HEADER_SIZE, size - STATS_HEADER_SIZE - 4)) {
+            _statsSegments = getUint(p + 8, 4);
+            _statsSegmentCrc = getUint(p + 12, 4);
+        } else {
+            DEBUG_PRINT("Corrupt statistics file, recounting the archive");
+        }
+    }
+    
+    // The saved counters hold as long as they cover the first segments of
+    // the archive as it is now, which a clear or restore may have replaced
+    bool matches = _statsSegments <= Archive::getSegmentCount();
+    if (matches && _statsSegments > 0) {
+        matches = false;
+        Archive::forEachSegment(_statsSegments - 1, [&matches](size_t segment, const String& path, const Archive::SegmentInfo& info) {
+            matches = info.rawCrc == _statsSegmentCrc;
+            return false;
+        });
+    }
+    if (!matches) {
+        _archiveStats.clear();
+        _statsSegments = 0;
+        _statsSegmentCrc = 0;
+    }
+    
+    // Segments archived since, or all of them the first time, are read once
+    if (!matches || _statsSegments < Archive::getSegmentCount()) {
+        foldArchiveStats();
+        saveStats();
+    }
+    
+    _stats = _archiveStats;
+    for (size_t i = 0; i < _entries.size(); i++) {
+        _stats.add(_entries, i);
+    }
+    
+    // Trends only reach back a week, so they are recounted from the entries
+    // of that week, archived ones included. The week is taken both up to the
+    // clock and up to the newest entry, so an unset clock or one that jumped
+    // ahead still leaves the trends of the latest entries
+    _trends.clear();
+    time_t now = RtcHAL::getTime();
+    time_t newest = now;
+    uint32_t position;
+    if (_entries.size() > 0) {
+        _index.getByTimeRank(_entries.size() - 1, newest, position);
+    }
+    time_t start = std::min(EntryTrends::getWindowStart(TREND_SHIFT, now), EntryTrends::getWindowStart(TREND_WEEK, now));
+    start = std::min(start, std::min(EntryTrends::getWindowStart(TREND_SHIFT, newest), EntryTrends::getWindowStart(TREND_WEEK, newest)));
+    Archive::forEach(start, std::max(now, newest), [](const LogEntry& entry) {
+        _trends.add(entry);
+        return true;
+    });
+    LogEntry entry((time_t)0);
+    for (size_t i = 0; i < _entries.size(); i++) {
+        if (_entries.getTimestamp(i) >= start) {
+            _entries.get(i, entry);
+            _trends.add(entry);
+        }
+    }
+}
+
+bool Database::foldArchiveStats() {
+    bool complete = true;
+    Archive::forEachSegment(_statsSegments, [&complete](size_t segment, const String& path, const Archive::SegmentInfo& info) {
+        // An unreadable segment is passed over, as archive queries do
+        if (!Archive::readBlock(path, [](const LogEntry& entry) {
+                _archiveStats.add(entry);
+                return true;
+            })) {
+            DEBUG_PRINTF("Failed to count archive segment %d", segment);
+            complete = false;
+        }
+        _statsSegments = segment + 1;
+        _statsSegmentCrc = info.rawCrc;
+        return true;
+    });
+    
+    return complete;
+}
+
+void Database::countArchived(const std::vector<LogEntry>& retired) {
+    // Counted straight from memory when the new segment is the only one
+    // not yet covered, otherwise read back like at boot
+    bool counted = false;
+    if (_statsSegments + 1 == Archive::getSegmentCount()) {
+        Archive::forEachSegment(_statsSegments, [&retired, &counted](size_t segment, const String& path, const Archive::SegmentInfo& info) {
+            for (const auto& entry : retired) {
+                _archiveStats.add(entry);
+            }
+            _statsSegments = segment + 1;
+            _statsSegmentCrc = info.rawCrc;
+            counted = true;
+            return false;
+        });
+    }
+    if (!counted) {
+        foldArchiveStats();
+    }
+    
+    saveStats();
+}
+
+bool Database::saveStats() {
+    std::vector<uint8_t> data;
+    data.insert(data.end(), STATS_MAGIC, STATS_MAGIC + sizeof(STATS_MAGIC));
+    putUint(data, STATS_FORMAT_VERSION, 2);
+    putUint(data, 0, 2);
+    putUint(data, _statsSegments, 4);
+    putUint(data, _statsSegmentCrc, 4);
+    _archiveStats.serialize(data);
+    putUint(data, StorageHAL::crc32(data.data(), data.size()), 4);
+    
+    if (!StorageHAL::writeFileAtomic(DATABASE_STATS_FILENAME, (const char*)data.data(), data.size())) {
+        DEBUG_PRINT("Failed to save entry statistics");
+        return false;
+    }
+    
+    return true;
+}
+
+bool Database::saveToFile(uint32_t sequence) {
+    if (!_dirty && sequence == _baseSequence) {
         DEBUG_PRINT("Database not modified, skipping save");
         return true;
     }
     
-    String content;
+    std::vector<uint8_t> content;
     
-    // Add entries
-    for (const auto& entry : _entries) {
-        content += entry.serialize() + "\n";
+    // Add header
+    appendFileHeader(content, sequence, _entries.size());
+    
+    // Add entries, materializing one at a time
+    LogEntry entry((time_t)0);
+    for (size_t i = 0; i < _entries.size(); i++) {
+        _entries.get(i, entry);
+        appendEntryRecord(content, NO_RECORD_TYPE, entry);
     }
+    appendIndexSection(content, _index);
     
-    // Write to file
-    if (StorageHAL::writeFile(DATABASE_FILENAME, content.c_str(), content.length()) < 0) {
+    // Replace the file atomically so a power loss keeps the previous version
+    if (!StorageHAL::writeFileAtomic(DATABASE_FILENAME, (const char*)content.data(), content.size())) {
         DEBUG_PRINT("Failed to save database to file");
         return false;
     }
     
+    _fileCrc = StorageHAL::crc32(content.data(), content.size());
+    _fileLength = content.size();
     _dirty = false;
     DEBUG_PRINTF("Saved %d entries to database file", _entries.size());
     return true;
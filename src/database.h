@@ -11,9 +11,28 @@
 #include <Arduino.h>
 #include <vector>
 #include "log_entry.h"
+#include "entry_table.h"
+#include "database_index.h"
+#include "database_batch.h"
+#include "entry_stats.h"
+#include "entry_trends.h"
+#include "result_set.h"
+#include "entry_cursor.h"
+#include "archive.h"
+#include "backup.h"
 #include "../hal/storage.h"
 #include "../config.h"
 
+// Group commit counters, reported for tuning the commit window
+struct CommitStats {
+    uint32_t flushes;          // Journal writes made
+    uint32_t records;          // Records those writes carried
+    uint32_t largestFlush;     // Most records carried by one write
+    uint32_t lastFlushMicros;  // Duration of the latest write
+    uint32_t maxFlushMicros;   // Longest write
+    uint64_t totalFlushMicros; // All writes together
+};
+
 class Database {
 public:
     /**
@@ -23,12 +42,39 @@ public:
     static bool init();
     
     /**
-     * Add a log entry to the database
+     * Add a log entry to the database. Like updates and deletes, the change
+     * reaches storage with the next group commit, see flush. An entry without
+     * an ID, or with one already in use, is given a new one
      * @param entry log entry to add
      * @return true if successful, false otherwise
      */
     static bool addEntry(const LogEntry& entry);
     
+    /**
+     * Generate a new entry ID. IDs increase over time and are never reused
+     * while their entries are held, so they stay valid across deletes and
+     * restarts where positions do not
+     * @return new ID
+     */
+    static uint64_t generateId();
+    
+    /**
+     * Add many log entries with one journal write and one index update
+     * @param entries log entries to add
+     * @return true if successful, false otherwise
+     */
+    static bool addEntries(const std::vector<LogEntry>& entries);
+    
+    /**
+     * Apply a batch of changes. The batch is journaled as a unit, so after a
+     * crash either all of it or none of it is recovered, and is written
+     * before this returns
+     * @param batch changes to apply
+     * @return true if successful, false if the batch refers to an entry that
+     *         does not exist (nothing is applied) or saving failed
+     */
+    static bool commit(const DatabaseBatch& batch);
+    
     /**
      * Get a log entry by index
      * @param index entry index
@@ -38,13 +84,76 @@ public:
     static bool getEntry(size_t index, LogEntry& entry);
     
     /**
-     * Get all log entries
+     * Find the position of an entry by ID, without scanning
+     * @param id entry ID
+     * @param index reference to store the entry index
+     * @return true if found, false otherwise
+     */
+    static bool findEntry(uint64_t id, size_t& index);
+    
+    /**
+     * Get a log entry by ID from either tier. The archive is only searched,
+     * segment by segment, for an ID not held in memory
+     * @param id entry ID
+     * @param entry reference to store the entry
+     * @return true if successful, false otherwise
+     */
+    static bool getEntryById(uint64_t id, LogEntry& entry);
+    
+    /**
+     * Get all log entries, archived ones first
      * @return vector of log entries
      */
     static std::vector<LogEntry> getAllEntries();
     
     /**
-     * Get entries by date range
+     * Select all entries without copying them
+     * @return result set in database order
+     */
+    static ResultSet selectAll();
+    
+    /**
+     * Select entries by date range without copying them
+     * @param startTime start of date range
+     * @param endTime end of date range
+     * @return result set in database order
+     */
+    static ResultSet selectByDateRange(time_t startTime, time_t endTime);
+    
+    /**
+     * Select entries by gender without copying them
+     * @param gender gender to filter by
+     * @return result set in database order
+     */
+    static ResultSet selectByGender(Gender gender);
+    
+    /**
+     * Select entries by item type without copying them
+     * @param itemType item type to filter by
+     * @return result set in database order
+     */
+    static ResultSet selectByItemType(ItemType itemType);
+    
+    /**
+     * Select entries containing text without copying them
+     * @param searchText text to search for
+     * @return result set in database order
+     */
+    static ResultSet selectByText(const String& searchText);
+    
+    /**
+     * Get one page of entries in timestamp order without copying them. Use
+     * EntryCursor to walk through pages in constant time per page
+     * @param offset number of matching entries to skip
+     * @param limit maximum number of entries
+     * @param order page order
+     * @param filter optional entry predicate
+     * @return result set in page order
+     */
+    static ResultSet getPage(size_t offset, size_t limit, PageOrder order, EntryFilter filter = nullptr);
+    
+    /**
+     * Get entries by date range, archived ones first
      * @param startTime start of date range
      * @param endTime end of date range
      * @return vector of log entries
@@ -52,32 +161,108 @@ public:
     static std::vector<LogEntry> getEntriesByDateRange(time_t startTime, time_t endTime);
     
     /**
-     * Get entries by gender
+     * Get entries by gender, archived ones first
      * @param gender gender to filter by
      * @return vector of log entries
      */
     static std::vector<LogEntry> getEntriesByGender(Gender gender);
     
     /**
-     * Get entries by item type
+     * Get entries by item type, archived ones first
      * @param itemType item type to filter by
      * @return vector of log entries
      */
     static std::vector<LogEntry> getEntriesByItemType(ItemType itemType);
     
     /**
-     * Search entries by text
+     * Search entries by text, archived ones first
      * @param searchText text to search for
      * @return vector of log entries
      */
     static std::vector<LogEntry> searchEntries(const String& searchText);
     
     /**
-     * Get the number of entries in the database
+     * Visit entries in a date range across the archive and the in-memory
+     * entries, oldest tier first, without holding the archive in memory
+     * @param startTime start of date range
+     * @param endTime end of date range
+     * @param callback called for each entry, returns false to stop
+     * @return true if every tier was read, false otherwise
+     */
+    static bool forEachEntry(time_t startTime, time_t endTime, std::function<bool(const LogEntry&)> callback);
+    
+    /**
+     * Visit archived entries in a date range, oldest first, for callers that
+     * already hold the in-memory matches
+     * @param startTime start of date range
+     * @param endTime end of date range
+     * @param callback called for each entry, returns false to stop
+     * @return true if the archive was read, false otherwise
+     */
+    static bool forEachArchivedEntry(time_t startTime, time_t endTime, std::function<bool(const LogEntry&)> callback);
+    
+    /**
+     * Get the in-memory entries without copying them. Positions and the result
+     * sets built from them cover these entries only, not the archive
+     * @return entry columns, addressed by position
+     */
+    static const EntryTable& getEntries();
+    
+    /**
+     * Get the secondary indexes over the stored entries
+     * @return index, valid until the next modification
+     */
+    static const EntryIndex& getIndex();
+    
+    /**
+     * Get the counters of all entries, archived ones included, for totals
+     * and breakdowns over time windows without reading any entry
+     * @return counters, kept current with every change
+     */
+    static const EntryStats& getStats();
+    
+    /**
+     * Get the most frequent color combinations and item descriptions of the
+     * last shift and week, for spotting repeat suspects
+     * @return trends, kept current with every change
+     */
+    static const EntryTrends& getTrends();
+    
+    /**
+     * Get the time that windows such as today or the last shift end at: the
+     * clock, or the newest entry while the clock is behind it, as an unset
+     * clock is. Trends are counted up to the same time
+     * @return end of the current window
+     */
+    static time_t getWindowTime();
+    
+    /**
+     * Get the database generation, which changes whenever entries are
+     * deleted or replaced and existing positions stop being valid
+     * @return generation counter
+     */
+    static uint32_t getGeneration();
+    
+    /**
+     * Get the number of in-memory entries
      * @return number of entries
      */
     static size_t getEntryCount();
     
+    /**
+     * Get the number of entries including archived ones
+     * @return number of entries
+     */
+    static size_t getTotalEntryCount();
+    
+    /**
+     * Replace an entry in place
+     * @param index entry index
+     * @param entry new entry content
+     * @return true if successful, false otherwise
+     */
+    static bool updateEntry(size_t index, const LogEntry& entry);
+    
     /**
      * Delete an entry by index
      * @param index entry index
@@ -86,7 +271,22 @@ public:
     static bool deleteEntry(size_t index);
     
     /**
-     * Delete all entries
+     * Replace an entry by ID; the entry keeps its ID
+     * @param id entry ID
+     * @param entry new entry content
+     * @return true if successful, false otherwise
+     */
+    static bool updateEntryById(uint64_t id, const LogEntry& entry);
+    
+    /**
+     * Delete an entry by ID
+     * @param id entry ID
+     * @return true if successful, false otherwise
+     */
+    static bool deleteEntryById(uint64_t id);
+    
+    /**
+     * Delete all entries, including archived ones
      * @return true if successful, false otherwise
      */
     static bool deleteAllEntries();
@@ -99,25 +299,185 @@ public:
     static bool exportToFile(const String& filename);
     
     /**
-     * Import database from file
+     * Import database from file, replacing all entries including archived ones.
+     * The newest entries are kept in memory and older ones are archived as
+     * they are read, so a large file needs no more memory than the hot tier
      * @param filename file to import from
      * @return true if successful, false otherwise
      */
     static bool importFromFile(const String& filename);
     
     /**
-     * Backup database
+     * Backup database, writing only what changed since the previous backup
      * @return true if successful, false otherwise
      */
     static bool backup();
+    
+    /**
+     * Replace all entries, including archived ones, with the newest backup
+     * taken at or before a point in time
+     * @param pointInTime latest backup time to accept
+     * @return true if successful, false otherwise
+     */
+    static bool restoreBackup(time_t pointInTime);
+    
+    /**
+     * Rewrite the database file with everything journaled so far and drop
+     * all segments. Blocks until done; prefer compactStep from the main loop
+     * @return true if successful, false otherwise
+     */
+    static bool checkpoint();
+    
+    /**
+     * Check whether enough sealed segments have built up to be compacted
+     * @return true if compactStep has work to do
+     */
+    static bool needsCompaction();
+    
+    /**
+     * Run one bounded step of folding sealed segments into the database file.
+     * Entries can be added, edited and deleted between steps
+     * @param budgetMs time budget for the step in milliseconds
+     * @return true if successful, false otherwise
+     */
+    static bool compactStep(uint32_t budgetMs = DATABASE_COMPACT_STEP_MS);
+    
+    /**
+     * Write the changes held in memory by group commit. Changes are journaled
+     * in memory and written together, at most DATABASE_COMMIT_WINDOW_MS after
+     * the first of them; call this at sync points such as going idle
+     * @return true if successful, false otherwise
+     */
+    static bool flush();
+    
+    /**
+     * Check whether held changes have waited out the commit window or
+     * DATABASE_COMMIT_MAX_RECORDS of them have built up
+     * @return true if flush has work to do
+     */
+    static bool needsFlush();
+    
+    /**
+     * Set how long changes may be held in memory, which bounds what a power
+     * loss can lose
+     * @param windowMs commit window in milliseconds, 0 to write every change
+     *        before the call making it returns
+     */
+    static void setCommitWindow(uint32_t windowMs);
+    
+    /**
+     * Get the group commit counters
+     * @return commit statistics
+     */
+    static const CommitStats& getCommitStats();
+    
+    /**
+     * Check whether entries are due to move to the archive, either past
+     * MAX_LOG_ENTRIES or older than RETENTION_HOT_DAYS
+     * @return true if archiveStep has work to do
+     */
+    static bool needsArchive();
+    
+    /**
+     * Move one segment of the oldest entries to the archive
+     * @return true if successful, false otherwise
+     */
+    static bool archiveStep();
 
 private:
+    // Host tests drop what a reboot loses and drive retirement (see
+    // test/test_support.h)
+    friend class DatabaseTestHooks;
+    
+    // An entry deleted while compaction was still due to copy it, held until
+    // the compaction cursor reaches the position it was deleted from
+    struct CompactGhost {
+        size_t position;
+        LogEntry entry;
+    };
+    
     static bool _initialized;
-    static std::vector<LogEntry> _entries;
+    static EntryTable _entries;
+    static EntryIndex _index;
+    static uint32_t _generation;
     static bool _dirty;
+    static size_t _journalRecords;
+    static uint32_t _fileCrc;
+    static size_t _fileLength;
+    static bool _needsMigration;
+    static uint32_t _baseSequence;
+    static uint32_t _sequence;
+    static uint64_t _lastId;
+    
+    // Counters of all entries, and of the archived ones as saved with the
+    // archive segments they cover
+    static EntryStats _stats;
+    static EntryStats _archiveStats;
+    static size_t _statsSegments;
+    static uint32_t _statsSegmentCrc;
+    
+    // Frequent keys of recent entries, rebuilt along with the counters
+    static EntryTrends _trends;
+    
+    // Group commit: journal records not yet written, and when the first was held
+    static std::vector<uint8_t> _pendingJournal;
+    static size_t _pendingRecords;
+    static uint32_t _pendingSince;
+    static uint32_t _commitWindowMs;
+    static CommitStats _commitStats;
+    
+    // Compaction progress
+    static bool _compacting;
+    static uint32_t _compactSequence;
+    static size_t _compactCursor;
+    static size_t _compactEnd;
+    static size_t _compactLength;
+    static uint32_t _compactCrc;
+    static std::vector<uint8_t> _compactIndex;
+    static size_t _compactIndexCursor;
+    static std::vector<CompactGhost> _compactGhosts;
     
     static bool loadFromFile();
-    static bool saveToFile();
+    static bool saveToFile(uint32_t sequence);
+    static bool parseBinary(StorageReader& reader);
+    static bool parseText(StorageReader& reader, bool skipHeader, EntryTable& entries,
+                          std::function<bool()> onFull = nullptr);
+    static size_t assignMissingIds();
+    static bool stageImportBlock(std::vector<String>& blocks);
+    static void removeImportBlocks();
+    
+    // Statistics helpers
+    static void refreshStats();
+    static bool foldArchiveStats();
+    static void countArchived(const std::vector<LogEntry>& retired);
+    static bool saveStats();
+    
+    // Journal helpers
+    static void stageJournal(uint8_t op, const uint8_t* payload, size_t len);
+    static bool appendJournal(uint8_t op, const uint8_t* payload, size_t len);
+    static bool journalChange(uint8_t op, const uint8_t* payload, size_t len);
+    static bool appendJournalBatch(const DatabaseBatch& batch);
+    static bool applyBatch(const uint8_t* operations, size_t len);
+    static bool replayJournal();
+    static bool replayLogFile(const String& path, size_t& applied, size_t& validLength);
+    static bool applyJournalRecord(uint8_t op, const uint8_t* payload, size_t len);
+    static bool writeJournal();
+    static bool writePending();
+    static bool sealJournal();
+    static void recordFlush(size_t records, uint32_t elapsedMicros);
+    static String segmentName(uint32_t sequence);
+    
+    // Compaction helpers
+    static bool beginCompaction();
+    static bool finishCompaction();
+    static void cancelCompaction();
+    static void removeSegments(uint32_t first, uint32_t last);
+    static void trackCompactionDelete(size_t index);
+    
+    // Retention helpers
+    static size_t countRetirable();
+    static bool retireEntries(size_t count);
+    static bool settleRetirement();
 };
 
 #endif // DATA_DATABASE_H
@@ -0,0 +1,70 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Database Batch Implementation
+ */
+
+#include "database_batch.h"
+#include "database.h"
+#include <algorithm>
+
+// Typical encoded size of an added entry, used to size the buffer up front
+static const size_t BATCH_ENTRY_BYTES = 96;
+
+static void putUint(uint8_t* p, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+DatabaseBatch::DatabaseBatch() : _count(0) {
+}
+
+void DatabaseBatch::add(const LogEntry& entry) {
+    // IDs are settled here since the encoded record is journaled as is, and
+    // an ID queued earlier in the batch is not in the database yet
+    size_t existing;
+    std::vector<uint64_t>::iterator queued = std::lower_bound(_ids.begin(), _ids.end(), entry.getId());
+    if (entry.getId() == 0 || (queued != _ids.end() && *queued == entry.getId()) ||
+        Database::findEntry(entry.getId(), existing)) {
+        LogEntry copy = entry;
+        copy.setId(Database::generateId());
+        add(copy);
+        return;
+    }
+    _ids.insert(queued, entry.getId());
+    
+    size_t size = entry.getBinarySize();
+    uint8_t* payload = beginOperation(BATCH_ADD, size);
+    entry.serializeBinary(payload, size);
+}
+
+void DatabaseBatch::update(size_t index, const LogEntry& entry) {
+    size_t size = entry.getBinarySize();
+    uint8_t* payload = beginOperation(BATCH_UPDATE, 4 + size);
+    putUint(payload, (uint32_t)index, 4);
+    entry.serializeBinary(payload + 4, size);
+}
+
+void DatabaseBatch::remove(size_t index) {
+    uint8_t* payload = beginOperation(BATCH_DELETE, 4);
+    putUint(payload, (uint32_t)index, 4);
+}
+
+void DatabaseBatch::clear() {
+    _operations.clear();
+    _ids.clear();
+    _count = 0;
+}
+
+void DatabaseBatch::reserve(size_t count) {
+    _operations.reserve(_operations.size() + count * BATCH_ENTRY_BYTES);
+}
+
+uint8_t* DatabaseBatch::beginOperation(BatchOp op, size_t payloadLen) {
+    size_t start = _operations.size();
+    _operations.resize(start + 3 + payloadLen);
+    _operations[start] = (uint8_t)op;
+    putUint(&_operations[start + 1], payloadLen, 2);
+    _count++;
+    return &_operations[start + 3];
+}
@@ -0,0 +1,99 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Database Batch
+ * 
+ * This file contains the batch of entry changes that Database::commit
+ * applies and journals as one unit
+ */
+
+#ifndef DATA_DATABASE_BATCH_H
+#define DATA_DATABASE_BATCH_H
+
+#include <Arduino.h>
+#include <vector>
+#include "log_entry.h"
+#include "../config.h"
+
+// Operation codes, the same bytes the database journal uses for them
+enum BatchOp {
+    BATCH_ADD = 'A',
+    BATCH_DELETE = 'D',
+    BATCH_UPDATE = 'U'
+};
+
+/**
+ * Inserts, updates and deletes collected in memory. Each operation is kept
+ * in its journal encoding, so committing the batch writes it out without
+ * re-encoding and a batch costs about as much memory as its journal bytes.
+ * Positions refer to the entry list as the earlier operations in the batch
+ * leave it
+ */
+class DatabaseBatch {
+public:
+    DatabaseBatch();
+    
+    /**
+     * Queue an entry to append. An entry without an ID, or with one already
+     * in use or queued in this batch, is given a new one
+     * @param entry entry to append
+     */
+    void add(const LogEntry& entry);
+    
+    /**
+     * Queue new content for an entry
+     * @param index entry position
+     * @param entry new content
+     */
+    void update(size_t index, const LogEntry& entry);
+    
+    /**
+     * Queue an entry to delete
+     * @param index entry position
+     */
+    void remove(size_t index);
+    
+    /**
+     * Get the number of queued operations
+     * @return number of operations
+     */
+    size_t size() const {
+        return _count;
+    }
+    
+    /**
+     * Check if no operation is queued
+     * @return true if empty, false otherwise
+     */
+    bool isEmpty() const {
+        return _count == 0;
+    }
+    
+    /**
+     * Drop every queued operation
+     */
+    void clear();
+    
+    /**
+     * Reserve room for a number of entries
+     * @param count number of entries
+     */
+    void reserve(size_t count);
+    
+    /**
+     * Get the encoded operations, each as [op][uint16 payload length][payload]
+     * with the payload of the matching journal record
+     * @return encoded operations
+     */
+    const std::vector<uint8_t>& getOperations() const {
+        return _operations;
+    }
+
+private:
+    std::vector<uint8_t> _operations;
+    std::vector<uint64_t> _ids;  // IDs of the queued adds, sorted
+    size_t _count;
+    
+    uint8_t* beginOperation(BatchOp op, size_t payloadLen);
+};
+
+#endif // DATA_DATABASE_BATCH_H
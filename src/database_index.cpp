@@ -0,0 +1,467 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Database Indexes Implementation
+ */
+
+#include "database_index.h"
+#include <algorithm>
+
+static const Bitmap EMPTY_BITMAP;
+
+// Saved indexes are written in native byte order and layout, since they are
+// only read back by the firmware that wrote them
+static void putRaw(std::vector<uint8_t>& out, const void* data, size_t len) {
+    out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + len);
+}
+
+static bool getRaw(const uint8_t*& p, const uint8_t* end, void* data, size_t len) {
+    if ((size_t)(end - p) < len) {
+        return false;
+    }
+    memcpy(data, p, len);
+    p += len;
+    return true;
+}
+
+static bool timeKeyLess(time_t timestamp, uint32_t position, time_t otherTimestamp, uint32_t otherPosition) {
+    return timestamp < otherTimestamp || (timestamp == otherTimestamp && position < otherPosition);
+}
+
+void EntryIndex::clear() {
+    for (auto& positions : _byGender) {
+        positions.clear();
+    }
+    for (auto& positions : _byItemType) {
+        positions.clear();
+    }
+    for (auto& colors : _byColor) {
+        colors.clear();
+    }
+    for (auto& grid : _byRgb) {
+        grid.clear();
+    }
+    _byTimestamp.clear();
+    _byText.clear();
+}
+
+void EntryIndex::rebuild(const EntryTable& entries) {
+    clear();
+    _byTimestamp.reserve(entries.size());
+    
+    // One entry is materialized at a time, reusing its string buffers
+    LogEntry entry((time_t)0);
+    for (size_t i = 0; i < entries.size(); i++) {
+        entries.get(i, entry);
+        
+        indexAttributes(i, entry);
+        _byTimestamp.push_back({entries.getTimestamp(i), (uint32_t)i});
+    }
+    
+    // Entries are mostly appended in time order, so this is usually already sorted
+    std::sort(_byTimestamp.begin(), _byTimestamp.end(), [](const TimeKey& a, const TimeKey& b) {
+        return timeKeyLess(a.timestamp, a.position, b.timestamp, b.position);
+    });
+}
+
+void EntryIndex::add(uint32_t position, const LogEntry& entry) {
+    indexAttributes(position, entry);
+    
+    TimeKey key = {entry.getTimestamp(), position};
+    auto it = std::upper_bound(_byTimestamp.begin(), _byTimestamp.end(), key, [](const TimeKey& a, const TimeKey& b) {
+        return timeKeyLess(a.timestamp, a.position, b.timestamp, b.position);
+    });
+    _byTimestamp.insert(it, key);
+}
+
+void EntryIndex::addRange(const EntryTable& entries, size_t first) {
+    if (first >= entries.size()) {
+        return;
+    }
+    
+    size_t oldCount = _byTimestamp.size();
+    _byTimestamp.reserve(oldCount + entries.size() - first);
+    
+    LogEntry entry((time_t)0);
+    for (size_t i = first; i < entries.size(); i++) {
+        entries.get(i, entry);
+        
+        indexAttributes(i, entry);
+        _byTimestamp.push_back({entries.getTimestamp(i), (uint32_t)i});
+    }
+    
+    // The new keys are usually already in order and later than the old ones,
+    // in which case neither step moves anything
+    auto less = [](const TimeKey& a, const TimeKey& b) {
+        return timeKeyLess(a.timestamp, a.position, b.timestamp, b.position);
+    };
+    auto middle = _byTimestamp.begin() + oldCount;
+    if (!std::is_sorted(middle, _byTimestamp.end(), less)) {
+        std::sort(middle, _byTimestamp.end(), less);
+    }
+    if (oldCount > 0 && less(*middle, *(middle - 1))) {
+        std::inplace_merge(_byTimestamp.begin(), middle, _byTimestamp.end(), less);
+    }
+}
+
+void EntryIndex::remove(uint32_t position, const LogEntry& entry) {
+    // Every bitmap has to shift its later positions down
+    for (auto& positions : _byGender) {
+        positions.removeAndShift(position);
+    }
+    for (auto& positions : _byItemType) {
+        positions.removeAndShift(position);
+    }
+    for (auto& colors : _byColor) {
+        for (auto it = colors.begin(); it != colors.end();) {
+            it->positions.removeAndShift(position);
+            if (it->positions.isEmpty()) {
+                it = colors.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto& grid : _byRgb) {
+        grid.removeAndShift(position);
+    }
+    _byText.remove(position);
+    
+    // Timestamp keys are ordered by time, so every key has to be checked
+    auto keyIt = _byTimestamp.end();
+    for (auto it = _byTimestamp.begin(); it != _byTimestamp.end(); ++it) {
+        if (it->position == position) {
+            keyIt = it;
+        } else if (it->position > position) {
+            it->position--;
+        }
+    }
+    if (keyIt != _byTimestamp.end()) {
+        _byTimestamp.erase(keyIt);
+    }
+}
+
+void EntryIndex::replace(uint32_t position, const LogEntry& oldEntry, const LogEntry& newEntry) {
+    // Only the old entry's own keys can hold the position, and nothing shifts
+    if ((size_t)oldEntry.getGender() < INDEX_GENDER_COUNT) {
+        _byGender[oldEntry.getGender()].remove(position);
+    }
+    if ((size_t)oldEntry.getItemType() < INDEX_ITEM_TYPE_COUNT) {
+        _byItemType[oldEntry.getItemType()].remove(position);
+    }
+    for (auto& colors : _byColor) {
+        for (auto it = colors.begin(); it != colors.end();) {
+            it->positions.remove(position);
+            if (it->positions.isEmpty()) {
+                it = colors.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    const Color* colors[INDEX_COLOR_COUNT] = {&oldEntry.getShirtColor(), &oldEntry.getPantsColor(), &oldEntry.getShoesColor()};
+    for (size_t attribute = 0; attribute < INDEX_COLOR_COUNT; attribute++) {
+        if (colors[attribute]->isRecorded()) {
+            _byRgb[attribute].remove(colors[attribute]->rgb, position);
+        }
+    }
+    _byText.remove(position, false);
+    
+    TimeKey key = {oldEntry.getTimestamp(), position};
+    auto keyIt = std::lower_bound(_byTimestamp.begin(), _byTimestamp.end(), key, [](const TimeKey& a, const TimeKey& b) {
+        return timeKeyLess(a.timestamp, a.position, b.timestamp, b.position);
+    });
+    if (keyIt != _byTimestamp.end() && keyIt->position == position) {
+        _byTimestamp.erase(keyIt);
+    }
+    
+    add(position, newEntry);
+}
+
+size_t EntryIndex::size() const {
+    return _byTimestamp.size();
+}
+
+const Bitmap& EntryIndex::getByGender(Gender gender) const {
+    if ((size_t)gender >= INDEX_GENDER_COUNT) {
+        return EMPTY_BITMAP;
+    }
+    return _byGender[gender];
+}
+
+const Bitmap& EntryIndex::getByItemType(ItemType itemType) const {
+    if ((size_t)itemType >= INDEX_ITEM_TYPE_COUNT) {
+        return EMPTY_BITMAP;
+    }
+    return _byItemType[itemType];
+}
+
+void EntryIndex::getByColor(IndexedColor attribute, const String& colorName, Bitmap& positions) const {
+    positions.clear();
+    if (attribute >= INDEX_COLOR_COUNT) {
+        return;
+    }
+    
+    // Substring matches can hit several names, so merge all of them
+    String key = colorKey(colorName);
+    for (const auto& color : _byColor[attribute]) {
+        if (color.name.indexOf(key) >= 0) {
+            positions.unionWith(color.positions);
+        }
+    }
+}
+
+void EntryIndex::getByColorNear(IndexedColor attribute, uint32_t rgb, float maxDistance, Bitmap& positions) const {
+    positions.clear();
+    if (attribute >= INDEX_COLOR_COUNT) {
+        return;
+    }
+    
+    _byRgb[attribute].find(ColorLab::fromRgb(rgb), maxDistance, positions);
+}
+
+void EntryIndex::getTextCandidates(const String& text, Bitmap& positions) const {
+    _byText.getCandidates(text, _byTimestamp.size(), positions);
+}
+
+void EntryIndex::getByDateRange(time_t startTime, time_t endTime, std::vector<uint32_t>& positions) const {
+    positions.clear();
+    
+    std::vector<TimeKey>::const_iterator first, last;
+    findDateRange(startTime, endTime, first, last);
+    
+    positions.reserve(last - first);
+    for (auto it = first; it != last; ++it) {
+        positions.push_back(it->position);
+    }
+    
+    // Report matches in entry order, as a scan would
+    std::sort(positions.begin(), positions.end());
+}
+
+void EntryIndex::getByDateRange(time_t startTime, time_t endTime, Bitmap& positions) const {
+    std::vector<uint32_t> sorted;
+    getByDateRange(startTime, endTime, sorted);
+    
+    positions.clear();
+    for (uint32_t position : sorted) {
+        positions.add(position);
+    }
+}
+
+size_t EntryIndex::countByDateRange(time_t startTime, time_t endTime) const {
+    std::vector<TimeKey>::const_iterator first, last;
+    findDateRange(startTime, endTime, first, last);
+    return last - first;
+}
+
+size_t EntryIndex::countByColor(IndexedColor attribute, const String& colorName) const {
+    if (attribute >= INDEX_COLOR_COUNT) {
+        return 0;
+    }
+    
+    // Each entry has one name per attribute, so the matching sets are disjoint
+    size_t count = 0;
+    String key = colorKey(colorName);
+    for (const auto& color : _byColor[attribute]) {
+        if (color.name.indexOf(key) >= 0) {
+            count += color.positions.cardinality();
+        }
+    }
+    return count;
+}
+
+size_t EntryIndex::countByColorNear(IndexedColor attribute, uint32_t rgb, float maxDistance) const {
+    if (attribute >= INDEX_COLOR_COUNT) {
+        return 0;
+    }
+    
+    return _byRgb[attribute].count(ColorLab::fromRgb(rgb), maxDistance);
+}
+
+size_t EntryIndex::estimateText(const String& text) const {
+    return _byText.estimateCandidates(text, _byTimestamp.size());
+}
+
+bool EntryIndex::getByTimeRank(size_t rank, time_t& timestamp, uint32_t& position) const {
+    if (rank >= _byTimestamp.size()) {
+        return false;
+    }
+    
+    timestamp = _byTimestamp[rank].timestamp;
+    position = _byTimestamp[rank].position;
+    return true;
+}
+
+size_t EntryIndex::countBefore(time_t timestamp, uint32_t position) const {
+    TimeKey key = {timestamp, position};
+    auto it = std::lower_bound(_byTimestamp.begin(), _byTimestamp.end(), key, [](const TimeKey& a, const TimeKey& b) {
+        return timeKeyLess(a.timestamp, a.position, b.timestamp, b.position);
+    });
+    return it - _byTimestamp.begin();
+}
+
+size_t EntryIndex::getMemoryUsage() const {
+    size_t bytes = _byTimestamp.capacity() * sizeof(TimeKey) + _byText.getMemoryUsage();
+    for (const auto& grid : _byRgb) {
+        bytes += grid.getMemoryUsage();
+    }
+    
+    for (const auto& positions : _byGender) {
+        bytes += positions.getMemoryUsage();
+    }
+    for (const auto& positions : _byItemType) {
+        bytes += positions.getMemoryUsage();
+    }
+    for (const auto& colors : _byColor) {
+        for (const auto& color : colors) {
+            bytes += sizeof(ColorKey) + color.name.length() + color.positions.getMemoryUsage();
+        }
+    }
+    
+    return bytes;
+}
+
+void EntryIndex::addColor(IndexedColor attribute, const ColorName& colorName, uint32_t position) {
+    // Keys are stored lowercase, so known names match without building a key
+    std::vector<ColorKey>& colors = _byColor[attribute];
+    for (auto& color : colors) {
+        if (strcasecmp(color.name.c_str(), colorName.c_str()) == 0) {
+            color.positions.add(position);
+            return;
+        }
+    }
+    
+    colors.push_back(ColorKey());
+    colors.back().name = colorKey(colorName);
+    colors.back().positions.add(position);
+}
+
+void EntryIndex::indexAttributes(uint32_t position, const LogEntry& entry) {
+    if ((size_t)entry.getGender() < INDEX_GENDER_COUNT) {
+        _byGender[entry.getGender()].add(position);
+    }
+    if ((size_t)entry.getItemType() < INDEX_ITEM_TYPE_COUNT) {
+        _byItemType[entry.getItemType()].add(position);
+    }
+    
+    addColor(INDEX_COLOR_SHIRT, entry.getShirtColor().name, position);
+    addColor(INDEX_COLOR_PANTS, entry.getPantsColor().name, position);
+    addColor(INDEX_COLOR_SHOES, entry.getShoesColor().name, position);
+    
+    const Color* colors[INDEX_COLOR_COUNT] = {&entry.getShirtColor(), &entry.getPantsColor(), &entry.getShoesColor()};
+    for (size_t attribute = 0; attribute < INDEX_COLOR_COUNT; attribute++) {
+        if (colors[attribute]->isRecorded()) {
+            _byRgb[attribute].add(colors[attribute]->rgb, position);
+        }
+    }
+    
+    _byText.add(position, entry);
+}
+
+void EntryIndex::findDateRange(time_t startTime, time_t endTime,
+                               std::vector<TimeKey>::const_iterator& first,
+                               std::vector<TimeKey>::const_iterator& last) const {
+    first = std::lower_bound(_byTimestamp.begin(), _byTimestamp.end(), startTime, [](const TimeKey& key, time_t time) {
+        return key.timestamp < time;
+    });
+    last = std::upper_bound(first, _byTimestamp.end(), endTime, [](time_t time, const TimeKey& key) {
+        return time < key.timestamp;
+    });
+}
+
+String EntryIndex::colorKey(const String& colorName) {
+    String key = colorName;
+    key.toLowerCase();
+    return key;
+}
+
+void EntryIndex::serialize(std::vector<uint8_t>& out) const {
+    for (const auto& positions : _byGender) {
+        positions.serialize(out);
+    }
+    for (const auto& positions : _byItemType) {
+        positions.serialize(out);
+    }
+    
+    for (const auto& colors : _byColor) {
+        uint32_t count = colors.size();
+        putRaw(out, &count, sizeof(count));
+        for (const auto& color : colors) {
+            uint32_t len = color.name.length();
+            putRaw(out, &len, sizeof(len));
+            putRaw(out, color.name.c_str(), len);
+            color.positions.serialize(out);
+        }
+    }
+    
+    // Written field by field to leave out padding; the timestamp size guards
+    // against a file saved by a build with another time_t
+    uint32_t header[2] = {(uint32_t)_byTimestamp.size(), (uint32_t)sizeof(time_t)};
+    putRaw(out, header, sizeof(header));
+    for (const auto& key : _byTimestamp) {
+        putRaw(out, &key.timestamp, sizeof(key.timestamp));
+        putRaw(out, &key.position, sizeof(key.position));
+    }
+    
+    _byText.serialize(out);
+    for (const auto& grid : _byRgb) {
+        grid.serialize(out);
+    }
+}
+
+bool EntryIndex::deserialize(const uint8_t* data, size_t len) {
+    clear();
+    
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    bool valid = true;
+    
+    for (auto& positions : _byGender) {
+        valid = valid && positions.deserialize(p, end);
+    }
+    for (auto& positions : _byItemType) {
+        valid = valid && positions.deserialize(p, end);
+    }
+    
+    for (auto& colors : _byColor) {
+        uint32_t count = 0;
+        valid = valid && getRaw(p, end, &count, sizeof(count)) && count <= (size_t)(end - p) / sizeof(uint32_t);
+        if (!valid) {
+            break;
+        }
+        
+        colors.resize(count);
+        for (auto& color : colors) {
+            uint32_t nameLen = 0;
+            valid = valid && getRaw(p, end, &nameLen, sizeof(nameLen)) && nameLen <= (size_t)(end - p);
+            if (!valid) {
+                break;
+            }
+            color.name = "";
+            color.name.concat((const char*)p, nameLen);
+            p += nameLen;
+            valid = color.positions.deserialize(p, end);
+        }
+    }
+    
+    uint32_t header[2] = {0, 0};
+    valid = valid && getRaw(p, end, header, sizeof(header)) && header[1] == sizeof(time_t) &&
+            header[0] <= (size_t)(end - p) / (sizeof(time_t) + sizeof(uint32_t));
+    if (valid) {
+        _byTimestamp.resize(header[0]);
+        for (auto& key : _byTimestamp) {
+            getRaw(p, end, &key.timestamp, sizeof(key.timestamp));
+            getRaw(p, end, &key.position, sizeof(key.position));
+        }
+    }
+    
+    valid = valid && _byText.deserialize(p, end);
+    for (auto& grid : _byRgb) {
+        valid = valid && grid.deserialize(p, end);
+    }
+    valid = valid && p == end;
+    if (!valid) {
+        clear();
+    }
+    return valid;
+}
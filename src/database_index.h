@@ -0,0 +1,230 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Database Indexes
+ * 
+ * This file contains the secondary indexes the database keeps over its entries
+ */
+
+#ifndef DATA_DATABASE_INDEX_H
+#define DATA_DATABASE_INDEX_H
+
+#include <Arduino.h>
+#include <vector>
+#include "log_entry.h"
+#include "entry_table.h"
+#include "bitmap.h"
+#include "trigram_index.h"
+#include "color_grid.h"
+#include "../config.h"
+
+// Number of indexed values per attribute
+#define INDEX_GENDER_COUNT (GENDER_OTHER + 1)
+#define INDEX_ITEM_TYPE_COUNT (ITEM_OTHER + 1)
+
+class EntryIndex {
+public:
+    /**
+     * Remove all indexed entries
+     */
+    void clear();
+    
+    /**
+     * Rebuild the index from scratch
+     * @param entries entries to index, addressed by their position
+     */
+    void rebuild(const EntryTable& entries);
+    
+    /**
+     * Index an entry appended at the end of the entry list
+     * @param position position of the new entry
+     * @param entry entry to index
+     */
+    void add(uint32_t position, const LogEntry& entry);
+    
+    /**
+     * Index the entries appended at the end of the entry list, merging their
+     * timestamps in with one pass instead of one insert each
+     * @param entries entries, of which the tail is indexed
+     * @param first position of the first entry not yet indexed
+     */
+    void addRange(const EntryTable& entries, size_t first);
+    
+    /**
+     * Remove an entry and shift the positions of the entries after it
+     * @param position position of the removed entry
+     * @param entry entry being removed
+     */
+    void remove(uint32_t position, const LogEntry& entry);
+    
+    /**
+     * Re-index an entry whose content was replaced in place
+     * @param position position of the entry
+     * @param oldEntry entry content before the change
+     * @param newEntry entry content after the change
+     */
+    void replace(uint32_t position, const LogEntry& oldEntry, const LogEntry& newEntry);
+    
+    /**
+     * Get the number of indexed entries
+     * @return number of entries
+     */
+    size_t size() const;
+    
+    /**
+     * Get positions of entries with a gender
+     * @param gender gender to look up
+     * @return bitmap of positions
+     */
+    const Bitmap& getByGender(Gender gender) const;
+    
+    /**
+     * Get positions of entries with an item type
+     * @param itemType item type to look up
+     * @return bitmap of positions
+     */
+    const Bitmap& getByItemType(ItemType itemType) const;
+    
+    /**
+     * Get positions of entries whose color name contains a string
+     * (case-insensitive), matching SearchEngine's color filters
+     * @param attribute color attribute to look up
+     * @param colorName text to look for in the color name
+     * @param positions bitmap to fill
+     */
+    void getByColor(IndexedColor attribute, const String& colorName, Bitmap& positions) const;
+    
+    /**
+     * Get positions of entries whose recorded RGB color is within a CIELAB
+     * distance of a color
+     * @param attribute color attribute to look up
+     * @param rgb color to look for, as 0xRRGGBB
+     * @param maxDistance largest CIELAB distance matched
+     * @param positions bitmap to fill
+     */
+    void getByColorNear(IndexedColor attribute, uint32_t rgb, float maxDistance, Bitmap& positions) const;
+    
+    /**
+     * Get positions of entries that may contain a string in their
+     * description, notes or color names. Candidates must be checked with
+     * TrigramIndex::matches()
+     * @param text text to look for (any case)
+     * @param positions bitmap to fill with candidate positions
+     */
+    void getTextCandidates(const String& text, Bitmap& positions) const;
+    
+    /**
+     * Get positions of entries within a date range
+     * @param startTime start of date range (inclusive)
+     * @param endTime end of date range (inclusive)
+     * @param positions vector to fill with ascending positions
+     */
+    void getByDateRange(time_t startTime, time_t endTime, std::vector<uint32_t>& positions) const;
+    
+    /**
+     * Get positions of entries within a date range
+     * @param startTime start of date range (inclusive)
+     * @param endTime end of date range (inclusive)
+     * @param positions bitmap to fill
+     */
+    void getByDateRange(time_t startTime, time_t endTime, Bitmap& positions) const;
+    
+    /**
+     * Count entries within a date range
+     * @param startTime start of date range (inclusive)
+     * @param endTime end of date range (inclusive)
+     * @return number of entries
+     */
+    size_t countByDateRange(time_t startTime, time_t endTime) const;
+    
+    /**
+     * Count entries whose color name contains a string (case-insensitive)
+     * @param attribute color attribute to look up
+     * @param colorName text to look for in the color name
+     * @return number of entries
+     */
+    size_t countByColor(IndexedColor attribute, const String& colorName) const;
+    
+    /**
+     * Count entries whose recorded RGB color is within a CIELAB distance of
+     * a color
+     * @param attribute color attribute to look up
+     * @param rgb color to look for, as 0xRRGGBB
+     * @param maxDistance largest CIELAB distance matched
+     * @return number of entries
+     */
+    size_t countByColorNear(IndexedColor attribute, uint32_t rgb, float maxDistance) const;
+    
+    /**
+     * Estimate how many entries may contain a string in their text fields
+     * @param text text to look for (any case)
+     * @return upper bound on the number of matches
+     */
+    size_t estimateText(const String& text) const;
+    
+    /**
+     * Get an entry by its rank in timestamp order
+     * @param rank rank, 0 being the oldest entry
+     * @param timestamp reference to store the timestamp
+     * @param position reference to store the position
+     * @return true if successful, false if the rank is out of range
+     */
+    bool getByTimeRank(size_t rank, time_t& timestamp, uint32_t& position) const;
+    
+    /**
+     * Count entries ordered before a key in timestamp order, ties broken
+     * by position
+     * @param timestamp timestamp of the key
+     * @param position position of the key
+     * @return number of entries before the key
+     */
+    size_t countBefore(time_t timestamp, uint32_t position) const;
+    
+    /**
+     * Get the heap memory used by the indexes
+     * @return bytes used
+     */
+    size_t getMemoryUsage() const;
+    
+    /**
+     * Append the indexes to a buffer saved with the database file
+     * @param out buffer to append to
+     */
+    void serialize(std::vector<uint8_t>& out) const;
+    
+    /**
+     * Replace the indexes with ones written by serialize
+     * @param data serialized indexes
+     * @param len length of data
+     * @return true if successful, false if the data is invalid (the indexes are left empty)
+     */
+    bool deserialize(const uint8_t* data, size_t len);
+
+private:
+    struct TimeKey {
+        time_t timestamp;
+        uint32_t position;
+    };
+    
+    // Distinct color names (lowercase) and the entries using them
+    struct ColorKey {
+        String name;
+        Bitmap positions;
+    };
+    
+    Bitmap _byGender[INDEX_GENDER_COUNT];
+    Bitmap _byItemType[INDEX_ITEM_TYPE_COUNT];
+    std::vector<ColorKey> _byColor[INDEX_COLOR_COUNT];
+    ColorGrid _byRgb[INDEX_COLOR_COUNT];
+    std::vector<TimeKey> _byTimestamp;
+    TrigramIndex _byText;
+    
+    void addColor(IndexedColor attribute, const ColorName& colorName, uint32_t position);
+    void indexAttributes(uint32_t position, const LogEntry& entry);
+    void findDateRange(time_t startTime, time_t endTime,
+                       std::vector<TimeKey>::const_iterator& first,
+                       std::vector<TimeKey>::const_iterator& last) const;
+    
+    static String colorKey(const String& colorName);
+};
+
+#endif // DATA_DATABASE_INDEX_H
@@ -0,0 +1,202 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Entry Cursor Implementation
+ */
+
+#include "entry_cursor.h"
+#include "database.h"
+#include "archive.h"
+#include <algorithm>
+
+EntryCursor::EntryCursor(PageOrder order, EntryFilter filter, ArchivedEntryFilter archivedFilter)
+    : _order(order), _filter(filter), _archivedFilter(archivedFilter), _hasPage(false), _seeking(false) {
+    _first = {0, 0, false};
+    _last = {0, 0, false};
+}
+
+void EntryCursor::reset() {
+    _hasPage = false;
+    _seeking = false;
+}
+
+bool EntryCursor::next(size_t limit, ResultSet& page) {
+    bool ascending = _order == ORDER_OLDEST_FIRST;
+    
+    // Oldest first starts in the archive, newest first in memory
+    if (!_hasPage) {
+        return fetch(ascending, ascending ? 0 : (long)Database::getIndex().size() - 1, true, limit, page);
+    }
+    
+    const PageToken& from = _seeking ? _first : _last;
+    return fetch(from.archived, startRank(from, ascending, _seeking), true, limit, page);
+}
+
+bool EntryCursor::previous(size_t limit, ResultSet& page) {
+    if (!_hasPage) {
+        page = ResultSet();
+        return false;
+    }
+    
+    // Walk away from the first entry of the current page
+    bool ascending = _order != ORDER_OLDEST_FIRST;
+    return fetch(_first.archived, startRank(_first, ascending, false), false, limit, page);
+}
+
+bool EntryCursor::getToken(PageToken& token) const {
+    if (!_hasPage) {
+        return false;
+    }
+    
+    token = _first;
+    return true;
+}
+
+void EntryCursor::seek(const PageToken& token) {
+    _first = token;
+    _last = token;
+    _hasPage = true;
+    _seeking = true;
+}
+
+bool EntryCursor::fetch(bool archived, long rank, bool forward, size_t limit, ResultSet& page) {
+    bool ascending = (_order == ORDER_OLDEST_FIRST) == forward;
+    
+    std::vector<uint32_t> positions;
+    std::vector<LogEntry> entries;
+    PageToken firstKey, lastKey;
+    
+    for (int tier = 0; tier < 2; tier++) {
+        if (archived) {
+            scanArchive(rank, ascending, limit, entries, firstKey, lastKey);
+        } else {
+            scan(rank, ascending, limit, positions, firstKey, lastKey);
+        }
+        if (!positions.empty() || !entries.empty()) {
+            break;
+        }
+        
+        // The archive holds the older entries, so only an ascending walk out
+        // of the archive or a descending one out of memory goes on
+        if (archived != ascending) {
+            break;
+        }
+        archived = !archived;
+        rank = ascending ? 0 : (long)Archive::getEntryCount() - 1;
+    }
+    
+    if (positions.empty() && entries.empty()) {
+        page = ResultSet(std::move(positions), Database::getGeneration());
+        return false;
+    }
+    
+    // Walking backwards collects entries in reverse page order
+    if (!forward) {
+        std::reverse(positions.begin(), positions.end());
+        std::reverse(entries.begin(), entries.end());
+        std::swap(firstKey, lastKey);
+    }
+    
+    _first = firstKey;
+    _last = lastKey;
+    _hasPage = true;
+    _seeking = false;
+    
+    if (archived) {
+        page = ResultSet(std::move(entries));
+    } else {
+        page = ResultSet(std::move(positions), Database::getGeneration());
+    }
+    return true;
+}
+
+long EntryCursor::startRank(const PageToken& from, bool ascending, bool inclusive) const {
+    if (from.archived) {
+        if (inclusive) {
+            return from.position;
+        }
+        return ascending ? (long)from.position + 1 : (long)from.position - 1;
+    }
+    
+    // Ranks count entries in ascending timestamp order
+    const EntryIndex& index = Database::getIndex();
+    if (inclusive) {
+        return ascending ? (long)index.countBefore(from.timestamp, from.position)
+                         : (long)index.countBefore(from.timestamp, from.position + 1) - 1;
+    }
+    return ascending ? (long)index.countBefore(from.timestamp, from.position + 1)
+                     : (long)index.countBefore(from.timestamp, from.position) - 1;
+}
+
+void EntryCursor::scan(long rank, bool ascending, size_t limit, std::vector<uint32_t>& positions,
+                       PageToken& firstKey, PageToken& lastKey) const {
+    const EntryIndex& index = Database::getIndex();
+    const EntryTable& entries = Database::getEntries();
+
+    positions.reserve(limit);
+    
+    while (positions.size() < limit && rank >= 0 && rank < (long)index.size()) {
+        time_t timestamp;
+        uint32_t position;
+        index.getByTimeRank(rank, timestamp, position);
+        rank += ascending ? 1 : -1;
+        
+        if (_filter && !_filter(position, entries)) {
+            continue;
+        }
+        
+        if (positions.empty()) {
+            firstKey = {timestamp, position, false};
+        }
+        lastKey = {timestamp, position, false};
+        positions.push_back(position);
+    }
+}
+
+void EntryCursor::scanArchive(long place, bool ascending, size_t limit, std::vector<LogEntry>& entries,
+                              PageToken& firstKey, PageToken& lastKey) const {
+    if (_filter && !_archivedFilter) {
+        return;
+    }
+    
+    long count = (long)Archive::getEntryCount();
+    
+    while (entries.size() < limit && place >= 0 && place < count) {
+        // Read up to a segment's worth at a time, oldest first either way
+        long first = ascending ? place : std::max(0L, place - ARCHIVE_SEGMENT_ENTRIES + 1);
+        long last = ascending ? std::min(count - 1, place + ARCHIVE_SEGMENT_ENTRIES - 1) : place;
+        size_t wanted = limit - entries.size();
+        
+        // Descending keeps only the newest matches of the window
+        std::vector<std::pair<long, LogEntry>> found;
+        long at = first;
+        bool read = Archive::forEachInRange(first, last - first + 1, [&](const LogEntry& entry) {
+            long current = at++;
+            if (_archivedFilter && !_archivedFilter(entry)) {
+                return true;
+            }
+            found.push_back(std::make_pair(current, entry));
+            if (ascending) {
+                return found.size() < wanted;
+            }
+            if (found.size() > wanted) {
+                found.erase(found.begin());
+            }
+            return true;
+        });
+        if (!read) {
+            break;
+        }
+        
+        if (!ascending) {
+            std::reverse(found.begin(), found.end());
+        }
+        for (const auto& match : found) {
+            if (entries.empty()) {
+                firstKey = {match.second.getTimestamp(), (uint32_t)match.first, true};
+            }
+            lastKey = {match.second.getTimestamp(), (uint32_t)match.first, true};
+            entries.push_back(match.second);
+        }
+        place = ascending ? last + 1 : first - 1;
+    }
+}
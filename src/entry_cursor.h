@@ -0,0 +1,110 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Entry Cursor
+ * 
+ * This file contains the cursor used to page through entries in timestamp
+ * order without loading the whole database
+ */
+
+#ifndef DATA_ENTRY_CURSOR_H
+#define DATA_ENTRY_CURSOR_H
+
+#include <Arduino.h>
+#include <vector>
+#include <functional>
+#include "log_entry.h"
+#include "entry_table.h"
+#include "result_set.h"
+#include "../config.h"
+
+// Page order
+enum PageOrder {
+    ORDER_NEWEST_FIRST,
+    ORDER_OLDEST_FIRST
+};
+
+// Entry predicate for paged queries, reading the entry columns
+typedef std::function<bool(uint32_t position, const EntryTable& entries)> EntryFilter;
+
+// Entry predicate for archived entries, which have no columns to read
+typedef std::function<bool(const LogEntry& entry)> ArchivedEntryFilter;
+
+// Sort key of an entry, used to resume paging after it. Positions shift when
+// entries are deleted, so a token from an older generation only resumes
+// exactly when its timestamp is unique. Places in the archive never shift
+struct PageToken {
+    time_t timestamp;
+    uint32_t position;  // Position in memory, or place in the archive
+    bool archived;
+};
+
+/**
+ * Pages run through the entries in memory in timestamp order and through the
+ * archive in the order entries were retired, the archive holding the older
+ * ones. A page never mixes the two, so the last page before the archive may
+ * be short
+ */
+class EntryCursor {
+public:
+    /**
+     * Create a cursor positioned before the first page
+     * @param order page order
+     * @param filter optional entry predicate
+     * @param archivedFilter the same predicate for archived entries. With a
+     *        filter but none for archived entries, the archive is left out
+     */
+    EntryCursor(PageOrder order = ORDER_NEWEST_FIRST, EntryFilter filter = nullptr,
+                ArchivedEntryFilter archivedFilter = nullptr);
+    
+    /**
+     * Move back before the first page
+     */
+    void reset();
+    
+    /**
+     * Move to the page after the current one
+     * @param limit maximum number of entries
+     * @param page result set to fill
+     * @return true if any entry was found, false at the end
+     */
+    bool next(size_t limit, ResultSet& page);
+    
+    /**
+     * Move to the page before the current one
+     * @param limit maximum number of entries
+     * @param page result set to fill
+     * @return true if any entry was found, false at the start
+     */
+    bool previous(size_t limit, ResultSet& page);
+    
+    /**
+     * Get a token for the start of the current page
+     * @param token reference to store the token
+     * @return true if successful, false if no page has been read
+     */
+    bool getToken(PageToken& token) const;
+    
+    /**
+     * Position the cursor so the next page starts at a token
+     * @param token token from getToken()
+     */
+    void seek(const PageToken& token);
+
+private:
+    PageOrder _order;
+    EntryFilter _filter;
+    ArchivedEntryFilter _archivedFilter;
+    bool _hasPage;
+    bool _seeking;      // Next page starts at _first instead of after _last
+    PageToken _first;   // First entry of the current page
+    PageToken _last;    // Last entry of the current page
+    
+    bool fetch(bool archived, long rank, bool forward, size_t limit, ResultSet& page);
+    long startRank(const PageToken& from, bool ascending, bool inclusive) const;
+    void scan(long rank, bool ascending, size_t limit, std::vector<uint32_t>& positions,
+              PageToken& firstKey, PageToken& lastKey) const;
+    void scanArchive(long place, bool ascending, size_t limit, std::vector<LogEntry>& entries,
+                     PageToken& firstKey, PageToken& lastKey) const;
+};
+
+#endif // DATA_ENTRY_CURSOR_H
@@ -0,0 +1,387 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Entry Statistics Implementation
+ */
+
+#include "entry_stats.h"
+#include <algorithm>
+
+static const int32_t SECONDS_PER_DAY = 86400;
+static const size_t NO_ROW = (size_t)-1;
+
+// Counter layout of a day row
+static const size_t COLUMN_TOTAL = 0;
+static const size_t COLUMN_GENDER = COLUMN_TOTAL + 1;
+static const size_t COLUMN_ITEM_TYPE = COLUMN_GENDER + STATS_GENDER_COUNT;
+static const size_t COLUMN_HOUR = COLUMN_ITEM_TYPE + STATS_ITEM_TYPE_COUNT;
+static const size_t COLUMN_COLOR = COLUMN_HOUR + STATS_HOUR_COUNT;
+static const size_t ROW_SIZE = COLUMN_COLOR + INDEX_COLOR_COUNT * STATS_COLOR_SLOTS;
+
+// Saved rows list their nonzero counters by column number
+static_assert(ROW_SIZE < 256, "Too many counters per day");
+
+static const String OTHER_COLOR = "Other";
+
+static void putRaw(std::vector<uint8_t>& out, const void* data, size_t len) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    out.insert(out.end(), bytes, bytes + len);
+}
+
+static bool getRaw(const uint8_t*& p, const uint8_t* end, void* data, size_t len) {
+    if ((size_t)(end - p) < len) {
+        return false;
+    }
+    memcpy(data, p, len);
+    p += len;
+    return true;
+}
+
+// Whole days since the epoch, rounding down for times before it
+static int32_t dayOf(time_t timestamp) {
+    int64_t seconds = (int64_t)timestamp;
+    int64_t day = seconds / SECONDS_PER_DAY;
+    if (seconds % SECONDS_PER_DAY < 0) {
+        day--;
+    }
+    return (int32_t)day;
+}
+
+EntryStats::EntryStats() : _prefixValid(0) {
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        _colorsEmptied[i] = false;
+    }
+}
+
+void EntryStats::clear() {
+    _days.clear();
+    _counts.clear();
+    _prefix.clear();
+    _prefixValid = 0;
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        _colorNames[i].clear();
+        _colorsEmptied[i] = false;
+    }
+}
+
+void EntryStats::add(const LogEntry& entry) {
+    const char* colors[INDEX_COLOR_COUNT] = {entry.getShirtColor().name.c_str(), entry.getPantsColor().name.c_str(), entry.getShoesColor().name.c_str()};
+    update(entry.getTimestamp(), entry.getGender(), entry.getItemType(), colors, true);
+}
+
+void EntryStats::add(const EntryTable& entries, size_t position) {
+    const char* colors[INDEX_COLOR_COUNT];
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        colors[i] = entries.getColorName((IndexedColor)i, position).c_str();
+    }
+    update(entries.getTimestamp(position), entries.getGender(position), entries.getItemType(position), colors, true);
+}
+
+void EntryStats::remove(const LogEntry& entry) {
+    const char* colors[INDEX_COLOR_COUNT] = {entry.getShirtColor().name.c_str(), entry.getPantsColor().name.c_str(), entry.getShoesColor().name.c_str()};
+    update(entry.getTimestamp(), entry.getGender(), entry.getItemType(), colors, false);
+}
+
+void EntryStats::remove(const EntryTable& entries, size_t position) {
+    const char* colors[INDEX_COLOR_COUNT];
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        colors[i] = entries.getColorName((IndexedColor)i, position).c_str();
+    }
+    update(entries.getTimestamp(position), entries.getGender(position), entries.getItemType(position), colors, false);
+}
+
+time_t EntryStats::getDayStart(time_t timestamp) {
+    return (time_t)dayOf(timestamp) * SECONDS_PER_DAY;
+}
+
+uint32_t EntryStats::count(time_t startTime, time_t endTime) const {
+    size_t first, last;
+    range(startTime, endTime, first, last);
+    if (first >= last) {
+        return 0;
+    }
+    
+    buildPrefix(last);
+    return _prefix[last * ROW_SIZE + COLUMN_TOTAL] - _prefix[first * ROW_SIZE + COLUMN_TOTAL];
+}
+
+void EntryStats::summarize(time_t startTime, time_t endTime, StatsSummary& summary) const {
+    memset(&summary, 0, sizeof(summary));
+    
+    size_t first, last;
+    range(startTime, endTime, first, last);
+    if (first >= last) {
+        return;
+    }
+    
+    buildPrefix(last);
+    const uint32_t* from = &_prefix[first * ROW_SIZE];
+    const uint32_t* to = &_prefix[last * ROW_SIZE];
+    
+    summary.total = to[COLUMN_TOTAL] - from[COLUMN_TOTAL];
+    for (size_t i = 0; i < STATS_GENDER_COUNT; i++) {
+        summary.genders[i] = to[COLUMN_GENDER + i] - from[COLUMN_GENDER + i];
+    }
+    for (size_t i = 0; i < STATS_ITEM_TYPE_COUNT; i++) {
+        summary.itemTypes[i] = to[COLUMN_ITEM_TYPE + i] - from[COLUMN_ITEM_TYPE + i];
+    }
+    for (size_t i = 0; i < STATS_HOUR_COUNT; i++) {
+        summary.hours[i] = to[COLUMN_HOUR + i] - from[COLUMN_HOUR + i];
+    }
+    for (size_t attribute = 0; attribute < INDEX_COLOR_COUNT; attribute++) {
+        size_t column = COLUMN_COLOR + attribute * STATS_COLOR_SLOTS;
+        for (size_t i = 0; i < STATS_COLOR_SLOTS; i++) {
+            summary.colors[attribute][i] = to[column + i] - from[column + i];
+        }
+    }
+}
+
+size_t EntryStats::getColorCount(IndexedColor attribute) const {
+    const std::vector<String>& names = _colorNames[attribute];
+    return names.size() < STATS_COLOR_SLOTS - 1 ? names.size() : STATS_COLOR_SLOTS;
+}
+
+const String& EntryStats::getColorName(IndexedColor attribute, size_t slot) const {
+    return slot < _colorNames[attribute].size() ? _colorNames[attribute][slot] : OTHER_COLOR;
+}
+
+size_t EntryStats::getMemoryUsage() const {
+    size_t bytes = _days.capacity() * sizeof(int32_t) + _counts.capacity() * sizeof(uint16_t);
+    bytes += _prefix.capacity() * sizeof(uint32_t);
+    for (size_t attribute = 0; attribute < INDEX_COLOR_COUNT; attribute++) {
+        bytes += _colorNames[attribute].capacity() * sizeof(String);
+        for (const auto& name : _colorNames[attribute]) {
+            bytes += name.length() + 1;
+        }
+    }
+    return bytes;
+}
+
+void EntryStats::serialize(std::vector<uint8_t>& out) const {
+    // The row size guards against a file saved by a build with other counters
+    uint32_t rowSize = ROW_SIZE;
+    putRaw(out, &rowSize, sizeof(rowSize));
+    for (size_t attribute = 0; attribute < INDEX_COLOR_COUNT; attribute++) {
+        uint32_t names = _colorNames[attribute].size();
+        putRaw(out, &names, sizeof(names));
+        for (const auto& name : _colorNames[attribute]) {
+            uint8_t len = (uint8_t)name.length();
+            putRaw(out, &len, sizeof(len));
+            putRaw(out, name.c_str(), len);
+        }
+    }
+    
+    // Each day lists only its nonzero counters, most of which are zero
+    uint32_t days = _days.size();
+    putRaw(out, &days, sizeof(days));
+    for (size_t row = 0; row < _days.size(); row++) {
+        const uint16_t* counts = &_counts[row * ROW_SIZE];
+        uint8_t used = 0;
+        for (size_t column = 0; column < ROW_SIZE; column++) {
+            used += counts[column] != 0;
+        }
+        
+        putRaw(out, &_days[row], sizeof(int32_t));
+        putRaw(out, &used, sizeof(used));
+        for (size_t column = 0; column < ROW_SIZE; column++) {
+            if (counts[column] != 0) {
+                uint8_t index = (uint8_t)column;
+                putRaw(out, &index, sizeof(index));
+                putRaw(out, &counts[column], sizeof(uint16_t));
+            }
+        }
+    }
+}
+
+bool EntryStats::deserialize(const uint8_t* data, size_t len) {
+    clear();
+    
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    
+    uint32_t rowSize = 0;
+    bool valid = getRaw(p, end, &rowSize, sizeof(rowSize)) && rowSize == ROW_SIZE;
+    for (size_t attribute = 0; valid && attribute < INDEX_COLOR_COUNT; attribute++) {
+        uint32_t names = 0;
+        valid = getRaw(p, end, &names, sizeof(names)) && names < STATS_COLOR_SLOTS;
+        for (uint32_t i = 0; valid && i < names; i++) {
+            uint8_t nameLen = 0;
+            valid = getRaw(p, end, &nameLen, sizeof(nameLen)) && nameLen <= (size_t)(end - p);
+            if (valid) {
+                String name;
+                name.concat((const char*)p, nameLen);
+                _colorNames[attribute].push_back(name);
+                p += nameLen;
+            }
+        }
+    }
+    
+    uint32_t days = 0;
+    valid = valid && getRaw(p, end, &days, sizeof(days)) && days <= (size_t)(end - p) / (sizeof(int32_t) + 1);
+    if (valid) {
+        _days.resize(days);
+        _counts.assign((size_t)days * ROW_SIZE, 0);
+    }
+    
+    for (uint32_t row = 0; valid && row < days; row++) {
+        uint8_t used = 0;
+        valid = getRaw(p, end, &_days[row], sizeof(int32_t)) && getRaw(p, end, &used, sizeof(used)) &&
+                (row == 0 || _days[row] > _days[row - 1]);
+        for (uint8_t i = 0; valid && i < used; i++) {
+            uint8_t column = 0;
+            uint16_t value = 0;
+            valid = getRaw(p, end, &column, sizeof(column)) && getRaw(p, end, &value, sizeof(value)) && column < ROW_SIZE;
+            if (valid) {
+                _counts[row * ROW_SIZE + column] = value;
+            }
+        }
+    }
+    
+    valid = valid && p == end;
+    if (!valid) {
+        clear();
+    }
+    return valid;
+}
+
+void EntryStats::update(time_t timestamp, Gender gender, ItemType itemType, const char* const colors[INDEX_COLOR_COUNT], bool add) {
+    int32_t day = dayOf(timestamp);
+    size_t row = findDay(day, add);
+    if (row == NO_ROW) {
+        return;
+    }
+    
+    size_t columns[3 + INDEX_COLOR_COUNT];
+    size_t used = 0;
+    columns[used++] = COLUMN_GENDER + (gender <= GENDER_OTHER ? gender : GENDER_UNKNOWN);
+    columns[used++] = COLUMN_ITEM_TYPE + (itemType <= ITEM_OTHER ? itemType : ITEM_UNKNOWN);
+    columns[used++] = COLUMN_HOUR + (size_t)(((int64_t)timestamp - (int64_t)day * SECONDS_PER_DAY) / 3600);
+    for (size_t attribute = 0; attribute < INDEX_COLOR_COUNT; attribute++) {
+        size_t slot = findColor(attribute, colors[attribute], add);
+        if (slot != NO_ROW) {
+            columns[used++] = COLUMN_COLOR + attribute * STATS_COLOR_SLOTS + slot;
+        }
+    }
+    
+    // Counters saturate instead of wrapping; a day would need 65535 entries
+    uint16_t* counts = &_counts[row * ROW_SIZE];
+    if (add) {
+        counts[COLUMN_TOTAL] += counts[COLUMN_TOTAL] < UINT16_MAX;
+        for (size_t i = 0; i < used; i++) {
+            counts[columns[i]] += counts[columns[i]] < UINT16_MAX;
+        }
+    } else {
+        counts[COLUMN_TOTAL] -= counts[COLUMN_TOTAL] > 0;
+        for (size_t i = 0; i < used; i++) {
+            counts[columns[i]] -= counts[columns[i]] > 0;
+            if (counts[columns[i]] == 0 && columns[i] >= COLUMN_COLOR) {
+                _colorsEmptied[(columns[i] - COLUMN_COLOR) / STATS_COLOR_SLOTS] = true;
+            }
+        }
+    }
+    
+    // Sums up to this day are unaffected
+    _prefixValid = std::min(_prefixValid, row);
+}
+
+size_t EntryStats::findDay(int32_t day, bool create) {
+    auto it = std::lower_bound(_days.begin(), _days.end(), day);
+    size_t row = it - _days.begin();
+    if (it != _days.end() && *it == day) {
+        return row;
+    }
+    if (!create) {
+        return NO_ROW;
+    }
+    
+    // Entries nearly always arrive for the latest day, which appends
+    _days.insert(it, day);
+    _counts.insert(_counts.begin() + row * ROW_SIZE, ROW_SIZE, 0);
+    _prefixValid = std::min(_prefixValid, row);
+    return row;
+}
+
+size_t EntryStats::findColor(size_t attribute, const char* name, bool create) {
+    // Colors left unset read "Unknown" and take no slot
+    if (name[0] == '\0' || strcmp(name, "Unknown") == 0) {
+        return NO_ROW;
+    }
+    
+    std::vector<String>& names = _colorNames[attribute];
+    for (size_t i = 0; i < names.size(); i++) {
+        if (strcasecmp(names[i].c_str(), name) == 0) {
+            return i;
+        }
+    }
+    
+    if (!create) {
+        return names.size() == STATS_COLOR_SLOTS - 1 ? STATS_COLOR_SLOTS - 1 : NO_ROW;
+    }
+    
+    // Slots of colors no longer counted are freed before a new color has to
+    // share the last slot with every further one
+    if (names.size() == STATS_COLOR_SLOTS - 1 && _colorsEmptied[attribute]) {
+        pruneColors(attribute);
+    }
+    if (names.size() == STATS_COLOR_SLOTS - 1) {
+        return STATS_COLOR_SLOTS - 1;
+    }
+    
+    names.push_back(name);
+    return names.size() - 1;
+}
+
+void EntryStats::pruneColors(size_t attribute) {
+    std::vector<String>& names = _colorNames[attribute];
+    size_t column = COLUMN_COLOR + attribute * STATS_COLOR_SLOTS;
+    _colorsEmptied[attribute] = false;
+    
+    // A slot is kept while any day still counts an entry in it
+    std::vector<bool> used(names.size(), false);
+    for (size_t row = 0; row < _days.size(); row++) {
+        const uint16_t* counts = &_counts[row * ROW_SIZE + column];
+        for (size_t slot = 0; slot < names.size(); slot++) {
+            used[slot] = used[slot] || counts[slot] != 0;
+        }
+    }
+    
+    // Kept slots move down in order; the shared last slot stays put
+    size_t kept = 0;
+    for (size_t slot = 0; slot < names.size(); slot++) {
+        if (!used[slot]) {
+            continue;
+        }
+        if (kept != slot) {
+            names[kept] = names[slot];
+            for (size_t row = 0; row < _days.size(); row++) {
+                uint16_t* counts = &_counts[row * ROW_SIZE + column];
+                counts[kept] = counts[slot];
+                counts[slot] = 0;
+            }
+        }
+        kept++;
+    }
+    if (kept < names.size()) {
+        names.resize(kept);
+        _prefixValid = 0;
+    }
+}
+
+void EntryStats::range(time_t startTime, time_t endTime, size_t& first, size_t& last) const {
+    first = std::lower_bound(_days.begin(), _days.end(), dayOf(startTime)) - _days.begin();
+    last = std::upper_bound(_days.begin(), _days.end(), dayOf(endTime)) - _days.begin();
+}
+
+void EntryStats::buildPrefix(size_t rows) const {
+    // Row r of the sums covers the days before day r, so row 0 stays zero
+    _prefix.resize((_days.size() + 1) * ROW_SIZE);
+    
+    for (size_t row = _prefixValid; row < rows; row++) {
+        const uint32_t* before = &_prefix[row * ROW_SIZE];
+        const uint16_t* counts = &_counts[row * ROW_SIZE];
+        uint32_t* after = &_prefix[(row + 1) * ROW_SIZE];
+        for (size_t column = 0; column < ROW_SIZE; column++) {
+            after[column] = before[column] + counts[column];
+        }
+    }
+    _prefixValid = std::max(_prefixValid, rows);
+}
@@ -0,0 +1,165 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Entry Statistics
+ * 
+ * This file contains the counters the database keeps for dashboard and
+ * report queries
+ */
+
+#ifndef DATA_ENTRY_STATS_H
+#define DATA_ENTRY_STATS_H
+
+#include <Arduino.h>
+#include <vector>
+#include "log_entry.h"
+#include "entry_table.h"
+#include "../config.h"
+
+// Number of counted values per attribute
+#define STATS_GENDER_COUNT (GENDER_OTHER + 1)
+#define STATS_ITEM_TYPE_COUNT (ITEM_OTHER + 1)
+#define STATS_HOUR_COUNT 24
+
+// Counts of the entries in a time window, broken down by attribute
+struct StatsSummary {
+    uint32_t total;
+    uint32_t genders[STATS_GENDER_COUNT];
+    uint32_t itemTypes[STATS_ITEM_TYPE_COUNT];
+    uint32_t hours[STATS_HOUR_COUNT];
+    uint32_t colors[INDEX_COLOR_COUNT][STATS_COLOR_SLOTS];  // By attribute and color slot, see EntryStats::getColorName
+};
+
+/**
+ * Entry counters per day: a total and one per gender, item type, hour of
+ * the day and color of each clothing attribute. Adding or removing an entry
+ * changes one day's counters; prefix sums over the days are brought up to
+ * date on the next query from the earliest changed day on, so a window of
+ * any length costs two binary searches and one row difference. Only days
+ * with entries take memory. Days and hours follow the device clock, which
+ * runs on UTC (see RtcHAL)
+ */
+class EntryStats {
+public:
+    EntryStats();
+    
+    /**
+     * Remove every counted entry
+     */
+    void clear();
+    
+    /**
+     * Count an entry
+     * @param entry entry to count
+     */
+    void add(const LogEntry& entry);
+    
+    /**
+     * Count an entry held in an entry table
+     * @param entries entry table
+     * @param position entry position
+     */
+    void add(const EntryTable& entries, size_t position);
+    
+    /**
+     * Stop counting an entry
+     * @param entry entry counted before
+     */
+    void remove(const LogEntry& entry);
+    
+    /**
+     * Stop counting an entry held in an entry table
+     * @param entries entry table
+     * @param position entry position
+     */
+    void remove(const EntryTable& entries, size_t position);
+    
+    /**
+     * Count the entries in a time window, resolved to the whole days its
+     * ends fall on
+     * @param startTime start of time window
+     * @param endTime end of time window
+     * @return number of entries
+     */
+    uint32_t count(time_t startTime, time_t endTime) const;
+    
+    /**
+     * Break down the entries in a time window, resolved to the whole days
+     * its ends fall on
+     * @param startTime start of time window
+     * @param endTime end of time window
+     * @param summary set to the counts of the window
+     */
+    void summarize(time_t startTime, time_t endTime, StatsSummary& summary) const;
+    
+    /**
+     * Get the number of color slots in use for a clothing attribute. The
+     * first colors seen get a slot each; once all but the last are taken by
+     * colors still counted, further colors share the last. Unset colors are
+     * not counted
+     * @param attribute clothing attribute
+     * @return number of color slots
+     */
+    size_t getColorCount(IndexedColor attribute) const;
+    
+    /**
+     * Get the name of a color slot
+     * @param attribute clothing attribute
+     * @param slot color slot
+     * @return color name, "Other" for the shared last slot
+     */
+    const String& getColorName(IndexedColor attribute, size_t slot) const;
+    
+    /**
+     * Get the start of the day a time falls on, as the counters divide days
+     * @param timestamp time within the day
+     * @return first second of the day
+     */
+    static time_t getDayStart(time_t timestamp);
+    
+    /**
+     * Get the number of days with counted entries
+     * @return number of days
+     */
+    size_t getDayCount() const {
+        return _days.size();
+    }
+    
+    /**
+     * Get the heap memory used by the counters
+     * @return bytes used
+     */
+    size_t getMemoryUsage() const;
+    
+    /**
+     * Append the counters to a buffer
+     * @param out buffer to append to
+     */
+    void serialize(std::vector<uint8_t>& out) const;
+    
+    /**
+     * Replace the counters with ones written by serialize
+     * @param data serialized counters
+     * @param len length of data
+     * @return true if successful, false if the data is invalid (the counters are left empty)
+     */
+    bool deserialize(const uint8_t* data, size_t len);
+
+private:
+    // Days with entries in ascending order, their counter rows, and the
+    // running sums of the rows before each day
+    std::vector<int32_t> _days;
+    std::vector<uint16_t> _counts;
+    mutable std::vector<uint32_t> _prefix;
+    mutable size_t _prefixValid;
+    std::vector<String> _colorNames[INDEX_COLOR_COUNT];
+    bool _colorsEmptied[INDEX_COLOR_COUNT];  // A color counter of the attribute dropped to zero since the last prune
+    
+    void update(time_t timestamp, Gender gender, ItemType itemType, const char* const colors[INDEX_COLOR_COUNT], bool add);
+    size_t findDay(int32_t day, bool create);
+    size_t findColor(size_t attribute, const char* name, bool create);
+    void pruneColors(size_t attribute);
+    void range(time_t startTime, time_t endTime, size_t& first, size_t& last) const;
+    void buildPrefix(size_t rows) const;
+};
+
+#endif // DATA_ENTRY_STATS_H
@@ -0,0 +1,272 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Entry Table Implementation
+ */
+
+#include "entry_table.h"
+#include <algorithm>
+
+EntryTable::EntryTable() {
+}
+
+void EntryTable::clear() {
+    _ids.clear();
+    _idMap.clear();
+    _timestamps.clear();
+    _genders.clear();
+    _itemTypes.clear();
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        _colorRgbs[i].clear();
+        _colorCodes[i].clear();
+    }
+    _textHandles.clear();
+    _descriptionLengths.clear();
+    _notesLengths.clear();
+    _text.clear();
+    _colorNames.clear();
+    _colorOrder.clear();
+}
+
+void EntryTable::reserve(size_t count) {
+    _ids.reserve(count);
+    _idMap.reserve(count);
+    _timestamps.reserve(count);
+    _genders.reserve(count);
+    _itemTypes.reserve(count);
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        _colorRgbs[i].reserve(count);
+        _colorCodes[i].reserve(count);
+    }
+    _textHandles.reserve(count);
+    _descriptionLengths.reserve(count);
+    _notesLengths.reserve(count);
+}
+
+void EntryTable::add(const LogEntry& entry) {
+    const Color* colors[INDEX_COLOR_COUNT] = {&entry._shirtColor, &entry._pantsColor, &entry._shoesColor};
+    
+    _idMap.insert(entry._id, _ids.size());
+    _ids.push_back(entry._id);
+    _timestamps.push_back(entry._timestamp);
+    _genders.push_back((uint8_t)entry._gender);
+    _itemTypes.push_back((uint8_t)entry._itemType);
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        _colorRgbs[i].push_back(colors[i]->rgb);
+        _colorCodes[i].push_back(encodeColor(colors[i]->name));
+    }
+    
+    _textHandles.push_back(TextArena::EMPTY);
+    _descriptionLengths.push_back(0);
+    _notesLengths.push_back(0);
+    setText(_timestamps.size() - 1, entry._itemDescription, entry._notes);
+}
+
+void EntryTable::assign(const std::vector<LogEntry>& entries) {
+    clear();
+    reserve(entries.size());
+    
+    for (const auto& entry : entries) {
+        add(entry);
+    }
+}
+
+void EntryTable::replace(size_t position, const LogEntry& entry) {
+    const Color* colors[INDEX_COLOR_COUNT] = {&entry._shirtColor, &entry._pantsColor, &entry._shoesColor};
+    
+    _timestamps[position] = entry._timestamp;
+    _genders[position] = (uint8_t)entry._gender;
+    _itemTypes[position] = (uint8_t)entry._itemType;
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        _colorRgbs[i][position] = colors[i]->rgb;
+        _colorCodes[i][position] = encodeColor(colors[i]->name);
+    }
+    
+    setText(position, entry._itemDescription, entry._notes);
+    compactText();
+}
+
+void EntryTable::remove(size_t position) {
+    _text.release(_textHandles[position], _descriptionLengths[position] + _notesLengths[position]);
+    
+    _idMap.erase(_ids[position]);
+    _ids.erase(_ids.begin() + position);
+    _timestamps.erase(_timestamps.begin() + position);
+    _genders.erase(_genders.begin() + position);
+    _itemTypes.erase(_itemTypes.begin() + position);
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        _colorRgbs[i].erase(_colorRgbs[i].begin() + position);
+        _colorCodes[i].erase(_colorCodes[i].begin() + position);
+    }
+    _textHandles.erase(_textHandles.begin() + position);
+    _descriptionLengths.erase(_descriptionLengths.begin() + position);
+    _notesLengths.erase(_notesLengths.begin() + position);
+    
+    // Later entries moved down by one, like the other columns
+    for (size_t i = position; i < _ids.size(); i++) {
+        _idMap.insert(_ids[i], i);
+    }
+    
+    compactText();
+}
+
+void EntryTable::removeFront(size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        _text.release(_textHandles[i], _descriptionLengths[i] + _notesLengths[i]);
+    }
+    
+    _ids.erase(_ids.begin(), _ids.begin() + count);
+    _timestamps.erase(_timestamps.begin(), _timestamps.begin() + count);
+    _genders.erase(_genders.begin(), _genders.begin() + count);
+    _itemTypes.erase(_itemTypes.begin(), _itemTypes.begin() + count);
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        _colorRgbs[i].erase(_colorRgbs[i].begin(), _colorRgbs[i].begin() + count);
+        _colorCodes[i].erase(_colorCodes[i].begin(), _colorCodes[i].begin() + count);
+    }
+    _textHandles.erase(_textHandles.begin(), _textHandles.begin() + count);
+    _descriptionLengths.erase(_descriptionLengths.begin(), _descriptionLengths.begin() + count);
+    _notesLengths.erase(_notesLengths.begin(), _notesLengths.begin() + count);
+    
+    // Every position changed, so the map is refilled
+    _idMap.clear();
+    for (size_t i = 0; i < _ids.size(); i++) {
+        _idMap.insert(_ids[i], i);
+    }
+    
+    compactText();
+}
+
+LogEntry EntryTable::get(size_t position) const {
+    LogEntry entry((time_t)0);
+    get(position, entry);
+    return entry;
+}
+
+void EntryTable::get(size_t position, LogEntry& entry) const {
+    Color* colors[INDEX_COLOR_COUNT] = {&entry._shirtColor, &entry._pantsColor, &entry._shoesColor};
+    
+    entry._id = _ids[position];
+    entry._timestamp = _timestamps[position];
+    entry._gender = (Gender)_genders[position];
+    entry._itemType = (ItemType)_itemTypes[position];
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        colors[i]->rgb = _colorRgbs[i][position];
+        const String& name = _colorNames[_colorCodes[i][position]];
+        colors[i]->name.assign(name.c_str(), name.length());
+    }
+    
+    const char* text = _text.get(_textHandles[position]);
+    entry._itemDescription.assign(text, _descriptionLengths[position]);
+    entry._notes.assign(text + _descriptionLengths[position], _notesLengths[position]);
+}
+
+void EntryTable::getRange(size_t first, size_t count, std::vector<LogEntry>& entries) const {
+    entries.reserve(entries.size() + count);
+    
+    for (size_t i = first; i < first + count; i++) {
+        entries.emplace_back((time_t)0);
+        get(i, entries.back());
+    }
+}
+
+bool EntryTable::findId(uint64_t id, size_t& position) const {
+    uint32_t found;
+    if (!_idMap.find(id, found)) {
+        return false;
+    }
+    
+    position = found;
+    return true;
+}
+
+void EntryTable::setId(size_t position, uint64_t id) {
+    _idMap.erase(_ids[position]);
+    _ids[position] = id;
+    _idMap.insert(id, position);
+}
+
+size_t EntryTable::getMemoryUsage() const {
+    size_t bytes = _ids.capacity() * sizeof(uint64_t) + _idMap.getMemoryUsage();
+    bytes += _timestamps.capacity() * sizeof(time_t) + _genders.capacity() + _itemTypes.capacity();
+    for (size_t i = 0; i < INDEX_COLOR_COUNT; i++) {
+        bytes += _colorRgbs[i].capacity() * sizeof(uint32_t) + _colorCodes[i].capacity() * sizeof(uint16_t);
+    }
+    bytes += _textHandles.capacity() * sizeof(uint32_t);
+    bytes += (_descriptionLengths.capacity() + _notesLengths.capacity()) * sizeof(uint16_t);
+    bytes += _text.getMemoryUsage();
+    
+    bytes += _colorNames.capacity() * sizeof(String) + _colorOrder.capacity() * sizeof(uint16_t);
+    for (const auto& name : _colorNames) {
+        bytes += name.length() + 1;
+    }
+    return bytes;
+}
+
+uint16_t EntryTable::encodeColor(const ColorName& name) {
+    auto it = std::lower_bound(_colorOrder.begin(), _colorOrder.end(), name.c_str(), [this](uint16_t code, const char* key) {
+        return strcmp(_colorNames[code].c_str(), key) < 0;
+    });
+    if (it != _colorOrder.end() && name == _colorNames[*it]) {
+        return *it;
+    }
+    
+    // Names come from the color picker, so the dictionary stays small; codes
+    // are never reused, and the dictionary only resets with the table
+    if (_colorNames.size() > 0xFFFF) {
+        DEBUG_PRINT("Color dictionary full, reusing the first color name");
+        return 0;
+    }
+    
+    uint16_t code = _colorNames.size();
+    _colorNames.push_back(String(name.c_str()));
+    _colorOrder.insert(it, code);
+    return code;
+}
+
+void EntryTable::setText(size_t position, const DescriptionText& description, const NotesText& notes) {
+    size_t descriptionLength = description.length();
+    size_t notesLength = notes.length();
+    size_t oldLength = _descriptionLengths[position] + _notesLengths[position];
+    
+    // Text of the same total length is overwritten in place
+    uint32_t handle = _textHandles[position];
+    if (descriptionLength + notesLength != oldLength) {
+        _text.release(handle, oldLength);
+        if (!_text.allocate(descriptionLength + notesLength, handle)) {
+            DEBUG_PRINT("Out of memory for entry text, storing it empty");
+            handle = TextArena::EMPTY;
+            descriptionLength = 0;
+            notesLength = 0;
+        }
+    }
+    
+    if (descriptionLength + notesLength > 0) {
+        memcpy(_text.get(handle), description.c_str(), descriptionLength);
+        memcpy(_text.get(handle) + descriptionLength, notes.c_str(), notesLength);
+    }
+    _textHandles[position] = handle;
+    _descriptionLengths[position] = descriptionLength;
+    _notesLengths[position] = notesLength;
+}
+
+void EntryTable::compactText() {
+    // Once freed text reaches half the live text, the text left in mostly
+    // empty blocks moves to the newest block so those blocks are freed whole
+    if (_text.getGarbageBytes() < ENTRY_TEXT_COMPACT_BYTES || _text.getGarbageBytes() < _text.getUsedBytes() / 2) {
+        return;
+    }
+    
+    for (size_t i = 0; i < _textHandles.size(); i++) {
+        if (!_text.isSparse(_textHandles[i])) {
+            continue;
+        }
+        
+        size_t length = _descriptionLengths[i] + _notesLengths[i];
+        uint32_t handle;
+        if (!_text.allocate(length, handle)) {
+            return;
+        }
+        memcpy(_text.get(handle), _text.get(_textHandles[i]), length);
+        _text.release(_textHandles[i], length);
+        _textHandles[i] = handle;
+    }
+}
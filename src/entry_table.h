@@ -0,0 +1,220 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Entry Table
+ * 
+ * This file contains the column store holding the database's in-memory
+ * entries, materializing LogEntry objects only when asked for one
+ */
+
+#ifndef DATA_ENTRY_TABLE_H
+#define DATA_ENTRY_TABLE_H
+
+#include <Arduino.h>
+#include <vector>
+#include "log_entry.h"
+#include "text_arena.h"
+#include "id_map.h"
+#include "../config.h"
+
+// Color attributes of an entry, shared by the color columns and the indexes
+enum IndexedColor {
+    INDEX_COLOR_SHIRT,
+    INDEX_COLOR_PANTS,
+    INDEX_COLOR_SHOES,
+    INDEX_COLOR_COUNT
+};
+
+/**
+ * Entries stored column by column: IDs, timestamps, genders, item types and
+ * RGB values in dense arrays, color names as codes into a shared dictionary,
+ * and descriptions and notes in a text arena. Scans touch only the columns
+ * they need, and no entry owns a heap allocation of its own. A hash map from
+ * ID to position finds an entry by ID without a scan
+ */
+class EntryTable {
+public:
+    EntryTable();
+    
+    /**
+     * Get the number of entries
+     * @return number of entries
+     */
+    size_t size() const {
+        return _timestamps.size();
+    }
+    
+    /**
+     * Check if the table is empty
+     * @return true if empty, false otherwise
+     */
+    bool isEmpty() const {
+        return _timestamps.empty();
+    }
+    
+    /**
+     * Remove all entries
+     */
+    void clear();
+    
+    /**
+     * Reserve room for a number of entries
+     * @param count number of entries
+     */
+    void reserve(size_t count);
+    
+    /**
+     * Append an entry
+     * @param entry entry to append
+     */
+    void add(const LogEntry& entry);
+    
+    /**
+     * Replace the entries with a list
+     * @param entries entries to store
+     */
+    void assign(const std::vector<LogEntry>& entries);
+    
+    /**
+     * Replace the content of an entry, which keeps its ID
+     * @param position entry position
+     * @param entry new content
+     */
+    void replace(size_t position, const LogEntry& entry);
+    
+    /**
+     * Remove an entry, moving every later entry down by one
+     * @param position entry position
+     */
+    void remove(size_t position);
+    
+    /**
+     * Remove the first entries
+     * @param count number of entries to remove
+     */
+    void removeFront(size_t count);
+    
+    /**
+     * Materialize an entry
+     * @param position entry position
+     * @return entry
+     */
+    LogEntry get(size_t position) const;
+    
+    /**
+     * Materialize an entry into an existing object
+     * @param position entry position
+     * @param entry set to the entry
+     */
+    void get(size_t position, LogEntry& entry) const;
+    
+    /**
+     * Materialize a run of entries
+     * @param first position of the first entry
+     * @param count number of entries
+     * @param entries vector to append the entries to
+     */
+    void getRange(size_t first, size_t count, std::vector<LogEntry>& entries) const;
+    
+    /**
+     * Find an entry by ID
+     * @param id entry ID
+     * @param position set to the entry position if found
+     * @return true if found, false otherwise
+     */
+    bool findId(uint64_t id, size_t& position) const;
+    
+    /**
+     * Set the ID of an entry that has none yet
+     * @param position entry position
+     * @param id new ID
+     */
+    void setId(size_t position, uint64_t id);
+    
+    // Column access, inline since filters call these once per scanned entry
+    
+    uint64_t getId(size_t position) const {
+        return _ids[position];
+    }
+    
+    time_t getTimestamp(size_t position) const {
+        return _timestamps[position];
+    }
+    
+    Gender getGender(size_t position) const {
+        return (Gender)_genders[position];
+    }
+    
+    ItemType getItemType(size_t position) const {
+        return (ItemType)_itemTypes[position];
+    }
+    
+    uint32_t getColorRgb(IndexedColor attribute, size_t position) const {
+        return _colorRgbs[attribute][position];
+    }
+    
+    uint16_t getColorCode(IndexedColor attribute, size_t position) const {
+        return _colorCodes[attribute][position];
+    }
+    
+    const String& getColorName(IndexedColor attribute, size_t position) const {
+        return _colorNames[_colorCodes[attribute][position]];
+    }
+    
+    const char* getItemDescription(size_t position, size_t& length) const {
+        length = _descriptionLengths[position];
+        return _text.get(_textHandles[position]);
+    }
+    
+    const char* getNotes(size_t position, size_t& length) const {
+        length = _notesLengths[position];
+        return _text.get(_textHandles[position]) + _descriptionLengths[position];
+    }
+    
+    /**
+     * Get the number of color names in the dictionary
+     * @return number of color codes
+     */
+    size_t getColorCodeCount() const {
+        return _colorNames.size();
+    }
+    
+    /**
+     * Get a color name from the dictionary
+     * @param code color code
+     * @return color name
+     */
+    const String& getColorName(uint16_t code) const {
+        return _colorNames[code];
+    }
+    
+    /**
+     * Get the heap memory used by the table
+     * @return bytes used
+     */
+    size_t getMemoryUsage() const;
+
+private:
+    std::vector<uint64_t> _ids;
+    IdMap _idMap;
+    std::vector<time_t> _timestamps;
+    std::vector<uint8_t> _genders;
+    std::vector<uint8_t> _itemTypes;
+    std::vector<uint32_t> _colorRgbs[INDEX_COLOR_COUNT];
+    std::vector<uint16_t> _colorCodes[INDEX_COLOR_COUNT];
+    
+    // Description followed by notes for each entry
+    std::vector<uint32_t> _textHandles;
+    std::vector<uint16_t> _descriptionLengths;
+    std::vector<uint16_t> _notesLengths;
+    TextArena _text;
+    
+    // Color names by code, and codes sorted by name for lookup
+    std::vector<String> _colorNames;
+    std::vector<uint16_t> _colorOrder;
+    
+    uint16_t encodeColor(const ColorName& name);
+    void setText(size_t position, const DescriptionText& description, const NotesText& notes);
+    void compactText();
+};
+
+#endif // DATA_ENTRY_TABLE_H
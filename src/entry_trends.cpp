@@ -0,0 +1,207 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Entry Trends Implementation
+ */
+
+#include "entry_trends.h"
+#include <algorithm>
+#include <ctype.h>
+
+static const int32_t EMPTY_BUCKET = INT32_MIN;
+static const time_t BUCKET_SECONDS[TREND_WINDOW_COUNT] = {3600, 86400};
+static const size_t BUCKET_COUNT[TREND_WINDOW_COUNT] = {TRENDS_SHIFT_HOURS, TRENDS_WEEK_DAYS};
+
+// Whole buckets since the epoch, rounding down for times before it
+static int32_t bucketOf(time_t timestamp, TrendWindow window) {
+    int64_t seconds = (int64_t)timestamp;
+    int64_t bucket = seconds / BUCKET_SECONDS[window];
+    if (seconds % BUCKET_SECONDS[window] < 0) {
+        bucket--;
+    }
+    return (int32_t)bucket;
+}
+
+static size_t slotOf(int32_t bucket, TrendWindow window) {
+    int32_t count = (int32_t)BUCKET_COUNT[window];
+    return (size_t)(((bucket % count) + count) % count);
+}
+
+// FNV-1a over the lowercased text, so keys differing only in case match
+static uint64_t hashKey(const char* text, size_t length) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)tolower((unsigned char)text[i]);
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Colors left unset read "Unknown" and say nothing about a suspect
+static const char* colorLabel(const ColorName& name) {
+    return name.isEmpty() || name == "Unknown" ? "-" : name.c_str();
+}
+
+EntryTrends::EntryTrends() {
+    for (size_t window = 0; window < TREND_WINDOW_COUNT; window++) {
+        _bucketIds[window].assign(BUCKET_COUNT[window], EMPTY_BUCKET);
+        for (size_t kind = 0; kind < TREND_KIND_COUNT; kind++) {
+            _buckets[window][kind].assign(BUCKET_COUNT[window], SpaceSaving(TRENDS_COUNTERS));
+        }
+    }
+}
+
+void EntryTrends::clear() {
+    for (size_t window = 0; window < TREND_WINDOW_COUNT; window++) {
+        std::fill(_bucketIds[window].begin(), _bucketIds[window].end(), EMPTY_BUCKET);
+        for (size_t kind = 0; kind < TREND_KIND_COUNT; kind++) {
+            for (auto& bucket : _buckets[window][kind]) {
+                bucket.clear();
+            }
+        }
+    }
+}
+
+void EntryTrends::add(const LogEntry& entry) {
+    update(entry, true);
+}
+
+void EntryTrends::remove(const LogEntry& entry) {
+    update(entry, false);
+}
+
+void EntryTrends::update(const LogEntry& entry, bool add) {
+    // Keys of the entry by kind; an entry without colors or description
+    // adds nothing to that kind
+    char colors[3 * MAX_COLOR_NAME_LENGTH + 7];
+    snprintf(colors, sizeof(colors), "%s / %s / %s", colorLabel(entry.getShirtColor().name),
+             colorLabel(entry.getPantsColor().name), colorLabel(entry.getShoesColor().name));
+    bool hasColors = strcmp(colors, "- / - / -") != 0;
+    
+    const char* description = entry.getItemDescription().c_str();
+    size_t length = entry.getItemDescription().length();
+    while (length > 0 && isspace((unsigned char)*description)) {
+        description++;
+        length--;
+    }
+    while (length > 0 && isspace((unsigned char)description[length - 1])) {
+        length--;
+    }
+    char trimmed[MAX_ITEM_DESCRIPTION_LENGTH + 1];
+    memcpy(trimmed, description, length);
+    trimmed[length] = '\0';
+    
+    const char* labels[TREND_KIND_COUNT] = {colors, trimmed};
+    uint64_t keys[TREND_KIND_COUNT] = {hashKey(colors, strlen(colors)), hashKey(trimmed, length)};
+    bool used[TREND_KIND_COUNT] = {hasColors, length > 0};
+    
+    for (size_t w = 0; w < TREND_WINDOW_COUNT; w++) {
+        TrendWindow window = (TrendWindow)w;
+        int32_t bucket = bucketOf(entry.getTimestamp(), window);
+        size_t slot = slotOf(bucket, window);
+        
+        if (_bucketIds[w][slot] != bucket) {
+            // An entry older than what the slot holds has left the window;
+            // one newer starts the slot over, expiring its old bucket
+            if (!add || (_bucketIds[w][slot] != EMPTY_BUCKET && _bucketIds[w][slot] > bucket)) {
+                continue;
+            }
+            _bucketIds[w][slot] = bucket;
+            for (size_t kind = 0; kind < TREND_KIND_COUNT; kind++) {
+                _buckets[w][kind][slot].clear();
+            }
+        }
+        
+        for (size_t kind = 0; kind < TREND_KIND_COUNT; kind++) {
+            if (!used[kind]) {
+                continue;
+            }
+            if (add) {
+                _buckets[w][kind][slot].add(keys[kind], labels[kind]);
+            } else {
+                _buckets[w][kind][slot].remove(keys[kind]);
+            }
+        }
+    }
+}
+
+void EntryTrends::top(TrendKind kind, TrendWindow window, time_t now, std::vector<TrendItem>& items, size_t limit) const {
+    items.clear();
+    
+    // Counters of the buckets in the window, with each bucket's bound for
+    // keys it does not monitor
+    struct Merged {
+        uint64_t key;
+        uint32_t count;
+        uint32_t error;
+        uint32_t minCounted;
+        const TrendLabel* label;
+    };
+    std::vector<Merged> merged;
+    uint32_t minTotal = 0;
+    
+    int32_t newest = bucketOf(now, window);
+    for (size_t slot = 0; slot < BUCKET_COUNT[window]; slot++) {
+        int32_t bucket = _bucketIds[window][slot];
+        if (bucket == EMPTY_BUCKET || bucket > newest || bucket <= newest - (int32_t)BUCKET_COUNT[window]) {
+            continue;
+        }
+        
+        const SpaceSaving& summary = _buckets[window][kind][slot];
+        uint32_t minCount = summary.getUnmonitoredBound();
+        minTotal += minCount;
+        for (size_t i = 0; i < summary.size(); i++) {
+            const SpaceSavingItem& item = summary.get(i);
+            if (item.count > 0) {
+                merged.push_back(Merged{item.key, item.count, item.error, minCount, &item.label});
+            }
+        }
+    }
+    
+    std::sort(merged.begin(), merged.end(), [](const Merged& a, const Merged& b) {
+        return a.key < b.key;
+    });
+    
+    size_t count = 0;
+    for (size_t i = 0; i < merged.size(); count++) {
+        Merged sum = merged[i];
+        for (i++; i < merged.size() && merged[i].key == sum.key; i++) {
+            sum.count += merged[i].count;
+            sum.error += merged[i].error;
+            sum.minCounted += merged[i].minCounted;
+        }
+        
+        // A bucket that does not monitor the key may still have seen it, up
+        // to the most any key it dropped had
+        sum.count += minTotal - sum.minCounted;
+        sum.error += minTotal - sum.minCounted;
+        merged[count] = sum;
+    }
+    merged.resize(count);
+    
+    std::sort(merged.begin(), merged.end(), [](const Merged& a, const Merged& b) {
+        return a.count != b.count ? a.count > b.count : a.error < b.error;
+    });
+    
+    for (size_t i = 0; i < merged.size() && i < limit; i++) {
+        items.push_back(TrendItem{*merged[i].label, merged[i].count, merged[i].error});
+    }
+}
+
+time_t EntryTrends::getWindowStart(TrendWindow window, time_t now) {
+    int32_t oldest = bucketOf(now, window) - (int32_t)BUCKET_COUNT[window] + 1;
+    return (time_t)((int64_t)oldest * BUCKET_SECONDS[window]);
+}
+
+size_t EntryTrends::getMemoryUsage() const {
+    size_t bytes = 0;
+    for (size_t window = 0; window < TREND_WINDOW_COUNT; window++) {
+        bytes += _bucketIds[window].capacity() * sizeof(int32_t);
+        for (size_t kind = 0; kind < TREND_KIND_COUNT; kind++) {
+            bytes += _buckets[window][kind].capacity() * sizeof(SpaceSaving);
+            for (const auto& bucket : _buckets[window][kind]) {
+                bytes += bucket.getMemoryUsage();
+            }
+        }
+    }
+    return bytes;
+}
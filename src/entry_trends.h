@@ -0,0 +1,102 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Entry Trends
+ * 
+ * This file contains the most frequent clothing color combinations and item
+ * descriptions over recent time windows
+ */
+
+#ifndef DATA_ENTRY_TRENDS_H
+#define DATA_ENTRY_TRENDS_H
+
+#include <Arduino.h>
+#include <vector>
+#include "log_entry.h"
+#include "space_saving.h"
+#include "../config.h"
+
+// What a trend counts
+enum TrendKind {
+    TREND_COLORS,        // Shirt, pants and shoes colors together
+    TREND_DESCRIPTIONS,  // Item description
+    TREND_KIND_COUNT
+};
+
+// Time window of a trend, ending now
+enum TrendWindow {
+    TREND_SHIFT,  // TRENDS_SHIFT_HOURS hourly buckets
+    TREND_WEEK,   // TRENDS_WEEK_DAYS daily buckets
+    TREND_WINDOW_COUNT
+};
+
+// A frequent key over a window: seen at most count times and at least
+// count - error times
+struct TrendItem {
+    TrendLabel label;
+    uint32_t count;
+    uint32_t error;
+};
+
+/**
+ * Streaming top-K of color combinations and item descriptions. Each window
+ * is a ring of time buckets holding one Space-Saving summary per kind, so
+ * memory is fixed however many entries are seen, and a bucket expires as a
+ * whole once the ring moves past it. A query merges the summaries of the
+ * window's buckets, a few hundred counters at most. Keys are compared
+ * without case, and descriptions also without surrounding spaces
+ */
+class EntryTrends {
+public:
+    EntryTrends();
+    
+    /**
+     * Remove every counted entry
+     */
+    void clear();
+    
+    /**
+     * Count an entry in the windows its timestamp falls in
+     * @param entry entry to count
+     */
+    void add(const LogEntry& entry);
+    
+    /**
+     * Take back an entry counted before, as far as its keys are still
+     * monitored
+     * @param entry entry to take back
+     */
+    void remove(const LogEntry& entry);
+    
+    /**
+     * Get the most frequent keys of a window
+     * @param kind what to count
+     * @param window time window
+     * @param now end of the window
+     * @param items set to the keys, most frequent first
+     * @param limit maximum number of keys
+     */
+    void top(TrendKind kind, TrendWindow window, time_t now, std::vector<TrendItem>& items, size_t limit) const;
+    
+    /**
+     * Get the earliest time a window ending now counts
+     * @param window time window
+     * @param now end of the window
+     * @return start of the window's oldest bucket
+     */
+    static time_t getWindowStart(TrendWindow window, time_t now);
+    
+    /**
+     * Get the heap memory used by the summaries
+     * @return bytes used
+     */
+    size_t getMemoryUsage() const;
+
+private:
+    // Bucket number held by each ring slot, and its summaries by kind
+    std::vector<int32_t> _bucketIds[TREND_WINDOW_COUNT];
+    std::vector<SpaceSaving> _buckets[TREND_WINDOW_COUNT][TREND_KIND_COUNT];
+    
+    void update(const LogEntry& entry, bool add);
+};
+
+#endif // DATA_ENTRY_TRENDS_H
@@ -5,18 +5,104 @@
 
 #include "export.h"
 
-bool ExportUtil::exportToFile(const std::vector<LogEntry>& entries, const String& filename, ExportFormat format) {
+static const char* CSV_HEADER = "Timestamp,Date,Time,Gender,Shirt Color,Shirt RGB,Pants Color,Pants RGB,Shoes Color,Shoes RGB,Item Type,Item Description,Notes\n";
+static const char* JSON_HEADER = "{\n  \"entries\": [\n";
+static const char* JSON_FOOTER = "  ]\n}";
+static const char* TEXT_HEADER = "Loss Prevention Log Export\n===========================\n\n";
+
+// Typical bytes per exported entry, reserved up front so the output buffer
+// is not regrown on every append
+static const size_t CSV_ROW_BYTES = 200;
+static const size_t JSON_ROW_BYTES = 560;
+static const size_t TEXT_ROW_BYTES = 300;
+
+static const char* genderName(Gender gender) {
+    switch (gender) {
+        case GENDER_MALE: return "Male";
+        case GENDER_FEMALE: return "Female";
+        case GENDER_OTHER: return "Other";
+        default: return "Unknown";
+    }
+}
+
+static const char* itemTypeName(ItemType itemType) {
+    switch (itemType) {
+        case ITEM_CLOTHING: return "Clothing";
+        case ITEM_ELECTRONICS: return "Electronics";
+        case ITEM_COSMETICS: return "Cosmetics";
+        case ITEM_ACCESSORIES: return "Accessories";
+        case ITEM_FOOD: return "Food";
+        case ITEM_OTHER: return "Other";
+        default: return "Unknown";
+    }
+}
+
+// Appends entry text with each double quote replaced by an escape sequence,
+// without copying the text into a String first
+static void appendEscaped(String& out, const char* text, const char* quoteEscape) {
+    for (const char* p = text; *p; p++) {
+        if (*p == '"') {
+            out += quoteEscape;
+        } else {
+            out += *p;
+        }
+    }
+}
+
+// Appends a timestamp formatted on the stack
+static void appendTimestamp(String& out, const LogEntry& entry, const char* format) {
+    char buffer[32];
+    entry.formatTimestamp(buffer, sizeof(buffer), format);
+    out += buffer;
+}
+
+// Appends an RGB value in the same lowercase hex as String(rgb, HEX)
+static void appendHex(String& out, uint32_t value) {
+    char buffer[9];
+    snprintf(buffer, sizeof(buffer), "%lx", (unsigned long)value);
+    out += buffer;
+}
+
+static void appendColorCSV(String& csv, const Color& color) {
+    csv += '"';
+    csv += color.name.c_str();
+    csv += "\",\"";
+    appendHex(csv, color.rgb);
+    csv += "\",";
+}
+
+static void appendColorJSON(String& json, const char* key, const Color& color) {
+    json += "      \"";
+    json += key;
+    json += "\": {\n        \"color\": \"";
+    json += color.name.c_str();
+    json += "\",\n        \"rgb\": \"";
+    appendHex(json, color.rgb);
+    json += "\"\n      },\n";
+}
+
+static void appendColorText(String& text, const char* label, const Color& color) {
+    text += label;
+    text += color.name.c_str();
+    text += " (";
+    appendHex(text, color.rgb);
+    text += ")\n";
+}
+
+// Shared by the vector and result set overloads
+template <typename Entries>
+static bool exportEntries(const Entries& entries, size_t count, const String& filename, ExportFormat format) {
     String content;
     
     switch (format) {
         case FORMAT_CSV:
-            content = exportToCSV(entries);
+            content = ExportUtil::exportToCSV(entries);
             break;
         case FORMAT_JSON:
-            content = exportToJSON(entries);
+            content = ExportUtil::exportToJSON(entries);
             break;
         case FORMAT_TEXT:
-            content = exportToText(entries);
+            content = ExportUtil::exportToText(entries);
             break;
         default:
             DEBUG_PRINT("Invalid export format");
@@ -29,179 +115,168 @@ bool ExportUtil::exportToFile(const std::vector<LogEntry>& entries, const String
         return false;
     }
     
-    DEBUG_PRINTF("Exported %d entries to file: %s", entries.size(), filename.c_str());
+    DEBUG_PRINTF("Exported %d entries to file: %s", count, filename.c_str());
     return true;
 }
 
+bool ExportUtil::exportToFile(const std::vector<LogEntry>& entries, const String& filename, ExportFormat format) {
+    return exportEntries(entries, entries.size(), filename, format);
+}
+
+bool ExportUtil::exportToFile(const ResultSet& results, const String& filename, ExportFormat format) {
+    if (!results.isValid()) {
+        DEBUG_PRINT("Result set is stale, cannot export entries");
+        return false;
+    }
+    
+    return exportEntries(results, results.size(), filename, format);
+}
+
 String ExportUtil::exportToCSV(const std::vector<LogEntry>& entries) {
-    String csv = "Timestamp,Date,Time,Gender,Shirt Color,Shirt RGB,Pants Color,Pants RGB,Shoes Color,Shoes RGB,Item Type,Item Description,Notes\n";
+    String csv = CSV_HEADER;
+    csv.reserve(csv.length() + entries.size() * CSV_ROW_BYTES);
     
     for (const auto& entry : entries) {
-        // Format timestamp
-        String date = entry.getFormattedTimestamp("%Y-%m-%d");
-        String time = entry.getFormattedTimestamp("%H:%M:%S");
-        
-        // Format gender
-        String gender;
-        switch (entry.getGender()) {
-            case GENDER_MALE: gender = "Male"; break;
-            case GENDER_FEMALE: gender = "Female"; break;
-            case GENDER_OTHER: gender = "Other"; break;
-            default: gender = "Unknown"; break;
-        }
-        
-        // Format item type
-        String itemType;
-        switch (entry.getItemType()) {
-            case ITEM_CLOTHING: itemType = "Clothing"; break;
-            case ITEM_ELECTRONICS: itemType = "Electronics"; break;
-            case ITEM_COSMETICS: itemType = "Cosmetics"; break;
-            case ITEM_ACCESSORIES: itemType = "Accessories"; break;
-            case ITEM_FOOD: itemType = "Food"; break;
-            case ITEM_OTHER: itemType = "Other"; break;
-            default: itemType = "Unknown"; break;
-        }
-        
-        // Escape CSV fields
-        String itemDesc = entry.getItemDescription();
-        itemDesc.replace("\"", "\"\""); // Escape quotes
-        
-        String notes = entry.getNotes();
-        notes.replace("\"", "\"\""); // Escape quotes
-        
-        // Add CSV row
-        csv += String(entry.getTimestamp()) + ",";
-        csv += date + ",";
-        csv += time + ",";
-        csv += gender + ",";
-        csv += "\"" + entry.getShirtColor().name + "\",";
-        csv += "\"" + String(entry.getShirtColor().rgb, HEX) + "\",";
-        csv += "\"" + entry.getPantsColor().name + "\",";
-        csv += "\"" + String(entry.getPantsColor().rgb, HEX) + "\",";
-        csv += "\"" + entry.getShoesColor().name + "\",";
-        csv += "\"" + String(entry.getShoesColor().rgb, HEX) + "\",";
-        csv += itemType + ",";
-        csv += "\"" + itemDesc + "\",";
-        csv += "\"" + notes + "\"\n";
+        appendCSV(csv, entry);
     }
     
     return csv;
 }
 
+String ExportUtil::exportToCSV(const ResultSet& results) {
+    String csv = CSV_HEADER;
+    csv.reserve(csv.length() + results.size() * CSV_ROW_BYTES);
+    
+    results.forEach([&csv](const LogEntry& entry) {
+        appendCSV(csv, entry);
+    });
+    
+    return csv;
+}
+
 String ExportUtil::exportToJSON(const std::vector<LogEntry>& entries) {
-    String json = "{\n  \"entries\": [\n";
+    String json = JSON_HEADER;
+    json.reserve(json.length() + entries.size() * JSON_ROW_BYTES);
     
     for (size_t i = 0; i < entries.size(); i++) {
-        const auto& entry = entries[i];
-        
-        // Format gender
-        String gender;
-        switch (entry.getGender()) {
-            case GENDER_MALE: gender = "Male"; break;
-            case GENDER_FEMALE: gender = "Female"; break;
-            case GENDER_OTHER: gender = "Other"; break;
-            default: gender = "Unknown"; break;
-        }
-        
-        // Format item type
-        String itemType;
-        switch (entry.getItemType()) {
-            case ITEM_CLOTHING: itemType = "Clothing"; break;
-            case ITEM_ELECTRONICS: itemType = "Electronics"; break;
-            case ITEM_COSMETICS: itemType = "Cosmetics"; break;
-            case ITEM_ACCESSORIES: itemType = "Accessories"; break;
-            case ITEM_FOOD: itemType = "Food"; break;
-            case ITEM_OTHER: itemType = "Other"; break;
-            default: itemType = "Unknown"; break;
-        }
-        
-        // Escape JSON strings
-        String itemDesc = entry.getItemDescription();
-        itemDesc.replace("\"", "\\\""); // Escape quotes
-        
-        String notes = entry.getNotes();
-        notes.replace("\"", "\\\""); // Escape quotes
-        
-        // Add JSON object
-        json += "    {\n";
-        json += "      \"timestamp\": " + String(entry.getTimestamp()) + ",\n";
-        json += "      \"date\": \"" + entry.getFormattedTimestamp("%Y-%m-%d") + "\",\n";
-        json += "      \"time\": \"" + entry.getFormattedTimestamp("%H:%M:%S") + "\",\n";
-        json += "      \"gender\": \"" + gender + "\",\n";
-        json += "      \"shirt\": {\n";
-        json += "        \"color\": \"" + entry.getShirtColor().name + "\",\n";
-        json += "        \"rgb\": \"" + String(entry.getShirtColor().rgb, HEX) + "\"\n";
-        json += "      },\n";
-        json += "      \"pants\": {\n";
-        json += "        \"color\": \"" + entry.getPantsColor().name + "\",\n";
-        json += "        \"rgb\": \"" + String(entry.getPantsColor().rgb, HEX) + "\"\n";
-        json += "      },\n";
-        json += "      \"shoes\": {\n";
-        json += "        \"color\": \"" + entry.getShoesColor().name + "\",\n";
-        json += "        \"rgb\": \"" + String(entry.getShoesColor().rgb, HEX) + "\"\n";
-        json += "      },\n";
-        json += "      \"item\": {\n";
-        json += "        \"type\": \"" + itemType + "\",\n";
-        json += "        \"description\": \"" + itemDesc + "\"\n";
-        json += "      },\n";
-        json += "      \"notes\": \"" + notes + "\"\n";
-        json += "    }";
-        
-        if (i < entries.size() - 1) {
-            json += ",";
-        }
-        json += "\n";
+        appendJSON(json, entries[i], i == entries.size() - 1);
     }
     
-    json += "  ]\n}";
+    json += JSON_FOOTER;
+    return json;
+}
+
+String ExportUtil::exportToJSON(const ResultSet& results) {
+    String json = JSON_HEADER;
+    json.reserve(json.length() + results.size() * JSON_ROW_BYTES);
+    
+    for (size_t i = 0; i < results.size(); i++) {
+        appendJSON(json, results.at(i), i == results.size() - 1);
+    }
+    
+    json += JSON_FOOTER;
     return json;
 }
 
 String ExportUtil::exportToText(const std::vector<LogEntry>& entries) {
-    String text = "Loss Prevention Log Export\n";
-    text += "===========================\n\n";
+    String text = TEXT_HEADER;
+    text.reserve(text.length() + entries.size() * TEXT_ROW_BYTES);
     
     for (const auto& entry : entries) {
-        text += "Date: " + entry.getFormattedTimestamp("%Y-%m-%d") + "\n";
-        text += "Time: " + entry.getFormattedTimestamp("%H:%M:%S") + "\n";
-        
-        // Format gender
-        String gender;
-        switch (entry.getGender()) {
-            case GENDER_MALE: gender = "Male"; break;
-            case GENDER_FEMALE: gender = "Female"; break;
-            case GENDER_OTHER: gender = "Other"; break;
-            default: gender = "Unknown"; break;
-        }
-        text += "Gender: " + gender + "\n";
-        
-        // Format clothing
-        text += "Clothing:\n";
-        text += "  Shirt: " + entry.getShirtColor().name + " (" + String(entry.getShirtColor().rgb, HEX) + ")\n";
-        text += "  Pants: " + entry.getPantsColor().name + " (" + String(entry.getPantsColor().rgb, HEX) + ")\n";
-        text += "  Shoes: " + entry.getShoesColor().name + " (" + String(entry.getShoesColor().rgb, HEX) + ")\n";
-        
-        // Format item
-        String itemType;
-        switch (entry.getItemType()) {
-            case ITEM_CLOTHING: itemType = "Clothing"; break;
-            case ITEM_ELECTRONICS: itemType = "Electronics"; break;
-            case ITEM_COSMETICS: itemType = "Cosmetics"; break;
-            case ITEM_ACCESSORIES: itemType = "Accessories"; break;
-            case ITEM_FOOD: itemType = "Food"; break;
-            case ITEM_OTHER: itemType = "Other"; break;
-            default: itemType = "Unknown"; break;
-        }
-        text += "Item Type: " + itemType + "\n";
-        text += "Item Description: " + entry.getItemDescription() + "\n";
-        
-        // Add notes if present
-        if (entry.getNotes().length() > 0) {
-            text += "Notes: " + entry.getNotes() + "\n";
-        }
-        
-        text += "----------------------------\n\n";
+        appendText(text, entry);
     }
     
     return text;
 }
+
+String ExportUtil::exportToText(const ResultSet& results) {
+    String text = TEXT_HEADER;
+    text.reserve(text.length() + results.size() * TEXT_ROW_BYTES);
+    
+    results.forEach([&text](const LogEntry& entry) {
+        appendText(text, entry);
+    });
+    
+    return text;
+}
+
+void ExportUtil::appendCSV(String& csv, const LogEntry& entry) {
+    // Add CSV row
+    csv += String(entry.getTimestamp());
+    csv += ',';
+    appendTimestamp(csv, entry, "%Y-%m-%d");
+    csv += ',';
+    appendTimestamp(csv, entry, "%H:%M:%S");
+    csv += ',';
+    csv += genderName(entry.getGender());
+    csv += ',';
+    appendColorCSV(csv, entry.getShirtColor());
+    appendColorCSV(csv, entry.getPantsColor());
+    appendColorCSV(csv, entry.getShoesColor());
+    csv += itemTypeName(entry.getItemType());
+    csv += ",\"";
+    appendEscaped(csv, entry.getItemDescription().c_str(), "\"\"");
+    csv += "\",\"";
+    appendEscaped(csv, entry.getNotes().c_str(), "\"\"");
+    csv += "\"\n";
+}
+
+void ExportUtil::appendJSON(String& json, const LogEntry& entry, bool last) {
+    // Add JSON object
+    json += "    {\n      \"timestamp\": ";
+    json += String(entry.getTimestamp());
+    json += ",\n      \"date\": \"";
+    appendTimestamp(json, entry, "%Y-%m-%d");
+    json += "\",\n      \"time\": \"";
+    appendTimestamp(json, entry, "%H:%M:%S");
+    json += "\",\n      \"gender\": \"";
+    json += genderName(entry.getGender());
+    json += "\",\n";
+    appendColorJSON(json, "shirt", entry.getShirtColor());
+    appendColorJSON(json, "pants", entry.getPantsColor());
+    appendColorJSON(json, "shoes", entry.getShoesColor());
+    json += "      \"item\": {\n        \"type\": \"";
+    json += itemTypeName(entry.getItemType());
+    json += "\",\n        \"description\": \"";
+    appendEscaped(json, entry.getItemDescription().c_str(), "\\\"");
+    json += "\"\n      },\n      \"notes\": \"";
+    appendEscaped(json, entry.getNotes().c_str(), "\\\"");
+    json += "\"\n    }";
+    
+    if (!last) {
+        json += ",";
+    }
+    json += "\n";
+}
+
+void ExportUtil::appendText(String& text, const LogEntry& entry) {
+    text += "Date: ";
+    appendTimestamp(text, entry, "%Y-%m-%d");
+    text += "\nTime: ";
+    appendTimestamp(text, entry, "%H:%M:%S");
+    text += "\nGender: ";
+    text += genderName(entry.getGender());
+    text += "\n";
+    
+    // Format clothing
+    text += "Clothing:\n";
+    appendColorText(text, "  Shirt: ", entry.getShirtColor());
+    appendColorText(text, "  Pants: ", entry.getPantsColor());
+    appendColorText(text, "  Shoes: ", entry.getShoesColor());
+    
+    // Format item
+    text += "Item Type: ";
+    text += itemTypeName(entry.getItemType());
+    text += "\nItem Description: ";
+    text += entry.getItemDescription().c_str();
+    text += "\n";
+    
+    // Add notes if present
+    if (!entry.getNotes().isEmpty()) {
+        text += "Notes: ";
+        text += entry.getNotes().c_str();
+        text += "\n";
+    }
+    
+    text += "----------------------------\n\n";
+}
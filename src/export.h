@@ -11,6 +11,7 @@
 #include <Arduino.h>
 #include <vector>
 #include "log_entry.h"
+#include "result_set.h"
 #include "../hal/storage.h"
 #include "../config.h"
 
@@ -51,6 +52,43 @@ public:
      * @return text formatted string
      */
     static String exportToText(const std::vector<LogEntry>& entries);
+    
+    /**
+     * Export a result set to file in specified format, reading entries in
+     * place instead of copying them
+     * @param results result set to export
+     * @param filename file to export to
+     * @param format export format
+     * @return true if successful, false otherwise
+     */
+    static bool exportToFile(const ResultSet& results, const String& filename, ExportFormat format);
+    
+    /**
+     * Export a result set to CSV format
+     * @param results result set to export
+     * @return CSV formatted string
+     */
+    static String exportToCSV(const ResultSet& results);
+    
+    /**
+     * Export a result set to JSON format
+     * @param results result set to export
+     * @return JSON formatted string
+     */
+    static String exportToJSON(const ResultSet& results);
+    
+    /**
+     * Export a result set to plain text format
+     * @param results result set to export
+     * @return text formatted string
+     */
+    static String exportToText(const ResultSet& results);
+
+private:
+    // Formatting of a single entry
+    static void appendCSV(String& csv, const LogEntry& entry);
+    static void appendJSON(String& json, const LogEntry& entry, bool last);
+    static void appendText(String& text, const LogEntry& entry);
 };
 
 #endif // DATA_EXPORT_H
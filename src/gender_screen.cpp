@@ -100,7 +100,7 @@ void GenderScreen::setCurrentEntry(const LogEntry& entry) {
     _currentEntry = entry;
 }
 
-LogEntry GenderScreen::getCurrentEntry() {
+const LogEntry& GenderScreen::getCurrentEntry() {
     return _currentEntry;
 }
 
@@ -0,0 +1,127 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - ID Map Implementation
+ */
+
+#include "id_map.h"
+#include <algorithm>
+
+static const uint64_t EMPTY_ID = 0;
+static const size_t MIN_SLOTS = 16;
+
+// IDs carry a timestamp in the upper half and a small counter in the lower,
+// so they are mixed before masking or nearby IDs would share a run of slots
+static uint64_t mixId(uint64_t id) {
+    id ^= id >> 33;
+    id *= 0xFF51AFD7ED558CCDULL;
+    id ^= id >> 33;
+    id *= 0xC4CEB9FE1A85EC53ULL;
+    id ^= id >> 33;
+    return id;
+}
+
+IdMap::IdMap() : _count(0), _mask(0) {
+}
+
+void IdMap::clear() {
+    std::fill(_ids.begin(), _ids.end(), EMPTY_ID);
+    _count = 0;
+}
+
+void IdMap::reserve(size_t count) {
+    size_t slots = MIN_SLOTS;
+    while (slots * 3 / 4 < count) {
+        slots *= 2;
+    }
+    if (slots > _ids.size()) {
+        resize(slots);
+    }
+}
+
+void IdMap::insert(uint64_t id, uint32_t position) {
+    if (id == EMPTY_ID) {
+        return;
+    }
+    
+    if ((_count + 1) * 4 > _ids.size() * 3) {
+        resize(_ids.empty() ? MIN_SLOTS : _ids.size() * 2);
+    }
+    
+    size_t slot = slotOf(id);
+    while (_ids[slot] != EMPTY_ID && _ids[slot] != id) {
+        slot = (slot + 1) & _mask;
+    }
+    
+    if (_ids[slot] == EMPTY_ID) {
+        _ids[slot] = id;
+        _count++;
+    }
+    _positions[slot] = position;
+}
+
+bool IdMap::find(uint64_t id, uint32_t& position) const {
+    if (_count == 0 || id == EMPTY_ID) {
+        return false;
+    }
+    
+    for (size_t slot = slotOf(id); _ids[slot] != EMPTY_ID; slot = (slot + 1) & _mask) {
+        if (_ids[slot] == id) {
+            position = _positions[slot];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IdMap::erase(uint64_t id) {
+    if (_count == 0 || id == EMPTY_ID) {
+        return false;
+    }
+    
+    size_t slot = slotOf(id);
+    while (_ids[slot] != id) {
+        if (_ids[slot] == EMPTY_ID) {
+            return false;
+        }
+        slot = (slot + 1) & _mask;
+    }
+    
+    // Move later IDs of the run back into the hole instead of leaving a
+    // tombstone, so lookups never probe past deleted slots
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & _mask; _ids[next] != EMPTY_ID; next = (next + 1) & _mask) {
+        size_t home = slotOf(_ids[next]);
+        if (((next - home) & _mask) >= ((next - hole) & _mask)) {
+            _ids[hole] = _ids[next];
+            _positions[hole] = _positions[next];
+            hole = next;
+        }
+    }
+    
+    _ids[hole] = EMPTY_ID;
+    _count--;
+    return true;
+}
+
+size_t IdMap::getMemoryUsage() const {
+    return _ids.capacity() * sizeof(uint64_t) + _positions.capacity() * sizeof(uint32_t);
+}
+
+size_t IdMap::slotOf(uint64_t id) const {
+    return (size_t)mixId(id) & _mask;
+}
+
+void IdMap::resize(size_t slots) {
+    std::vector<uint64_t> ids(slots, EMPTY_ID);
+    std::vector<uint32_t> positions(slots);
+    ids.swap(_ids);
+    positions.swap(_positions);
+    _mask = slots - 1;
+    _count = 0;
+    
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (ids[i] != EMPTY_ID) {
+            insert(ids[i], positions[i]);
+        }
+    }
+}
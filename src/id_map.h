@@ -0,0 +1,83 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - ID Map
+ * 
+ * This file contains the hash map from entry IDs to entry positions
+ */
+
+#ifndef DATA_ID_MAP_H
+#define DATA_ID_MAP_H
+
+#include <Arduino.h>
+#include <vector>
+#include "../config.h"
+
+/**
+ * Open-addressing hash map from 64-bit IDs to 32-bit positions, with linear
+ * probing over a power-of-two table kept at most three quarters full. IDs
+ * and positions sit in two flat arrays, so a lookup touches one or two cache
+ * lines and nothing is allocated per entry. ID 0 marks an empty slot and
+ * cannot be stored
+ */
+class IdMap {
+public:
+    IdMap();
+    
+    /**
+     * Get the number of stored IDs
+     * @return number of IDs
+     */
+    size_t size() const {
+        return _count;
+    }
+    
+    /**
+     * Remove every ID, keeping the table
+     */
+    void clear();
+    
+    /**
+     * Size the table for a number of IDs
+     * @param count number of IDs
+     */
+    void reserve(size_t count);
+    
+    /**
+     * Store the position of an ID, replacing any position it already has
+     * @param id entry ID, not 0
+     * @param position entry position
+     */
+    void insert(uint64_t id, uint32_t position);
+    
+    /**
+     * Look up the position of an ID
+     * @param id entry ID
+     * @param position set to the position if found
+     * @return true if found, false otherwise
+     */
+    bool find(uint64_t id, uint32_t& position) const;
+    
+    /**
+     * Remove an ID
+     * @param id entry ID
+     * @return true if it was stored, false otherwise
+     */
+    bool erase(uint64_t id);
+    
+    /**
+     * Get the heap memory used by the map
+     * @return bytes used
+     */
+    size_t getMemoryUsage() const;
+
+private:
+    std::vector<uint64_t> _ids;
+    std::vector<uint32_t> _positions;
+    size_t _count;
+    size_t _mask;
+    
+    size_t slotOf(uint64_t id) const;
+    void resize(size_t slots);
+};
+
+#endif // DATA_ID_MAP_H
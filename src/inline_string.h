@@ -0,0 +1,130 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Inline String
+ * 
+ * This file contains the fixed-capacity string used for log entry text
+ */
+
+#ifndef DATA_INLINE_STRING_H
+#define DATA_INLINE_STRING_H
+
+#include <Arduino.h>
+#include <string.h>
+
+/**
+ * String stored inside the object, up to a fixed number of bytes. Copying
+ * one is a plain memory copy with no heap allocation. Longer text is cut at
+ * the capacity, backing off to a UTF-8 character boundary
+ */
+template <size_t Capacity>
+class InlineString {
+public:
+    InlineString() : _length(0) {
+        _data[0] = '\0';
+    }
+    
+    // Copies only the bytes in use, not the whole capacity
+    InlineString(const InlineString& other) : _length(other._length) {
+        memcpy(_data, other._data, _length + 1);
+    }
+    
+    InlineString(const char* text) {
+        assign(text, text ? strlen(text) : 0);
+    }
+    
+    InlineString(const String& text) {
+        assign(text.c_str(), text.length());
+    }
+    
+    InlineString& operator=(const InlineString& other) {
+        _length = other._length;
+        memmove(_data, other._data, _length + 1);
+        return *this;
+    }
+    
+    InlineString& operator=(const char* text) {
+        assign(text, text ? strlen(text) : 0);
+        return *this;
+    }
+    
+    InlineString& operator=(const String& text) {
+        assign(text.c_str(), text.length());
+        return *this;
+    }
+    
+    /**
+     * Replace the content, truncating it to the capacity
+     * @param text bytes to copy, not necessarily null-terminated
+     * @param length number of bytes
+     */
+    void assign(const char* text, size_t length) {
+        if (length > Capacity) {
+            length = Capacity;
+            // Never leave half of a multi-byte character at the end
+            while (length > 0 && ((uint8_t)text[length] & 0xC0) == 0x80) {
+                length--;
+            }
+        }
+        
+        if (length > 0) {
+            memcpy(_data, text, length);
+        }
+        _data[length] = '\0';
+        _length = length;
+    }
+    
+    const char* c_str() const {
+        return _data;
+    }
+    
+    size_t length() const {
+        return _length;
+    }
+    
+    bool isEmpty() const {
+        return _length == 0;
+    }
+    
+    static size_t capacity() {
+        return Capacity;
+    }
+    
+    bool operator==(const char* text) const {
+        return strcmp(_data, text) == 0;
+    }
+    
+    bool operator==(const String& text) const {
+        return _length == text.length() && memcmp(_data, text.c_str(), _length) == 0;
+    }
+    
+    bool operator==(const InlineString& other) const {
+        return _length == other._length && memcmp(_data, other._data, _length) == 0;
+    }
+    
+    bool operator!=(const char* text) const {
+        return !(*this == text);
+    }
+    
+    // Copies to the heap, for code that needs an Arduino String
+    operator String() const {
+        return String(_data);
+    }
+    
+    friend String operator+(const String& lhs, const InlineString& rhs) {
+        String result(lhs);
+        result += rhs._data;
+        return result;
+    }
+    
+    friend String operator+(const char* lhs, const InlineString& rhs) {
+        String result(lhs);
+        result += rhs._data;
+        return result;
+    }
+
+private:
+    char _data[Capacity + 1];
+    uint16_t _length;
+};
+
+#endif // DATA_INLINE_STRING_H
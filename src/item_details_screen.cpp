@@ -52,6 +52,7 @@ lv_obj_t* ItemDetailsScreen::create() {
     lv_obj_set_size(descTextArea, lv_pct(100), 40);
     lv_obj_align_to(descTextArea, descLabel, LV_ALIGN_OUT_BOTTOM_LEFT, 0, 5);
     lv_textarea_set_placeholder_text(descTextArea, "Enter item description");
+    lv_textarea_set_max_length(descTextArea, MAX_ITEM_DESCRIPTION_LENGTH);
     lv_obj_add_event_cb(descTextArea, _descriptionInputHandler, LV_EVENT_VALUE_CHANGED, NULL);
     lv_obj_add_event_cb(descTextArea, _keyboardEventHandler, LV_EVENT_FOCUSED, NULL);
     lv_obj_set_user_data(descTextArea, (void*)"description");
@@ -68,6 +69,7 @@ lv_obj_t* ItemDetailsScreen::create() {
     lv_obj_set_size(notesTextArea, lv_pct(100), 80);
     lv_obj_align_to(notesTextArea, notesLabel, LV_ALIGN_OUT_BOTTOM_LEFT, 0, 5);
     lv_textarea_set_placeholder_text(notesTextArea, "Enter additional notes");
+    lv_textarea_set_max_length(notesTextArea, MAX_NOTES_LENGTH);
     lv_obj_add_event_cb(notesTextArea, _notesInputHandler, LV_EVENT_VALUE_CHANGED, NULL);
     lv_obj_add_event_cb(notesTextArea, _keyboardEventHandler, LV_EVENT_FOCUSED, NULL);
     lv_obj_set_user_data(notesTextArea, (void*)"notes");
@@ -161,7 +163,7 @@ void ItemDetailsScreen::setCurrentEntry(const LogEntry& entry) {
     _currentEntry = entry;
 }
 
-LogEntry ItemDetailsScreen::getCurrentEntry() {
+const LogEntry& ItemDetailsScreen::getCurrentEntry() {
     return _currentEntry;
 }
 
@@ -170,7 +172,7 @@ void ItemDetailsScreen::_descriptionInputHandler(lv_event_t* e) {
     const char* text = lv_textarea_get_text(textArea);
     
     // Update current entry
-    _currentEntry.setItemDescription(String(text));
+    _currentEntry.setItemDescription(text);
     
     DEBUG_PRINTF("Item description updated: %s", text);
 }
@@ -180,7 +182,7 @@ void ItemDetailsScreen::_notesInputHandler(lv_event_t* e) {
     const char* text = lv_textarea_get_text(textArea);
     
     // Update current entry
-    _currentEntry.setNotes(String(text));
+    _currentEntry.setNotes(text);
     
     DEBUG_PRINTF("Notes updated: %s", text);
 }
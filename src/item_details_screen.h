@@ -40,7 +40,7 @@ public:
      * Get current log entry
      * @return current log entry
      */
-    static LogEntry getCurrentEntry();
+    static const LogEntry& getCurrentEntry();
 
 private:
     static LogEntry _currentEntry;
@@ -100,7 +100,7 @@ void ItemScreen::setCurrentEntry(const LogEntry& entry) {
     _currentEntry = entry;
 }
 
-LogEntry ItemScreen::getCurrentEntry() {
+const LogEntry& ItemScreen::getCurrentEntry() {
     return _currentEntry;
 }
 
@@ -12,9 +12,10 @@
 #include "../../data/log_entry.h"
 #include "../../data/sync.h"
 #include "../../app/app_controller.h"
+#include <algorithm>
 
 // Static member initialization
-int LogDetailScreen::_logIndex = -1;
+uint64_t LogDetailScreen::_logId = 0;
 
 lv_obj_t* LogDetailScreen::create() {
     DEBUG_PRINTLN("Creating log detail screen...");
@@ -116,8 +117,8 @@ void LogDetailScreen::update(lv_obj_t* screen) {
     // Any other dynamic updates can be added here
 }
 
-void LogDetailScreen::setLogIndex(int index) {
-    _logIndex = index;
+void LogDetailScreen::setLogId(uint64_t id) {
+    _logId = id;
 }
 
 void LogDetailScreen::_backButtonClickHandler(lv_event_t* e) {
@@ -151,7 +152,7 @@ void LogDetailScreen::_syncButtonClickHandler(lv_event_t* e) {
     // For now, we'll simulate it with a delay
     
     // In a real implementation, this would be:
-    // SyncManager::syncLog(_logIndex, [](bool success) {
+    // SyncManager::syncLog(_logId, [](bool success) {
     //     UIManager::hideLoading();
     //     if (success) {
     //         UIManager::showAlert("Sync Complete", "Log has been synchronized.", "OK");
@@ -171,21 +172,45 @@ void LogDetailScreen::_syncButtonClickHandler(lv_event_t* e) {
 }
 
 void LogDetailScreen::_loadLogDetails(lv_obj_t* container) {
-    DEBUG_PRINTF("Loading log details for index %d\n", _logIndex);
-    
-    // In a real implementation, this would load log details from the database
-    // For now, we'll create a sample log
-    
-    // Sample log data
-    const char* title = "Log #1";
-    const char* gender = "Male";
-    const char* shirtColor = "Red";
-    const char* pantsColor = "Blue";
-    const char* item = "Shirt";
-    const char* timestamp = "2025-03-17 12:30";
-    const char* location = "Store #123";
-    const char* notes = "Customer was observed concealing merchandise in a shopping bag.";
-    bool synced = false;
+    DEBUG_PRINTF("Loading log details for ID %llu\n", (unsigned long long)_logId);
+    
+    LogEntry entry;
+    if (!Database::getEntryById(_logId, entry)) {
+        lv_obj_t* missingLabel = lv_label_create(container);
+        lv_obj_set_style_text_font(missingLabel, &lv_font_montserrat_16, 0);
+        lv_obj_set_style_text_color(missingLabel, lv_color_hex(0x999999), 0);
+        lv_label_set_text(missingLabel, "Log not found");
+        lv_obj_center(missingLabel);
+        return;
+    }
+    
+    const char* genders[] = {"Unknown", "Male", "Female", "Other"};
+    const char* items[] = {"Unknown", "Clothing", "Electronics", "Cosmetics", "Accessories", "Food", "Other"};
+    
+    // Archived entries have no place in memory to number them by
+    char title[32];
+    size_t index;
+    if (Database::findEntry(_logId, index)) {
+        snprintf(title, sizeof(title), "Log #%d", index + 1);
+    } else {
+        snprintf(title, sizeof(title), "Archived log");
+    }
+    
+    const char* gender = genders[entry.getGender() <= GENDER_OTHER ? entry.getGender() : GENDER_UNKNOWN];
+    String shirtColor = entry.getShirtColor().name;
+    String pantsColor = entry.getPantsColor().name;
+    String shoesColor = entry.getShoesColor().name;
+    String item = String(items[entry.getItemType() <= ITEM_OTHER ? entry.getItemType() : ITEM_UNKNOWN]);
+    if (entry.getItemDescription().length() > 0) {
+        item += " (" + entry.getItemDescription() + ")";
+    }
+    String timestamp = entry.getFormattedTimestamp("%Y-%m-%d %H:%M");
+    String notes = entry.getNotes();
+    
+    // Entries still waiting to sync are matched by ID, as the logs screen does
+    std::vector<uint64_t> pendingIds;
+    SyncManager::getPendingSyncIds(pendingIds);
+    bool synced = !std::binary_search(pendingIds.begin(), pendingIds.end(), entry.getId());
     
     // Create title
     lv_obj_t* titleLabel = lv_label_create(container);
@@ -198,7 +223,7 @@ void LogDetailScreen::_loadLogDetails(lv_obj_t* container) {
     lv_obj_t* timeLabel = lv_label_create(container);
     lv_obj_set_style_text_font(timeLabel, &lv_font_montserrat_14, 0);
     lv_obj_set_style_text_color(timeLabel, lv_color_hex(0xCCCCCC), 0);
-    lv_label_set_text(timeLabel, timestamp);
+    lv_label_set_text(timeLabel, timestamp.c_str());
     lv_obj_align(timeLabel, LV_ALIGN_TOP_MID, 0, 30);
     
     // Create sync status
@@ -226,8 +251,8 @@ void LogDetailScreen::_loadLogDetails(lv_obj_t* container) {
     lv_obj_set_flex_align(grid, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
     
     // Create detail rows
-    const char* labels[] = {"Gender:", "Shirt Color:", "Pants Color:", "Item:", "Location:"};
-    const char* values[] = {gender, shirtColor, pantsColor, item, location};
+    const char* labels[] = {"Gender:", "Shirt Color:", "Pants Color:", "Shoes Color:", "Item:"};
+    const char* values[] = {gender, shirtColor.c_str(), pantsColor.c_str(), shoesColor.c_str(), item.c_str()};
     
     for (int i = 0; i < 5; i++) {
         // Create row container
@@ -265,7 +290,7 @@ void LogDetailScreen::_loadLogDetails(lv_obj_t* container) {
     lv_obj_set_style_text_color(notesValue, lv_color_hex(0xFFFFFF), 0);
     lv_label_set_long_mode(notesValue, LV_LABEL_LONG_WRAP);
     lv_obj_set_width(notesValue, lv_pct(100));
-    lv_label_set_text(notesValue, notes);
+    lv_label_set_text(notesValue, notes.c_str());
     lv_obj_align(notesValue, LV_ALIGN_TOP_LEFT, 0, 330);
 }
 
@@ -279,19 +304,21 @@ void LogDetailScreen::_confirmDelete() {
             // Delete confirmed
             DEBUG_PRINTLN("Delete confirmed");
             
-            // In a real implementation, this would delete the log from the database
-            // For now, just show a message and go back to logs screen
-            
             // Show loading
             UIManager::hideLoading();
             UIManager::showLoading("Deleting log...");
             
-            // Simulate delete process
-            delay(1000);
+            bool deleted = Database::deleteEntryById(_logId);
+            _logId = 0;
             
             // Hide loading
             UIManager::hideLoading();
             
+            if (!deleted) {
+                UIManager::showAlert("Delete Failed", "The log could not be deleted. Please try again.", "OK");
+                return;
+            }
+            
             // Show success message
             UIManager::showAlert("Log Deleted", "The log has been deleted successfully.", "OK", 
                 [](lv_event_t* e) {
@@ -28,13 +28,13 @@ public:
     static void update(lv_obj_t* screen);
     
     /**
-     * Set log index to display
-     * @param index log index
+     * Set log to display
+     * @param id log entry ID, which unlike its index survives other deletes
      */
-    static void setLogIndex(int index);
+    static void setLogId(uint64_t id);
 
 private:
-    static int _logIndex;
+    static uint64_t _logId;
     
     // Event handlers
     static void _backButtonClickHandler(lv_event_t* e);
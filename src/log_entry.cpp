@@ -6,18 +6,113 @@
 #include "log_entry.h"
 #include "../hal/rtc.h"
 
+// Longest text the binary format can hold per field
+// (keeps a whole record within a uint16 length)
+static const size_t MAX_BINARY_NAME_LENGTH = 0xFF;
+static const size_t MAX_BINARY_TEXT_LENGTH = 0x3FFF;
+
+static size_t clampLength(size_t length, size_t maxLength) {
+    return length < maxLength ? length : maxLength;
+}
+
+static uint8_t* writeUint(uint8_t* p, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        *p++ = (uint8_t)(value >> (8 * i));
+    }
+    return p;
+}
+
+static uint64_t readUint(const uint8_t* p, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+template <size_t Capacity>
+static uint8_t* writeText(uint8_t* p, const InlineString<Capacity>& text, size_t lengthBytes, size_t maxLength) {
+    size_t length = clampLength(text.length(), maxLength);
+    p = writeUint(p, length, lengthBytes);
+    memcpy(p, text.c_str(), length);
+    return p + length;
+}
+
+// Parse helpers for the text format, working on (begin, end) views
+static long long parseDecimal(const char* p, const char* end) {
+    bool negative = false;
+    long long value = 0;
+    
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    
+    return negative ? -value : value;
+}
+
+static uint32_t parseHex(const char* p, const char* end) {
+    uint32_t value = 0;
+    
+    for (; p < end; p++) {
+        char c = *p;
+        if (c >= '0' && c <= '9') {
+            value = (value << 4) | (c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            value = (value << 4) | (c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            value = (value << 4) | (c - 'A' + 10);
+        } else {
+            break;
+        }
+    }
+    
+    return value;
+}
+
+template <size_t Capacity>
+static bool readText(const uint8_t*& p, const uint8_t* end, size_t lengthBytes, InlineString<Capacity>& text) {
+    if ((size_t)(end - p) < lengthBytes) {
+        return false;
+    }
+    size_t length = (size_t)readUint(p, lengthBytes);
+    p += lengthBytes;
+    
+    if ((size_t)(end - p) < length) {
+        return false;
+    }
+    text.assign((const char*)p, length);
+    p += length;
+    return true;
+}
+
 LogEntry::LogEntry() {
+    _id = 0;
     _timestamp = RtcHAL::getTime();
     _gender = GENDER_UNKNOWN;
     _itemType = ITEM_UNKNOWN;
 }
 
 LogEntry::LogEntry(time_t timestamp) {
+    _id = 0;
     _timestamp = timestamp;
     _gender = GENDER_UNKNOWN;
     _itemType = ITEM_UNKNOWN;
 }
 
+uint64_t LogEntry::getId() const {
+    return _id;
+}
+
+void LogEntry::setId(uint64_t id) {
+    _id = id;
+}
+
 time_t LogEntry::getTimestamp() const {
     return _timestamp;
 }
@@ -34,7 +129,7 @@ void LogEntry::setGender(Gender gender) {
     _gender = gender;
 }
 
-Color LogEntry::getShirtColor() const {
+const Color& LogEntry::getShirtColor() const {
     return _shirtColor;
 }
 
@@ -42,7 +137,7 @@ void LogEntry::setShirtColor(const Color& color) {
     _shirtColor = color;
 }
 
-Color LogEntry::getPantsColor() const {
+const Color& LogEntry::getPantsColor() const {
     return _pantsColor;
 }
 
@@ -50,7 +145,7 @@ void LogEntry::setPantsColor(const Color& color) {
     _pantsColor = color;
 }
 
-Color LogEntry::getShoesColor() const {
+const Color& LogEntry::getShoesColor() const {
     return _shoesColor;
 }
 
@@ -66,19 +161,19 @@ void LogEntry::setItemType(ItemType type) {
     _itemType = type;
 }
 
-String LogEntry::getItemDescription() const {
+const DescriptionText& LogEntry::getItemDescription() const {
     return _itemDescription;
 }
 
-void LogEntry::setItemDescription(const String& description) {
+void LogEntry::setItemDescription(const DescriptionText& description) {
     _itemDescription = description;
 }
 
-String LogEntry::getNotes() const {
+const NotesText& LogEntry::getNotes() const {
     return _notes;
 }
 
-void LogEntry::setNotes(const String& notes) {
+void LogEntry::setNotes(const NotesText& notes) {
     _notes = notes;
 }
 
@@ -86,58 +181,132 @@ String LogEntry::serialize() const {
     // Format: timestamp|gender|shirtColor.name|shirtColor.rgb|pantsColor.name|pantsColor.rgb|shoesColor.name|shoesColor.rgb|itemType|itemDescription|notes
     String serialized = String(_timestamp) + "|";
     serialized += String((int)_gender) + "|";
-    serialized += _shirtColor.name + "|";
-    serialized += String(_shirtColor.rgb, HEX) + "|";
-    serialized += _pantsColor.name + "|";
-    serialized += String(_pantsColor.rgb, HEX) + "|";
-    serialized += _shoesColor.name + "|";
-    serialized += String(_shoesColor.rgb, HEX) + "|";
+    serialized += _shirtColor.name.c_str();
+    serialized += "|" + String(_shirtColor.rgb, HEX) + "|";
+    serialized += _pantsColor.name.c_str();
+    serialized += "|" + String(_pantsColor.rgb, HEX) + "|";
+    serialized += _shoesColor.name.c_str();
+    serialized += "|" + String(_shoesColor.rgb, HEX) + "|";
     serialized += String((int)_itemType) + "|";
-    serialized += _itemDescription + "|";
-    serialized += _notes;
+    serialized += _itemDescription.c_str();
+    serialized += "|";
+    serialized += _notes.c_str();
     
     return serialized;
 }
 
 bool LogEntry::deserialize(const String& data) {
-    // Split the serialized string by delimiter
-    int delimiterPositions[10];
-    int delimiterCount = 0;
+    return deserialize(data.c_str(), data.length());
+}
+
+bool LogEntry::deserialize(const char* data, size_t len) {
+    // Locate the field boundaries without copying the line
+    const char* fields[11];
+    const char* ends[11];
+    size_t fieldCount = 0;
+    const char* end = data + len;
+    const char* p = data;
     
-    for (size_t i = 0; i < data.length() && delimiterCount < 10; i++) {
-        if (data[i] == '|') {
-            delimiterPositions[delimiterCount++] = i;
+    fields[fieldCount] = p;
+    while (p < end && fieldCount < 10) {
+        if (*p == '|') {
+            ends[fieldCount++] = p;
+            fields[fieldCount] = p + 1;
         }
+        p++;
     }
     
-    if (delimiterCount != 10) {
+    if (fieldCount != 10) {
         DEBUG_PRINT("Invalid log entry format");
         return false;
     }
+    ends[10] = end;
+    
+    // Convert values in place; only the text fields are copied, truncated to
+    // their capacities. The text format has no ID
+    _id = 0;
+    _timestamp = (time_t)parseDecimal(fields[0], ends[0]);
+    _gender = (Gender)parseDecimal(fields[1], ends[1]);
+    _shirtColor.name.assign(fields[2], ends[2] - fields[2]);
+    _shirtColor.rgb = parseHex(fields[3], ends[3]);
+    _pantsColor.name.assign(fields[4], ends[4] - fields[4]);
+    _pantsColor.rgb = parseHex(fields[5], ends[5]);
+    _shoesColor.name.assign(fields[6], ends[6] - fields[6]);
+    _shoesColor.rgb = parseHex(fields[7], ends[7]);
+    _itemType = (ItemType)parseDecimal(fields[8], ends[8]);
+    _itemDescription.assign(fields[9], ends[9] - fields[9]);
+    _notes.assign(fields[10], ends[10] - fields[10]);
+    
+    return true;
+}
+
+size_t LogEntry::getBinarySize() const {
+    size_t size = 8 + 1 + 1 + 3 * 3;
+    size += 1 + clampLength(_shirtColor.name.length(), MAX_BINARY_NAME_LENGTH);
+    size += 1 + clampLength(_pantsColor.name.length(), MAX_BINARY_NAME_LENGTH);
+    size += 1 + clampLength(_shoesColor.name.length(), MAX_BINARY_NAME_LENGTH);
+    size += 2 + clampLength(_itemDescription.length(), MAX_BINARY_TEXT_LENGTH);
+    size += 2 + clampLength(_notes.length(), MAX_BINARY_TEXT_LENGTH);
+    size += 8;
+    return size;
+}
+
+size_t LogEntry::serializeBinary(uint8_t* buffer, size_t maxLen) const {
+    size_t size = getBinarySize();
+    if (size > maxLen) {
+        return 0;
+    }
+    
+    uint8_t* p = buffer;
+    
+    // Fixed-width fields
+    p = writeUint(p, (uint64_t)(int64_t)_timestamp, 8);
+    p = writeUint(p, (uint8_t)_gender, 1);
+    p = writeUint(p, (uint8_t)_itemType, 1);
+    p = writeUint(p, _shirtColor.rgb & 0xFFFFFF, 3);
+    p = writeUint(p, _pantsColor.rgb & 0xFFFFFF, 3);
+    p = writeUint(p, _shoesColor.rgb & 0xFFFFFF, 3);
+    
+    // Length-prefixed text
+    p = writeText(p, _shirtColor.name, 1, MAX_BINARY_NAME_LENGTH);
+    p = writeText(p, _pantsColor.name, 1, MAX_BINARY_NAME_LENGTH);
+    p = writeText(p, _shoesColor.name, 1, MAX_BINARY_NAME_LENGTH);
+    p = writeText(p, _itemDescription, 2, MAX_BINARY_TEXT_LENGTH);
+    p = writeText(p, _notes, 2, MAX_BINARY_TEXT_LENGTH);
+    p = writeUint(p, _id, 8);
+    
+    return p - buffer;
+}
+
+bool LogEntry::deserializeBinary(const uint8_t* data, size_t len) {
+    const size_t fixedSize = 8 + 1 + 1 + 3 * 3;
+    if (len < fixedSize) {
+        DEBUG_PRINT("Invalid binary log entry");
+        return false;
+    }
     
-    // Extract fields
-    String timestampStr = data.substring(0, delimiterPositions[0]);
-    String genderStr = data.substring(delimiterPositions[0] + 1, delimiterPositions[1]);
-    String shirtColorName = data.substring(delimiterPositions[1] + 1, delimiterPositions[2]);
-    String shirtColorRgbStr = data.substring(delimiterPositions[2] + 1, delimiterPositions[3]);
-    String pantsColorName = data.substring(delimiterPositions[3] + 1, delimiterPositions[4]);
-    String pantsColorRgbStr = data.substring(delimiterPositions[4] + 1, delimiterPositions[5]);
-    String shoesColorName = data.substring(delimiterPositions[5] + 1, delimiterPositions[6]);
-    String shoesColorRgbStr = data.substring(delimiterPositions[6] + 1, delimiterPositions[7]);
-    String itemTypeStr = data.substring(delimiterPositions[7] + 1, delimiterPositions[8]);
-    _itemDescription = data.substring(delimiterPositions[8] + 1, delimiterPositions[9]);
-    _notes = data.substring(delimiterPositions[9] + 1);
-    
-    // Convert values
-    _timestamp = (time_t)timestampStr.toInt();
-    _gender = (Gender)genderStr.toInt();
-    _shirtColor.name = shirtColorName;
-    _shirtColor.rgb = (uint32_t)strtoul(shirtColorRgbStr.c_str(), NULL, 16);
-    _pantsColor.name = pantsColorName;
-    _pantsColor.rgb = (uint32_t)strtoul(pantsColorRgbStr.c_str(), NULL, 16);
-    _shoesColor.name = shoesColorName;
-    _shoesColor.rgb = (uint32_t)strtoul(shoesColorRgbStr.c_str(), NULL, 16);
-    _itemType = (ItemType)itemTypeStr.toInt();
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    
+    _timestamp = (time_t)(int64_t)readUint(p, 8);
+    _gender = (Gender)p[8];
+    _itemType = (ItemType)p[9];
+    _shirtColor.rgb = (uint32_t)readUint(p + 10, 3);
+    _pantsColor.rgb = (uint32_t)readUint(p + 13, 3);
+    _shoesColor.rgb = (uint32_t)readUint(p + 16, 3);
+    p += fixedSize;
+    
+    if (!readText(p, end, 1, _shirtColor.name) ||
+        !readText(p, end, 1, _pantsColor.name) ||
+        !readText(p, end, 1, _shoesColor.name) ||
+        !readText(p, end, 2, _itemDescription) ||
+        !readText(p, end, 2, _notes)) {
+        DEBUG_PRINT("Truncated binary log entry");
+        return false;
+    }
+    
+    // Entries saved before IDs end here
+    _id = end - p >= 8 ? readUint(p, 8) : 0;
     
     return true;
 }
@@ -146,6 +315,10 @@ String LogEntry::getFormattedTimestamp(const char* format) const {
     return RtcHAL::formatTime(_timestamp, format);
 }
 
+size_t LogEntry::formatTimestamp(char* buffer, size_t size, const char* format) const {
+    return RtcHAL::formatTime(_timestamp, format, buffer, size);
+}
+
 String LogEntry::getSummary() const {
     String genderStr;
     switch (_gender) {
@@ -10,6 +10,7 @@
 
 #include <Arduino.h>
 #include <time.h>
+#include "inline_string.h"
 #include "../config.h"
 
 enum Gender {
@@ -29,12 +30,23 @@ enum ItemType {
     ITEM_OTHER = 6
 };
 
+// Entry text is held inline, so copying an entry never touches the heap.
+// Text longer than these capacities is truncated when it is set or loaded
+typedef InlineString<MAX_COLOR_NAME_LENGTH> ColorName;
+typedef InlineString<MAX_ITEM_DESCRIPTION_LENGTH> DescriptionText;
+typedef InlineString<MAX_NOTES_LENGTH> NotesText;
+
 struct Color {
-    String name;
+    ColorName name;
     uint32_t rgb;
     
     Color() : name("Unknown"), rgb(0) {}
-    Color(const String& _name, uint32_t _rgb) : name(_name), rgb(_rgb) {}
+    Color(const ColorName& _name, uint32_t _rgb) : name(_name), rgb(_rgb) {}
+    
+    // False for a color left unset, whose RGB value means nothing
+    bool isRecorded() const {
+        return !name.isEmpty() && name != "Unknown";
+    }
 };
 
 class LogEntry {
@@ -43,49 +55,71 @@ public:
     LogEntry();
     LogEntry(time_t timestamp);
     
-    // Getters and setters
+    // Getters and setters. Text and colors are returned by reference, so
+    // reading a field never copies it
+    
+    // Stable ID, given by the database when the entry is added; 0 until then
+    uint64_t getId() const;
+    void setId(uint64_t id);
+    
     time_t getTimestamp() const;
     void setTimestamp(time_t timestamp);
     
     Gender getGender() const;
     void setGender(Gender gender);
     
-    Color getShirtColor() const;
+    const Color& getShirtColor() const;
     void setShirtColor(const Color& color);
     
-    Color getPantsColor() const;
+    const Color& getPantsColor() const;
     void setPantsColor(const Color& color);
     
-    Color getShoesColor() const;
+    const Color& getShoesColor() const;
     void setShoesColor(const Color& color);
     
     ItemType getItemType() const;
     void setItemType(ItemType type);
     
-    String getItemDescription() const;
-    void setItemDescription(const String& description);
+    const DescriptionText& getItemDescription() const;
+    void setItemDescription(const DescriptionText& description);
     
-    String getNotes() const;
-    void setNotes(const String& notes);
+    const NotesText& getNotes() const;
+    void setNotes(const NotesText& notes);
     
     // Serialization methods
     String serialize() const;
     bool deserialize(const String& data);
+    bool deserialize(const char* data, size_t len);
+    
+    // Binary serialization methods
+    // Layout (little-endian): int64 timestamp, uint8 gender, uint8 item type,
+    // 3 x 24-bit RGB (shirt, pants, shoes), 3 x uint8-length color names,
+    // uint16-length item description, uint16-length notes, uint64 ID.
+    // Records end where the ID starts when read without one, which is how
+    // entries saved before IDs are recognised; they read back with ID 0
+    size_t getBinarySize() const;
+    size_t serializeBinary(uint8_t* buffer, size_t maxLen) const;
+    bool deserializeBinary(const uint8_t* data, size_t len);
     
     // Utility methods
     String getFormattedTimestamp(const char* format = "%Y-%m-%d %H:%M:%S") const;
+    size_t formatTimestamp(char* buffer, size_t size, const char* format = "%Y-%m-%d %H:%M:%S") const;
     String getSummary() const;
     bool isValid() const;
-    
+
 private:
+    // Stores entries column by column and materializes them field by field
+    friend class EntryTable;
+    
+    uint64_t _id;
     time_t _timestamp;
     Gender _gender;
     Color _shirtColor;
     Color _pantsColor;
     Color _shoesColor;
     ItemType _itemType;
-    String _itemDescription;
-    String _notes;
+    DescriptionText _itemDescription;
+    NotesText _notes;
 };
 
 #endif // DATA_LOG_ENTRY_H
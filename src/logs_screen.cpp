@@ -6,6 +6,7 @@
  */
 
 #include "logs_screen.h"
+#include "log_detail_screen.h"
 #include "../ui_manager.h"
 #include "../components/status_bar.h"
 #include "../../data/database.h"
@@ -13,12 +14,21 @@
 #include "../../data/export.h"
 #include "../../data/sync.h"
 #include "../../app/app_controller.h"
+#include <algorithm>
 
 // Static member initialization
 LogScreenMode LogsScreen::_currentMode = LOG_SCREEN_ALL;
 lv_obj_t* LogsScreen::_logsList = nullptr;
 lv_obj_t* LogsScreen::_modeSelector = nullptr;
-int LogsScreen::_selectedLogIndex = -1;
+uint64_t LogsScreen::_selectedLogId = 0;
+EntryCursor LogsScreen::_topCursor;
+EntryCursor LogsScreen::_bottomCursor;
+std::vector<size_t> LogsScreen::_pageSizes;
+std::vector<uint64_t> LogsScreen::_rowIds;
+
+// Entries fetched per page, and pages kept on screen while scrolling
+static const size_t LOGS_PAGE_SIZE = 20;
+static const size_t LOGS_MAX_PAGES = 3;
 
 lv_obj_t* LogsScreen::create() {
     DEBUG_PRINTLN("Creating logs screen...");
@@ -56,7 +66,7 @@ lv_obj_t* LogsScreen::create() {
     
     // Create mode selector
     _modeSelector = lv_dropdown_create(screen);
-    lv_dropdown_set_options(_modeSelector, "All Logs\nToday's Logs\nPending Sync");
+    lv_dropdown_set_options(_modeSelector, "All Logs\nToday's Logs\nPending Sync\nRepeat Suspects");
     lv_obj_set_size(_modeSelector, 150, 40);
     lv_obj_align(_modeSelector, LV_ALIGN_TOP_RIGHT, -10, 80);
     lv_obj_add_event_cb(_modeSelector, _modeSelectorEventHandler, LV_EVENT_VALUE_CHANGED, nullptr);
@@ -69,6 +79,7 @@ lv_obj_t* LogsScreen::create() {
     lv_obj_set_style_border_width(_logsList, 0, 0);
     lv_obj_set_style_radius(_logsList, 10, 0);
     lv_obj_set_style_pad_all(_logsList, 10, 0);
+    lv_obj_add_event_cb(_logsList, _listScrollEventHandler, LV_EVENT_SCROLL_END, nullptr);
     
     // Create button container
     lv_obj_t* btnContainer = lv_obj_create(screen);
@@ -156,13 +167,18 @@ void LogsScreen::_modeSelectorEventHandler(lv_event_t* e) {
 
 void LogsScreen::_logItemClickHandler(lv_event_t* e) {
     lv_obj_t* btn = lv_event_get_target(e);
-    int index = (int)lv_obj_get_user_data(btn);
-    DEBUG_PRINTF("Log item clicked: %d\n", index);
+    uint32_t row = lv_obj_get_index(btn);
+    if (row >= _rowIds.size()) {
+        return;
+    }
+    uint64_t id = _rowIds[row];
+    DEBUG_PRINTF("Log item clicked: %llu\n", (unsigned long long)id);
     
-    // Store selected log index
-    _selectedLogIndex = index;
+    // Store selected log ID
+    _selectedLogId = id;
     
     // Navigate to log detail screen
+    LogDetailScreen::setLogId(id);
     UIManager::setScreen(SCREEN_LOG_DETAIL);
 }
 
@@ -229,60 +245,227 @@ void LogsScreen::_exportButtonClickHandler(lv_event_t* e) {
     UIManager::showAlert("Export Complete", "Logs exported to: /logs.csv", "OK");
 }
 
+void LogsScreen::_listScrollEventHandler(lv_event_t* e) {
+    lv_obj_t* list = lv_event_get_target(e);
+    
+    // Fetch the next or previous page once scrolling stops near an edge
+    if (lv_obj_get_scroll_bottom(list) < 80) {
+        _loadNextPage();
+    } else if (lv_obj_get_scroll_top(list) < 80) {
+        _loadPreviousPage();
+    }
+}
+
 void LogsScreen::_loadLogs(lv_obj_t* list, LogScreenMode mode) {
     DEBUG_PRINTF("Loading logs for mode %d\n", mode);
+    _rowIds.clear();
     
-    // In a real implementation, this would load logs from the database
-    // For now, we'll create some sample logs
+    if (mode == LOG_SCREEN_REPEAT) {
+        _pageSizes.clear();
+        _loadTrends(list);
+        return;
+    }
     
-    // Sample logs
-    const int numLogs = 10;
+    EntryFilter filter = nullptr;
+    ArchivedEntryFilter archivedFilter = nullptr;
     
-    for (int i = 0; i < numLogs; i++) {
-        char title[32];
-        char description[64];
-        char timestamp[32];
-        bool synced = (i % 3 != 0); // Every third log is not synced
+    if (mode == LOG_SCREEN_TODAY) {
+        // Days are divided as the stats divide them
+        time_t startOfDay = EntryStats::getDayStart(Database::getWindowTime());
         
-        // Generate sample data
-        snprintf(title, sizeof(title), "Log #%d", i + 1);
+        filter = [startOfDay](uint32_t position, const EntryTable& entries) {
+            return entries.getTimestamp(position) >= startOfDay;
+        };
+        archivedFilter = [startOfDay](const LogEntry& entry) {
+            return entry.getTimestamp() >= startOfDay;
+        };
+    } else if (mode == LOG_SCREEN_PENDING) {
+        // Entries are matched by ID, since deletes, retirements and syncs
+        // finishing out of order all move queued entries around
+        std::vector<uint64_t> pendingIds;
+        SyncManager::getPendingSyncIds(pendingIds);
         
-        const char* genders[] = {"Male", "Female"};
-        const char* colors[] = {"Red", "Blue", "Green", "Black", "White"};
-        const char* items[] = {"Shirt", "Pants", "Shoes", "Hat", "Jacket"};
+        filter = [pendingIds](uint32_t position, const EntryTable& entries) {
+            return std::binary_search(pendingIds.begin(), pendingIds.end(), entries.getId(position));
+        };
+        archivedFilter = [pendingIds](const LogEntry& entry) {
+            return std::binary_search(pendingIds.begin(), pendingIds.end(), entry.getId());
+        };
+    }
+    
+    // Only the first page is fetched, more are loaded while scrolling
+    _topCursor = EntryCursor(ORDER_NEWEST_FIRST, filter, archivedFilter);
+    _bottomCursor = EntryCursor(ORDER_NEWEST_FIRST, filter, archivedFilter);
+    _pageSizes.clear();
+    
+    ResultSet page;
+    if (!_bottomCursor.next(LOGS_PAGE_SIZE, page)) {
+        lv_obj_t* emptyMsg = lv_label_create(list);
+        lv_obj_set_style_text_font(emptyMsg, &lv_font_montserrat_16, 0);
+        lv_obj_set_style_text_color(emptyMsg, lv_color_hex(0x999999), 0);
+        lv_label_set_text(emptyMsg, "No logs found");
+        lv_obj_center(emptyMsg);
+        return;
+    }
+    
+    _topCursor.next(LOGS_PAGE_SIZE, page);
+    _appendPage(list, page, false);
+}
+
+void LogsScreen::_appendPage(lv_obj_t* list, const ResultSet& page, bool atTop) {
+    const char* genders[] = {"Unknown", "Male", "Female", "Other"};
+    const char* items[] = {"Unknown", "Clothing", "Electronics", "Cosmetics", "Accessories", "Food", "Other"};
+    
+    std::vector<uint64_t> pendingIds;
+    SyncManager::getPendingSyncIds(pendingIds);
+    
+    for (size_t i = 0; i < page.size(); i++) {
+        const LogEntry& entry = page.at(i);
+        
+        char title[32];
+        char description[128];
         
-        int genderIndex = i % 2;
-        int shirtColorIndex = i % 5;
-        int pantsColorIndex = (i + 2) % 5;
-        int itemIndex = i % 5;
+        // Archived entries have no place in memory to number them by
+        if (page.isArchived()) {
+            snprintf(title, sizeof(title), "Archived log");
+        } else {
+            snprintf(title, sizeof(title), "Log #%u", (unsigned)(page.getPosition(i) + 1));
+        }
         
         snprintf(description, sizeof(description), "%s, %s shirt, %s pants, %s", 
-                genders[genderIndex], 
-                colors[shirtColorIndex], 
-                colors[pantsColorIndex], 
-                items[itemIndex]);
+                genders[entry.getGender() <= GENDER_OTHER ? entry.getGender() : GENDER_UNKNOWN], 
+                entry.getShirtColor().name.c_str(), 
+                entry.getPantsColor().name.c_str(), 
+                items[entry.getItemType() <= ITEM_OTHER ? entry.getItemType() : ITEM_UNKNOWN]);
+        
+        String timestamp = entry.getFormattedTimestamp("%Y-%m-%d %H:%M");
         
-        // Generate timestamp (today - i days)
-        time_t now = time(nullptr);
-        struct tm* timeinfo = localtime(&now);
-        timeinfo->tm_mday -= i;
-        mktime(timeinfo);
-        strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M", timeinfo);
+        _createLogItem(list, title, description, timestamp.c_str(), !std::binary_search(pendingIds.begin(), pendingIds.end(), entry.getId()));
         
-        // Skip logs that don't match the current mode
-        if (mode == LOG_SCREEN_TODAY && i > 0) {
-            continue; // Only show today's logs
-        } else if (mode == LOG_SCREEN_PENDING && synced) {
-            continue; // Only show pending logs
+        // Keep page order when inserting above the current rows
+        if (atTop) {
+            lv_obj_move_to_index(lv_obj_get_child(list, -1), i);
+            _rowIds.insert(_rowIds.begin() + i, entry.getId());
+        } else {
+            _rowIds.push_back(entry.getId());
         }
+    }
+    
+    if (atTop) {
+        _pageSizes.insert(_pageSizes.begin(), page.size());
+    } else {
+        _pageSizes.push_back(page.size());
+    }
+}
+
+void LogsScreen::_loadTrends(lv_obj_t* list) {
+    const char* windows[] = {"Last shift", "Last week"};
+    const char* kinds[] = {"colors", "items"};
+    const size_t TRENDS_SHOWN = 5;
+    
+    const EntryTrends& trends = Database::getTrends();
+    time_t now = Database::getWindowTime();
+    std::vector<TrendItem> items;
+    
+    for (size_t window = 0; window < TREND_WINDOW_COUNT; window++) {
+        for (size_t kind = 0; kind < TREND_KIND_COUNT; kind++) {
+            char heading[32];
+            snprintf(heading, sizeof(heading), "%s: %s", windows[window], kinds[kind]);
+            lv_obj_t* header = lv_list_add_text(list, heading);
+            lv_obj_set_style_bg_color(header, lv_color_hex(0x303030), 0);
+            lv_obj_set_style_text_color(header, lv_color_hex(0x999999), 0);
+            
+            // Only keys certainly seen more than once point to a repeat
+            trends.top((TrendKind)kind, (TrendWindow)window, now, items, TRENDS_SHOWN);
+            size_t shown = 0;
+            for (const auto& item : items) {
+                if (item.count - item.error < 2) {
+                    continue;
+                }
+                
+                char line[TRENDS_LABEL_LENGTH + 16];
+                snprintf(line, sizeof(line), "%ux  %s", (unsigned)item.count, item.label.c_str());
+                lv_obj_t* row = lv_list_add_text(list, line);
+                lv_obj_set_style_bg_color(row, lv_color_hex(0x404040), 0);
+                lv_obj_set_style_text_color(row, lv_color_hex(0xFFFFFF), 0);
+                shown++;
+            }
+            
+            if (shown == 0) {
+                lv_obj_t* row = lv_list_add_text(list, "No repeats");
+                lv_obj_set_style_text_color(row, lv_color_hex(0x999999), 0);
+            }
+        }
+    }
+}
+
+void LogsScreen::_loadNextPage() {
+    if (!_logsList || _pageSizes.empty()) {
+        return;
+    }
+    
+    ResultSet page;
+    if (!_bottomCursor.next(LOGS_PAGE_SIZE, page)) {
+        return;
+    }
+    
+    _appendPage(_logsList, page, false);
+    
+    // Drop the top page so memory stays bounded
+    if (_pageSizes.size() > LOGS_MAX_PAGES) {
+        lv_coord_t removed = 0;
+        for (size_t i = 0; i < _pageSizes.front(); i++) {
+            lv_obj_t* item = lv_obj_get_child(_logsList, 0);
+            removed += lv_obj_get_height(item) + lv_obj_get_style_pad_row(_logsList, 0);
+            lv_obj_del(item);
+        }
+        _rowIds.erase(_rowIds.begin(), _rowIds.begin() + _pageSizes.front());
+        _pageSizes.erase(_pageSizes.begin());
+        
+        ResultSet skipped;
+        _topCursor.next(LOGS_PAGE_SIZE, skipped);
+        
+        // Keep the visible rows in place
+        lv_obj_update_layout(_logsList);
+        lv_obj_scroll_by(_logsList, 0, removed, LV_ANIM_OFF);
+    }
+}
+
+void LogsScreen::_loadPreviousPage() {
+    if (!_logsList || _pageSizes.empty()) {
+        return;
+    }
+    
+    ResultSet page;
+    if (!_topCursor.previous(LOGS_PAGE_SIZE, page)) {
+        return;
+    }
+    
+    _appendPage(_logsList, page, true);
+    
+    // Keep the visible rows in place
+    lv_obj_update_layout(_logsList);
+    lv_coord_t added = 0;
+    for (size_t i = 0; i < page.size(); i++) {
+        added += lv_obj_get_height(lv_obj_get_child(_logsList, i)) + lv_obj_get_style_pad_row(_logsList, 0);
+    }
+    lv_obj_scroll_by(_logsList, 0, -added, LV_ANIM_OFF);
+    
+    // Drop the bottom page so memory stays bounded
+    if (_pageSizes.size() > LOGS_MAX_PAGES) {
+        for (size_t i = 0; i < _pageSizes.back(); i++) {
+            lv_obj_del(lv_obj_get_child(_logsList, -1));
+        }
+        _rowIds.resize(_rowIds.size() - _pageSizes.back());
+        _pageSizes.pop_back();
         
-        // Create log item
-        _createLogItem(list, title, description, timestamp, synced, i);
+        ResultSet skipped;
+        _bottomCursor.previous(LOGS_PAGE_SIZE, skipped);
     }
 }
 
 void LogsScreen::_createLogItem(lv_obj_t* parent, const char* title, const char* description, 
-                             const char* timestamp, bool synced, int index) {
+                             const char* timestamp, bool synced) {
     // Create list button
     lv_obj_t* btn = lv_list_add_btn(parent, nullptr, "");
     lv_obj_set_style_bg_color(btn, lv_color_hex(0x404040), 0);
@@ -292,9 +475,6 @@ void LogsScreen::_createLogItem(lv_obj_t* parent, const char* title, const char*
     lv_obj_set_height(btn, 80);
     lv_obj_add_event_cb(btn, _logItemClickHandler, LV_EVENT_CLICKED, nullptr);
     
-    // Store index as user data
-    lv_obj_set_user_data(btn, (void*)(intptr_t)index);
-    
     // Create container for content
     lv_obj_t* container = lv_obj_create(btn);
     lv_obj_set_size(container, lv_pct(100), lv_pct(100));
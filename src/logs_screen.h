@@ -11,13 +11,16 @@
 
 #include <Arduino.h>
 #include <lvgl.h>
+#include <vector>
 #include "../config.h"
+#include "../../data/entry_cursor.h"
 
 // Log screen mode
 enum LogScreenMode {
     LOG_SCREEN_ALL,
     LOG_SCREEN_TODAY,
-    LOG_SCREEN_PENDING
+    LOG_SCREEN_PENDING,
+    LOG_SCREEN_REPEAT
 };
 
 class LogsScreen {
@@ -49,7 +52,15 @@ private:
     static LogScreenMode _currentMode;
     static lv_obj_t* _logsList;
     static lv_obj_t* _modeSelector;
-    static int _selectedLogIndex;
+    static uint64_t _selectedLogId;
+    
+    // Pages currently shown, between the pages at the top and bottom cursors
+    static EntryCursor _topCursor;
+    static EntryCursor _bottomCursor;
+    static std::vector<size_t> _pageSizes;
+    
+    // IDs of the entries in the rows shown, in list order
+    static std::vector<uint64_t> _rowIds;
     
     // Event handlers
     static void _backButtonClickHandler(lv_event_t* e);
@@ -57,11 +68,16 @@ private:
     static void _logItemClickHandler(lv_event_t* e);
     static void _syncButtonClickHandler(lv_event_t* e);
     static void _exportButtonClickHandler(lv_event_t* e);
+    static void _listScrollEventHandler(lv_event_t* e);
     
     // Helper methods
     static void _loadLogs(lv_obj_t* list, LogScreenMode mode);
+    static void _appendPage(lv_obj_t* list, const ResultSet& page, bool atTop);
+    static void _loadTrends(lv_obj_t* list);
+    static void _loadNextPage();
+    static void _loadPreviousPage();
     static void _createLogItem(lv_obj_t* parent, const char* title, const char* description, 
-                             const char* timestamp, bool synced, int index);
+                             const char* timestamp, bool synced);
 };
 
 #endif // UI_LOGS_SCREEN_H
@@ -118,8 +118,11 @@ void MainMenuScreen::update(lv_obj_t* screen) {
     // Update View Logs card with count
     lv_obj_t* viewLogsCard = lv_obj_get_child(menuContainer, 1);
     if (viewLogsCard) {
-        int logCount = Database::getEntryCount();
-        String content = String(logCount) + " entries";
+        int logCount = Database::getTotalEntryCount();
+        // Days are divided as the stats divide them, on the device clock
+        time_t now = Database::getWindowTime();
+        int todayCount = Database::getStats().count(EntryStats::getDayStart(now), now);
+        String content = String(logCount) + " entries, " + String(todayCount) + " today";
         Card::setContent(viewLogsCard, content.c_str());
     }
     
@@ -46,6 +46,7 @@ bool OfflineQueueManager::queueLogEntry(const LogEntry& entry) {
     QueueItem item;
     item.type = QUEUE_LOG_ENTRY;
     item.data = entry.serialize();
+    item.entryId = entry.getId();
     item.target = "";
     item.timestamp = millis();
     item.retryCount = 0;
@@ -66,6 +67,7 @@ bool OfflineQueueManager::queueApiRequest(const String& endpoint, const String&
     QueueItem item;
     item.type = QUEUE_API_REQUEST;
     item.data = data;
+    item.entryId = 0;
     item.target = endpoint;
     item.timestamp = millis();
     item.retryCount = 0;
@@ -86,6 +88,7 @@ bool OfflineQueueManager::queueWebhook(const String& url, const String& data) {
     QueueItem item;
     item.type = QUEUE_WEBHOOK;
     item.data = data;
+    item.entryId = 0;
     item.target = url;
     item.timestamp = millis();
     item.retryCount = 0;
@@ -125,19 +128,25 @@ int OfflineQueueManager::processQueue() {
             case QUEUE_LOG_ENTRY: {
                 LogEntry entry;
                 if (entry.deserialize(item.data)) {
-                    // Convert to JSON for API
+                    // Convert to JSON for API. The ID is sent as a string, as
+                    // the sync manager does, so no JSON reader rounds it
                     StaticJsonDocument<512> doc;
+                    char id[21];
+                    if (item.entryId != 0) {
+                        snprintf(id, sizeof(id), "%llu", (unsigned long long)item.entryId);
+                        doc["id"] = id;
+                    }
                     doc["timestamp"] = entry.getTimestamp();
                     doc["gender"] = (int)entry.getGender();
-                    doc["shirt_color"] = entry.getShirtColor().name;
+                    doc["shirt_color"] = String(entry.getShirtColor().name.c_str());
                     doc["shirt_rgb"] = String(entry.getShirtColor().rgb, HEX);
-                    doc["pants_color"] = entry.getPantsColor().name;
+                    doc["pants_color"] = String(entry.getPantsColor().name.c_str());
                     doc["pants_rgb"] = String(entry.getPantsColor().rgb, HEX);
-                    doc["shoes_color"] = entry.getShoesColor().name;
+                    doc["shoes_color"] = String(entry.getShoesColor().name.c_str());
                     doc["shoes_rgb"] = String(entry.getShoesColor().rgb, HEX);
                     doc["item_type"] = (int)entry.getItemType();
-                    doc["item_description"] = entry.getItemDescription();
-                    doc["notes"] = entry.getNotes();
+                    doc["item_description"] = String(entry.getItemDescription().c_str());
+                    doc["notes"] = String(entry.getNotes().c_str());
                     
                     String json;
                     serializeJson(doc, json);
@@ -207,6 +216,11 @@ bool OfflineQueueManager::saveQueue() {
         JsonObject itemObj = queueArray.createNestedObject();
         itemObj["type"] = (int)item.type;
         itemObj["data"] = item.data;
+        if (item.entryId != 0) {
+            char id[21];
+            snprintf(id, sizeof(id), "%llu", (unsigned long long)item.entryId);
+            itemObj["entryId"] = id;
+        }
         itemObj["target"] = item.target;
         itemObj["timestamp"] = item.timestamp;
         itemObj["retryCount"] = item.retryCount;
@@ -216,8 +230,8 @@ bool OfflineQueueManager::saveQueue() {
     String jsonStr;
     serializeJson(doc, jsonStr);
     
-    // Write to file
-    if (StorageHAL::writeFile(QUEUE_FILENAME, jsonStr.c_str(), jsonStr.length()) < 0) {
+    // Replace the file atomically so a power loss keeps the previous queue
+    if (!StorageHAL::writeFileAtomic(QUEUE_FILENAME, jsonStr.c_str(), jsonStr.length())) {
         DEBUG_PRINT("Failed to save offline queue to file");
         return false;
     }
@@ -234,6 +248,11 @@ bool OfflineQueueManager::loadQueue() {
         return false;
     }
     
+    // Finish or discard a save that was interrupted
+    if (!StorageHAL::recoverFile(QUEUE_FILENAME)) {
+        DEBUG_PRINT("Failed to recover offline queue file");
+    }
+    
     if (!StorageHAL::fileExists(QUEUE_FILENAME)) {
         DEBUG_PRINT("Offline queue file not found, starting with empty queue");
         return true;
@@ -253,6 +272,18 @@ bool OfflineQueueManager::loadQueue() {
         return false;
     }
     
+    // Files written before atomic saves have no footer and are parsed whole
+    size_t dataLength;
+    uint32_t dataCrc;
+    if (StorageHAL::readFooter(QUEUE_FILENAME, dataLength, dataCrc)) {
+        if (StorageHAL::crc32(buffer, dataLength) != dataCrc) {
+            DEBUG_PRINT("Offline queue file checksum mismatch, starting with empty queue");
+            delete[] buffer;
+            return false;
+        }
+        buffer[dataLength] = '\0';
+    }
+    
     // Parse JSON
     DynamicJsonDocument doc(16384); // Adjust size as needed
     DeserializationError error = deserializeJson(doc, buffer);
@@ -269,6 +300,9 @@ bool OfflineQueueManager::loadQueue() {
         QueueItem item;
         item.type = (QueueItemType)itemObj["type"].as<int>();
         item.data = itemObj["data"].as<String>();
+        // Items queued before entries had IDs have none
+        const char* id = itemObj["entryId"] | "";
+        item.entryId = strtoull(id, nullptr, 10);
         item.target = itemObj["target"].as<String>();
         item.timestamp = itemObj["timestamp"].as<uint32_t>();
         item.retryCount = itemObj["retryCount"].as<int>();
@@ -22,6 +22,7 @@ enum QueueItemType {
 struct QueueItem {
     QueueItemType type;
     String data;
+    uint64_t entryId;  // ID of a queued log entry, which its text form leaves out
     String target;
     uint32_t timestamp;
     int retryCount;
@@ -0,0 +1,274 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Query Planner Implementation
+ */
+
+#include "query_planner.h"
+#include "database.h"
+#include <algorithm>
+
+// Relative cost of checking one candidate against a filter, in units of
+// one position handled while resolving an index bitmap
+static const size_t CHECK_COST = 2;
+static const size_t TEXT_CHECK_COST = 16;
+static const size_t COLOR_NEAR_CHECK_COST = 8;
+
+static int accessRank(PlanAccess access) {
+    switch (access) {
+        case PLAN_ACCESS_INDEX: return 0;
+        case PLAN_ACCESS_INDEX_CHECK: return 1;
+        default: return 2;
+    }
+}
+
+QueryPlan::QueryPlan() : totalRows(0), estimatedRows(0), resultRows(0), executed(false) {
+}
+
+String QueryPlan::explain() const {
+    String text = "Plan over " + String(totalRows) + " entries, estimated " + String(estimatedRows) + " rows\n";
+    
+    char line[96];
+    for (size_t i = 0; i < steps.size(); i++) {
+        const PlanStep& step = steps[i];
+        const char* access = step.access == PLAN_ACCESS_INDEX ? "index" :
+                             step.access == PLAN_ACCESS_INDEX_CHECK ? "index+check" : "check";
+        
+        if (executed) {
+            snprintf(line, sizeof(line), "  %u. %-11s est %6u actual %6u  ",
+                     (unsigned)(i + 1), access, (unsigned)step.estimatedRows, (unsigned)step.actualRows);
+        } else {
+            snprintf(line, sizeof(line), "  %u. %-11s est %6u  ",
+                     (unsigned)(i + 1), access, (unsigned)step.estimatedRows);
+        }
+        text += line;
+        text += QueryPlanner::describe(step.filter);
+        text += "\n";
+    }
+    
+    if (executed) {
+        text += "Result: " + String(resultRows) + " rows\n";
+    }
+    return text;
+}
+
+QueryPlan QueryPlanner::plan(const std::vector<SearchFilter>& filters) {
+    QueryPlan plan;
+    plan.totalRows = Database::getIndex().size();
+    
+    for (const auto& filter : filters) {
+        PlanStep step;
+        step.filter = filter;
+        step.access = PLAN_ACCESS_CHECK;
+        step.estimatedRows = estimateRows(filter);
+        step.actualRows = 0;
+        plan.steps.push_back(step);
+    }
+    
+    // Most selective filters first
+    std::stable_sort(plan.steps.begin(), plan.steps.end(), [](const PlanStep& a, const PlanStep& b) {
+        return a.estimatedRows < b.estimatedRows;
+    });
+    
+    // Resolve a filter through its index unless checking the candidates left
+    // by earlier steps is cheaper. Rows are estimated assuming independent filters
+    double remaining = plan.totalRows;
+    for (size_t i = 0; i < plan.steps.size(); i++) {
+        PlanStep& step = plan.steps[i];
+        bool useIndex = (i == 0) || resolveCost(step.filter, step.estimatedRows) <= remaining * checkCost(step.filter);
+        
+        if (step.filter.type == FILTER_TEXT) {
+            step.access = useIndex ? PLAN_ACCESS_INDEX_CHECK : PLAN_ACCESS_CHECK;
+        } else {
+            step.access = useIndex ? PLAN_ACCESS_INDEX : PLAN_ACCESS_CHECK;
+        }
+        
+        if (plan.totalRows > 0) {
+            remaining = remaining * step.estimatedRows / plan.totalRows;
+        }
+    }
+    plan.estimatedRows = (size_t)remaining;
+    
+    // Steps run in this order: index intersections, then one pass over the
+    // candidates checking the rest
+    std::stable_sort(plan.steps.begin(), plan.steps.end(), [](const PlanStep& a, const PlanStep& b) {
+        return accessRank(a.access) < accessRank(b.access);
+    });
+    
+    return plan;
+}
+
+void QueryPlanner::execute(QueryPlan& plan, std::vector<uint32_t>& positions) {
+    positions.clear();
+    
+    const EntryTable& entries = Database::getEntries();
+    
+    // Intersect index bitmaps
+    Bitmap candidates;
+    bool resolved = false;
+    std::vector<PlanStep*> checks;
+    
+    for (auto& step : plan.steps) {
+        if (step.access == PLAN_ACCESS_CHECK) {
+            checks.push_back(&step);
+            continue;
+        }
+        
+        if (!resolved || !candidates.isEmpty()) {
+            Bitmap storage;
+            const Bitmap* bitmap = resolve(step.filter, storage);
+            if (!resolved) {
+                candidates = *bitmap;
+                resolved = true;
+            } else {
+                candidates.intersectWith(*bitmap);
+            }
+        }
+        step.actualRows = candidates.cardinality();
+        
+        if (step.access == PLAN_ACCESS_INDEX_CHECK) {
+            checks.push_back(&step);
+        }
+    }
+    
+    if (!resolved) {
+        candidates.addRange(entries.size());
+    }
+    
+    candidates.toPositions(positions);
+    
+    // Each check narrows the survivors of the one before with a pass over
+    // its entry column, so no entry is materialized
+    for (auto* step : checks) {
+        if (!positions.empty()) {
+            SearchEngine::narrow(entries, SearchEngine::bind(entries, step->filter), positions);
+        }
+        step->actualRows = positions.size();
+    }
+    
+    plan.resultRows = positions.size();
+    plan.executed = true;
+}
+
+QueryPlan QueryPlanner::search(const std::vector<SearchFilter>& filters, std::vector<uint32_t>& positions) {
+    QueryPlan queryPlan = plan(filters);
+    execute(queryPlan, positions);
+    return queryPlan;
+}
+
+size_t QueryPlanner::estimateRows(const SearchFilter& filter) {
+    const EntryIndex& index = Database::getIndex();
+    
+    switch (filter.type) {
+        case FILTER_DATE_RANGE:
+            return index.countByDateRange(filter.dateRange.startTime, filter.dateRange.endTime);
+        case FILTER_GENDER:
+            return index.getByGender(filter.gender).cardinality();
+        case FILTER_SHIRT_COLOR:
+            return index.countByColor(INDEX_COLOR_SHIRT, filter.color.colorName);
+        case FILTER_PANTS_COLOR:
+            return index.countByColor(INDEX_COLOR_PANTS, filter.color.colorName);
+        case FILTER_SHOES_COLOR:
+            return index.countByColor(INDEX_COLOR_SHOES, filter.color.colorName);
+        case FILTER_ITEM_TYPE:
+            return index.getByItemType(filter.itemType).cardinality();
+        case FILTER_TEXT:
+            return index.estimateText(filter.textSearch.text);
+        case FILTER_SHIRT_COLOR_NEAR:
+            return index.countByColorNear(INDEX_COLOR_SHIRT, filter.nearColor.rgb, filter.nearColor.maxDistance);
+        case FILTER_PANTS_COLOR_NEAR:
+            return index.countByColorNear(INDEX_COLOR_PANTS, filter.nearColor.rgb, filter.nearColor.maxDistance);
+        case FILTER_SHOES_COLOR_NEAR:
+            return index.countByColorNear(INDEX_COLOR_SHOES, filter.nearColor.rgb, filter.nearColor.maxDistance);
+    }
+    
+    return index.size();
+}
+
+size_t QueryPlanner::resolveCost(const SearchFilter& filter, size_t estimatedRows) {
+    // Gender and item type bitmaps are kept ready, the others are built per query
+    if (filter.type == FILTER_GENDER || filter.type == FILTER_ITEM_TYPE) {
+        return 0;
+    }
+    return estimatedRows;
+}
+
+size_t QueryPlanner::checkCost(const SearchFilter& filter) {
+    switch (filter.type) {
+        case FILTER_TEXT:
+            return TEXT_CHECK_COST;
+        case FILTER_SHIRT_COLOR_NEAR:
+        case FILTER_PANTS_COLOR_NEAR:
+        case FILTER_SHOES_COLOR_NEAR:
+            return COLOR_NEAR_CHECK_COST;
+        default:
+            return CHECK_COST;
+    }
+}
+
+const Bitmap* QueryPlanner::resolve(const SearchFilter& filter, Bitmap& storage) {
+    const EntryIndex& index = Database::getIndex();
+    
+    switch (filter.type) {
+        case FILTER_DATE_RANGE:
+            index.getByDateRange(filter.dateRange.startTime, filter.dateRange.endTime, storage);
+            break;
+        case FILTER_GENDER:
+            return &index.getByGender(filter.gender);
+        case FILTER_SHIRT_COLOR:
+            index.getByColor(INDEX_COLOR_SHIRT, filter.color.colorName, storage);
+            break;
+        case FILTER_PANTS_COLOR:
+            index.getByColor(INDEX_COLOR_PANTS, filter.color.colorName, storage);
+            break;
+        case FILTER_SHOES_COLOR:
+            index.getByColor(INDEX_COLOR_SHOES, filter.color.colorName, storage);
+            break;
+        case FILTER_ITEM_TYPE:
+            return &index.getByItemType(filter.itemType);
+        case FILTER_TEXT:
+            index.getTextCandidates(filter.textSearch.text, storage);
+            break;
+        case FILTER_SHIRT_COLOR_NEAR:
+            index.getByColorNear(INDEX_COLOR_SHIRT, filter.nearColor.rgb, filter.nearColor.maxDistance, storage);
+            break;
+        case FILTER_PANTS_COLOR_NEAR:
+            index.getByColorNear(INDEX_COLOR_PANTS, filter.nearColor.rgb, filter.nearColor.maxDistance, storage);
+            break;
+        case FILTER_SHOES_COLOR_NEAR:
+            index.getByColorNear(INDEX_COLOR_SHOES, filter.nearColor.rgb, filter.nearColor.maxDistance, storage);
+            break;
+    }
+    
+    return &storage;
+}
+
+String QueryPlanner::describe(const SearchFilter& filter) {
+    switch (filter.type) {
+        case FILTER_DATE_RANGE:
+            return "date " + String((long)filter.dateRange.startTime) + ".." + String((long)filter.dateRange.endTime);
+        case FILTER_GENDER:
+            return "gender = " + String((int)filter.gender);
+        case FILTER_SHIRT_COLOR:
+            return "shirt color ~ '" + filter.color.colorName + "'";
+        case FILTER_PANTS_COLOR:
+            return "pants color ~ '" + filter.color.colorName + "'";
+        case FILTER_SHOES_COLOR:
+            return "shoes color ~ '" + filter.color.colorName + "'";
+        case FILTER_ITEM_TYPE:
+            return "item type = " + String((int)filter.itemType);
+        case FILTER_TEXT:
+            return "text ~ '" + filter.textSearch.text + "'";
+        case FILTER_SHIRT_COLOR_NEAR:
+        case FILTER_PANTS_COLOR_NEAR:
+        case FILTER_SHOES_COLOR_NEAR: {
+            const char* attributes[] = {"shirt", "pants", "shoes"};
+            char text[64];
+            snprintf(text, sizeof(text), "%s color within %.1f of #%06X",
+                     attributes[filter.type - FILTER_SHIRT_COLOR_NEAR], filter.nearColor.maxDistance,
+                     (unsigned)(filter.nearColor.rgb & 0xFFFFFF));
+            return String(text);
+        }
+    }
+    
+    return "unknown";
+}
@@ -0,0 +1,90 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Query Planner
+ * 
+ * This file contains the cost-based planner that orders and executes
+ * search filter combinations against the database indexes
+ */
+
+#ifndef DATA_QUERY_PLANNER_H
+#define DATA_QUERY_PLANNER_H
+
+#include <Arduino.h>
+#include <vector>
+#include "search.h"
+#include "bitmap.h"
+#include "../config.h"
+
+// How a plan step is evaluated
+enum PlanAccess {
+    PLAN_ACCESS_INDEX,          // Intersect the filter's index bitmap
+    PLAN_ACCESS_INDEX_CHECK,    // Intersect trigram candidates, then check each one
+    PLAN_ACCESS_CHECK           // Check each remaining candidate
+};
+
+// One filter of a plan
+struct PlanStep {
+    SearchFilter filter;
+    PlanAccess access;
+    size_t estimatedRows;   // Entries matching this filter alone
+    size_t actualRows;      // Entries remaining after this step
+};
+
+// Ordered filters with their access methods and row counts
+class QueryPlan {
+public:
+    std::vector<PlanStep> steps;
+    size_t totalRows;
+    size_t estimatedRows;
+    size_t resultRows;
+    bool executed;
+    
+    QueryPlan();
+    
+    /**
+     * Describe the plan, one line per step. The search screen logs it in
+     * builds with QUERY_PLAN_DEBUG defined
+     * @return plan description
+     */
+    String explain() const;
+};
+
+class QueryPlanner {
+public:
+    /**
+     * Plan a filter combination (AND logic) from index statistics
+     * @param filters filters to plan
+     * @return plan, with steps in execution order
+     */
+    static QueryPlan plan(const std::vector<SearchFilter>& filters);
+    
+    /**
+     * Execute a plan and record its actual row counts
+     * @param plan plan to execute
+     * @param positions vector to fill with matching positions in ascending order
+     */
+    static void execute(QueryPlan& plan, std::vector<uint32_t>& positions);
+    
+    /**
+     * Plan and execute a filter combination
+     * @param filters filters to apply (AND logic)
+     * @param positions vector to fill with matching positions in ascending order
+     * @return executed plan
+     */
+    static QueryPlan search(const std::vector<SearchFilter>& filters, std::vector<uint32_t>& positions);
+    
+    /**
+     * Describe a filter for plan output
+     * @param filter filter to describe
+     * @return short description
+     */
+    static String describe(const SearchFilter& filter);
+
+private:
+    static size_t estimateRows(const SearchFilter& filter);
+    static size_t resolveCost(const SearchFilter& filter, size_t estimatedRows);
+    static size_t checkCost(const SearchFilter& filter);
+    static const Bitmap* resolve(const SearchFilter& filter, Bitmap& storage);
+};
+
+#endif // DATA_QUERY_PLANNER_H
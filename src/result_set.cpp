@@ -0,0 +1,150 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Result Set Implementation
+ */
+
+#include "result_set.h"
+#include "database.h"
+#include <algorithm>
+
+ResultSet::ResultSet() : _isArchived(false), _generation(Database::getGeneration()) {
+}
+
+ResultSet::ResultSet(std::vector<uint32_t>&& positions, uint32_t generation)
+    : _positions(std::move(positions)), _isArchived(false), _generation(generation) {
+}
+
+ResultSet::ResultSet(std::vector<LogEntry>&& entries)
+    : _archived(std::move(entries)), _isArchived(true), _generation(Database::getGeneration()) {
+}
+
+bool ResultSet::isArchived() const {
+    return _isArchived;
+}
+
+size_t ResultSet::size() const {
+    return _isArchived ? _archived.size() : _positions.size();
+}
+
+bool ResultSet::isEmpty() const {
+    return size() == 0;
+}
+
+bool ResultSet::isValid() const {
+    return _isArchived || _generation == Database::getGeneration();
+}
+
+uint32_t ResultSet::getPosition(size_t index) const {
+    return _isArchived ? 0 : _positions[index];
+}
+
+const std::vector<uint32_t>& ResultSet::getPositions() const {
+    return _positions;
+}
+
+LogEntry ResultSet::at(size_t index) const {
+    LogEntry entry((time_t)0);
+    materialize(index, entry);
+    return entry;
+}
+
+bool ResultSet::materialize(size_t index, LogEntry& entry) const {
+    if (_isArchived) {
+        if (index >= _archived.size()) {
+            return false;
+        }
+        entry = _archived[index];
+        return true;
+    }
+    
+    // Positions of a stale result set may now be out of range, or refer to
+    // other entries
+    if (!isValid() || index >= _positions.size() || _positions[index] >= Database::getEntries().size()) {
+        return false;
+    }
+    
+    Database::getEntries().get(_positions[index], entry);
+    return true;
+}
+
+std::vector<LogEntry> ResultSet::materialize() const {
+    if (_isArchived) {
+        return _archived;
+    }
+    
+    std::vector<LogEntry> entries;
+    if (!isValid()) {
+        return entries;
+    }
+    entries.reserve(_positions.size());
+    
+    const EntryTable& table = Database::getEntries();
+    for (uint32_t position : _positions) {
+        entries.emplace_back((time_t)0);
+        table.get(position, entries.back());
+    }
+    
+    return entries;
+}
+
+void ResultSet::sortByTimestampDesc() {
+    if (_isArchived) {
+        std::stable_sort(_archived.begin(), _archived.end(), [](const LogEntry& a, const LogEntry& b) {
+            return a.getTimestamp() > b.getTimestamp();
+        });
+        return;
+    }
+    if (!isValid()) {
+        return;
+    }
+    
+    const EntryTable& entries = Database::getEntries();
+    std::stable_sort(_positions.begin(), _positions.end(), [&entries](uint32_t a, uint32_t b) {
+        return entries.getTimestamp(a) > entries.getTimestamp(b);
+    });
+}
+
+void ResultSet::sortByTimestampAsc() {
+    if (_isArchived) {
+        std::stable_sort(_archived.begin(), _archived.end(), [](const LogEntry& a, const LogEntry& b) {
+            return a.getTimestamp() < b.getTimestamp();
+        });
+        return;
+    }
+    if (!isValid()) {
+        return;
+    }
+    
+    const EntryTable& entries = Database::getEntries();
+    std::stable_sort(_positions.begin(), _positions.end(), [&entries](uint32_t a, uint32_t b) {
+        return entries.getTimestamp(a) < entries.getTimestamp(b);
+    });
+}
+
+void ResultSet::sortCustom(std::function<bool(const LogEntry&, const LogEntry&)> comparator) {
+    if (_isArchived) {
+        std::stable_sort(_archived.begin(), _archived.end(), comparator);
+        return;
+    }
+    if (!isValid()) {
+        return;
+    }
+    
+    // The comparator needs whole entries, so they are materialized once
+    // and sorted through an order over them
+    std::vector<LogEntry> entries = materialize();
+    std::vector<uint32_t> order(entries.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    
+    std::stable_sort(order.begin(), order.end(), [&entries, &comparator](uint32_t a, uint32_t b) {
+        return comparator(entries[a], entries[b]);
+    });
+    
+    std::vector<uint32_t> positions(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        positions[i] = _positions[order[i]];
+    }
+    _positions.swap(positions);
+}
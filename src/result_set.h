@@ -0,0 +1,136 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Result Set
+ * 
+ * This file contains the result set type returned by database queries. It
+ * refers to entries by position instead of copying them, so it is only good
+ * until the next entry is deleted, replaced or retired; a stale result set
+ * reads as empty and must be re-queried. Archived entries have no position
+ * and are held by the result set instead
+ */
+
+#ifndef DATA_RESULT_SET_H
+#define DATA_RESULT_SET_H
+
+#include <Arduino.h>
+#include <vector>
+#include <functional>
+#include "log_entry.h"
+#include "../config.h"
+
+class ResultSet {
+public:
+    ResultSet();
+    
+    /**
+     * Create a result set over database positions
+     * @param positions entry positions, taken over by the result set
+     * @param generation database generation the positions belong to
+     */
+    ResultSet(std::vector<uint32_t>&& positions, uint32_t generation);
+    
+    /**
+     * Create a result set holding entries read from the archive. It never
+     * goes stale, as archived entries do not move
+     * @param entries entries in result order, taken over by the result set
+     */
+    explicit ResultSet(std::vector<LogEntry>&& entries);
+    
+    /**
+     * Check if the result set holds archived entries rather than positions
+     * @return true if archived, false otherwise
+     */
+    bool isArchived() const;
+    
+    /**
+     * Get the number of entries in the result set
+     * @return number of entries
+     */
+    size_t size() const;
+    
+    /**
+     * Check if the result set is empty
+     * @return true if empty, false otherwise
+     */
+    bool isEmpty() const;
+    
+    /**
+     * Check if the positions still refer to the same entries, i.e. no entry
+     * has been deleted or replaced since the query ran
+     * @return true if valid, false otherwise
+     */
+    bool isValid() const;
+    
+    /**
+     * Get the database position of a result, which an archived result does
+     * not have
+     * @param index result index
+     * @return entry position, 0 for an archived result
+     */
+    uint32_t getPosition(size_t index) const;
+    
+    /**
+     * Get the database positions of all results
+     * @return entry positions in result order, none for archived results
+     */
+    const std::vector<uint32_t>& getPositions() const;
+    
+    /**
+     * Get a result, materialized from the database's entry columns
+     * @param index result index
+     * @return entry, or an empty entry if the result set is stale or the
+     *         index is out of range
+     */
+    LogEntry at(size_t index) const;
+    
+    /**
+     * Copy the results out
+     * @return vector of log entries in result order, empty if the result
+     *         set is stale
+     */
+    std::vector<LogEntry> materialize() const;
+    
+    /**
+     * Sort results by timestamp (newest first). A stale result set is left
+     * as it is
+     */
+    void sortByTimestampDesc();
+    
+    /**
+     * Sort results by timestamp (oldest first)
+     */
+    void sortByTimestampAsc();
+    
+    /**
+     * Sort results by custom comparator
+     * @param comparator function to compare entries
+     */
+    void sortCustom(std::function<bool(const LogEntry&, const LogEntry&)> comparator);
+    
+    /**
+     * Call a function for each result in order; nothing is called for a
+     * stale result set
+     * @param func function taking a const LogEntry&
+     */
+    template <typename Func>
+    void forEach(Func func) const {
+        // One entry is materialized at a time, reusing its string buffers
+        LogEntry entry((time_t)0);
+        for (size_t i = 0; i < size(); i++) {
+            if (!materialize(i, entry)) {
+                return;
+            }
+            func(entry);
+        }
+    }
+
+private:
+    std::vector<uint32_t> _positions;
+    std::vector<LogEntry> _archived;
+    bool _isArchived;
+    
+    bool materialize(size_t index, LogEntry& entry) const;
+    uint32_t _generation;
+};
+
+#endif // DATA_RESULT_SET_H
@@ -116,11 +116,20 @@ bool RtcHAL::syncWithNTP(const char* ntpServer) {
 
 String RtcHAL::formatTime(time_t time, const char* format) {
     char buffer[64];
-    struct tm* timeinfo = localtime(&time);
-    strftime(buffer, sizeof(buffer), format, timeinfo);
+    formatTime(time, format, buffer, sizeof(buffer));
     return String(buffer);
 }
 
+size_t RtcHAL::formatTime(time_t time, const char* format, char* buffer, size_t size) {
+    struct tm timeinfo;
+    localtime_r(&time, &timeinfo);
+    size_t length = strftime(buffer, size, format, &timeinfo);
+    if (length == 0 && size > 0) {
+        buffer[0] = '\0';
+    }
+    return length;
+}
+
 String RtcHAL::formatCurrentTime(const char* format) {
     return formatTime(getTime(), format);
 }
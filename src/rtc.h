@@ -66,6 +66,16 @@ public:
      */
     static String formatTime(time_t time, const char* format);
     
+    /**
+     * Format time into a caller-supplied buffer, without allocating
+     * @param time time_t to format
+     * @param format strftime format string
+     * @param buffer buffer for the null-terminated result
+     * @param size size of the buffer
+     * @return length of the formatted time, 0 if it did not fit
+     */
+    static size_t formatTime(time_t time, const char* format, char* buffer, size_t size);
+    
     /**
      * Format current time as string
      * @param format strftime format string
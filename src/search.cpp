@@ -4,11 +4,25 @@
  */
 
 #include "search.h"
+#include "database.h"
+#include "query_planner.h"
 #include <algorithm>
 
 // Static member initialization
 bool SearchEngine::_initialized = false;
 
+// Compacts the positions in place, keeping those the predicate accepts
+template <typename Predicate>
+static void keepIf(std::vector<uint32_t>& positions, Predicate predicate) {
+    size_t kept = 0;
+    for (uint32_t position : positions) {
+        if (predicate(position)) {
+            positions[kept++] = position;
+        }
+    }
+    positions.resize(kept);
+}
+
 // SearchFilter static constructors
 SearchFilter SearchFilter::createDateRangeFilter(time_t startTime, time_t endTime) {
     SearchFilter filter;
@@ -46,6 +60,30 @@ SearchFilter SearchFilter::createShoesColorFilter(const String& colorName) {
     return filter;
 }
 
+SearchFilter SearchFilter::createShirtColorNearFilter(uint32_t rgb, float maxDistance) {
+    SearchFilter filter;
+    filter.type = FILTER_SHIRT_COLOR_NEAR;
+    filter.nearColor.rgb = rgb;
+    filter.nearColor.maxDistance = maxDistance;
+    return filter;
+}
+
+SearchFilter SearchFilter::createPantsColorNearFilter(uint32_t rgb, float maxDistance) {
+    SearchFilter filter;
+    filter.type = FILTER_PANTS_COLOR_NEAR;
+    filter.nearColor.rgb = rgb;
+    filter.nearColor.maxDistance = maxDistance;
+    return filter;
+}
+
+SearchFilter SearchFilter::createShoesColorNearFilter(uint32_t rgb, float maxDistance) {
+    SearchFilter filter;
+    filter.type = FILTER_SHOES_COLOR_NEAR;
+    filter.nearColor.rgb = rgb;
+    filter.nearColor.maxDistance = maxDistance;
+    return filter;
+}
+
 SearchFilter SearchFilter::createItemTypeFilter(ItemType itemType) {
     SearchFilter filter;
     filter.type = FILTER_ITEM_TYPE;
@@ -78,33 +116,7 @@ std::vector<LogEntry> SearchEngine::search(const std::vector<LogEntry>& entries,
     std::vector<LogEntry> result;
     
     for (const auto& entry : entries) {
-        bool match = false;
-        
-        switch (filter.type) {
-            case FILTER_DATE_RANGE:
-                match = filterByDateRange(entry, filter.dateRange.startTime, filter.dateRange.endTime);
-                break;
-            case FILTER_GENDER:
-                match = filterByGender(entry, filter.gender);
-                break;
-            case FILTER_SHIRT_COLOR:
-                match = filterByShirtColor(entry, filter.color.colorName);
-                break;
-            case FILTER_PANTS_COLOR:
-                match = filterByPantsColor(entry, filter.color.colorName);
-                break;
-            case FILTER_SHOES_COLOR:
-                match = filterByShoesColor(entry, filter.color.colorName);
-                break;
-            case FILTER_ITEM_TYPE:
-                match = filterByItemType(entry, filter.itemType);
-                break;
-            case FILTER_TEXT:
-                match = filterByText(entry, filter.textSearch.text);
-                break;
-        }
-        
-        if (match) {
+        if (matches(entry, filter)) {
             result.push_back(entry);
         }
     }
@@ -117,13 +129,46 @@ std::vector<LogEntry> SearchEngine::searchMultiple(const std::vector<LogEntry>&
         return entries;
     }
     
-    std::vector<LogEntry> result = entries;
+    // Check every filter per entry so only matching entries are copied
+    std::vector<LogEntry> result;
+    
+    for (const auto& entry : entries) {
+        bool match = true;
+        for (const auto& filter : filters) {
+            if (!matches(entry, filter)) {
+                match = false;
+                break;
+            }
+        }
+        
+        if (match) {
+            result.push_back(entry);
+        }
+    }
+    
+    return result;
+}
+
+ResultSet SearchEngine::select(const std::vector<SearchFilter>& filters) {
+    std::vector<uint32_t> positions;
+    QueryPlanner::search(filters, positions);
+    return ResultSet(std::move(positions), Database::getGeneration());
+}
+
+ResultSet SearchEngine::filter(const ResultSet& results, const std::vector<SearchFilter>& filters) {
+    std::vector<uint32_t> positions;
     
+    // Checked against the columns, so no entry is materialized
+    const EntryTable& entries = Database::getEntries();
+    positions = results.getPositions();
     for (const auto& filter : filters) {
-        result = search(result, filter);
+        if (positions.empty()) {
+            break;
+        }
+        narrow(entries, bind(entries, filter), positions);
     }
     
-    return result;
+    return ResultSet(std::move(positions), Database::getGeneration());
 }
 
 std::vector<LogEntry> SearchEngine::sortByTimestampDesc(const std::vector<LogEntry>& entries) {
@@ -149,6 +194,184 @@ std::vector<LogEntry> SearchEngine::sortCustom(const std::vector<LogEntry>& entr
     return sorted;
 }
 
+bool SearchEngine::matches(const LogEntry& entry, const SearchFilter& filter) {
+    switch (filter.type) {
+        case FILTER_DATE_RANGE:
+            return filterByDateRange(entry, filter.dateRange.startTime, filter.dateRange.endTime);
+        case FILTER_GENDER:
+            return filterByGender(entry, filter.gender);
+        case FILTER_SHIRT_COLOR:
+            return filterByShirtColor(entry, filter.color.colorName);
+        case FILTER_PANTS_COLOR:
+            return filterByPantsColor(entry, filter.color.colorName);
+        case FILTER_SHOES_COLOR:
+            return filterByShoesColor(entry, filter.color.colorName);
+        case FILTER_ITEM_TYPE:
+            return filterByItemType(entry, filter.itemType);
+        case FILTER_TEXT:
+            return filterByText(entry, filter.textSearch.text);
+        case FILTER_SHIRT_COLOR_NEAR:
+            return filterByColorNear(entry.getShirtColor(), ColorLab::fromRgb(filter.nearColor.rgb), filter.nearColor.maxDistance);
+        case FILTER_PANTS_COLOR_NEAR:
+            return filterByColorNear(entry.getPantsColor(), ColorLab::fromRgb(filter.nearColor.rgb), filter.nearColor.maxDistance);
+        case FILTER_SHOES_COLOR_NEAR:
+            return filterByColorNear(entry.getShoesColor(), ColorLab::fromRgb(filter.nearColor.rgb), filter.nearColor.maxDistance);
+    }
+    
+    return false;
+}
+
+ColumnFilter SearchEngine::bind(const EntryTable& entries, const SearchFilter& filter) {
+    ColumnFilter bound;
+    bound.filter = filter;
+    
+    if (filter.type == FILTER_SHIRT_COLOR || filter.type == FILTER_PANTS_COLOR || filter.type == FILTER_SHOES_COLOR) {
+        bound.colorCodes.resize(entries.getColorCodeCount());
+        for (size_t code = 0; code < bound.colorCodes.size(); code++) {
+            const String& entryColor = entries.getColorName((uint16_t)code);
+            bound.colorCodes[code] = TrigramIndex::containsIgnoreCase(entryColor.c_str(), entryColor.length(),
+                                                                       filter.color.colorName);
+        }
+    }
+    
+    if (filter.type == FILTER_SHIRT_COLOR_NEAR || filter.type == FILTER_PANTS_COLOR_NEAR || filter.type == FILTER_SHOES_COLOR_NEAR) {
+        bound.colorCodes.resize(entries.getColorCodeCount());
+        for (size_t code = 0; code < bound.colorCodes.size(); code++) {
+            const String& name = entries.getColorName((uint16_t)code);
+            bound.colorCodes[code] = !name.isEmpty() && name != "Unknown";
+        }
+        bound.target = ColorLab::fromRgb(filter.nearColor.rgb);
+    }
+    
+    return bound;
+}
+
+bool SearchEngine::matches(const EntryTable& entries, uint32_t position, const ColumnFilter& filter) {
+    switch (filter.filter.type) {
+        case FILTER_DATE_RANGE: {
+            time_t timestamp = entries.getTimestamp(position);
+            return timestamp >= filter.filter.dateRange.startTime && timestamp <= filter.filter.dateRange.endTime;
+        }
+        case FILTER_GENDER:
+            return entries.getGender(position) == filter.filter.gender;
+        case FILTER_SHIRT_COLOR:
+        case FILTER_PANTS_COLOR:
+        case FILTER_SHOES_COLOR: {
+            uint16_t code = entries.getColorCode(colorAttribute(filter.filter.type), position);
+            return code < filter.colorCodes.size() && filter.colorCodes[code];
+        }
+        case FILTER_ITEM_TYPE:
+            return entries.getItemType(position) == filter.filter.itemType;
+        case FILTER_TEXT:
+            return TrigramIndex::matches(entries, position, filter.filter.textSearch.text);
+        case FILTER_SHIRT_COLOR_NEAR:
+        case FILTER_PANTS_COLOR_NEAR:
+        case FILTER_SHOES_COLOR_NEAR: {
+            IndexedColor attribute = colorAttribute(filter.filter.type);
+            uint16_t code = entries.getColorCode(attribute, position);
+            return code < filter.colorCodes.size() && filter.colorCodes[code] &&
+                   ColorLab::distance(ColorLab::fromRgb(entries.getColorRgb(attribute, position)), filter.target) <=
+                       filter.filter.nearColor.maxDistance;
+        }
+    }
+    
+    return false;
+}
+
+void SearchEngine::narrow(const EntryTable& entries, const ColumnFilter& filter, std::vector<uint32_t>& positions) {
+    // The filter type is settled once, so each loop reads a single column
+    switch (filter.filter.type) {
+        case FILTER_DATE_RANGE: {
+            time_t startTime = filter.filter.dateRange.startTime;
+            time_t endTime = filter.filter.dateRange.endTime;
+            keepIf(positions, [&](uint32_t position) {
+                time_t timestamp = entries.getTimestamp(position);
+                return timestamp >= startTime && timestamp <= endTime;
+            });
+            break;
+        }
+        case FILTER_GENDER: {
+            Gender gender = filter.filter.gender;
+            keepIf(positions, [&](uint32_t position) {
+                return entries.getGender(position) == gender;
+            });
+            break;
+        }
+        case FILTER_SHIRT_COLOR:
+        case FILTER_PANTS_COLOR:
+        case FILTER_SHOES_COLOR: {
+            IndexedColor attribute = colorAttribute(filter.filter.type);
+            keepIf(positions, [&](uint32_t position) {
+                uint16_t code = entries.getColorCode(attribute, position);
+                return code < filter.colorCodes.size() && filter.colorCodes[code];
+            });
+            break;
+        }
+        case FILTER_ITEM_TYPE: {
+            ItemType itemType = filter.filter.itemType;
+            keepIf(positions, [&](uint32_t position) {
+                return entries.getItemType(position) == itemType;
+            });
+            break;
+        }
+        case FILTER_TEXT:
+            keepIf(positions, [&](uint32_t position) {
+                return TrigramIndex::matches(entries, position, filter.filter.textSearch.text);
+            });
+            break;
+        case FILTER_SHIRT_COLOR_NEAR:
+        case FILTER_PANTS_COLOR_NEAR:
+        case FILTER_SHOES_COLOR_NEAR:
+            narrowColorNear(entries, filter, positions);
+            break;
+    }
+}
+
+void SearchEngine::narrowColorNear(const EntryTable& entries, const ColumnFilter& filter, std::vector<uint32_t>& positions) {
+    // Converted a batch at a time into separate L, a and b arrays, then
+    // measured with the batch kernel
+    const size_t BATCH = 32;
+    float l[BATCH];
+    float a[BATCH];
+    float b[BATCH];
+    uint32_t matches[BATCH];
+    
+    IndexedColor attribute = colorAttribute(filter.filter.type);
+    size_t kept = 0;
+    for (size_t first = 0; first < positions.size(); first += BATCH) {
+        size_t count = std::min(BATCH, positions.size() - first);
+        for (size_t i = 0; i < count; i++) {
+            LabColor color = ColorLab::fromRgb(entries.getColorRgb(attribute, positions[first + i]));
+            l[i] = color.l;
+            a[i] = color.a;
+            b[i] = color.b;
+        }
+        
+        size_t found = ColorLab::findWithin(l, a, b, count, filter.target, filter.filter.nearColor.maxDistance, matches);
+        for (size_t i = 0; i < found; i++) {
+            uint32_t position = positions[first + matches[i]];
+            uint16_t code = entries.getColorCode(attribute, position);
+            if (code < filter.colorCodes.size() && filter.colorCodes[code]) {
+                positions[kept++] = position;
+            }
+        }
+    }
+    positions.resize(kept);
+}
+
+IndexedColor SearchEngine::colorAttribute(FilterType type) {
+    switch (type) {
+        case FILTER_PANTS_COLOR:
+        case FILTER_PANTS_COLOR_NEAR:
+            return INDEX_COLOR_PANTS;
+        case FILTER_SHOES_COLOR:
+        case FILTER_SHOES_COLOR_NEAR:
+            return INDEX_COLOR_SHOES;
+        default:
+            return INDEX_COLOR_SHIRT;
+    }
+}
+
 // Filter functions
 bool SearchEngine::filterByDateRange(const LogEntry& entry, time_t startTime, time_t endTime) {
     time_t timestamp = entry.getTimestamp();
@@ -160,33 +383,18 @@ bool SearchEngine::filterByGender(const LogEntry& entry, Gender gender) {
 }
 
 bool SearchEngine::filterByShirtColor(const LogEntry& entry, const String& colorName) {
-    String entryColor = entry.getShirtColor().name;
-    entryColor.toLowerCase();
-    
-    String searchColor = colorName;
-    searchColor.toLowerCase();
-    
-    return entryColor.indexOf(searchColor) >= 0;
+    const ColorName& entryColor = entry.getShirtColor().name;
+    return TrigramIndex::containsIgnoreCase(entryColor.c_str(), entryColor.length(), colorName);
 }
 
 bool SearchEngine::filterByPantsColor(const LogEntry& entry, const String& colorName) {
-    String entryColor = entry.getPantsColor().name;
-    entryColor.toLowerCase();
-    
-    String searchColor = colorName;
-    searchColor.toLowerCase();
-    
-    return entryColor.indexOf(searchColor) >= 0;
+    const ColorName& entryColor = entry.getPantsColor().name;
+    return TrigramIndex::containsIgnoreCase(entryColor.c_str(), entryColor.length(), colorName);
 }
 
 bool SearchEngine::filterByShoesColor(const LogEntry& entry, const String& colorName) {
-    String entryColor = entry.getShoesColor().name;
-    entryColor.toLowerCase();
-    
-    String searchColor = colorName;
-    searchColor.toLowerCase();
-    
-    return entryColor.indexOf(searchColor) >= 0;
+    const ColorName& entryColor = entry.getShoesColor().name;
+    return TrigramIndex::containsIgnoreCase(entryColor.c_str(), entryColor.length(), colorName);
 }
 
 bool SearchEngine::filterByItemType(const LogEntry& entry, ItemType itemType) {
@@ -194,47 +402,9 @@ bool SearchEngine::filterByItemType(const LogEntry& entry, ItemType itemType) {
 }
 
 bool SearchEngine::filterByText(const LogEntry& entry, const String& text) {
-    if (text.isEmpty()) {
-        return true;
-    }
-    
-    String searchText = text;
-    searchText.toLowerCase();
-    
-    // Search in item description
-    String desc = entry.getItemDescription();
-    desc.toLowerCase();
-    if (desc.indexOf(searchText) >= 0) {
-        return true;
-    }
-    
-    // Search in notes
-    String notes = entry.getNotes();
-    notes.toLowerCase();
-    if (notes.indexOf(searchText) >= 0) {
-        return true;
-    }
-    
-    // Search in shirt color
-    String shirtColor = entry.getShirtColor().name;
-    shirtColor.toLowerCase();
-    if (shirtColor.indexOf(searchText) >= 0) {
-        return true;
-    }
-    
-    // Search in pants color
-    String pantsColor = entry.getPantsColor().name;
-    pantsColor.toLowerCase();
-    if (pantsColor.indexOf(searchText) >= 0) {
-        return true;
-    }
-    
-    // Search in shoes color
-    String shoesColor = entry.getShoesColor().name;
-    shoesColor.toLowerCase();
-    if (shoesColor.indexOf(searchText) >= 0) {
-        return true;
-    }
-    
-    return false;
+    return TrigramIndex::matches(entry, text);
+}
+
+bool SearchEngine::filterByColorNear(const Color& color, const LabColor& target, float maxDistance) {
+    return color.isRecorded() && ColorLab::distance(ColorLab::fromRgb(color.rgb), target) <= maxDistance;
 }
@@ -12,6 +12,9 @@
 #include <vector>
 #include <functional>
 #include "log_entry.h"
+#include "entry_table.h"
+#include "result_set.h"
+#include "color_lab.h"
 #include "../config.h"
 
 // Search filter type
@@ -22,7 +25,10 @@ enum FilterType {
     FILTER_PANTS_COLOR,
     FILTER_SHOES_COLOR,
     FILTER_ITEM_TYPE,
-    FILTER_TEXT
+    FILTER_TEXT,
+    FILTER_SHIRT_COLOR_NEAR,
+    FILTER_PANTS_COLOR_NEAR,
+    FILTER_SHOES_COLOR_NEAR
 };
 
 // Search filter class
@@ -30,25 +36,29 @@ class SearchFilter {
 public:
     FilterType type;
     
-    // Filter parameters
-    union {
-        struct {
-            time_t startTime;
-            time_t endTime;
-        } dateRange;
-        
-        Gender gender;
-        
-        struct {
-            String colorName;
-        } color;
-        
-        ItemType itemType;
-        
-        struct {
-            String text;
-        } textSearch;
-    };
+    // Filter parameters, only the ones matching the type are used
+    struct {
+        time_t startTime;
+        time_t endTime;
+    } dateRange;
+    
+    Gender gender;
+    
+    struct {
+        String colorName;
+    } color;
+    
+    // Recorded RGB color within a CIELAB distance of a target
+    struct {
+        uint32_t rgb;
+        float maxDistance;
+    } nearColor;
+    
+    ItemType itemType;
+    
+    struct {
+        String text;
+    } textSearch;
     
     // Constructors for different filter types
     static SearchFilter createDateRangeFilter(time_t startTime, time_t endTime);
@@ -56,10 +66,23 @@ public:
     static SearchFilter createShirtColorFilter(const String& colorName);
     static SearchFilter createPantsColorFilter(const String& colorName);
     static SearchFilter createShoesColorFilter(const String& colorName);
+    static SearchFilter createShirtColorNearFilter(uint32_t rgb, float maxDistance = COLOR_NEAR_DISTANCE);
+    static SearchFilter createPantsColorNearFilter(uint32_t rgb, float maxDistance = COLOR_NEAR_DISTANCE);
+    static SearchFilter createShoesColorNearFilter(uint32_t rgb, float maxDistance = COLOR_NEAR_DISTANCE);
     static SearchFilter createItemTypeFilter(ItemType itemType);
     static SearchFilter createTextFilter(const String& text);
 };
 
+// Search filter bound to the database's entry columns. Color filters are
+// resolved against the color dictionary once, so checking an entry is a
+// lookup by its color code; for near color filters the codes mark the
+// colors that were recorded, and the target is converted to CIELAB once
+struct ColumnFilter {
+    SearchFilter filter;
+    std::vector<bool> colorCodes;
+    LabColor target;
+};
+
 class SearchEngine {
 public:
     /**
@@ -84,6 +107,22 @@ public:
      */
     static std::vector<LogEntry> searchMultiple(const std::vector<LogEntry>& entries, const std::vector<SearchFilter>& filters);
     
+    /**
+     * Search the database with multiple filters (AND logic), planned by
+     * QueryPlanner. No entry is copied
+     * @param filters vector of search filters to apply
+     * @return matching entries in database order
+     */
+    static ResultSet select(const std::vector<SearchFilter>& filters);
+    
+    /**
+     * Narrow a result set with multiple filters (AND logic)
+     * @param results result set to filter
+     * @param filters vector of search filters to apply
+     * @return matching entries in the order of the input result set
+     */
+    static ResultSet filter(const ResultSet& results, const std::vector<SearchFilter>& filters);
+    
     /**
      * Sort entries by timestamp (newest first)
      * @param entries vector of entries to sort
@@ -107,6 +146,41 @@ public:
     static std::vector<LogEntry> sortCustom(const std::vector<LogEntry>& entries, 
                                            std::function<bool(const LogEntry&, const LogEntry&)> comparator);
 
+    /**
+     * Check an entry against one filter
+     * @param entry entry to check
+     * @param filter filter to apply
+     * @return true if the entry matches, false otherwise
+     */
+    static bool matches(const LogEntry& entry, const SearchFilter& filter);
+    
+    /**
+     * Bind a filter to the entry columns for repeated checks
+     * @param entries entry table the filter will check
+     * @param filter filter to bind
+     * @return bound filter, valid until the table is next modified
+     */
+    static ColumnFilter bind(const EntryTable& entries, const SearchFilter& filter);
+    
+    /**
+     * Check a stored entry against one bound filter, reading only the
+     * columns the filter needs
+     * @param entries entry table the filter was bound to
+     * @param position entry position
+     * @param filter bound filter
+     * @return true if the entry matches, false otherwise
+     */
+    static bool matches(const EntryTable& entries, uint32_t position, const ColumnFilter& filter);
+    
+    /**
+     * Keep only the positions whose entries match one bound filter. The
+     * filter's column is scanned in one pass, without a check per entry
+     * @param entries entry table the filter was bound to
+     * @param filter bound filter
+     * @param positions positions to narrow, order is kept
+     */
+    static void narrow(const EntryTable& entries, const ColumnFilter& filter, std::vector<uint32_t>& positions);
+
 private:
     static bool _initialized;
     
@@ -118,6 +192,9 @@ private:
     static bool filterByShoesColor(const LogEntry& entry, const String& colorName);
     static bool filterByItemType(const LogEntry& entry, ItemType itemType);
     static bool filterByText(const LogEntry& entry, const String& text);
+    static bool filterByColorNear(const Color& color, const LabColor& target, float maxDistance);
+    static void narrowColorNear(const EntryTable& entries, const ColumnFilter& filter, std::vector<uint32_t>& positions);
+    static IndexedColor colorAttribute(FilterType type);
 };
 
 #endif // DATA_SEARCH_H
@@ -6,17 +6,23 @@
  */
 
 #include "search_screen.h"
+#include "log_detail_screen.h"
 #include "../ui_manager.h"
 #include "../components/status_bar.h"
 #include "../../data/database.h"
 #include "../../data/log_entry.h"
+#include "../../data/query_planner.h"
+#include "../../data/sync.h"
 #include "../../app/app_controller.h"
+#include <algorithm>
+#include <limits>
 
 // Static member initialization
 lv_obj_t* SearchScreen::_searchInput = nullptr;
 lv_obj_t* SearchScreen::_resultsList = nullptr;
 lv_obj_t* SearchScreen::_dateFilterDropdown = nullptr;
 lv_obj_t* SearchScreen::_itemFilterDropdown = nullptr;
+std::vector<uint64_t> SearchScreen::_resultIds;
 
 lv_obj_t* SearchScreen::create() {
     DEBUG_PRINTLN("Creating search screen...");
@@ -126,7 +132,7 @@ lv_obj_t* SearchScreen::create() {
     lv_label_set_text(itemLabel, "Item:");
     
     _itemFilterDropdown = lv_dropdown_create(filterContainer);
-    lv_dropdown_set_options(_itemFilterDropdown, "All Items\nShirt\nPants\nShoes\nHat\nJacket");
+    lv_dropdown_set_options(_itemFilterDropdown, "All Items\nClothing\nElectronics\nCosmetics\nAccessories\nFood\nOther");
     lv_obj_set_size(_itemFilterDropdown, 120, 40);
     lv_obj_add_event_cb(_itemFilterDropdown, _itemFilterEventHandler, LV_EVENT_VALUE_CHANGED, nullptr);
     
@@ -138,6 +144,7 @@ lv_obj_t* SearchScreen::create() {
     lv_obj_set_style_border_width(_resultsList, 0, 0);
     lv_obj_set_style_radius(_resultsList, 10, 0);
     lv_obj_set_style_pad_all(_resultsList, 10, 0);
+    _resultIds.clear();
     
     // Add initial message
     lv_obj_t* initialMsg = lv_label_create(_resultsList);
@@ -208,6 +215,7 @@ void SearchScreen::_clearButtonClickHandler(lv_event_t* e) {
     // Clear results
     if (_resultsList) {
         lv_obj_clean(_resultsList);
+        _resultIds.clear();
         
         // Add initial message
         lv_obj_t* initialMsg = lv_label_create(_resultsList);
@@ -238,11 +246,15 @@ void SearchScreen::_itemFilterEventHandler(lv_event_t* e) {
 
 void SearchScreen::_resultItemClickHandler(lv_event_t* e) {
     lv_obj_t* btn = lv_event_get_target(e);
-    int index = (int)lv_obj_get_user_data(btn);
-    DEBUG_PRINTF("Result item clicked: %d\n", index);
+    uint32_t row = lv_obj_get_index(btn);
+    if (row >= _resultIds.size()) {
+        return;
+    }
+    uint64_t id = _resultIds[row];
+    DEBUG_PRINTF("Result item clicked: %llu\n", (unsigned long long)id);
     
     // Navigate to log detail screen
-    LogDetailScreen::setLogIndex(index);
+    LogDetailScreen::setLogId(id);
     UIManager::setScreen(SCREEN_LOG_DETAIL);
 }
 
@@ -255,9 +267,10 @@ void SearchScreen::_displaySearchResults(const char* query, int dateFilter, int
     
     // Clear list
     lv_obj_clean(_resultsList);
+    _resultIds.clear();
     
-    // Check if query is empty
-    if (strlen(query) == 0) {
+    // Check if there is anything to search for
+    if (strlen(query) == 0 && dateFilter == 0 && itemFilter == 0) {
         lv_obj_t* noQueryMsg = lv_label_create(_resultsList);
         lv_obj_set_style_text_font(noQueryMsg, &lv_font_montserrat_16, 0);
         lv_obj_set_style_text_color(noQueryMsg, lv_color_hex(0x999999), 0);
@@ -266,71 +279,92 @@ void SearchScreen::_displaySearchResults(const char* query, int dateFilter, int
         return;
     }
     
-    // In a real implementation, this would search the database
-    // For now, we'll create some sample results
+    // Build filters, the planner decides the order they run in
+    std::vector<SearchFilter> filters;
+    time_t startTime = std::numeric_limits<time_t>::min();
+    time_t endTime = std::numeric_limits<time_t>::max();
+    
+    if (strlen(query) > 0) {
+        filters.push_back(SearchFilter::createTextFilter(String(query)));
+    }
+    
+    if (dateFilter > 0) {
+        // Days are divided as the stats divide them
+        const int days[] = {0, 1, 7, 30};
+        endTime = Database::getWindowTime();
+        startTime = EntryStats::getDayStart(endTime) - (time_t)(days[dateFilter] - 1) * 86400;
+        filters.push_back(SearchFilter::createDateRangeFilter(startTime, endTime));
+    }
+    
+    if (itemFilter > 0) {
+        filters.push_back(SearchFilter::createItemTypeFilter((ItemType)itemFilter));
+    }
     
-    // Sample search results
-    const int maxResults = 10;
+    std::vector<uint32_t> positions;
+    QueryPlan plan = QueryPlanner::search(filters, positions);
+#ifdef QUERY_PLAN_DEBUG
+    // Building the description costs more than some searches, so it is
+    // only compiled in with -D QUERY_PLAN_DEBUG
+    DEBUG_PRINT(plan.explain());
+#endif
+    
+    // Show the newest matches first
+    const int maxResults = 50;
     int numResults = 0;
     
-    // Convert query to lowercase for case-insensitive search
-    String queryLower = String(query);
-    queryLower.toLowerCase();
-    
-    // Sample data
-    const char* genders[] = {"Male", "Female"};
-    const char* colors[] = {"Red", "Blue", "Green", "Black", "White"};
-    const char* items[] = {"Shirt", "Pants", "Shoes", "Hat", "Jacket"};
-    
-    for (int i = 0; i < maxResults; i++) {
-        // Generate sample data
-        int genderIndex = i % 2;
-        int shirtColorIndex = i % 5;
-        int pantsColorIndex = (i + 2) % 5;
-        int itemIndex = i % 5;
-        
-        // Skip if item filter doesn't match
-        if (itemFilter > 0 && itemFilter - 1 != itemIndex) {
-            continue;
-        }
-        
+    const char* genders[] = {"Unknown", "Male", "Female", "Other"};
+    const char* items[] = {"Unknown", "Clothing", "Electronics", "Cosmetics", "Accessories", "Food", "Other"};
+    
+    // Entries still waiting to sync are matched by ID, as the logs screen does
+    const EntryTable& entries = Database::getEntries();
+    std::vector<uint64_t> pendingIds;
+    SyncManager::getPendingSyncIds(pendingIds);
+    
+    // The index only covers entries in memory. When they leave room, the
+    // archive is scanned too, keeping only its newest matches
+    std::vector<LogEntry> archived;
+    size_t archivedWanted = positions.size() < (size_t)maxResults ? maxResults - positions.size() : 0;
+    if (archivedWanted > 0) {
+        Database::forEachArchivedEntry(startTime, endTime, [&filters, &archived, archivedWanted](const LogEntry& entry) {
+            for (const SearchFilter& filter : filters) {
+                if (!SearchEngine::matches(entry, filter)) {
+                    return true;
+                }
+            }
+            archived.push_back(entry);
+            if (archived.size() > archivedWanted) {
+                archived.erase(archived.begin());
+            }
+            return true;
+        });
+    }
+    
+    LogEntry entry((time_t)0);
+    for (size_t i = 0; i < positions.size() + archived.size() && numResults < maxResults; i++) {
         char title[32];
-        char description[64];
-        char timestamp[32];
+        char description[128];
         
-        snprintf(title, sizeof(title), "Log #%d", i + 1);
+        // Archived entries are older than any in memory, and have no place to number them by
+        if (i < positions.size()) {
+            uint32_t position = positions[positions.size() - 1 - i];
+            entries.get(position, entry);
+            snprintf(title, sizeof(title), "Log #%u", (unsigned)(position + 1));
+        } else {
+            entry = archived[archived.size() - 1 - (i - positions.size())];
+            snprintf(title, sizeof(title), "Archived log");
+        }
         
         snprintf(description, sizeof(description), "%s, %s shirt, %s pants, %s", 
-                genders[genderIndex], 
-                colors[shirtColorIndex], 
-                colors[pantsColorIndex], 
-                items[itemIndex]);
+                genders[entry.getGender() <= GENDER_OTHER ? entry.getGender() : GENDER_UNKNOWN], 
+                entry.getShirtColor().name.c_str(), 
+                entry.getPantsColor().name.c_str(), 
+                items[entry.getItemType() <= ITEM_OTHER ? entry.getItemType() : ITEM_UNKNOWN]);
         
-        // Generate timestamp (today - i days)
-        time_t now = time(nullptr);
-        struct tm* timeinfo = localtime(&now);
-        timeinfo->tm_mday -= i;
-        mktime(timeinfo);
-        strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M", timeinfo);
+        String timestamp = entry.getFormattedTimestamp("%Y-%m-%d %H:%M");
         
-        // Skip if date filter doesn't match
-        if (dateFilter == 1 && i > 0) { // Today
-            continue;
-        } else if (dateFilter == 2 && i >= 7) { // Last 7 days
-            continue;
-        } else if (dateFilter == 3 && i >= 30) { // Last 30 days
-            continue;
-        }
-        
-        // Check if this result matches the search query
-        String descLower = String(description);
-        descLower.toLowerCase();
-        
-        if (descLower.indexOf(queryLower) >= 0) {
-            // Create result item
-            _createResultItem(_resultsList, title, description, timestamp, (i % 3 != 0), i);
-            numResults++;
-        }
+        _createResultItem(_resultsList, title, description, timestamp.c_str(), !std::binary_search(pendingIds.begin(), pendingIds.end(), entry.getId()));
+        _resultIds.push_back(entry.getId());
+        numResults++;
     }
     
     // Show no results message if needed
@@ -344,7 +378,7 @@ void SearchScreen::_displaySearchResults(const char* query, int dateFilter, int
 }
 
 void SearchScreen::_createResultItem(lv_obj_t* parent, const char* title, const char* description, 
-                                const char* timestamp, bool synced, int index) {
+                                const char* timestamp, bool synced) {
     // Create list button
     lv_obj_t* btn = lv_list_add_btn(parent, nullptr, "");
     lv_obj_set_style_bg_color(btn, lv_color_hex(0x404040), 0);
@@ -354,9 +388,6 @@ void SearchScreen::_createResultItem(lv_obj_t* parent, const char* title, const
     lv_obj_set_height(btn, 80);
     lv_obj_add_event_cb(btn, _resultItemClickHandler, LV_EVENT_CLICKED, nullptr);
     
-    // Store index as user data
-    lv_obj_set_user_data(btn, (void*)(intptr_t)index);
-    
     // Create container for content
     lv_obj_t* container = lv_obj_create(btn);
     lv_obj_set_size(container, lv_pct(100), lv_pct(100));
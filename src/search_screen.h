@@ -11,6 +11,7 @@
 
 #include <Arduino.h>
 #include <lvgl.h>
+#include <vector>
 #include "../config.h"
 
 class SearchScreen {
@@ -38,6 +39,9 @@ private:
     static lv_obj_t* _dateFilterDropdown;
     static lv_obj_t* _itemFilterDropdown;
     
+    // IDs of the entries in the result rows, in list order
+    static std::vector<uint64_t> _resultIds;
+    
     // Event handlers
     static void _backButtonClickHandler(lv_event_t* e);
     static void _searchButtonClickHandler(lv_event_t* e);
@@ -49,7 +53,7 @@ private:
     // Helper methods
     static void _displaySearchResults(const char* query, int dateFilter, int itemFilter);
     static void _createResultItem(lv_obj_t* parent, const char* title, const char* description, 
-                                const char* timestamp, bool synced, int index);
+                                const char* timestamp, bool synced);
 };
 
 #endif // UI_SEARCH_SCREEN_H
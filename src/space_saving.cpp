@@ -0,0 +1,127 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Space-Saving Counter Implementation
+ */
+
+#include "space_saving.h"
+#include <algorithm>
+
+SpaceSaving::SpaceSaving(size_t capacity) : _capacity(std::min(std::max(capacity, (size_t)1), (size_t)UINT16_MAX)), _dropped(0) {
+}
+
+void SpaceSaving::clear() {
+    _dropped = 0;
+    _items.clear();
+    _keys.clear();
+    _heap.clear();
+    _heapSlots.clear();
+}
+
+void SpaceSaving::add(uint64_t key, const char* label) {
+    size_t index = find(key);
+    if (index < _items.size()) {
+        _items[index].count++;
+        siftDown(_heapSlots[index]);
+        return;
+    }
+    
+    if (_items.size() < _capacity) {
+        // Reserved in full on first use, so the counters never reallocate
+        if (_items.empty()) {
+            _items.reserve(_capacity);
+            _keys.reserve(_capacity);
+            _heap.reserve(_capacity);
+            _heapSlots.reserve(_capacity);
+        }
+        
+        SpaceSavingItem item;
+        item.key = key;
+        item.count = 1;
+        item.error = 0;
+        item.label = label;
+        _items.push_back(item);
+        _keys.push_back(key);
+        _heap.push_back((uint16_t)(_items.size() - 1));
+        _heapSlots.push_back((uint16_t)(_heap.size() - 1));
+        siftUp(_heap.size() - 1);
+        return;
+    }
+    
+    // Replace the least counted key. The new one may have occurred as often
+    // as any key dropped so far, which after removals can be more than the
+    // lowest count now
+    SpaceSavingItem& item = _items[_heap[0]];
+    _dropped = std::max(_dropped, item.count);
+    item.key = key;
+    item.error = _dropped;
+    item.count = _dropped + 1;
+    item.label = label;
+    _keys[_heap[0]] = key;
+    siftDown(0);
+}
+
+void SpaceSaving::remove(uint64_t key) {
+    size_t index = find(key);
+    if (index >= _items.size() || _items[index].count == 0) {
+        return;
+    }
+    
+    SpaceSavingItem& item = _items[index];
+    item.count--;
+    item.error = std::min(item.error, item.count);
+    siftUp(_heapSlots[index]);
+}
+
+size_t SpaceSaving::find(uint64_t key) const {
+    for (size_t i = 0; i < _keys.size(); i++) {
+        if (_keys[i] == key) {
+            return i;
+        }
+    }
+    return _keys.size();
+}
+
+uint32_t SpaceSaving::getUnmonitoredBound() const {
+    return _dropped;
+}
+
+size_t SpaceSaving::getMemoryUsage() const {
+    return _items.capacity() * sizeof(SpaceSavingItem) + _keys.capacity() * sizeof(uint64_t) +
+           (_heap.capacity() + _heapSlots.capacity()) * sizeof(uint16_t);
+}
+
+void SpaceSaving::siftUp(size_t slot) {
+    while (slot > 0) {
+        size_t parent = (slot - 1) / 2;
+        if (_items[_heap[parent]].count <= _items[_heap[slot]].count) {
+            break;
+        }
+        swapSlots(slot, parent);
+        slot = parent;
+    }
+}
+
+void SpaceSaving::siftDown(size_t slot) {
+    for (;;) {
+        size_t smallest = slot;
+        size_t left = slot * 2 + 1;
+        size_t right = left + 1;
+        if (left < _heap.size() && _items[_heap[left]].count < _items[_heap[smallest]].count) {
+            smallest = left;
+        }
+        if (right < _heap.size() && _items[_heap[right]].count < _items[_heap[smallest]].count) {
+            smallest = right;
+        }
+        if (smallest == slot) {
+            return;
+        }
+        swapSlots(slot, smallest);
+        slot = smallest;
+    }
+}
+
+void SpaceSaving::swapSlots(size_t a, size_t b) {
+    std::swap(_heap[a], _heap[b]);
+    _heapSlots[_heap[a]] = (uint16_t)a;
+    _heapSlots[_heap[b]] = (uint16_t)b;
+}
@@ -0,0 +1,112 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Space-Saving Counter
+ * 
+ * This file contains the bounded counter of the most frequent keys in a
+ * stream, used for entry trends
+ */
+
+#ifndef DATA_SPACE_SAVING_H
+#define DATA_SPACE_SAVING_H
+
+#include <Arduino.h>
+#include <vector>
+#include "inline_string.h"
+#include "../config.h"
+
+typedef InlineString<TRENDS_LABEL_LENGTH> TrendLabel;
+
+// A monitored key: its count may overstate the true one by up to error
+struct SpaceSavingItem {
+    uint64_t key;
+    uint32_t count;
+    uint32_t error;
+    TrendLabel label;
+};
+
+/**
+ * Space-Saving summary of a stream of keys with a fixed number of counters.
+ * A key not yet monitored takes over the counter with the lowest count once
+ * all are in use, inheriting that count as its error. Any key seen more
+ * often than the stream length over the capacity is guaranteed a counter.
+ * Counters are kept in a min-heap by count, and keys are found by scanning
+ * a flat key array, which for a few dozen counters beats hashing
+ */
+class SpaceSaving {
+public:
+    /**
+     * Constructor
+     * @param capacity number of counters
+     */
+    SpaceSaving(size_t capacity = TRENDS_COUNTERS);
+    
+    /**
+     * Remove all counters
+     */
+    void clear();
+    
+    /**
+     * Count one occurrence of a key
+     * @param key key hash
+     * @param label text shown for the key, kept from its first occurrence
+     */
+    void add(uint64_t key, const char* label);
+    
+    /**
+     * Take back one occurrence of a key, if it is monitored
+     * @param key key hash
+     */
+    void remove(uint64_t key);
+    
+    /**
+     * Get the number of counters in use
+     * @return number of monitored keys
+     */
+    size_t size() const {
+        return _items.size();
+    }
+    
+    /**
+     * Get a monitored key, in no particular order
+     * @param index counter index, below size()
+     * @return monitored key
+     */
+    const SpaceSavingItem& get(size_t index) const {
+        return _items[index];
+    }
+    
+    /**
+     * Look up a monitored key
+     * @param key key hash
+     * @return counter index, or size() if the key is not monitored
+     */
+    size_t find(uint64_t key) const;
+    
+    /**
+     * Get the most a key without a counter can have occurred
+     * @return highest count a dropped key had, 0 if none was dropped
+     */
+    uint32_t getUnmonitoredBound() const;
+    
+    /**
+     * Get the heap memory used by the summary
+     * @return bytes used
+     */
+    size_t getMemoryUsage() const;
+
+private:
+    size_t _capacity;
+    uint32_t _dropped;
+    std::vector<SpaceSavingItem> _items;
+    std::vector<uint64_t> _keys;
+    
+    // Min-heap of counter indices by count, and each counter's heap slot
+    std::vector<uint16_t> _heap;
+    std::vector<uint16_t> _heapSlots;
+    
+    void siftUp(size_t slot);
+    void siftDown(size_t slot);
+    void swapSlots(size_t a, size_t b);
+};
+
+#endif // DATA_SPACE_SAVING_H
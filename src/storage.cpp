@@ -4,6 +4,13 @@
  */
 
 #include "storage.h"
+#include <algorithm>
+#include <vector>
+
+// Footer written by writeFileAtomic: uint32 content length, uint32 CRC-32 of
+// the content, then a magic value so a file without a footer is recognised
+static const uint8_t STORAGE_FOOTER_MAGIC[4] = {'L', 'P', 'F', 'T'};
+static const size_t STORAGE_FOOTER_SIZE = 12;
 
 // Static member initialization
 bool StorageHAL::_initialized = false;
@@ -138,6 +145,20 @@ bool StorageHAL::deleteFile(const char* path) {
     }
 }
 
+bool StorageHAL::renameFile(const char* fromPath, const char* toPath) {
+    if (!_initialized) return false;
+    
+    acquireSPIBus();
+    
+    if (SD.rename(fromPath, toPath)) {
+        DEBUG_PRINTF("File renamed: %s -> %s\n", fromPath, toPath);
+        return true;
+    } else {
+        DEBUG_PRINTF("Failed to rename file: %s -> %s\n", fromPath, toPath);
+        return false;
+    }
+}
+
 bool StorageHAL::fileExists(const char* path) {
     if (!_initialized) return false;
     
@@ -243,36 +264,232 @@ bool StorageHAL::backupFile(const char* sourcePath, const char* backupDir) {
     }
     backupPath += fileName + "." + String(timestamp);
     
-    // Copy file
+    if (!copyFile(sourcePath, backupPath.c_str())) {
+        return false;
+    }
+    
+    DEBUG_PRINTF("File backed up: %s -> %s\n", sourcePath, backupPath.c_str());
+    return true;
+}
+
+bool StorageHAL::copyFile(const char* sourcePath, const char* destPath) {
+    if (!_initialized) return false;
+    
+    acquireSPIBus();
+    
     File sourceFile = SD.open(sourcePath, FILE_READ);
     if (!sourceFile) {
-        DEBUG_PRINTF("Failed to open source file for backup: %s\n", sourcePath);
+        DEBUG_PRINTF("Failed to open source file for copy: %s\n", sourcePath);
         return false;
     }
     
-    File backupFile = SD.open(backupPath.c_str(), FILE_WRITE);
-    if (!backupFile) {
-        DEBUG_PRINTF("Failed to create backup file: %s\n", backupPath.c_str());
+    File destFile = SD.open(destPath, FILE_WRITE);
+    if (!destFile) {
+        DEBUG_PRINTF("Failed to create copy destination: %s\n", destPath);
         sourceFile.close();
         return false;
     }
     
-    // Copy data in chunks
-    const size_t bufferSize = 512;
-    uint8_t buffer[bufferSize];
+    // Copy in buffer-sized chunks from the heap rather than the task stack
+    std::vector<uint8_t> buffer(STORAGE_READ_BUFFER_SIZE);
     size_t bytesRead;
+    bool success = true;
     
-    while ((bytesRead = sourceFile.read(buffer, bufferSize)) > 0) {
-        backupFile.write(buffer, bytesRead);
+    while ((bytesRead = sourceFile.read(buffer.data(), buffer.size())) > 0) {
+        if (destFile.write(buffer.data(), bytesRead) != bytesRead) {
+            DEBUG_PRINTF("Copy incomplete: %s\n", destPath);
+            success = false;
+            break;
+        }
     }
     
     sourceFile.close();
-    backupFile.close();
+    destFile.close();
+    return success;
+}
+
+bool StorageHAL::writeFileAtomic(const char* path, const char* buffer, size_t len) {
+    if (!_initialized) return false;
+    
+    String tempPath = getTempPath(path);
+    if (writeFile(tempPath.c_str(), buffer, len) != (int)len) {
+        DEBUG_PRINTF("Failed to write temporary file: %s\n", tempPath.c_str());
+        return false;
+    }
+    
+    if (!sealTempFile(path, len, crc32(buffer, len))) {
+        return false;
+    }
+    
+    return commitTempFile(path);
+}
+
+String StorageHAL::getTempPath(const char* path) {
+    return String(path) + STORAGE_TEMP_SUFFIX;
+}
+
+bool StorageHAL::sealTempFile(const char* path, size_t dataLength, uint32_t crc) {
+    uint8_t footer[STORAGE_FOOTER_SIZE];
+    for (size_t i = 0; i < 4; i++) {
+        footer[i] = (uint8_t)(dataLength >> (8 * i));
+        footer[4 + i] = (uint8_t)(crc >> (8 * i));
+    }
+    memcpy(footer + 8, STORAGE_FOOTER_MAGIC, sizeof(STORAGE_FOOTER_MAGIC));
+    
+    String tempPath = getTempPath(path);
+    if (appendFile(tempPath.c_str(), (const char*)footer, sizeof(footer)) != (int)sizeof(footer)) {
+        DEBUG_PRINTF("Failed to seal temporary file: %s\n", tempPath.c_str());
+        return false;
+    }
     
-    DEBUG_PRINTF("File backed up: %s -> %s\n", sourcePath, backupPath.c_str());
     return true;
 }
 
+bool StorageHAL::commitTempFile(const char* path) {
+    if (!_initialized) return false;
+    
+    acquireSPIBus();
+    
+    // FAT cannot rename over a file, so the old one goes first. The temporary
+    // file is complete by now, which is what recoverFile relies on
+    if (SD.exists(path) && !SD.remove(path)) {
+        DEBUG_PRINTF("Failed to remove file being replaced: %s\n", path);
+        return false;
+    }
+    
+    String tempPath = getTempPath(path);
+    return renameFile(tempPath.c_str(), path);
+}
+
+bool StorageHAL::recoverFile(const char* path) {
+    if (!_initialized) return false;
+    
+    String tempPath = getTempPath(path);
+    if (!fileExists(tempPath.c_str())) {
+        return true;
+    }
+    
+    if (fileExists(path)) {
+        // The old file is still there, so the write may have stopped part way
+        size_t dataLength;
+        uint32_t crc;
+        bool sealed = readFooter(tempPath.c_str(), dataLength, crc);
+        
+        if (sealed) {
+            StorageReader reader;
+            sealed = reader.open(tempPath.c_str(), dataLength);
+            reader.skipToEnd();
+            sealed = sealed && reader.getPosition() == dataLength && reader.getChecksum() == crc;
+        }
+        
+        if (!sealed) {
+            DEBUG_PRINTF("Discarding incomplete temporary file: %s\n", tempPath.c_str());
+            return deleteFile(tempPath.c_str());
+        }
+    }
+    
+    DEBUG_PRINTF("Completing interrupted replacement of %s\n", path);
+    return commitTempFile(path);
+}
+
+bool StorageHAL::readFooter(const char* path, size_t& dataLength, uint32_t& crc) {
+    if (!_initialized) return false;
+    
+    acquireSPIBus();
+    
+    File file = SD.open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    
+    uint8_t footer[STORAGE_FOOTER_SIZE];
+    size_t size = file.size();
+    bool found = size >= sizeof(footer) && file.seek(size - sizeof(footer)) &&
+                 file.read(footer, sizeof(footer)) == sizeof(footer);
+    file.close();
+    
+    if (!found || memcmp(footer + 8, STORAGE_FOOTER_MAGIC, sizeof(STORAGE_FOOTER_MAGIC)) != 0) {
+        return false;
+    }
+    
+    dataLength = 0;
+    crc = 0;
+    for (size_t i = 0; i < 4; i++) {
+        dataLength |= (size_t)footer[i] << (8 * i);
+        crc |= (uint32_t)footer[4 + i] << (8 * i);
+    }
+    
+    return dataLength == size - sizeof(footer);
+}
+
+bool StorageHAL::truncateFile(const char* path, size_t length) {
+    if (!_initialized) return false;
+    
+    acquireSPIBus();
+    
+    File sourceFile = SD.open(path, FILE_READ);
+    if (!sourceFile) {
+        DEBUG_PRINTF("Failed to open file for truncation: %s\n", path);
+        return false;
+    }
+    
+    String tempPath = getTempPath(path);
+    File destFile = SD.open(tempPath.c_str(), FILE_WRITE);
+    if (!destFile) {
+        DEBUG_PRINTF("Failed to create temporary file: %s\n", tempPath.c_str());
+        sourceFile.close();
+        return false;
+    }
+    
+    std::vector<uint8_t> buffer(STORAGE_READ_BUFFER_SIZE);
+    size_t remaining = length;
+    bool success = true;
+    
+    while (remaining > 0 && success) {
+        size_t bytesRead = sourceFile.read(buffer.data(), std::min(remaining, buffer.size()));
+        success = bytesRead > 0 && destFile.write(buffer.data(), bytesRead) == bytesRead;
+        remaining -= success ? bytesRead : 0;
+    }
+    
+    sourceFile.close();
+    destFile.close();
+    
+    if (!success) {
+        DEBUG_PRINTF("Failed to truncate file: %s\n", path);
+        deleteFile(tempPath.c_str());
+        return false;
+    }
+    
+    return commitTempFile(path);
+}
+
+uint32_t StorageHAL::crc32(const void* data, size_t len, uint32_t crc) {
+    // Nibble-wise table keeps flash usage small while avoiding a bit loop per byte
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    
+    const uint8_t* bytes = (const uint8_t*)data;
+    crc = ~crc;
+    
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ bytes[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (bytes[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    
+    return ~crc;
+}
+
+File StorageHAL::openFile(const char* path, const char* mode) {
+    if (!_initialized) return File();
+    
+    acquireSPIBus();
+    return SD.open(path, mode);
+}
+
 void StorageHAL::releaseSPIBus() {
     SPI.end();
 }
@@ -281,3 +498,184 @@ void StorageHAL::acquireSPIBus() {
     releaseSPIBus();
     SPI.begin(SD_SPI_SCK_PIN, SD_SPI_MISO_PIN, SD_SPI_MOSI_PIN, SD_SPI_CS_PIN);
 }
+
+// StorageReader implementation
+StorageReader::StorageReader() 
+    : _buffer(nullptr), _start(0), _end(0), _eof(true), _crc(0), _fetched(0), _remaining(0) {
+}
+
+StorageReader::~StorageReader() {
+    close();
+}
+
+bool StorageReader::open(const char* path, size_t length) {
+    close();
+    
+    _file = StorageHAL::openFile(path, FILE_READ);
+    if (!_file) {
+        DEBUG_PRINTF("Failed to open file for reading: %s\n", path);
+        return false;
+    }
+    
+    _buffer = new char[STORAGE_READ_BUFFER_SIZE];
+    _start = 0;
+    _end = 0;
+    _eof = false;
+    _crc = 0;
+    _fetched = 0;
+    _remaining = length;
+    return true;
+}
+
+void StorageReader::close() {
+    if (_file) {
+        _file.close();
+    }
+    
+    delete[] _buffer;
+    _buffer = nullptr;
+    _start = 0;
+    _end = 0;
+    _eof = true;
+}
+
+bool StorageReader::fill() {
+    if (_eof || !_buffer) {
+        return false;
+    }
+    
+    // Carry the unread tail over to the front of the buffer
+    if (_start > 0) {
+        memmove(_buffer, _buffer + _start, _end - _start);
+        _end -= _start;
+        _start = 0;
+    }
+    
+    if (_end == STORAGE_READ_BUFFER_SIZE) {
+        return false;
+    }
+    
+    size_t wanted = STORAGE_READ_BUFFER_SIZE - _end;
+    if (wanted > _remaining) {
+        wanted = _remaining;
+    }
+    
+    size_t bytesRead = wanted > 0 ? _file.read((uint8_t*)_buffer + _end, wanted) : 0;
+    if (bytesRead == 0) {
+        _eof = true;
+        return false;
+    }
+    
+    _crc = StorageHAL::crc32(_buffer + _end, bytesRead, _crc);
+    _end += bytesRead;
+    _fetched += bytesRead;
+    _remaining -= bytesRead;
+    return true;
+}
+
+bool StorageReader::readLine(const char*& line, size_t& len) {
+    if (!_buffer) {
+        return false;
+    }
+    
+    size_t scanned = _start;
+    bool skipping = false;
+    
+    while (true) {
+        char* newline = (char*)memchr(_buffer + scanned, '\n', _end - scanned);
+        
+        if (newline) {
+            size_t lineStart = _start;
+            _start = newline - _buffer + 1;
+            
+            if (skipping) {
+                skipping = false;
+                scanned = _start;
+                continue;
+            }
+            
+            line = _buffer + lineStart;
+            len = newline - line;
+            if (len > 0 && line[len - 1] == '\r') {
+                len--;
+            }
+            return true;
+        }
+        
+        size_t pending = _end - _start;
+        if (pending == STORAGE_READ_BUFFER_SIZE) {
+            // Line does not fit in the buffer, drop it and resync at the next newline
+            DEBUG_PRINT("Skipping line longer than read buffer");
+            skipping = true;
+            _start = _end;
+            pending = 0;
+        }
+        
+        if (!fill()) {
+            // Last line without a trailing newline
+            if (_start < _end && !skipping) {
+                line = _buffer + _start;
+                len = _end - _start;
+                _start = _end;
+                return true;
+            }
+            return false;
+        }
+        
+        scanned = _start + pending;
+    }
+}
+
+size_t StorageReader::read(void* buffer, size_t len) {
+    size_t copied = 0;
+    
+    while (copied < len) {
+        if (_start == _end && !fill()) {
+            break;
+        }
+        
+        size_t chunk = _end - _start;
+        if (chunk > len - copied) {
+            chunk = len - copied;
+        }
+        
+        memcpy((uint8_t*)buffer + copied, _buffer + _start, chunk);
+        _start += chunk;
+        copied += chunk;
+    }
+    
+    return copied;
+}
+
+const uint8_t* StorageReader::peek(size_t len) {
+    if (!_buffer || len > STORAGE_READ_BUFFER_SIZE) {
+        return nullptr;
+    }
+    
+    while (_end - _start < len) {
+        if (!fill()) {
+            return nullptr;
+        }
+    }
+    
+    return (const uint8_t*)_buffer + _start;
+}
+
+void StorageReader::skipToEnd() {
+    _start = _end;
+    while (fill()) {
+        _start = _end;
+    }
+}
+
+size_t StorageReader::getSize() {
+    return _file ? _file.size() : 0;
+}
+
+size_t StorageReader::getPosition() const {
+    return _fetched - (_end - _start);
+}
+
+uint32_t StorageReader::getChecksum() const {
+    return _crc;
+}
@@ -72,6 +72,14 @@ public:
      */
     static bool deleteFile(const char* path);
     
+    /**
+     * Rename file
+     * @param fromPath current file path
+     * @param toPath new file path, which must not exist
+     * @return true if successful, false otherwise
+     */
+    static bool renameFile(const char* fromPath, const char* toPath);
+    
     /**
      * Check if file exists
      * @param path file path
@@ -108,6 +116,94 @@ public:
      * @return true if successful, false otherwise
      */
     static bool backupFile(const char* sourcePath, const char* backupDir);
+    
+    /**
+     * Copy file
+     * @param sourcePath source file path
+     * @param destPath destination file path, replaced if it exists
+     * @return true if successful, false otherwise
+     */
+    static bool copyFile(const char* sourcePath, const char* destPath);
+    
+    /**
+     * Replace a file so that a power loss leaves either the old or the new
+     * contents. The content and a checksummed footer are written to the
+     * file's temporary path, which is then renamed over it
+     * @param path file path
+     * @param buffer content to write
+     * @param len length of content
+     * @return true if successful, false otherwise
+     */
+    static bool writeFileAtomic(const char* path, const char* buffer, size_t len);
+    
+    /**
+     * Get the temporary path a file is written to before replacing it
+     * @param path file path
+     * @return temporary file path
+     */
+    static String getTempPath(const char* path);
+    
+    /**
+     * Append the checksummed footer to a temporary file that was written in
+     * pieces, marking it complete
+     * @param path file path whose temporary file is sealed
+     * @param dataLength length of the content written
+     * @param crc CRC-32 of the content written
+     * @return true if successful, false otherwise
+     */
+    static bool sealTempFile(const char* path, size_t dataLength, uint32_t crc);
+    
+    /**
+     * Replace a file with its temporary file
+     * @param path file path
+     * @return true if successful, false otherwise
+     */
+    static bool commitTempFile(const char* path);
+    
+    /**
+     * Settle a replacement interrupted by a power loss. The temporary file is
+     * installed if it is sealed or the old file was already removed, and
+     * discarded otherwise. Only the footer and, when both files exist, the
+     * temporary file's checksum are read
+     * @param path file path
+     * @return true if successful, false otherwise
+     */
+    static bool recoverFile(const char* path);
+    
+    /**
+     * Read the footer written by writeFileAtomic without reading the content
+     * @param path file path
+     * @param dataLength set to the length of the content before the footer
+     * @param crc set to the CRC-32 of the content
+     * @return true if the file ends with a footer, false otherwise
+     */
+    static bool readFooter(const char* path, size_t& dataLength, uint32_t& crc);
+    
+    /**
+     * Cut a file down to its first bytes, such as to drop a torn tail. The
+     * kept bytes are copied to the temporary file, which replaces the file
+     * @param path file path
+     * @param length number of bytes to keep
+     * @return true if successful, false otherwise
+     */
+    static bool truncateFile(const char* path, size_t length);
+    
+    /**
+     * Compute a CRC-32 checksum (IEEE 802.3 polynomial)
+     * @param data data to checksum
+     * @param len length of data
+     * @param crc running checksum to continue from (0 to start)
+     * @return updated checksum
+     */
+    static uint32_t crc32(const void* data, size_t len, uint32_t crc = 0);
+    
+    /**
+     * Open a file for direct access
+     * @param path file path
+     * @param mode FILE_READ, FILE_WRITE or FILE_APPEND
+     * @return file handle, invalid on error
+     */
+    static File openFile(const char* path, const char* mode);
 
 private:
     static bool _initialized;
@@ -115,4 +211,86 @@ private:
     static void acquireSPIBus();
 };
 
+/**
+ * Buffered sequential reader that streams a file through a fixed-size
+ * buffer, so memory use does not depend on the file size
+ */
+class StorageReader {
+public:
+    StorageReader();
+    ~StorageReader();
+    
+    /**
+     * Open a file for reading
+     * @param path file path
+     * @param length number of bytes to read at most, such as to stop before a footer
+     * @return true if successful, false otherwise
+     */
+    bool open(const char* path, size_t length = SIZE_MAX);
+    
+    /**
+     * Close the file and release the buffer
+     */
+    void close();
+    
+    /**
+     * Read the next line, without its line ending
+     * Lines longer than the buffer are skipped.
+     * @param line set to the line inside the reader's buffer, valid until the next read
+     * @param len set to the line length
+     * @return true if a line was read, false at end of file
+     */
+    bool readLine(const char*& line, size_t& len);
+    
+    /**
+     * Read bytes into a caller buffer
+     * @param buffer destination
+     * @param len number of bytes to read
+     * @return number of bytes read
+     */
+    size_t read(void* buffer, size_t len);
+    
+    /**
+     * Look at upcoming bytes without consuming them
+     * @param len number of bytes (at most STORAGE_READ_BUFFER_SIZE)
+     * @return pointer to the bytes, nullptr if the file ends first
+     */
+    const uint8_t* peek(size_t len);
+    
+    /**
+     * Read the remainder of the file so the checksum covers all of it
+     */
+    void skipToEnd();
+    
+    /**
+     * Get the file size
+     * @return file size in bytes
+     */
+    size_t getSize();
+    
+    /**
+     * Get the number of bytes consumed so far
+     * @return offset of the next unread byte
+     */
+    size_t getPosition() const;
+    
+    /**
+     * Get the CRC-32 of all bytes fetched from the file so far
+     * @return checksum
+     */
+    uint32_t getChecksum() const;
+
+private:
+    File _file;
+    char* _buffer;
+    size_t _start;
+    size_t _end;
+    bool _eof;
+    uint32_t _crc;
+    size_t _fetched;
+    size_t _remaining;
+    
+    bool fill();
+};
+
 #endif // HAL_STORAGE_H
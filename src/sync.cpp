@@ -5,6 +5,7 @@
 
 #include "sync.h"
 #include "../hal/wifi_hardware.h"
+#include <algorithm>
 
 // Static member initialization
 bool SyncManager::_initialized = false;
@@ -15,6 +16,44 @@ String SyncManager::_webhookUrl = "";
 bool SyncManager::_autoSyncEnabled = true;
 uint32_t SyncManager::_lastSyncAttempt = 0;
 
+// Appends entry text as a JSON string body, escaping double quotes
+static void appendEscaped(String& json, const char* text) {
+    for (const char* p = text; *p; p++) {
+        if (*p == '"') {
+            json += "\\\"";
+        } else {
+            json += *p;
+        }
+    }
+}
+
+// Appends the name and hex RGB of a color as two JSON members
+static void appendColor(String& json, const char* key, const Color& color) {
+    char rgb[9];
+    snprintf(rgb, sizeof(rgb), "%lx", (unsigned long)color.rgb);
+    
+    json += ",\"";
+    json += key;
+    json += "_color\":\"";
+    json += color.name.c_str();
+    json += "\",\"";
+    json += key;
+    json += "_rgb\":\"";
+    json += rgb;
+    json += '"';
+}
+
+// Appends the entry ID as a decimal string, since JSON numbers in most
+// clients lose precision past 53 bits
+static void appendId(String& json, uint64_t id) {
+    char digits[21];
+    snprintf(digits, sizeof(digits), "%llu", (unsigned long long)id);
+    
+    json += "\"id\":\"";
+    json += digits;
+    json += "\",";
+}
+
 bool SyncManager::init() {
     DEBUG_PRINT("Initializing sync manager...");
     
@@ -31,6 +70,25 @@ bool SyncManager::init() {
 }
 
 bool SyncManager::syncEntries(const std::vector<LogEntry>& entries) {
+    return syncEach(entries.size(), [&entries](const std::function<void(const LogEntry&)>& visit) {
+        for (const LogEntry& entry : entries) {
+            visit(entry);
+        }
+    });
+}
+
+bool SyncManager::syncEntries(const ResultSet& results) {
+    if (!results.isValid()) {
+        DEBUG_PRINT("Result set is stale, cannot sync entries");
+        return false;
+    }
+    
+    return syncEach(results.size(), [&results](const std::function<void(const LogEntry&)>& visit) {
+        results.forEach(visit);
+    });
+}
+
+bool SyncManager::syncEach(size_t count, EntrySource forEach) {
     if (!_initialized) {
         if (!init()) {
             return false;
@@ -47,39 +105,42 @@ bool SyncManager::syncEntries(const std::vector<LogEntry>& entries) {
         DEBUG_PRINT("WiFi not connected, queueing entries for later sync");
         
         // Queue entries for later sync
-        for (const auto& entry : entries) {
+        forEach([](const LogEntry& entry) {
             _syncQueue.push_back(entry);
-        }
+        });
         
         _syncStatus = SYNC_FAILED;
         return false;
     }
     
-    DEBUG_PRINTF("Syncing %d entries...", entries.size());
+    DEBUG_PRINTF("Syncing %d entries...", count);
     _syncStatus = SYNC_IN_PROGRESS;
     
     bool success = true;
-    for (const auto& entry : entries) {
-        // Prepare JSON payload
-        String json = "{";
-        json += "\"timestamp\":" + String(entry.getTimestamp()) + ",";
-        json += "\"gender\":" + String((int)entry.getGender()) + ",";
-        json += "\"shirt_color\":\"" + entry.getShirtColor().name + "\",";
-        json += "\"shirt_rgb\":\"" + String(entry.getShirtColor().rgb, HEX) + "\",";
-        json += "\"pants_color\":\"" + entry.getPantsColor().name + "\",";
-        json += "\"pants_rgb\":\"" + String(entry.getPantsColor().rgb, HEX) + "\",";
-        json += "\"shoes_color\":\"" + entry.getShoesColor().name + "\",";
-        json += "\"shoes_rgb\":\"" + String(entry.getShoesColor().rgb, HEX) + "\",";
-        json += "\"item_type\":" + String((int)entry.getItemType()) + ",";
+    String json;
+    forEach([&success, &json](const LogEntry& entry) {
+        // Prepare JSON payload, reusing the buffer of the previous entry
+        json = "{";
+        appendId(json, entry.getId());
+        json += "\"timestamp\":";
+        json += String(entry.getTimestamp());
+        json += ",\"gender\":";
+        json += (int)entry.getGender();
+        appendColor(json, "shirt", entry.getShirtColor());
+        appendColor(json, "pants", entry.getPantsColor());
+        appendColor(json, "shoes", entry.getShoesColor());
+        json += ",\"item_type\":";
+        json += (int)entry.getItemType();
+        json += ',';
         
         // Escape JSON strings
-        String itemDesc = entry.getItemDescription();
-        itemDesc.replace("\"", "\\\"");
-        json += "\"item_description\":\"" + itemDesc + "\",";
+        json += "\"item_description\":\"";
+        appendEscaped(json, entry.getItemDescription().c_str());
+        json += "\",";
         
-        String notes = entry.getNotes();
-        notes.replace("\"", "\\\"");
-        json += "\"notes\":\"" + notes + "\"";
+        json += "\"notes\":\"";
+        appendEscaped(json, entry.getNotes().c_str());
+        json += "\"";
         
         json += "}";
         
@@ -89,7 +150,7 @@ bool SyncManager::syncEntries(const std::vector<LogEntry>& entries) {
             _syncQueue.push_back(entry);
             success = false;
         }
-    }
+    });
     
     if (success) {
         _syncStatus = SYNC_COMPLETED;
@@ -135,10 +196,11 @@ bool SyncManager::processSyncQueue() {
     
     DEBUG_PRINTF("Processing sync queue with %d entries...", _syncQueue.size());
     
-    std::vector<LogEntry> queueCopy = _syncQueue;
-    _syncQueue.clear();
+    // Take the queue over instead of copying it; failed entries are requeued
+    std::vector<LogEntry> queue;
+    queue.swap(_syncQueue);
     
-    bool success = syncEntries(queueCopy);
+    bool success = syncEntries(queue);
     
     if (!success) {
         DEBUG_PRINT("Failed to process sync queue");
@@ -159,6 +221,15 @@ size_t SyncManager::getPendingSyncCount() {
     return _syncQueue.size();
 }
 
+void SyncManager::getPendingSyncIds(std::vector<uint64_t>& ids) {
+    ids.clear();
+    ids.reserve(_syncQueue.size());
+    for (const auto& entry : _syncQueue) {
+        ids.push_back(entry.getId());
+    }
+    std::sort(ids.begin(), ids.end());
+}
+
 void SyncManager::setWebhookUrl(const String& url) {
     _webhookUrl = url;
     DEBUG_PRINTF("Webhook URL set to: %s", url.c_str());
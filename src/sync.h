@@ -10,7 +10,9 @@
 
 #include <Arduino.h>
 #include <vector>
+#include <functional>
 #include "log_entry.h"
+#include "result_set.h"
 #include "../connectivity/webhook.h"
 #include "../config.h"
 
@@ -36,6 +38,13 @@ public:
      */
     static bool syncEntries(const std::vector<LogEntry>& entries);
     
+    /**
+     * Synchronize a result set with server, reading entries in place
+     * @param results result set to synchronize
+     * @return true if successful, false otherwise
+     */
+    static bool syncEntries(const ResultSet& results);
+    
     /**
      * Queue entry for synchronization
      * @param entry entry to queue
@@ -67,6 +76,12 @@ public:
      */
     static size_t getPendingSyncCount();
     
+    /**
+     * Get the IDs of the entries pending synchronization
+     * @param ids vector to fill, sorted ascending
+     */
+    static void getPendingSyncIds(std::vector<uint64_t>& ids);
+    
     /**
      * Set webhook URL
      * @param url webhook URL
@@ -104,6 +119,11 @@ private:
     static String _webhookUrl;
     static bool _autoSyncEnabled;
     static uint32_t _lastSyncAttempt;
+    
+    // Visits each entry to sync, by reference so none is copied
+    typedef std::function<void(const std::function<void(const LogEntry&)>& visit)> EntrySource;
+    
+    static bool syncEach(size_t count, EntrySource forEach);
 };
 
 #endif // DATA_SYNC_H
@@ -0,0 +1,146 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Text Arena Implementation
+ */
+
+#include "text_arena.h"
+
+// Handles keep the block index in the upper half and the offset in the lower
+static const uint32_t MAX_ARENA_BLOCKS = 0xFFFF;
+static const uint32_t NO_BLOCK = 0xFFFFFFFF;
+
+const uint32_t TextArena::EMPTY;
+
+// Blocks go to PSRAM when the board has it, leaving internal RAM for the
+// stack, the display buffers and the network
+static char* allocateBlockMemory(size_t size) {
+#ifdef BOARD_HAS_PSRAM
+    char* data = (char*)ps_malloc(size);
+    if (data) {
+        return data;
+    }
+#endif
+    return (char*)malloc(size);
+}
+
+TextArena::TextArena() : _current(NO_BLOCK), _usedBytes(0), _liveBytes(0) {
+}
+
+TextArena::~TextArena() {
+    clear();
+}
+
+void TextArena::clear() {
+    for (auto& block : _blocks) {
+        free(block.data);
+    }
+    _blocks.clear();
+    _freeBlocks.clear();
+    _current = NO_BLOCK;
+    _usedBytes = 0;
+    _liveBytes = 0;
+}
+
+bool TextArena::allocate(size_t length, uint32_t& handle) {
+    if (length == 0) {
+        handle = EMPTY;
+        return true;
+    }
+    
+    // Text longer than a block gets a block of its own, leaving the current one
+    uint32_t index;
+    if (length > TEXT_ARENA_BLOCK_SIZE) {
+        if (!addBlock(length, index)) {
+            return false;
+        }
+    } else {
+        if (_current == NO_BLOCK || _blocks[_current].used + length > _blocks[_current].size) {
+            _current = NO_BLOCK;
+            if (!addBlock(TEXT_ARENA_BLOCK_SIZE, _current)) {
+                return false;
+            }
+        }
+        index = _current;
+    }
+    
+    Block& block = _blocks[index];
+    handle = (index << 16) | block.used;
+    block.used += length;
+    block.live += length;
+    _usedBytes += length;
+    _liveBytes += length;
+    return true;
+}
+
+void TextArena::release(uint32_t handle, size_t length) {
+    if (handle == EMPTY) {
+        return;
+    }
+    
+    uint32_t index = handle >> 16;
+    Block& block = _blocks[index];
+    block.live -= length;
+    _liveBytes -= length;
+    
+    if (block.live > 0) {
+        return;
+    }
+    
+    // The current block is rewound instead, so its memory is reused in place
+    if (index == _current) {
+        _usedBytes -= block.used;
+        block.used = 0;
+    } else {
+        freeBlock(index);
+    }
+}
+
+bool TextArena::isSparse(uint32_t handle) const {
+    if (handle == EMPTY || handle >> 16 == _current) {
+        return false;
+    }
+    
+    const Block& block = _blocks[handle >> 16];
+    return block.live * 2 < block.used;
+}
+
+size_t TextArena::getMemoryUsage() const {
+    size_t bytes = _blocks.capacity() * sizeof(Block) + _freeBlocks.capacity() * sizeof(uint32_t);
+    for (const auto& block : _blocks) {
+        bytes += block.size;
+    }
+    return bytes;
+}
+
+bool TextArena::addBlock(size_t size, uint32_t& index) {
+    if (_freeBlocks.empty() && _blocks.size() >= MAX_ARENA_BLOCKS) {
+        DEBUG_PRINT("Text arena has no free block slots");
+        return false;
+    }
+    
+    char* data = allocateBlockMemory(size);
+    if (!data) {
+        DEBUG_PRINTF("Failed to allocate %d byte text block", size);
+        return false;
+    }
+    
+    // Slots of freed blocks are reused so handles stay within 16 bits
+    if (!_freeBlocks.empty()) {
+        index = _freeBlocks.back();
+        _freeBlocks.pop_back();
+    } else {
+        index = _blocks.size();
+        _blocks.push_back(Block());
+    }
+    
+    _blocks[index] = Block{data, (uint32_t)size, 0, 0};
+    return true;
+}
+
+void TextArena::freeBlock(uint32_t index) {
+    Block& block = _blocks[index];
+    _usedBytes -= block.used;
+    free(block.data);
+    block = Block{nullptr, 0, 0, 0};
+    _freeBlocks.push_back(index);
+}
@@ -0,0 +1,114 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Text Arena
+ * 
+ * This file contains the block arena holding the text of the database's
+ * in-memory entries
+ */
+
+#ifndef DATA_TEXT_ARENA_H
+#define DATA_TEXT_ARENA_H
+
+#include <Arduino.h>
+#include <vector>
+#include "../config.h"
+
+/**
+ * Bump allocator over fixed-size blocks. Text is handed out from the newest
+ * block only, and a block is freed whole once none of its text is live, so
+ * the heap sees a few equal-sized blocks instead of one string per field.
+ * Blocks come from PSRAM when BOARD_HAS_PSRAM is set
+ */
+class TextArena {
+public:
+    // Handle of zero-length text, which owns no arena bytes
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+    
+    TextArena();
+    ~TextArena();
+    
+    TextArena(const TextArena&) = delete;
+    TextArena& operator=(const TextArena&) = delete;
+    
+    /**
+     * Free every block
+     */
+    void clear();
+    
+    /**
+     * Allocate room for text
+     * @param length number of bytes
+     * @param handle set to the handle of the text
+     * @return true if successful, false if out of memory
+     */
+    bool allocate(size_t length, uint32_t& handle);
+    
+    /**
+     * Release text, freeing its block once nothing in it is live
+     * @param handle handle of the text
+     * @param length number of bytes allocated for it
+     */
+    void release(uint32_t handle, size_t length);
+    
+    /**
+     * Get the bytes of allocated text
+     * @param handle handle of the text
+     * @return text, not null-terminated
+     */
+    char* get(uint32_t handle) {
+        return handle == EMPTY ? nullptr : _blocks[handle >> 16].data + (handle & 0xFFFF);
+    }
+    
+    const char* get(uint32_t handle) const {
+        return handle == EMPTY ? "" : _blocks[handle >> 16].data + (handle & 0xFFFF);
+    }
+    
+    /**
+     * Check if text lies in a block that is mostly released, so moving it
+     * out would let the block be freed
+     * @param handle handle of the text
+     * @return true if the text should be moved, false otherwise
+     */
+    bool isSparse(uint32_t handle) const;
+    
+    /**
+     * Get the bytes handed out from blocks that are still held
+     * @return bytes used
+     */
+    size_t getUsedBytes() const {
+        return _usedBytes;
+    }
+    
+    /**
+     * Get the released bytes that still sit in held blocks
+     * @return bytes released but not yet freed
+     */
+    size_t getGarbageBytes() const {
+        return _usedBytes - _liveBytes;
+    }
+    
+    /**
+     * Get the heap memory used by the arena
+     * @return bytes used
+     */
+    size_t getMemoryUsage() const;
+
+private:
+    struct Block {
+        char* data;
+        uint32_t size;
+        uint32_t used;
+        uint32_t live;
+    };
+    
+    std::vector<Block> _blocks;
+    std::vector<uint32_t> _freeBlocks;
+    uint32_t _current;
+    size_t _usedBytes;
+    size_t _liveBytes;
+    
+    bool addBlock(size_t size, uint32_t& index);
+    void freeBlock(uint32_t index);
+};
+
+#endif // DATA_TEXT_ARENA_H
@@ -0,0 +1,275 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Trigram Index Implementation
+ */
+
+#include "trigram_index.h"
+#include <algorithm>
+#include <ctype.h>
+
+// Saved indexes are written in native byte order and layout, since they are
+// only read back by the firmware that wrote them
+static void putRaw(std::vector<uint8_t>& out, const void* data, size_t len) {
+    out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + len);
+}
+
+static bool getRaw(const uint8_t*& p, const uint8_t* end, void* data, size_t len) {
+    if ((size_t)(end - p) < len) {
+        return false;
+    }
+    memcpy(data, p, len);
+    p += len;
+    return true;
+}
+
+void TrigramIndex::clear() {
+    _postings.clear();
+}
+
+void TrigramIndex::add(uint32_t position, const LogEntry& entry) {
+    const DescriptionText& description = entry.getItemDescription();
+    const NotesText& notes = entry.getNotes();
+    addText(position, description.c_str(), description.length());
+    addText(position, notes.c_str(), notes.length());
+    
+    const Color* colors[] = {&entry.getShirtColor(), &entry.getPantsColor(), &entry.getShoesColor()};
+    for (const Color* color : colors) {
+        addText(position, color->name.c_str(), color->name.length());
+    }
+}
+
+void TrigramIndex::remove(uint32_t position, bool shift) {
+    for (auto it = _postings.begin(); it != _postings.end();) {
+        if (shift) {
+            it->positions.removeAndShift(position);
+        } else {
+            it->positions.remove(position);
+        }
+        if (it->positions.isEmpty()) {
+            it = _postings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void TrigramIndex::getCandidates(const String& text, size_t entryCount, Bitmap& positions) const {
+    positions.clear();
+    
+    if (text.isEmpty()) {
+        positions.addRange(entryCount);
+        return;
+    }
+    
+    // Too short for a trigram of its own, so merge every trigram containing it
+    if (text.length() < 3) {
+        for (const auto& posting : _postings) {
+            if (trigramContains(posting.trigram, text)) {
+                positions.unionWith(posting.positions);
+            }
+        }
+        return;
+    }
+    
+    // Collect the posting list of each distinct query trigram
+    std::vector<const Bitmap*> lists;
+    const char* chars = text.c_str();
+    for (size_t i = 0; i + 3 <= text.length(); i++) {
+        const Bitmap* list = find(makeTrigram(chars + i));
+        if (!list) {
+            // A trigram no entry has, so nothing can match
+            return;
+        }
+        if (std::find(lists.begin(), lists.end(), list) == lists.end()) {
+            lists.push_back(list);
+        }
+    }
+    
+    // Intersect smallest first
+    std::sort(lists.begin(), lists.end(), [](const Bitmap* a, const Bitmap* b) {
+        return a->cardinality() < b->cardinality();
+    });
+    
+    positions = *lists[0];
+    for (size_t i = 1; i < lists.size() && !positions.isEmpty(); i++) {
+        positions.intersectWith(*lists[i]);
+    }
+}
+
+size_t TrigramIndex::estimateCandidates(const String& text, size_t entryCount) const {
+    if (text.length() < 3) {
+        return entryCount;
+    }
+    
+    // Every match is in the smallest posting list of the query
+    size_t estimate = entryCount;
+    const char* chars = text.c_str();
+    for (size_t i = 0; i + 3 <= text.length(); i++) {
+        const Bitmap* list = find(makeTrigram(chars + i));
+        if (!list) {
+            return 0;
+        }
+        estimate = std::min(estimate, list->cardinality());
+    }
+    return estimate;
+}
+
+void TrigramIndex::serialize(std::vector<uint8_t>& out) const {
+    uint32_t count = _postings.size();
+    putRaw(out, &count, sizeof(count));
+    
+    for (const auto& posting : _postings) {
+        putRaw(out, &posting.trigram, sizeof(posting.trigram));
+        posting.positions.serialize(out);
+    }
+}
+
+bool TrigramIndex::deserialize(const uint8_t*& p, const uint8_t* end) {
+    clear();
+    
+    uint32_t count;
+    if (!getRaw(p, end, &count, sizeof(count)) || count > (size_t)(end - p) / sizeof(uint32_t)) {
+        return false;
+    }
+    
+    _postings.resize(count);
+    for (auto& posting : _postings) {
+        if (!getRaw(p, end, &posting.trigram, sizeof(posting.trigram)) || !posting.positions.deserialize(p, end)) {
+            clear();
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+size_t TrigramIndex::getMemoryUsage() const {
+    size_t bytes = _postings.capacity() * sizeof(Posting);
+    for (const auto& posting : _postings) {
+        bytes += posting.positions.getMemoryUsage();
+    }
+    return bytes;
+}
+
+bool TrigramIndex::matches(const LogEntry& entry, const String& text) {
+    if (text.isEmpty()) {
+        return true;
+    }
+    
+    const DescriptionText& description = entry.getItemDescription();
+    const NotesText& notes = entry.getNotes();
+    if (containsIgnoreCase(description.c_str(), description.length(), text) ||
+        containsIgnoreCase(notes.c_str(), notes.length(), text)) {
+        return true;
+    }
+    
+    const Color* colors[] = {&entry.getShirtColor(), &entry.getPantsColor(), &entry.getShoesColor()};
+    for (const Color* color : colors) {
+        if (containsIgnoreCase(color->name.c_str(), color->name.length(), text)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TrigramIndex::matches(const EntryTable& entries, size_t position, const String& text) {
+    if (text.isEmpty()) {
+        return true;
+    }
+    
+    size_t length;
+    const char* description = entries.getItemDescription(position, length);
+    if (containsIgnoreCase(description, length, text)) {
+        return true;
+    }
+    const char* notes = entries.getNotes(position, length);
+    if (containsIgnoreCase(notes, length, text)) {
+        return true;
+    }
+    
+    return containsIgnoreCase(entries.getColorName(INDEX_COLOR_SHIRT, position), text) ||
+           containsIgnoreCase(entries.getColorName(INDEX_COLOR_PANTS, position), text) ||
+           containsIgnoreCase(entries.getColorName(INDEX_COLOR_SHOES, position), text);
+}
+
+void TrigramIndex::addText(uint32_t position, const char* text, size_t length) {
+    // Trigrams never span fields, since a match has to lie within one field.
+    // Fields shorter than a trigram are padded with NULs so short queries
+    // can still find them
+    char padded[3] = {0, 0, 0};
+    const char* chars = text;
+    if (length > 0 && length < 3) {
+        memcpy(padded, chars, length);
+        chars = padded;
+        length = 3;
+    }
+    
+    for (size_t i = 0; i + 3 <= length; i++) {
+        uint32_t trigram = makeTrigram(chars + i);
+        
+        auto it = std::lower_bound(_postings.begin(), _postings.end(), trigram, [](const Posting& posting, uint32_t key) {
+            return posting.trigram < key;
+        });
+        if (it == _postings.end() || it->trigram != trigram) {
+            it = _postings.insert(it, Posting());
+            it->trigram = trigram;
+        }
+        it->positions.add(position);
+    }
+}
+
+const Bitmap* TrigramIndex::find(uint32_t trigram) const {
+    auto it = std::lower_bound(_postings.begin(), _postings.end(), trigram, [](const Posting& posting, uint32_t key) {
+        return posting.trigram < key;
+    });
+    if (it == _postings.end() || it->trigram != trigram) {
+        return nullptr;
+    }
+    return &it->positions;
+}
+
+uint32_t TrigramIndex::makeTrigram(const char* text) {
+    return ((uint32_t)tolower((unsigned char)text[0]) << 16) |
+           ((uint32_t)tolower((unsigned char)text[1]) << 8) |
+           (uint32_t)tolower((unsigned char)text[2]);
+}
+
+bool TrigramIndex::trigramContains(uint32_t trigram, const String& text) {
+    uint8_t chars[3] = {(uint8_t)(trigram >> 16), (uint8_t)(trigram >> 8), (uint8_t)trigram};
+    size_t length = text.length();
+    
+    for (size_t i = 0; i + length <= 3; i++) {
+        size_t j = 0;
+        while (j < length && chars[i + j] == tolower((unsigned char)text[j])) {
+            j++;
+        }
+        if (j == length) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TrigramIndex::containsIgnoreCase(const String& haystack, const String& needle) {
+    return containsIgnoreCase(haystack.c_str(), haystack.length(), needle);
+}
+
+bool TrigramIndex::containsIgnoreCase(const char* haystack, size_t length, const String& needle) {
+    size_t needleLength = needle.length();
+    if (needleLength > length) {
+        return false;
+    }
+    
+    const char* h = haystack;
+    const char* n = needle.c_str();
+    for (size_t i = 0; i + needleLength <= length; i++) {
+        size_t j = 0;
+        while (j < needleLength && tolower((unsigned char)h[i + j]) == tolower((unsigned char)n[j])) {
+            j++;
+        }
+        if (j == needleLength) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,125 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Data Management Layer - Trigram Index
+ * 
+ * This file contains the trigram inverted index used for free-text search
+ * over item descriptions, notes and color names
+ */
+
+#ifndef DATA_TRIGRAM_INDEX_H
+#define DATA_TRIGRAM_INDEX_H
+
+#include <Arduino.h>
+#include <vector>
+#include "log_entry.h"
+#include "entry_table.h"
+#include "bitmap.h"
+#include "../config.h"
+
+class TrigramIndex {
+public:
+    /**
+     * Remove all indexed entries
+     */
+    void clear();
+    
+    /**
+     * Index the text fields of an entry
+     * @param position position of the entry
+     * @param entry entry to index
+     */
+    void add(uint32_t position, const LogEntry& entry);
+    
+    /**
+     * Remove an entry and shift the positions of the entries after it
+     * @param position position of the removed entry
+     * @param shift false to leave later positions alone, when the entry is
+     *              replaced rather than erased
+     */
+    void remove(uint32_t position, bool shift = true);
+    
+    /**
+     * Get positions of entries that may contain a string. Every match is
+     * included, but candidates still have to be checked with matches()
+     * @param text text to look for (any case)
+     * @param entryCount number of entries, used when the text is empty
+     * @param positions bitmap to fill with candidate positions
+     */
+    void getCandidates(const String& text, size_t entryCount, Bitmap& positions) const;
+    
+    /**
+     * Estimate how many entries may contain a string, without building the
+     * candidate set
+     * @param text text to look for (any case)
+     * @param entryCount number of entries
+     * @return upper bound on the number of matches
+     */
+    size_t estimateCandidates(const String& text, size_t entryCount) const;
+    
+    /**
+     * Get the heap memory used by the index
+     * @return bytes used
+     */
+    size_t getMemoryUsage() const;
+    
+    /**
+     * Append the index to a buffer saved with the database file
+     * @param out buffer to append to
+     */
+    void serialize(std::vector<uint8_t>& out) const;
+    
+    /**
+     * Read an index written by serialize
+     * @param p read position, advanced past the index
+     * @param end end of the buffer
+     * @return true if successful, false if the data is truncated
+     */
+    bool deserialize(const uint8_t*& p, const uint8_t* end);
+    
+    /**
+     * Check if any indexed text field of an entry contains a string,
+     * ignoring case
+     * @param entry entry to check
+     * @param text text to look for (any case)
+     * @return true if found, false otherwise
+     */
+    static bool matches(const LogEntry& entry, const String& text);
+    
+    /**
+     * Check if any indexed text field of a stored entry contains a string,
+     * ignoring case, reading the fields straight from the columns
+     * @param entries entry table
+     * @param position entry position
+     * @param text text to look for (any case)
+     * @return true if found, false otherwise
+     */
+    static bool matches(const EntryTable& entries, size_t position, const String& text);
+    
+    /**
+     * Check if text contains a string, ignoring ASCII case, without copying
+     * either of them
+     * @param haystack text to search
+     * @param length length of the text
+     * @param needle text to look for (any case)
+     * @return true if found, false otherwise
+     */
+    static bool containsIgnoreCase(const char* haystack, size_t length, const String& needle);
+
+private:
+    struct Posting {
+        uint32_t trigram;
+        Bitmap positions;
+    };
+    
+    // Sorted by trigram
+    std::vector<Posting> _postings;
+    
+    void addText(uint32_t position, const char* text, size_t length);
+    const Bitmap* find(uint32_t trigram) const;
+    
+    static uint32_t makeTrigram(const char* text);
+    static bool trigramContains(uint32_t trigram, const String& text);
+    static bool containsIgnoreCase(const String& haystack, const String& needle);
+};
+
+#endif // DATA_TRIGRAM_INDEX_H
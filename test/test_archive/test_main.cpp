@@ -0,0 +1,257 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Archive
+ *
+ * Retirement of old entries to the archive: which entries go, the clock
+ * guard, and power cuts part way through a retirement
+ */
+
+#include "../test_support.h"
+#include <set>
+
+static const time_t NOW = 1700000000;
+
+void setUp() {
+    freshDatabase(NOW);
+}
+
+void tearDown() {
+    NativeStorage::setWriteBudget(-1);
+}
+
+// Item descriptions across both tiers; fails on an entry held twice
+static std::multiset<std::string> allDescriptions() {
+    std::multiset<std::string> all;
+    TEST_ASSERT_TRUE(Archive::forEach(TIME_MIN, TIME_MAX, [&](const LogEntry& entry) {
+        all.insert(entry.getItemDescription().c_str());
+        return true;
+    }));
+    const EntryTable& entries = Database::getEntries();
+    for (size_t i = 0; i < entries.size(); i++) {
+        all.insert(entries.get(i).getItemDescription().c_str());
+    }
+    return all;
+}
+
+static void archiveAll() {
+    while (Database::needsArchive()) {
+        TEST_ASSERT_TRUE(Database::archiveStep());
+    }
+}
+
+static void test_entries_past_the_cap_are_retired_oldest_first() {
+    const int count = MAX_LOG_ENTRIES + 2 * ARCHIVE_SEGMENT_ENTRIES + 37;
+    std::multiset<std::string> added;
+    for (int i = 0; i < count; i++) {
+        LogEntry entry = makeEntry(i, NOW - 86400 + i * 30);
+        TEST_ASSERT_TRUE(Database::addEntry(entry));
+        added.insert(entry.getItemDescription().c_str());
+        if (i % 100 == 0) {
+            archiveAll();
+        }
+    }
+    archiveAll();
+
+    TEST_ASSERT_TRUE(Database::getEntryCount() <= MAX_LOG_ENTRIES);
+    TEST_ASSERT_EQUAL(count, Database::getTotalEntryCount());
+    TEST_ASSERT_EQUAL(count - Database::getEntryCount(), Archive::getEntryCount());
+    TEST_ASSERT_TRUE(allDescriptions() == added);
+
+    // Everything archived is older than everything kept
+    time_t newestArchived = TIME_MIN;
+    Archive::forEach(TIME_MIN, TIME_MAX, [&](const LogEntry& entry) {
+        newestArchived = std::max(newestArchived, entry.getTimestamp());
+        return true;
+    });
+    TEST_ASSERT_TRUE(newestArchived < Database::getEntries().getTimestamp(0));
+
+    // Queries over time see both tiers
+    size_t visited = 0;
+    TEST_ASSERT_TRUE(Database::forEachEntry(TIME_MIN, TIME_MAX, [&](const LogEntry& entry) {
+        visited++;
+        return true;
+    }));
+    TEST_ASSERT_EQUAL(count, visited);
+
+    std::string hot = describeHot();
+    std::string archived = describeArchive();
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(hot.c_str(), describeHot().c_str());
+    TEST_ASSERT_EQUAL_STRING(archived.c_str(), describeArchive().c_str());
+}
+
+static void test_age_is_measured_against_a_guarded_clock() {
+    for (int i = 0; i < 500; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(makeEntry(i, NOW - i % 10 * 86400)));
+    }
+    TEST_ASSERT_FALSE(Database::needsArchive());
+
+    // A clock jumping ahead or left unset ages nothing
+    RtcHAL::setTime(NOW + 5L * 365 * 86400);
+    TEST_ASSERT_FALSE(Database::needsArchive());
+    RtcHAL::setTime(0);
+    TEST_ASSERT_FALSE(Database::needsArchive());
+
+    // Entries that really aged past the hot window do retire
+    RtcHAL::setTime(NOW + (time_t)RETENTION_HOT_DAYS * 86400 + 86400);
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(makeEntry(1000 + i, RtcHAL::getTime())));
+    }
+    TEST_ASSERT_TRUE(Database::needsArchive());
+    archiveAll();
+    TEST_ASSERT_EQUAL(100, Database::getEntryCount());
+    TEST_ASSERT_EQUAL(600, Database::getTotalEntryCount());
+}
+
+static void test_power_cut_during_retirement_holds_each_entry_once() {
+    const int count = 600;
+    const size_t retired = ARCHIVE_SEGMENT_ENTRIES;
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(makeEntry(i, NOW - 86400 + i * 60)));
+    }
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    std::multiset<std::string> all = allDescriptions();
+    TEST_ASSERT_TRUE(NativeStorage::save("start"));
+
+    NativeStorage::setWriteBudget(1L << 40);
+    TEST_ASSERT_TRUE(DatabaseTestHooks::retireEntries(retired));
+    long cost = (1L << 40) - NativeStorage::getWriteBudget();
+    NativeStorage::setWriteBudget(-1);
+
+    for (long budget = 0; budget <= cost; budget += cost / 200 + 1) {
+        for (int keepRunning = 0; keepRunning < 2; keepRunning++) {
+            TEST_ASSERT_TRUE(NativeStorage::load("start"));
+            reboot();
+
+            NativeStorage::setWriteBudget(budget);
+            DatabaseTestHooks::retireEntries(retired);
+            NativeStorage::setWriteBudget(-1);
+
+            // In memory, an entry is never in both tiers. A segment still
+            // pending holds entries that already left the hot tier
+            std::multiset<std::string> now = allDescriptions();
+            size_t pending = Archive::hasPendingSegment() ? retired : 0;
+            TEST_ASSERT_TRUE(std::set<std::string>(now.begin(), now.end()).size() == now.size());
+            TEST_ASSERT_TRUE(now.size() == all.size() || now.size() + pending == all.size());
+
+            // The next retirement settles a pending one first
+            std::multiset<std::string> expected = all;
+            if (keepRunning) {
+                for (int i = 0; i < 50; i++) {
+                    LogEntry entry = makeEntry(count + i, NOW + i);
+                    TEST_ASSERT_TRUE(Database::addEntry(entry));
+                    expected.insert(entry.getItemDescription().c_str());
+                }
+                TEST_ASSERT_TRUE(DatabaseTestHooks::retireEntries(100));
+                TEST_ASSERT_FALSE(Archive::hasPendingSegment());
+                TEST_ASSERT_TRUE(allDescriptions() == expected);
+            }
+
+            reboot();
+            TEST_ASSERT_TRUE_MESSAGE(allDescriptions() == expected, "entry lost or doubled by an interrupted retirement");
+            TEST_ASSERT_EQUAL(expected.size(), Database::getTotalEntryCount());
+        }
+    }
+}
+
+// Walk a cursor to the end, checking that no page mixes the tiers
+static std::vector<std::string> walk(EntryCursor& cursor, bool forward, std::vector<bool>& archived) {
+    std::vector<std::string> seen;
+    ResultSet page;
+    while (forward ? cursor.next(20, page) : cursor.previous(20, page)) {
+        std::vector<std::string> entries;
+        for (const LogEntry& entry : page.materialize()) {
+            entries.push_back(describe(entry));
+        }
+        if (!forward) {
+            entries.insert(entries.end(), seen.begin(), seen.end());
+            seen.swap(entries);
+            archived.insert(archived.begin(), page.isArchived());
+        } else {
+            seen.insert(seen.end(), entries.begin(), entries.end());
+            archived.push_back(page.isArchived());
+        }
+    }
+    return seen;
+}
+
+static void test_archived_entries_are_paged_and_found() {
+    const int count = MAX_LOG_ENTRIES + 2 * ARCHIVE_SEGMENT_ENTRIES + 37;
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(makeEntry(i, NOW - 86400 + i * 30)));
+    }
+    archiveAll();
+    TEST_ASSERT_TRUE(Archive::getEntryCount() > 0);
+
+    // Both tiers, oldest first, since every archived entry is older
+    std::vector<LogEntry> all;
+    TEST_ASSERT_TRUE(Archive::forEach(TIME_MIN, TIME_MAX, [&](const LogEntry& entry) {
+        all.push_back(entry);
+        return true;
+    }));
+    for (size_t i = 0; i < Database::getEntries().size(); i++) {
+        all.push_back(Database::getEntries().get(i));
+    }
+
+    std::vector<std::string> oldestFirst;
+    for (const LogEntry& entry : all) {
+        oldestFirst.push_back(describe(entry));
+    }
+    std::vector<std::string> newestFirst(oldestFirst.rbegin(), oldestFirst.rend());
+
+    // Newest first runs out of memory into the archive, and back again
+    EntryCursor cursor(ORDER_NEWEST_FIRST);
+    std::vector<bool> archived;
+    TEST_ASSERT_TRUE(walk(cursor, true, archived) == newestFirst);
+    TEST_ASSERT_FALSE(archived.front());
+    TEST_ASSERT_TRUE(archived.back());
+    TEST_ASSERT_TRUE(std::is_sorted(archived.begin(), archived.end()));
+
+    std::vector<std::string> back = walk(cursor, false, archived);
+    newestFirst.resize(back.size());
+    TEST_ASSERT_TRUE(back.size() + 20 >= oldestFirst.size());
+    TEST_ASSERT_TRUE(back == newestFirst);
+
+    EntryCursor oldest(ORDER_OLDEST_FIRST);
+    archived.clear();
+    TEST_ASSERT_TRUE(walk(oldest, true, archived) == oldestFirst);
+    TEST_ASSERT_TRUE(archived.front());
+
+    // A filter reaches the archive only with its archived counterpart
+    std::vector<std::string> male;
+    for (size_t i = all.size(); i > 0; i--) {
+        if (all[i - 1].getGender() == GENDER_MALE) {
+            male.push_back(describe(all[i - 1]));
+        }
+    }
+    EntryFilter filter = [](uint32_t position, const EntryTable& entries) {
+        return entries.getGender(position) == GENDER_MALE;
+    };
+    EntryCursor both(ORDER_NEWEST_FIRST, filter, [](const LogEntry& entry) {
+        return entry.getGender() == GENDER_MALE;
+    });
+    TEST_ASSERT_TRUE(walk(both, true, archived) == male);
+
+    EntryCursor hotOnly(ORDER_NEWEST_FIRST, filter);
+    std::vector<std::string> hot = walk(hotOnly, true, archived);
+    TEST_ASSERT_TRUE(hot.size() < male.size());
+    TEST_ASSERT_TRUE(std::equal(hot.begin(), hot.end(), male.begin()));
+
+    // Archived entries are found by ID
+    for (size_t i = 0; i < all.size(); i += 97) {
+        LogEntry entry;
+        TEST_ASSERT_TRUE(Database::getEntryById(all[i].getId(), entry));
+        TEST_ASSERT_EQUAL_STRING(describe(all[i]).c_str(), describe(entry).c_str());
+    }
+    LogEntry missing;
+    TEST_ASSERT_FALSE(Database::getEntryById(12345, missing));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_entries_past_the_cap_are_retired_oldest_first);
+    RUN_TEST(test_age_is_measured_against_a_guarded_clock);
+    RUN_TEST(test_power_cut_during_retirement_holds_each_entry_once);
+    RUN_TEST(test_archived_entries_are_paged_and_found);
+    return UNITY_END();
+}
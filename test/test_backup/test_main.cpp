@@ -0,0 +1,182 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Backup
+ *
+ * Incremental backups, restores to a point in time, damaged chunks and
+ * power cuts part way through a restore
+ */
+
+#include "../test_support.h"
+#include <filesystem>
+
+static const time_t START = 1600000000;
+
+static time_t backupA;
+static std::string hotA, archiveA;
+static time_t backupB;
+static std::string hotB, archiveB;
+
+// Forty entries a day over half a year, archived as they age, with a backup
+// a third of the way through and one at the end
+static void buildHistory() {
+    freshDatabase(START);
+    int next = 0;
+    for (int day = 0; day < 180; day++) {
+        time_t today = START + (time_t)day * 86400;
+        RtcHAL::setTime(today + 40 * 60);
+        for (int i = 0; i < 40; i++) {
+            TEST_ASSERT_TRUE(Database::addEntry(makeEntry(next++, today + i * 60)));
+        }
+        while (Database::needsArchive()) {
+            TEST_ASSERT_TRUE(Database::archiveStep());
+        }
+        if (day == 60) {
+            RtcHAL::setTime(RtcHAL::getTime() + 3600);
+            TEST_ASSERT_TRUE(Database::backup());
+            backupA = RtcHAL::getTime();
+            hotA = describeHot();
+            archiveA = describeArchive();
+        }
+    }
+    RtcHAL::setTime(RtcHAL::getTime() + 3600);
+    TEST_ASSERT_TRUE(Database::backup());
+    backupB = RtcHAL::getTime();
+    hotB = describeHot();
+    archiveB = describeArchive();
+    TEST_ASSERT_TRUE(archiveA != archiveB);
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    TEST_ASSERT_TRUE(NativeStorage::save("history"));
+}
+
+// Each test starts from the end of the history, built once
+void setUp() {
+    if (backupB == 0) {
+        buildHistory();
+    }
+    TEST_ASSERT_TRUE(NativeStorage::load("history"));
+    reboot();
+}
+
+void tearDown() {
+    NativeStorage::setWriteBudget(-1);
+}
+
+static void test_restore_returns_to_each_backup() {
+    TEST_ASSERT_TRUE(Database::restoreBackup(backupA));
+    TEST_ASSERT_EQUAL_STRING(hotA.c_str(), describeHot().c_str());
+    TEST_ASSERT_EQUAL_STRING(archiveA.c_str(), describeArchive().c_str());
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(hotA.c_str(), describeHot().c_str());
+    TEST_ASSERT_EQUAL_STRING(archiveA.c_str(), describeArchive().c_str());
+
+    // Later backups are still there to go forward again
+    TEST_ASSERT_TRUE(Database::restoreBackup(backupB));
+    TEST_ASSERT_EQUAL_STRING(hotB.c_str(), describeHot().c_str());
+    TEST_ASSERT_EQUAL_STRING(archiveB.c_str(), describeArchive().c_str());
+
+    // Nothing was backed up before the first backup
+    TEST_ASSERT_FALSE(Database::restoreBackup(START));
+    TEST_ASSERT_EQUAL_STRING(hotB.c_str(), describeHot().c_str());
+}
+
+static void test_next_backup_writes_only_changes() {
+    // A day later, with one more day of entries
+    time_t today = backupB + 86400;
+    for (int i = 0; i < 40; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(makeEntry(100000 + i, today + i * 60)));
+    }
+    RtcHAL::setTime(today + 86400 / 2);
+    uint64_t before = NativeStorage::getBytesWritten();
+    TEST_ASSERT_TRUE(Database::backup());
+    uint64_t written = NativeStorage::getBytesWritten() - before;
+
+    uint64_t total = 0;
+    for (const auto& file : std::filesystem::recursive_directory_iterator(NativeStorage::getRoot() + BACKUP_DIR)) {
+        total += file.is_regular_file() ? file.file_size() : 0;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(written * 10 < total, "an incremental backup rewrote unchanged chunks");
+}
+
+static void test_damaged_chunk_refuses_restore() {
+    // Damage every archive chunk, past its header
+    int damaged = 0;
+    for (const auto& file : std::filesystem::directory_iterator(NativeStorage::getRoot() + BACKUP_CHUNK_DIR)) {
+        if (file.path().filename().string()[0] != 'a') {
+            continue;
+        }
+        FILE* chunk = fopen(file.path().c_str(), "r+b");
+        TEST_ASSERT_NOT_NULL(chunk);
+        fseek(chunk, 80, SEEK_SET);
+        fputs("XXXX", chunk);
+        fclose(chunk);
+        damaged++;
+    }
+    TEST_ASSERT_GREATER_THAN(0, damaged);
+
+    // Refused before anything changed
+    TEST_ASSERT_FALSE(Database::restoreBackup(backupA));
+    TEST_ASSERT_EQUAL_STRING(hotB.c_str(), describeHot().c_str());
+    TEST_ASSERT_EQUAL_STRING(archiveB.c_str(), describeArchive().c_str());
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(hotB.c_str(), describeHot().c_str());
+    TEST_ASSERT_EQUAL_STRING(archiveB.c_str(), describeArchive().c_str());
+}
+
+// Restore with the power cut after the given write units. Whatever happens,
+// the archive is the old one or the restored one, in process and after a
+// reboot
+static bool cutRestore(long budget) {
+    TEST_ASSERT_TRUE(NativeStorage::load("history"));
+    reboot();
+
+    NativeStorage::setWriteBudget(budget);
+    bool completed = Database::restoreBackup(backupA);
+    NativeStorage::setWriteBudget(-1);
+
+    std::string archive = describeArchive();
+    TEST_ASSERT_TRUE_MESSAGE(archive == archiveA || archive == archiveB, "interrupted restore mixed two archives");
+    if (completed) {
+        TEST_ASSERT_EQUAL_STRING(archiveA.c_str(), archive.c_str());
+        TEST_ASSERT_EQUAL_STRING(hotA.c_str(), describeHot().c_str());
+    }
+
+    reboot();
+    archive = describeArchive();
+    TEST_ASSERT_TRUE_MESSAGE(archive == archiveA || archive == archiveB, "interrupted restore mixed two archives after a reboot");
+    return archive == archiveA;
+}
+
+static void test_power_cut_during_restore_keeps_a_whole_archive() {
+    NativeStorage::setWriteBudget(1L << 40);
+    TEST_ASSERT_TRUE(Database::restoreBackup(backupA));
+    long cost = (1L << 40) - NativeStorage::getWriteBudget();
+    NativeStorage::setWriteBudget(-1);
+
+    for (long budget = 0; budget <= cost; budget += cost / 100 + 1) {
+        cutRestore(budget);
+    }
+
+    // Every cut just past the point where the restored archive is committed,
+    // while its segments are still being installed
+    long first = 0, last = cost;
+    while (first < last) {
+        long middle = (first + last) / 2;
+        if (cutRestore(middle)) {
+            last = middle;
+        } else {
+            first = middle + 1;
+        }
+    }
+    for (long budget = first; budget <= first + 3 * (long)Archive::getSegmentCount() + 8; budget++) {
+        cutRestore(budget);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_restore_returns_to_each_backup);
+    RUN_TEST(test_next_backup_writes_only_changes);
+    RUN_TEST(test_damaged_chunk_refuses_restore);
+    RUN_TEST(test_power_cut_during_restore_keeps_a_whole_archive);
+    return UNITY_END();
+}
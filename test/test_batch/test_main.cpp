@@ -0,0 +1,59 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Batches
+ *
+ * Batches committed as one journal record, applied whole or not at all
+ */
+
+#include "../test_support.h"
+
+static int nextEntry = 0;
+
+void setUp() {
+    freshDatabase();
+    nextEntry = 0;
+}
+
+void tearDown() {
+}
+
+static LogEntry nextLogEntry() {
+    int i = nextEntry++;
+    return makeEntry(i, 1700000000 - 3600 + i * 7);
+}
+
+static void test_torn_batch_is_all_or_nothing() {
+    for (int i = 0; i < 30; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(nextLogEntry()));
+    }
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    std::string before = describeHot();
+
+    DatabaseBatch batch;
+    for (int i = 0; i < 40; i++) {
+        batch.add(nextLogEntry());
+    }
+    batch.remove(2);
+    batch.update(0, nextLogEntry());
+    TEST_ASSERT_TRUE(Database::commit(batch));
+    std::string after = describeHot();
+    TEST_ASSERT_TRUE(NativeStorage::save("batch"));
+    int length = StorageHAL::getFileSize(DATABASE_JOURNAL_FILENAME);
+
+    int kept = 0;
+    for (int cut = 0; cut <= length; cut += cut < 32 || length - cut < 32 ? 1 : 5) {
+        TEST_ASSERT_TRUE(NativeStorage::load("batch"));
+        TEST_ASSERT_TRUE(StorageHAL::truncateFile(DATABASE_JOURNAL_FILENAME, cut));
+        reboot();
+        std::string state = describeHot();
+        TEST_ASSERT_TRUE_MESSAGE(state == before || state == after, "torn batch applied in part");
+        kept += state == after;
+    }
+    TEST_ASSERT_EQUAL(1, kept);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_torn_batch_is_all_or_nothing);
+    return UNITY_END();
+}
@@ -0,0 +1,152 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Bitmaps
+ *
+ * Bitmap operations and serialization checked against a set, and searches
+ * over the bitmap indexes checked against a scan
+ */
+
+#include "../test_support.h"
+#include "data/search.h"
+#include <random>
+#include <set>
+
+static std::mt19937 rng(4);
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+}
+
+static void assertSame(const Bitmap& bitmap, const std::set<uint32_t>& expected) {
+    std::vector<uint32_t> positions;
+    bitmap.toPositions(positions);
+    TEST_ASSERT_EQUAL(expected.size(), bitmap.cardinality());
+    TEST_ASSERT_TRUE(positions == std::vector<uint32_t>(expected.begin(), expected.end()));
+    for (uint32_t position : expected) {
+        TEST_ASSERT_TRUE(bitmap.contains(position));
+    }
+}
+
+static void test_bitmap_matches_set() {
+    for (int round = 0; round < 200; round++) {
+        Bitmap bitmap;
+        std::set<uint32_t> expected;
+        uint32_t range = 1 + rng() % 3000;
+
+        for (int op = 0; op < 2000; op++) {
+            int kind = rng() % 10;
+            uint32_t position = rng() % range;
+            if (kind < 5) {
+                bitmap.add(position);
+                expected.insert(position);
+            } else if (kind < 7) {
+                bitmap.remove(position);
+                expected.erase(position);
+            } else if (kind < 8) {
+                bitmap.removeAndShift(position);
+                std::set<uint32_t> shifted;
+                for (uint32_t p : expected) {
+                    if (p != position) {
+                        shifted.insert(p < position ? p : p - 1);
+                    }
+                }
+                expected = shifted;
+            } else {
+                Bitmap other;
+                std::set<uint32_t> otherExpected;
+                for (uint32_t k = rng() % range; k > 0; k--) {
+                    uint32_t p = rng() % range;
+                    other.add(p);
+                    otherExpected.insert(p);
+                }
+                if (kind < 9) {
+                    bitmap.intersectWith(other);
+                    std::set<uint32_t> both;
+                    for (uint32_t p : expected) {
+                        if (otherExpected.count(p)) {
+                            both.insert(p);
+                        }
+                    }
+                    expected = both;
+                } else {
+                    bitmap.unionWith(other);
+                    expected.insert(otherExpected.begin(), otherExpected.end());
+                }
+            }
+        }
+        assertSame(bitmap, expected);
+
+        // Saved and loaded, sparse or dense
+        std::vector<uint8_t> saved;
+        bitmap.serialize(saved);
+        const uint8_t* p = saved.data();
+        Bitmap loaded;
+        TEST_ASSERT_TRUE(loaded.deserialize(p, saved.data() + saved.size()));
+        TEST_ASSERT_TRUE(p == saved.data() + saved.size());
+        assertSame(loaded, expected);
+    }
+
+    Bitmap all;
+    all.addRange(70);
+    TEST_ASSERT_EQUAL(70, all.cardinality());
+    TEST_ASSERT_TRUE(all.contains(69));
+    TEST_ASSERT_FALSE(all.contains(70));
+}
+
+static void test_categorical_searches_match_scan() {
+    static const char* const colors[] = {"red", "BLUE", "navy", "white", "e"};
+    for (int i = 0; i < MAX_LOG_ENTRIES; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(makeEntry(rng() % 500, 1700000000 + i * 60)));
+    }
+    for (int i = 0; i < 50; i++) {
+        TEST_ASSERT_TRUE(Database::deleteEntry(rng() % Database::getEntryCount()));
+    }
+    std::vector<LogEntry> all = Database::getAllEntries();
+
+    for (int query = 0; query < 200; query++) {
+        std::vector<SearchFilter> filters;
+        if (rng() % 2) {
+            filters.push_back(SearchFilter::createGenderFilter((Gender)(rng() % 4)));
+        }
+        if (rng() % 2) {
+            filters.push_back(SearchFilter::createItemTypeFilter((ItemType)(rng() % 7)));
+        }
+        if (rng() % 2) {
+            filters.push_back(SearchFilter::createShirtColorFilter(colors[rng() % 5]));
+        }
+        if (rng() % 3 == 0) {
+            filters.push_back(SearchFilter::createPantsColorFilter(colors[rng() % 5]));
+        }
+        if (rng() % 3 == 0) {
+            time_t start = 1700000000 + (time_t)(rng() % 60000);
+            filters.push_back(SearchFilter::createDateRangeFilter(start, start + 10000));
+        }
+
+        std::vector<LogEntry> expected;
+        for (const LogEntry& entry : all) {
+            bool matched = true;
+            for (const SearchFilter& filter : filters) {
+                matched = matched && SearchEngine::matches(entry, filter);
+            }
+            if (matched) {
+                expected.push_back(entry);
+            }
+        }
+
+        std::vector<LogEntry> found = SearchEngine::select(filters).materialize();
+        TEST_ASSERT_EQUAL(expected.size(), found.size());
+        for (size_t i = 0; i < found.size(); i++) {
+            TEST_ASSERT_EQUAL_STRING(describe(expected[i]).c_str(), describe(found[i]).c_str());
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_bitmap_matches_set);
+    RUN_TEST(test_categorical_searches_match_scan);
+    return UNITY_END();
+}
@@ -0,0 +1,186 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Near Color Search
+ *
+ * The CIELAB batch kernels against the scalar distance, near color lookups
+ * against a brute-force scan as entries change, and the allocations a
+ * lookup takes at 50k entries
+ */
+
+#include "../test_support.h"
+#include "data/color_lab.h"
+#include <cmath>
+#include <random>
+
+static std::mt19937 rng(25);
+
+static const size_t BENCH_ENTRIES = 50000;
+
+// Allocations a count may take growing its match buffer, and a lookup
+// growing that and the bitmap it fills, however many entries they find
+static const size_t COUNT_ALLOCATION_LIMIT = 16;
+static const size_t LOOKUP_ALLOCATION_LIMIT = 64;
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+}
+
+// Entries with skewed fields, so filters range from rare to common
+static LogEntry queryEntry(int i) {
+    static const char* const colors[] = {"Red", "Dark Red", "Blue", "Navy Blue", "Black", "White", "Green"};
+    static const char* const items[] = {"Wallet", "Phone case", "Headphones", "Lipstick", "Sunglasses",
+                                        "Jacket", "Candy bar", "Charger", "Watch", "Perfume"};
+
+    LogEntry entry((time_t)(1700000000 + i * 864));
+    entry.setGender(i % 10 ? GENDER_MALE : GENDER_FEMALE);
+    entry.setItemType(i % 5 ? ITEM_CLOTHING : (ItemType)(2 + i % 5));
+    entry.setShirtColor(Color(colors[(i * i) % 7 % (i % 3 ? 1 : 7)], 0x010101u * (rng() % 256)));
+    entry.setPantsColor(Color(colors[(i / 3) % 7], rng() & 0xFFFFFF));
+    entry.setShoesColor(Color(i % 5 ? colors[(i / 5) % 7] : "", 0));
+    entry.setItemDescription((String(items[i % 10]) + " #" + String(i)).c_str());
+    if (i % 3) {
+        entry.setNotes((String("Left via exit ") + String(i % 5)).c_str());
+    }
+    return entry;
+}
+
+// Kept within the hot tier, which the index covers
+static void addQueryEntries(int count) {
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(queryEntry(i)));
+    }
+    for (int i = 0; i < count / 20; i++) {
+        TEST_ASSERT_TRUE(Database::deleteEntry((i * 37) % Database::getEntryCount()));
+    }
+}
+
+// Positions whose stored color lies within the distance, by brute force
+static std::vector<uint32_t> scanColorNear(const EntryTable& entries, IndexedColor attribute, uint32_t rgb,
+                                           float maxDistance) {
+    LabColor target = ColorLab::fromRgb(rgb);
+    std::vector<uint32_t> positions;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const String& name = entries.getColorName(attribute, i);
+        if (name.isEmpty() || name == "Unknown") {
+            continue;
+        }
+        if (ColorLab::distance(ColorLab::fromRgb(entries.getColorRgb(attribute, i)), target) <= maxDistance) {
+            positions.push_back(i);
+        }
+    }
+    return positions;
+}
+
+static void checkColorNear(const EntryTable& entries, const EntryIndex& index) {
+    for (int query = 0; query < 40; query++) {
+        uint32_t rgb = rng() & 0xFFFFFF;
+        float maxDistance = (float)(rng() % 40);
+        IndexedColor attribute = (IndexedColor)(rng() % INDEX_COLOR_COUNT);
+
+        Bitmap found;
+        index.getByColorNear(attribute, rgb, maxDistance, found);
+        std::vector<uint32_t> positions;
+        found.toPositions(positions);
+        TEST_ASSERT_TRUE(positions == scanColorNear(entries, attribute, rgb, maxDistance));
+        TEST_ASSERT_EQUAL(positions.size(), index.countByColorNear(attribute, rgb, maxDistance));
+    }
+}
+
+static void test_kernels_match_scalar_distance() {
+    const size_t count = 1000;
+    std::vector<float> l(count), a(count), b(count);
+    std::vector<LabColor> colors(count);
+    for (size_t i = 0; i < count; i++) {
+        colors[i] = ColorLab::fromRgb(rng() & 0xFFFFFF);
+        l[i] = colors[i].l;
+        a[i] = colors[i].a;
+        b[i] = colors[i].b;
+    }
+
+    std::vector<float> distances(count);
+    std::vector<uint32_t> matches(count);
+    for (int query = 0; query < 50; query++) {
+        LabColor target = ColorLab::fromRgb(rng() & 0xFFFFFF);
+        float maxDistance = (float)(rng() % 60);
+        // Odd counts leave a partial batch at the end
+        size_t n = count - rng() % 40;
+
+        ColorLab::distancesSquared(l.data(), a.data(), b.data(), n, target, distances.data());
+        size_t found = ColorLab::findWithin(l.data(), a.data(), b.data(), n, target, maxDistance, matches.data());
+        size_t next = 0;
+        for (size_t i = 0; i < n; i++) {
+            float distance = ColorLab::distance(colors[i], target);
+            TEST_ASSERT_TRUE(fabsf(sqrtf(distances[i]) - distance) <= 1e-3f);
+            if (distances[i] <= maxDistance * maxDistance) {
+                TEST_ASSERT_TRUE(next < found);
+                TEST_ASSERT_EQUAL(i, matches[next++]);
+            }
+        }
+        TEST_ASSERT_EQUAL(next, found);
+    }
+}
+
+static void test_color_near_matches_scan() {
+    LabColor navy = ColorLab::fromRgb(0x000080);
+    TEST_ASSERT_TRUE(ColorLab::distance(navy, ColorLab::fromRgb(0x00008B)) < COLOR_NEAR_DISTANCE);
+    TEST_ASSERT_TRUE(ColorLab::distance(navy, ColorLab::fromRgb(0x000000)) > COLOR_NEAR_DISTANCE);
+
+    addQueryEntries(MAX_LOG_ENTRIES);
+    checkColorNear(Database::getEntries(), Database::getIndex());
+
+    for (int i = 0; i < 300; i++) {
+        size_t count = Database::getEntryCount();
+        if (i % 3) {
+            TEST_ASSERT_TRUE(Database::updateEntry(rng() % count, queryEntry(5000 + i)));
+        } else {
+            TEST_ASSERT_TRUE(Database::deleteEntry(rng() % count));
+        }
+    }
+    checkColorNear(Database::getEntries(), Database::getIndex());
+
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    reboot();
+    checkColorNear(Database::getEntries(), Database::getIndex());
+}
+
+static void test_lookup_at_50k_entries() {
+    EntryTable entries;
+    for (size_t i = 0; i < BENCH_ENTRIES; i++) {
+        entries.add(queryEntry(i));
+    }
+    EntryIndex index;
+    index.rebuild(entries);
+    checkColorNear(entries, index);
+
+    // The allocations stay bounded whether a lookup finds nothing or a
+    // third of the entries
+    Bitmap found;
+    for (int query = 0; query < 20; query++) {
+        uint32_t rgb = rng() & 0xFFFFFF;
+        IndexedColor attribute = query % 2 ? INDEX_COLOR_PANTS : INDEX_COLOR_SHIRT;
+        std::vector<uint32_t> expected = scanColorNear(entries, attribute, rgb, COLOR_NEAR_DISTANCE);
+
+        NativeHeap::reset();
+        size_t count = index.countByColorNear(attribute, rgb, COLOR_NEAR_DISTANCE);
+        size_t countAllocations = NativeHeap::getAllocations();
+        NativeHeap::reset();
+        index.getByColorNear(attribute, rgb, COLOR_NEAR_DISTANCE, found);
+        size_t findAllocations = NativeHeap::getAllocations();
+
+        TEST_ASSERT_EQUAL(expected.size(), count);
+        TEST_ASSERT_EQUAL(expected.size(), found.cardinality());
+        TEST_ASSERT_LESS_OR_EQUAL(COUNT_ALLOCATION_LIMIT, countAllocations);
+        TEST_ASSERT_LESS_OR_EQUAL(LOOKUP_ALLOCATION_LIMIT, findAllocations);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_kernels_match_scalar_distance);
+    RUN_TEST(test_color_near_matches_scan);
+    RUN_TEST(test_lookup_at_50k_entries);
+    return UNITY_END();
+}
@@ -0,0 +1,110 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Journal
+ *
+ * Background compaction of journal segments, and changes that fail to
+ * save leaving memory as stored
+ */
+
+#include "../test_support.h"
+#include <random>
+
+static std::mt19937 rng(11);
+static int nextEntry = 0;
+
+void setUp() {
+    freshDatabase();
+    nextEntry = 0;
+}
+
+void tearDown() {
+    NativeStorage::setWriteBudget(-1);
+}
+
+static LogEntry nextLogEntry() {
+    int i = nextEntry++;
+    return makeEntry(i, 1700000000 - 3600 + i * 7);
+}
+
+// One random change to the database, as the UI would make it
+static bool randomChange() {
+    size_t count = Database::getEntryCount();
+    int r = rng() % 100;
+    if (r < 50 || count == 0) {
+        return Database::addEntry(nextLogEntry());
+    }
+    if (r < 70) {
+        return Database::updateEntry(rng() % count, nextLogEntry());
+    }
+    if (r < 85) {
+        return Database::deleteEntry(rng() % count);
+    }
+    if (r < 92) {
+        DatabaseBatch batch;
+        for (int i = 0; i < 5; i++) {
+            batch.add(nextLogEntry());
+        }
+        batch.remove(rng() % count);
+        return Database::commit(batch);
+    }
+    if (r < 96) {
+        return Database::checkpoint();
+    }
+    Database::compactStep(1);
+    return true;
+}
+
+static void test_compaction_keeps_every_entry() {
+    for (int step = 0; step < 2000; step++) {
+        TEST_ASSERT_TRUE(randomChange());
+        if (step % 5 == 0) {
+            Database::compactStep(0);
+        }
+        if (step % 250 == 0) {
+            std::string state = describeHot();
+            reboot();
+            TEST_ASSERT_EQUAL_STRING(state.c_str(), describeHot().c_str());
+        }
+    }
+    while (Database::needsCompaction()) {
+        Database::compactStep();
+    }
+    std::string state = describeHot();
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(state.c_str(), describeHot().c_str());
+}
+
+static void test_failed_save_leaves_memory_as_stored() {
+    for (int i = 0; i < 30; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(nextLogEntry()));
+    }
+    std::string stored = describeHot();
+    uint32_t counted = Database::getStats().count(TIME_MIN, TIME_MAX);
+
+    // With nothing written, every change fails and leaves no trace
+    NativeStorage::setWriteBudget(0);
+    TEST_ASSERT_FALSE(Database::addEntry(nextLogEntry()));
+    TEST_ASSERT_FALSE(Database::updateEntry(3, nextLogEntry()));
+    TEST_ASSERT_FALSE(Database::deleteEntry(5));
+    NativeStorage::setWriteBudget(-1);
+    TEST_ASSERT_EQUAL_STRING(stored.c_str(), describeHot().c_str());
+    TEST_ASSERT_EQUAL(counted, Database::getStats().count(TIME_MIN, TIME_MAX));
+    TEST_ASSERT_EQUAL(30, Database::getIndex().size());
+
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(stored.c_str(), describeHot().c_str());
+
+    // Changes made before anything else loads the database load it first
+    simulateReboot();
+    TEST_ASSERT_TRUE(Database::updateEntry(3, nextLogEntry()));
+    simulateReboot();
+    TEST_ASSERT_TRUE(Database::deleteEntry(5));
+    TEST_ASSERT_EQUAL(29, Database::getEntryCount());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_compaction_keeps_every_entry);
+    RUN_TEST(test_failed_save_leaves_memory_as_stored);
+    return UNITY_END();
+}
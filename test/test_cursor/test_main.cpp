@@ -0,0 +1,200 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Entry Cursor
+ *
+ * Paging through 50k entries across the hot tier and the archive, both
+ * ways and in both orders, and paging on while entries are added
+ */
+
+#include "../test_support.h"
+#include <random>
+#include <set>
+
+static std::mt19937 rng(10);
+
+static const int CURSOR_ENTRIES = 50000;
+static const size_t PAGE_SIZE = 20;
+static const time_t FIRST_TIME = 1700000000;
+
+// Heap one page may take, enough to decode one archive segment and far
+// below what the 50k entries would take
+static const size_t PAGE_HEAP_LIMIT = 128 * 1024;
+static const size_t PAGE_ALLOCATION_LIMIT = 512;
+
+void setUp() {
+    freshDatabase(FIRST_TIME + CURSOR_ENTRIES * 60);
+}
+
+void tearDown() {
+}
+
+// Unique timestamps, a few of them out of insertion order
+static time_t entryTime(int i) {
+    return FIRST_TIME + i * 60 + (i % 50 == 7 ? -300 : 0);
+}
+
+// Fill both tiers: the newest entries stay in memory, the rest are archived
+static void addCursorEntries() {
+    for (int first = 0; first < CURSOR_ENTRIES; first += 1000) {
+        DatabaseBatch batch;
+        for (int i = first; i < first + 1000; i++) {
+            batch.add(makeEntry(i, entryTime(i)));
+        }
+        TEST_ASSERT_TRUE(Database::commit(batch));
+        while (Database::needsArchive()) {
+            TEST_ASSERT_TRUE(Database::archiveStep());
+        }
+    }
+    TEST_ASSERT_EQUAL(CURSOR_ENTRIES, Database::getTotalEntryCount());
+    TEST_ASSERT_TRUE(Database::getEntryCount() <= MAX_LOG_ENTRIES);
+    TEST_ASSERT_TRUE(Archive::getEntryCount() > 0);
+}
+
+static std::vector<uint64_t> idsOf(const ResultSet& page) {
+    std::vector<uint64_t> ids;
+    page.forEach([&ids](const LogEntry& entry) {
+        ids.push_back(entry.getId());
+    });
+    return ids;
+}
+
+// Entries in the order a newest-first walk should return them: memory by
+// timestamp, then the archive from the last retired
+static std::vector<uint64_t> expectedNewestFirst() {
+    std::vector<std::pair<time_t, uint64_t>> hot;
+    const EntryTable& entries = Database::getEntries();
+    for (size_t i = 0; i < entries.size(); i++) {
+        hot.push_back(std::make_pair(entries.getTimestamp(i), entries.getId(i)));
+    }
+    std::sort(hot.rbegin(), hot.rend());
+
+    std::vector<uint64_t> ids;
+    for (const auto& entry : hot) {
+        ids.push_back(entry.second);
+    }
+    std::vector<uint64_t> archived;
+    Archive::forEach(TIME_MIN, TIME_MAX, [&archived](const LogEntry& entry) {
+        archived.push_back(entry.getId());
+        return true;
+    });
+    ids.insert(ids.end(), archived.rbegin(), archived.rend());
+    return ids;
+}
+
+static void assertNoGapsOrDuplicates(const std::vector<uint64_t>& ids, size_t count) {
+    std::set<uint64_t> unique(ids.begin(), ids.end());
+    TEST_ASSERT_EQUAL(ids.size(), unique.size());
+    TEST_ASSERT_EQUAL(count, unique.size());
+}
+
+static void test_walks_50k_entries_both_ways() {
+    addCursorEntries();
+    std::vector<uint64_t> expected = expectedNewestFirst();
+    assertNoGapsOrDuplicates(expected, CURSOR_ENTRIES);
+
+    // Forward, newest first, with no page over the limit. Pages fall short
+    // only where memory gives way to the archive and at the end. Each page
+    // takes the same bounded heap wherever it lies
+    EntryCursor cursor(ORDER_NEWEST_FIRST);
+    ResultSet page;
+    std::vector<std::vector<uint64_t>> pages;
+    std::vector<uint64_t> walked;
+    size_t shortPages = 0;
+    for (;;) {
+        size_t inUse = NativeHeap::getInUse();
+        NativeHeap::reset();
+        bool found = cursor.next(PAGE_SIZE, page);
+        TEST_ASSERT_LESS_OR_EQUAL(PAGE_ALLOCATION_LIMIT, NativeHeap::getAllocations());
+        TEST_ASSERT_LESS_OR_EQUAL(inUse + PAGE_HEAP_LIMIT, NativeHeap::getPeak());
+        if (!found) {
+            break;
+        }
+
+        pages.push_back(idsOf(page));
+        TEST_ASSERT_TRUE(pages.back().size() <= PAGE_SIZE);
+        shortPages += pages.back().size() < PAGE_SIZE;
+        walked.insert(walked.end(), pages.back().begin(), pages.back().end());
+    }
+    TEST_ASSERT_TRUE(shortPages <= 2);
+    TEST_ASSERT_TRUE(walked == expected);
+
+    // Back again, page by page, to the first
+    for (size_t i = pages.size() - 1; i-- > 0;) {
+        TEST_ASSERT_TRUE(cursor.previous(PAGE_SIZE, page));
+        TEST_ASSERT_TRUE(idsOf(page) == pages[i]);
+    }
+    TEST_ASSERT_FALSE(cursor.previous(PAGE_SIZE, page));
+
+    // Oldest first is the same walk reversed, and back again the same way
+    EntryCursor oldest(ORDER_OLDEST_FIRST);
+    std::vector<std::vector<uint64_t>> oldestPages;
+    walked.clear();
+    while (oldest.next(PAGE_SIZE, page)) {
+        oldestPages.push_back(idsOf(page));
+        walked.insert(walked.end(), oldestPages.back().begin(), oldestPages.back().end());
+    }
+    TEST_ASSERT_TRUE(walked == std::vector<uint64_t>(expected.rbegin(), expected.rend()));
+    for (size_t i = oldestPages.size() - 1; i-- > 0;) {
+        TEST_ASSERT_TRUE(oldest.previous(PAGE_SIZE, page));
+        TEST_ASSERT_TRUE(idsOf(page) == oldestPages[i]);
+    }
+
+    // A token for a page, in memory or archived, reopens it on a new cursor
+    for (size_t target : {(size_t)3, pages.size() - 3}) {
+        EntryCursor first(ORDER_NEWEST_FIRST);
+        for (size_t i = 0; i <= target; i++) {
+            TEST_ASSERT_TRUE(first.next(PAGE_SIZE, page));
+        }
+        PageToken token;
+        TEST_ASSERT_TRUE(first.getToken(token));
+        EntryCursor resumed(ORDER_NEWEST_FIRST);
+        resumed.seek(token);
+        TEST_ASSERT_TRUE(resumed.next(PAGE_SIZE, page));
+        TEST_ASSERT_TRUE(idsOf(page) == pages[target]);
+        TEST_ASSERT_TRUE(resumed.next(PAGE_SIZE, page));
+        TEST_ASSERT_TRUE(idsOf(page) == pages[target + 1]);
+    }
+}
+
+static void test_cursor_survives_adds_between_pages() {
+    addCursorEntries();
+    size_t total = Database::getTotalEntryCount();
+
+    EntryCursor cursor(ORDER_NEWEST_FIRST);
+    ResultSet page;
+    std::vector<uint64_t> walked;
+    std::vector<uint64_t> added;
+    time_t newest = entryTime(CURSOR_ENTRIES);
+    for (int pages = 0; cursor.next(PAGE_SIZE, page); pages++) {
+        std::vector<uint64_t> ids = idsOf(page);
+        walked.insert(walked.end(), ids.begin(), ids.end());
+
+        // While still in memory, add an entry ahead of the cursor, already
+        // passed, and one behind it, still to come
+        if (pages < 20) {
+            LogEntry last = page.at(page.size() - 1);
+            TEST_ASSERT_TRUE(Database::addEntry(makeEntry(pages, newest++)));
+            LogEntry behind = makeEntry(pages, last.getTimestamp() - 1 - rng() % 30);
+            behind.setId(Database::generateId());
+            TEST_ASSERT_TRUE(Database::addEntry(behind));
+            added.push_back(behind.getId());
+            total += 2;
+        }
+    }
+
+    // Every entry that was there when the walk passed its place is seen
+    // once; those added behind the cursor are among them
+    std::set<uint64_t> unique(walked.begin(), walked.end());
+    TEST_ASSERT_EQUAL(walked.size(), unique.size());
+    TEST_ASSERT_EQUAL(total - 20, walked.size());
+    for (uint64_t id : added) {
+        TEST_ASSERT_EQUAL(1, unique.count(id));
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_walks_50k_entries_both_ways);
+    RUN_TEST(test_cursor_survives_adds_between_pages);
+    return UNITY_END();
+}
@@ -0,0 +1,153 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Entry and File Formats
+ *
+ * Binary entry records, their size and load cost, and the migration of
+ * legacy text databases
+ */
+
+#include "../test_support.h"
+#include <random>
+
+static std::mt19937 rng(2);
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+}
+
+static std::string randomText(size_t maxLength) {
+    static const char alphabet[] = "abcXYZ 019|-_,.;\"'\xC3\xA9";
+    std::string text(rng() % (maxLength + 1), ' ');
+    for (char& c : text) {
+        c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    }
+    return text;
+}
+
+// Entries with random fields, including text at and over the stored limits
+static LogEntry randomEntry(bool textSafe) {
+    LogEntry entry((time_t)(int32_t)rng());
+    entry.setId(((uint64_t)rng() << 32) | rng());
+    entry.setGender((Gender)(rng() % 4));
+    entry.setItemType((ItemType)(rng() % 7));
+
+    // The text format keeps '|' only in the notes, the last field
+    auto text = [&](size_t maxLength, bool pipes) {
+        std::string s = randomText(maxLength);
+        if (!pipes) {
+            std::replace(s.begin(), s.end(), '|', '/');
+        }
+        return String(s.c_str());
+    };
+    entry.setShirtColor(Color(text(MAX_COLOR_NAME_LENGTH + 4, !textSafe), rng() & 0xFFFFFF));
+    entry.setPantsColor(Color(text(MAX_COLOR_NAME_LENGTH, !textSafe), rng() & 0xFFFFFF));
+    entry.setShoesColor(Color(text(8, !textSafe), rng() & 0xFFFFFF));
+    entry.setItemDescription(text(MAX_ITEM_DESCRIPTION_LENGTH + 10, !textSafe));
+    entry.setNotes(text(MAX_NOTES_LENGTH + 10, true));
+    return entry;
+}
+
+static void test_binary_record_round_trip() {
+    std::vector<uint8_t> buffer;
+    for (int i = 0; i < 2000; i++) {
+        LogEntry entry = randomEntry(false);
+        size_t size = entry.getBinarySize();
+        buffer.assign(size + 16, 0xEE);
+
+        TEST_ASSERT_EQUAL(0, entry.serializeBinary(buffer.data(), size - 1));
+        TEST_ASSERT_EQUAL(size, entry.serializeBinary(buffer.data(), buffer.size()));
+
+        LogEntry decoded;
+        TEST_ASSERT_TRUE(decoded.deserializeBinary(buffer.data(), size));
+        TEST_ASSERT_EQUAL_STRING(describe(entry).c_str(), describe(decoded).c_str());
+
+        // A record cut short is refused, except one that ends where records
+        // saved before IDs did
+        TEST_ASSERT_FALSE(decoded.deserializeBinary(buffer.data(), rng() % (size - 8)));
+        TEST_ASSERT_TRUE(decoded.deserializeBinary(buffer.data(), size - 8));
+        TEST_ASSERT_EQUAL_UINT64(0, decoded.getId());
+    }
+}
+
+static void test_records_load_without_allocating() {
+    // Each record is encoded and decoded in place
+    std::vector<uint8_t> buffer;
+    size_t binaryBytes = 0;
+    size_t textBytes = 0;
+    for (int i = 0; i < 1000; i++) {
+        LogEntry entry = makeEntry(i, 1700000000 + i * 60);
+        entry.setId(i + 1);
+        buffer.assign(entry.getBinarySize(), 0);
+        binaryBytes += buffer.size();
+        textBytes += entry.serialize().length() + 1;
+
+        LogEntry decoded;
+        NativeHeap::reset();
+        TEST_ASSERT_EQUAL(buffer.size(), entry.serializeBinary(buffer.data(), buffer.size()));
+        TEST_ASSERT_TRUE(decoded.deserializeBinary(buffer.data(), buffer.size()));
+        TEST_ASSERT_EQUAL(0, NativeHeap::getAllocations());
+        TEST_ASSERT_EQUAL_STRING(describe(entry).c_str(), describe(decoded).c_str());
+    }
+
+    // The ID aside, a record takes no more room than its text line
+    TEST_ASSERT_LESS_OR_EQUAL(textBytes, binaryBytes - 1000 * sizeof(uint64_t));
+
+    // A boot allocates for the table and its indexes, not per field of each
+    // record as the text loader did
+    DatabaseBatch batch;
+    for (int i = 0; i < 1000; i++) {
+        batch.add(makeEntry(i, 1700000000 + i * 60));
+    }
+    TEST_ASSERT_TRUE(Database::commit(batch));
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    std::string saved = describeHot();
+    simulateReboot();
+    NativeHeap::reset();
+    TEST_ASSERT_TRUE(Database::init());
+    TEST_ASSERT_LESS_OR_EQUAL(2 * 1000, NativeHeap::getAllocations());
+    TEST_ASSERT_EQUAL_STRING(saved.c_str(), describeHot().c_str());
+}
+
+static void test_legacy_text_database_is_migrated() {
+    std::string text;
+    std::vector<std::string> lines;
+    for (int i = 0; i < 300; i++) {
+        LogEntry entry = makeEntry(i, 1700000000 - 86400 + i * 60);
+        lines.push_back(entry.serialize().c_str());
+        text += lines.back() + "\n";
+    }
+    TEST_ASSERT_EQUAL(text.size(), StorageHAL::writeFile(DATABASE_FILENAME, text.data(), text.size()));
+
+    // Loaded from text, given IDs and saved in the binary format
+    reboot();
+    TEST_ASSERT_EQUAL(lines.size(), Database::getEntryCount());
+    std::vector<uint64_t> ids;
+    for (size_t i = 0; i < lines.size(); i++) {
+        LogEntry entry;
+        TEST_ASSERT_TRUE(Database::getEntry(i, entry));
+        TEST_ASSERT_EQUAL_STRING(lines[i].c_str(), entry.serialize().c_str());
+        TEST_ASSERT_TRUE(entry.getId() != 0);
+        ids.push_back(entry.getId());
+    }
+    std::sort(ids.begin(), ids.end());
+    TEST_ASSERT_TRUE(std::unique(ids.begin(), ids.end()) == ids.end());
+
+    char magic[5];
+    TEST_ASSERT_EQUAL(4, StorageHAL::readFile(DATABASE_FILENAME, magic, sizeof(magic)));
+    TEST_ASSERT_EQUAL_STRING("LPDB", magic);
+
+    std::string migrated = describeHot();
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(migrated.c_str(), describeHot().c_str());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_binary_record_round_trip);
+    RUN_TEST(test_records_load_without_allocating);
+    RUN_TEST(test_legacy_text_database_is_migrated);
+    return UNITY_END();
+}
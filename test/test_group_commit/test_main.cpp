@@ -0,0 +1,95 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Group Commit
+ *
+ * Changes held for the commit window, lost only until they are flushed
+ */
+
+#include "../test_support.h"
+#include <random>
+
+static std::mt19937 rng(21);
+static int nextEntry = 0;
+
+void setUp() {
+    freshDatabase();
+    nextEntry = 0;
+}
+
+void tearDown() {
+}
+
+static LogEntry nextLogEntry() {
+    int i = nextEntry++;
+    return makeEntry(i, 1700000000 - 3600 + i * 7);
+}
+
+// One random change to the database, as the UI would make it
+static bool randomChange() {
+    size_t count = Database::getEntryCount();
+    int r = rng() % 100;
+    if (r < 50 || count == 0) {
+        return Database::addEntry(nextLogEntry());
+    }
+    if (r < 70) {
+        return Database::updateEntry(rng() % count, nextLogEntry());
+    }
+    if (r < 85) {
+        return Database::deleteEntry(rng() % count);
+    }
+    if (r < 92) {
+        DatabaseBatch batch;
+        for (int i = 0; i < 5; i++) {
+            batch.add(nextLogEntry());
+        }
+        batch.remove(rng() % count);
+        return Database::commit(batch);
+    }
+    if (r < 96) {
+        return Database::checkpoint();
+    }
+    Database::compactStep(1);
+    return true;
+}
+
+static void test_group_commit_holds_changes_until_flush() {
+    Database::setCommitWindow(60000);
+    TEST_ASSERT_TRUE(Database::addEntry(nextLogEntry()));
+    TEST_ASSERT_TRUE(Database::addEntry(nextLogEntry()));
+    TEST_ASSERT_FALSE(Database::needsFlush());
+    TEST_ASSERT_TRUE(Database::flush());
+    std::string durable = describeHot();
+
+    // Held changes are lost by a power cut, flushed ones never are
+    TEST_ASSERT_TRUE(Database::addEntry(nextLogEntry()));
+    TEST_ASSERT_TRUE(Database::deleteEntry(0));
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(durable.c_str(), describeHot().c_str());
+
+    for (int step = 0; step < 1000; step++) {
+        TEST_ASSERT_TRUE(randomChange());
+        if (step % 7 == 0) {
+            TEST_ASSERT_TRUE(Database::flush());
+        }
+        if (DatabaseTestHooks::getHeldChanges() == 0) {
+            durable = describeHot();
+        }
+        if (step % 97 == 0) {
+            reboot();
+            TEST_ASSERT_EQUAL_STRING(durable.c_str(), describeHot().c_str());
+        }
+    }
+
+    // Going back to write-through flushes what is held
+    TEST_ASSERT_TRUE(Database::addEntry(nextLogEntry()));
+    Database::setCommitWindow(0);
+    std::string state = describeHot();
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(state.c_str(), describeHot().c_str());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_group_commit_holds_changes_until_flush);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Entry IDs
+ *
+ * The ID hash map against std::unordered_map, and stable entry IDs through
+ * edits, batches, compaction and reboots
+ */
+
+#include "../test_support.h"
+#include "data/database_batch.h"
+#include <random>
+#include <unordered_map>
+
+static std::mt19937_64 rng(3);
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+}
+
+static void test_id_map_matches_unordered_map() {
+    IdMap map;
+    std::unordered_map<uint64_t, uint32_t> expected;
+    std::vector<uint64_t> ids;
+
+    for (int step = 0; step < 400000; step++) {
+        int kind = rng() % 10;
+        if (kind < 5 || ids.empty()) {
+            // IDs built like generated ones, clustered by second, and small ones
+            uint64_t id = rng() % 3 == 0 ? ((uint64_t)(1700000000 + rng() % 1000) << 32) + rng() % 4 : 1 + rng() % 5000;
+            uint32_t position = rng();
+            map.insert(id, position);
+            expected[id] = position;
+            ids.push_back(id);
+        } else if (kind < 8) {
+            uint64_t id = ids[rng() % ids.size()];
+            TEST_ASSERT_EQUAL(expected.erase(id) > 0, map.erase(id));
+        } else {
+            uint64_t id = ids[rng() % ids.size()];
+            uint32_t position;
+            auto it = expected.find(id);
+            TEST_ASSERT_EQUAL(it != expected.end(), map.find(id, position));
+            if (it != expected.end()) {
+                TEST_ASSERT_EQUAL_UINT32(it->second, position);
+            }
+        }
+
+        if (step % 50000 == 0) {
+            TEST_ASSERT_EQUAL(expected.size(), map.size());
+            for (const auto& item : expected) {
+                uint32_t position;
+                TEST_ASSERT_TRUE(map.find(item.first, position));
+                TEST_ASSERT_EQUAL_UINT32(item.second, position);
+            }
+        }
+        if (step == 300000) {
+            map.clear();
+            expected.clear();
+        }
+    }
+}
+
+static LogEntry randomEntry(int i) {
+    LogEntry entry((time_t)(1700000000 + i * 60));
+    entry.setGender((Gender)(1 + rng() % 3));
+    entry.setItemType((ItemType)(1 + rng() % 6));
+    entry.setShirtColor(Color("Red", rng() & 0xFFFFFF));
+    entry.setItemDescription((String("item ") + String(i)).c_str());
+    return entry;
+}
+
+// What each position should hold: its ID and its fields
+static std::vector<std::pair<uint64_t, std::string>> model;
+
+static void checkModel() {
+    const EntryTable& entries = Database::getEntries();
+    TEST_ASSERT_EQUAL(model.size(), entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        uint64_t id = entries.getId(i);
+        TEST_ASSERT_TRUE(id != 0);
+        TEST_ASSERT_TRUE(id == model[i].first);
+        TEST_ASSERT_EQUAL_STRING(model[i].second.c_str(), entries.get(i).serialize().c_str());
+        if (i > 0) {
+            TEST_ASSERT_TRUE(entries.getId(i - 1) < id);
+        }
+
+        size_t position;
+        TEST_ASSERT_TRUE(Database::findEntry(id, position));
+        TEST_ASSERT_EQUAL(i, position);
+    }
+
+    size_t position;
+    TEST_ASSERT_FALSE(Database::findEntry(12345, position));
+    TEST_ASSERT_FALSE(Database::findEntry(0, position));
+}
+
+static void test_ids_are_stable_through_edits_and_reboots() {
+    model.clear();
+    int next = 0;
+    for (int step = 0; step < 3000; step++) {
+        int kind = rng() % 100;
+        size_t count = model.size();
+
+        // Stay within the hot tier, so no entry is retired underneath the model
+        if (count > MAX_LOG_ENTRIES - 30 && (kind < 40 || (kind >= 75 && kind < 82))) {
+            kind = 60;
+        }
+
+        if (kind < 40 || count == 0) {
+            // An entry carrying an ID already in use is given a fresh one
+            LogEntry entry = randomEntry(next++);
+            if (rng() % 5 == 0 && count > 0) {
+                entry.setId(model[rng() % count].first);
+            }
+            TEST_ASSERT_TRUE(Database::addEntry(entry));
+            model.push_back({Database::getEntries().getId(count), entry.serialize().c_str()});
+        } else if (kind < 55) {
+            // An update keeps the ID, whatever the entry passed in carries
+            size_t i = rng() % count;
+            LogEntry entry = randomEntry(next++);
+            entry.setId(rng());
+            TEST_ASSERT_TRUE(Database::updateEntryById(model[i].first, entry));
+            model[i].second = entry.serialize().c_str();
+        } else if (kind < 70) {
+            size_t i = rng() % count;
+            TEST_ASSERT_TRUE(Database::deleteEntryById(model[i].first));
+            TEST_ASSERT_FALSE(Database::deleteEntryById(model[i].first));
+            model.erase(model.begin() + i);
+        } else if (kind < 75) {
+            size_t i = rng() % count;
+            LogEntry entry;
+            TEST_ASSERT_TRUE(Database::getEntryById(model[i].first, entry));
+            TEST_ASSERT_TRUE(entry.getId() == model[i].first);
+            TEST_ASSERT_EQUAL_STRING(model[i].second.c_str(), entry.serialize().c_str());
+        } else if (kind < 82) {
+            DatabaseBatch batch;
+            std::vector<std::string> added;
+            for (int k = 1 + rng() % 20; k > 0; k--) {
+                LogEntry entry = randomEntry(next++);
+                batch.add(entry);
+                added.push_back(entry.serialize().c_str());
+            }
+            TEST_ASSERT_TRUE(Database::commit(batch));
+            for (size_t k = 0; k < added.size(); k++) {
+                model.push_back({Database::getEntries().getId(count + k), added[k]});
+            }
+        } else if (kind < 88) {
+            while (Database::needsCompaction() && rng() % 3) {
+                Database::compactStep(1);
+            }
+        } else if (kind < 92) {
+            TEST_ASSERT_TRUE(Database::checkpoint());
+        } else if (kind < 96) {
+            reboot();
+        }
+        checkModel();
+    }
+
+    reboot();
+    checkModel();
+}
+
+static void test_entries_without_ids_are_given_them() {
+    // A text import, as exported before entries had IDs
+    String text = "header\n";
+    for (int i = 0; i < 50; i++) {
+        text += randomEntry(i).serialize() + "\n";
+    }
+    TEST_ASSERT_EQUAL(text.length(), StorageHAL::writeFile("/import.txt", text.c_str(), text.length()));
+    TEST_ASSERT_TRUE(Database::importFromFile("/import.txt"));
+
+    const EntryTable& entries = Database::getEntries();
+    TEST_ASSERT_EQUAL(50, entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        TEST_ASSERT_TRUE(entries.getId(i) != 0);
+        if (i > 0) {
+            TEST_ASSERT_TRUE(entries.getId(i - 1) < entries.getId(i));
+        }
+    }
+
+    // Kept across a reboot, and new IDs follow the loaded ones
+    uint64_t last = entries.getId(49);
+    reboot();
+    TEST_ASSERT_TRUE(Database::getEntries().getId(49) == last);
+    TEST_ASSERT_TRUE(Database::addEntry(randomEntry(50)));
+    TEST_ASSERT_TRUE(Database::getEntries().getId(50) > last);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_id_map_matches_unordered_map);
+    RUN_TEST(test_ids_are_stable_through_edits_and_reboots);
+    RUN_TEST(test_entries_without_ids_are_given_them);
+    return UNITY_END();
+}
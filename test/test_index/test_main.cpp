@@ -0,0 +1,195 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Secondary Indexes
+ *
+ * Gender, item type and date range lookups checked against a linear scan,
+ * kept current by each change, and the entries checked and allocations a
+ * lookup takes at 20k entries
+ */
+
+#include "../test_support.h"
+#include <random>
+
+static std::mt19937 rng(6);
+
+static const size_t BENCH_ENTRIES = 20000;
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+}
+
+// Entries spread over about 70 days, out of time order now and then
+static LogEntry indexEntry(int i) {
+    time_t timestamp = 1700000000 + i * 300 - (i % 17 == 0 ? 86400 : 0);
+    return makeEntry(rng() % 1000, timestamp);
+}
+
+static std::vector<uint32_t> positionsOf(const Bitmap& bitmap) {
+    std::vector<uint32_t> positions;
+    bitmap.toPositions(positions);
+    return positions;
+}
+
+static std::vector<uint32_t> scanDateRange(const EntryTable& entries, time_t startTime, time_t endTime) {
+    std::vector<uint32_t> positions;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries.getTimestamp(i) >= startTime && entries.getTimestamp(i) <= endTime) {
+            positions.push_back(i);
+        }
+    }
+    return positions;
+}
+
+// Whether every lookup of the index answers as a scan of the entries does
+static bool matchesScan(const EntryTable& entries, const EntryIndex& index) {
+    if (index.size() != entries.size()) {
+        return false;
+    }
+
+    for (int gender = 0; gender < INDEX_GENDER_COUNT; gender++) {
+        std::vector<uint32_t> expected;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries.getGender(i) == (Gender)gender) {
+                expected.push_back(i);
+            }
+        }
+        if (positionsOf(index.getByGender((Gender)gender)) != expected) {
+            return false;
+        }
+    }
+    for (int itemType = 0; itemType < INDEX_ITEM_TYPE_COUNT; itemType++) {
+        std::vector<uint32_t> expected;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries.getItemType(i) == (ItemType)itemType) {
+                expected.push_back(i);
+            }
+        }
+        if (positionsOf(index.getByItemType((ItemType)itemType)) != expected) {
+            return false;
+        }
+    }
+
+    for (int query = 0; query < 20; query++) {
+        time_t startTime = 1700000000 - 86400 + (time_t)(rng() % (80 * 86400));
+        time_t endTime = startTime + (time_t)(rng() % (8 * 86400));
+        std::vector<uint32_t> positions;
+        index.getByDateRange(startTime, endTime, positions);
+        std::vector<uint32_t> expected = scanDateRange(entries, startTime, endTime);
+        if (positions != expected || index.countByDateRange(startTime, endTime) != expected.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_database_queries_match_scan() {
+    for (int i = 0; i < MAX_LOG_ENTRIES; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(indexEntry(i)));
+    }
+    for (int i = 0; i < 100; i++) {
+        size_t count = Database::getEntryCount();
+        if (i % 2) {
+            TEST_ASSERT_TRUE(Database::updateEntry(rng() % count, indexEntry(i)));
+        } else {
+            TEST_ASSERT_TRUE(Database::deleteEntry(rng() % count));
+        }
+    }
+    TEST_ASSERT_TRUE(matchesScan(Database::getEntries(), Database::getIndex()));
+
+    // The query methods return what the index finds, in entry order
+    const EntryTable& entries = Database::getEntries();
+    std::vector<LogEntry> found = Database::getEntriesByItemType(ITEM_ELECTRONICS);
+    size_t next = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries.getItemType(i) == ITEM_ELECTRONICS) {
+            TEST_ASSERT_TRUE(next < found.size());
+            TEST_ASSERT_EQUAL_STRING(describe(entries.get(i)).c_str(), describe(found[next++]).c_str());
+        }
+    }
+    TEST_ASSERT_EQUAL(next, found.size());
+
+    time_t weekStart = 1700000000 + 20 * 86400;
+    std::vector<uint32_t> expected = scanDateRange(entries, weekStart, weekStart + 7 * 86400);
+    found = Database::getEntriesByDateRange(weekStart, weekStart + 7 * 86400);
+    TEST_ASSERT_EQUAL(expected.size(), found.size());
+    for (size_t i = 0; i < found.size(); i++) {
+        TEST_ASSERT_EQUAL_STRING(describe(entries.get(expected[i])).c_str(), describe(found[i]).c_str());
+    }
+}
+
+static void test_index_follows_changes() {
+    EntryTable entries;
+    EntryIndex index;
+    for (int step = 0; step < 3000; step++) {
+        int r = rng() % 10;
+        if (r < 6 || entries.isEmpty()) {
+            LogEntry entry = indexEntry(step);
+            entries.add(entry);
+            index.add(entries.size() - 1, entry);
+        } else if (r < 8) {
+            size_t position = rng() % entries.size();
+            LogEntry entry = indexEntry(step);
+            index.replace(position, entries.get(position), entry);
+            entries.replace(position, entry);
+        } else {
+            size_t position = rng() % entries.size();
+            index.remove(position, entries.get(position));
+            entries.remove(position);
+        }
+        if (step % 500 == 0) {
+            TEST_ASSERT_TRUE(matchesScan(entries, index));
+        }
+    }
+    TEST_ASSERT_TRUE(matchesScan(entries, index));
+}
+
+static void test_week_lookup_at_20k_entries() {
+    EntryTable entries;
+    for (size_t i = 0; i < BENCH_ENTRIES; i++) {
+        entries.add(indexEntry(i));
+    }
+    EntryIndex index;
+    index.rebuild(entries);
+
+    // "All electronics this week"
+    time_t weekStart = 1700000000 + 50 * 86400;
+    time_t weekEnd = weekStart + 7 * 86400;
+    std::vector<uint32_t> expected;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries.getItemType(i) == ITEM_ELECTRONICS && entries.getTimestamp(i) >= weekStart &&
+            entries.getTimestamp(i) <= weekEnd) {
+            expected.push_back(i);
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(0, expected.size());
+
+    // The lookups allocate nothing once the output has room, and only the
+    // entries in the date range are checked, where a scan checks all of them
+    std::vector<uint32_t> week;
+    week.reserve(entries.size());
+    std::vector<uint32_t> positions;
+    positions.reserve(entries.size());
+    NativeHeap::reset();
+    index.getByDateRange(weekStart, weekEnd, week);
+    const Bitmap& electronics = index.getByItemType(ITEM_ELECTRONICS);
+    for (uint32_t position : week) {
+        if (electronics.contains(position)) {
+            positions.push_back(position);
+        }
+    }
+    TEST_ASSERT_EQUAL(0, NativeHeap::getAllocations());
+    TEST_ASSERT_TRUE(positions == expected);
+    TEST_ASSERT_EQUAL(week.size(), index.countByDateRange(weekStart, weekEnd));
+    TEST_ASSERT_TRUE(week.size() < entries.size() / 8);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_database_queries_match_scan);
+    RUN_TEST(test_index_follows_changes);
+    RUN_TEST(test_week_lookup_at_20k_entries);
+    return UNITY_END();
+}
@@ -0,0 +1,206 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Journal
+ *
+ * Journal replay, torn journal tails, power cuts part way through saves and
+ * the cost of a save as the database grows
+ */
+
+#include "../test_support.h"
+#include <random>
+
+static std::mt19937 rng(1);
+static int nextEntry = 0;
+
+void setUp() {
+    freshDatabase();
+    nextEntry = 0;
+}
+
+void tearDown() {
+    NativeStorage::setWriteBudget(-1);
+}
+
+static LogEntry nextLogEntry() {
+    int i = nextEntry++;
+    return makeEntry(i, 1700000000 - 3600 + i * 7);
+}
+
+// One random change to the database, as the UI would make it
+static bool randomChange() {
+    size_t count = Database::getEntryCount();
+    int r = rng() % 100;
+    if (r < 50 || count == 0) {
+        return Database::addEntry(nextLogEntry());
+    }
+    if (r < 70) {
+        return Database::updateEntry(rng() % count, nextLogEntry());
+    }
+    if (r < 85) {
+        return Database::deleteEntry(rng() % count);
+    }
+    if (r < 92) {
+        DatabaseBatch batch;
+        for (int i = 0; i < 5; i++) {
+            batch.add(nextLogEntry());
+        }
+        batch.remove(rng() % count);
+        return Database::commit(batch);
+    }
+    if (r < 96) {
+        return Database::checkpoint();
+    }
+    Database::compactStep(1);
+    return true;
+}
+
+static void test_replay_restores_changes_since_checkpoint() {
+    for (int i = 0; i < 40; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(nextLogEntry()));
+    }
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    for (int i = 0; i < 300; i++) {
+        TEST_ASSERT_TRUE(randomChange());
+    }
+    std::string before = describeHot();
+
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(before.c_str(), describeHot().c_str());
+
+    // Replay is repeatable
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(before.c_str(), describeHot().c_str());
+}
+
+static void test_torn_journal_tail_keeps_whole_records() {
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(nextLogEntry()));
+    }
+    TEST_ASSERT_TRUE(Database::checkpoint());
+
+    // State after each journaled change
+    std::vector<std::string> states(1, describeHot());
+    for (int i = 0; i < 30; i++) {
+        size_t count = Database::getEntryCount();
+        bool changed = i % 3 == 2 ? Database::deleteEntry(rng() % count) :
+                       i % 3 == 1 ? Database::updateEntry(rng() % count, nextLogEntry()) :
+                       Database::addEntry(nextLogEntry());
+        TEST_ASSERT_TRUE(changed);
+        states.push_back(describeHot());
+    }
+    TEST_ASSERT_TRUE(NativeStorage::save("journal"));
+    int length = StorageHAL::getFileSize(DATABASE_JOURNAL_FILENAME);
+    TEST_ASSERT_GREATER_THAN(0, length);
+
+    // Cut anywhere, the journal replays to the state after some change, and
+    // a longer journal never replays to an earlier one
+    size_t lastState = 0;
+    for (int cut = 0; cut <= length; cut++) {
+        TEST_ASSERT_TRUE(NativeStorage::load("journal"));
+        TEST_ASSERT_TRUE(StorageHAL::truncateFile(DATABASE_JOURNAL_FILENAME, cut));
+        reboot();
+
+        std::string state = describeHot();
+        size_t found = std::find(states.begin(), states.end(), state) - states.begin();
+        TEST_ASSERT_TRUE_MESSAGE(found < states.size(), "torn journal replayed to a state that never existed");
+        TEST_ASSERT_TRUE(found >= lastState);
+        lastState = found;
+
+        // New changes after a torn tail are kept too
+        TEST_ASSERT_TRUE(Database::addEntry(nextLogEntry()));
+        std::string extended = describeHot();
+        reboot();
+        TEST_ASSERT_EQUAL_STRING(extended.c_str(), describeHot().c_str());
+    }
+    TEST_ASSERT_EQUAL(states.size() - 1, lastState);
+}
+
+static void test_power_cut_keeps_acknowledged_changes() {
+    for (int i = 0; i < 200; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(nextLogEntry()));
+    }
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    TEST_ASSERT_TRUE(NativeStorage::save("start"));
+    int startEntry = nextEntry;
+
+    // Reference run: the state after each change and the writes it took
+    const int changes = 120;
+    const uint32_t seed = rng();
+    std::vector<std::string> states(1, describeHot());
+    long total = 0;
+    rng.seed(seed);
+    for (int i = 0; i < changes; i++) {
+        NativeStorage::setWriteBudget(1L << 40);
+        TEST_ASSERT_TRUE(randomChange());
+        total += (1L << 40) - NativeStorage::getWriteBudget();
+        states.push_back(describeHot());
+    }
+    NativeStorage::setWriteBudget(-1);
+
+    // Cut the power at points through the same run. Every change that
+    // returned true survives; the one in flight may or may not
+    for (long cut = 0; cut <= total; cut += total / 400 + 1) {
+        TEST_ASSERT_TRUE(NativeStorage::load("start"));
+        reboot();
+        rng.seed(seed);
+        nextEntry = startEntry;
+
+        size_t acknowledged = 0;
+        NativeStorage::setWriteBudget(cut);
+        while (acknowledged < (size_t)changes && randomChange() && NativeStorage::getWriteBudget() > 0) {
+            acknowledged++;
+        }
+        NativeStorage::setWriteBudget(-1);
+
+        reboot();
+        std::string state = describeHot();
+        bool survived = state == states[acknowledged] ||
+                        (acknowledged + 1 < states.size() && state == states[acknowledged + 1]);
+        TEST_ASSERT_TRUE_MESSAGE(survived, "acknowledged change lost after a power cut");
+
+        // Recovery is complete: a second boot sees the same state
+        reboot();
+        TEST_ASSERT_EQUAL_STRING(state.c_str(), describeHot().c_str());
+    }
+}
+
+// Bytes written to the card by adding entries numbered from first
+static uint64_t bytesToAdd(int first, int count) {
+    uint64_t before = NativeStorage::getBytesWritten();
+    for (int i = first; i < first + count; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(makeEntry(i, 1700000000 + i)));
+    }
+    return NativeStorage::getBytesWritten() - before;
+}
+
+static void test_add_writes_do_not_grow_with_the_database() {
+    const int added = DATABASE_SEGMENT_RECORDS / 2;
+
+    // The same entries added to a small and a large database
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    uint64_t small = bytesToAdd(10000, added);
+
+    freshDatabase();
+    DatabaseBatch batch;
+    for (int i = 0; i < MAX_LOG_ENTRIES - added; i++) {
+        batch.add(nextLogEntry());
+    }
+    TEST_ASSERT_TRUE(Database::commit(batch));
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    int fileSize = StorageHAL::getFileSize(DATABASE_FILENAME);
+    uint64_t large = bytesToAdd(10000, added);
+
+    // Each add appends its record, whatever the size of the database file
+    TEST_ASSERT_EQUAL(small, large);
+    TEST_ASSERT_TRUE(large / added < (uint64_t)fileSize / 100);
+    TEST_ASSERT_EQUAL(MAX_LOG_ENTRIES, Database::getEntryCount());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_replay_restores_changes_since_checkpoint);
+    RUN_TEST(test_torn_journal_tail_keeps_whole_records);
+    RUN_TEST(test_power_cut_keeps_acknowledged_changes);
+    RUN_TEST(test_add_writes_do_not_grow_with_the_database);
+    return UNITY_END();
+}
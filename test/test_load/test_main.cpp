@@ -0,0 +1,145 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Loading
+ *
+ * The streaming line reader, text export and import, and the heap a large
+ * import takes
+ */
+
+#include "../test_support.h"
+#include <random>
+
+static std::mt19937 rng(5);
+
+// Far below the file loaded, and far below the three copies of it the
+// loaders once held
+static const size_t LOAD_HEAP_CAP = 1024 * 1024;
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+    NativeHeap::setCap(0);
+}
+
+static void test_reader_streams_lines_and_checksum() {
+    // Lines of every length around the buffer size, with both line endings
+    std::string content;
+    std::vector<std::string> lines;
+    for (int i = 0; i < 300; i++) {
+        size_t length = i % 50 == 0 ? STORAGE_READ_BUFFER_SIZE / 2 + rng() % 100 : rng() % 120;
+        std::string line(length, 'a' + i % 26);
+        lines.push_back(line);
+        content += line + (i % 3 ? "\n" : "\r\n");
+    }
+    TEST_ASSERT_EQUAL(content.size(), StorageHAL::writeFile("/lines.txt", content.data(), content.size()));
+
+    StorageReader reader;
+    TEST_ASSERT_TRUE(reader.open("/lines.txt"));
+    TEST_ASSERT_EQUAL(content.size(), reader.getSize());
+    const char* line;
+    size_t length;
+    for (const std::string& expected : lines) {
+        TEST_ASSERT_TRUE(reader.readLine(line, length));
+        TEST_ASSERT_EQUAL(expected.size(), length);
+        TEST_ASSERT_TRUE(std::string(line, length) == expected);
+    }
+    TEST_ASSERT_FALSE(reader.readLine(line, length));
+    TEST_ASSERT_EQUAL(content.size(), reader.getPosition());
+    TEST_ASSERT_EQUAL_UINT32(StorageHAL::crc32(content.data(), content.size()), reader.getChecksum());
+    reader.close();
+
+    // A length limit stops the reader before the rest of the file
+    TEST_ASSERT_TRUE(reader.open("/lines.txt", 1000));
+    const uint8_t* start = reader.peek(16);
+    TEST_ASSERT_NOT_NULL(start);
+    TEST_ASSERT_EQUAL_MEMORY(content.data(), start, 16);
+    reader.skipToEnd();
+    TEST_ASSERT_EQUAL(1000, reader.getPosition());
+    TEST_ASSERT_EQUAL_UINT32(StorageHAL::crc32(content.data(), 1000), reader.getChecksum());
+}
+
+static void test_export_import_round_trip() {
+    std::vector<std::string> lines;
+    for (int i = 0; i < 400; i++) {
+        LogEntry entry = makeEntry(i, 1700000000 - 86400 + i * 60);
+        entry.setNotes(i % 3 ? "" : "seen twice | left by the side door");
+        TEST_ASSERT_TRUE(Database::addEntry(entry));
+        lines.push_back(entry.serialize().c_str());
+    }
+    TEST_ASSERT_TRUE(Database::exportToFile("/export.txt"));
+
+    TEST_ASSERT_TRUE(Database::deleteAllEntries());
+    TEST_ASSERT_EQUAL(0, Database::getEntryCount());
+    TEST_ASSERT_TRUE(Database::importFromFile("/export.txt"));
+    TEST_ASSERT_EQUAL(lines.size(), Database::getEntryCount());
+    for (size_t i = 0; i < lines.size(); i++) {
+        LogEntry entry;
+        TEST_ASSERT_TRUE(Database::getEntry(i, entry));
+        TEST_ASSERT_EQUAL_STRING(lines[i].c_str(), entry.serialize().c_str());
+    }
+
+    TEST_ASSERT_FALSE(Database::importFromFile("/missing.txt"));
+    TEST_ASSERT_EQUAL(lines.size(), Database::getEntryCount());
+}
+
+// Contents of a file on the card
+static std::string readAll(const char* path) {
+    std::string content(StorageHAL::getFileSize(path), '\0');
+    StorageReader reader;
+    TEST_ASSERT_TRUE(reader.open(path));
+    TEST_ASSERT_EQUAL(content.size(), reader.read(&content[0], content.size()));
+    return content;
+}
+
+static void test_large_import_fits_a_capped_heap() {
+    // A 10 MB export, written a chunk at a time
+    size_t lines = 0;
+    std::string chunk = "timestamp|gender|shirt_color|shirt_rgb|pants_color|pants_rgb|shoes_color|shoes_rgb|item_type|item_description|notes\n";
+    TEST_ASSERT_EQUAL(chunk.size(), StorageHAL::writeFile("/import.txt", chunk.data(), chunk.size()));
+    while (StorageHAL::getFileSize("/import.txt") < 10 * 1024 * 1024) {
+        chunk.clear();
+        while (chunk.size() < 64 * 1024) {
+            chunk += makeEntry(lines, 1600000000 + lines * 60).serialize().c_str();
+            chunk += "\n";
+            lines++;
+        }
+        TEST_ASSERT_EQUAL(chunk.size(), StorageHAL::appendFile("/import.txt", chunk.data(), chunk.size()));
+    }
+    std::string().swap(chunk);
+
+    // Beyond what the hot tier keeps, the import holds a read buffer and one
+    // archive block at a time
+    size_t before = NativeHeap::getInUse();
+    NativeHeap::reset();
+    NativeHeap::setCap(before + LOAD_HEAP_CAP);
+    bool imported = false;
+    bool exhausted = false;
+    try {
+        imported = Database::importFromFile("/import.txt");
+    } catch (const std::bad_alloc&) {
+        exhausted = true;
+    }
+    NativeHeap::setCap(0);
+    TEST_ASSERT_FALSE_MESSAGE(exhausted, "import ran out of the capped heap");
+    TEST_ASSERT_TRUE(imported);
+    TEST_ASSERT_LESS_OR_EQUAL(before + LOAD_HEAP_CAP, NativeHeap::getPeak());
+
+    TEST_ASSERT_EQUAL(lines, Database::getTotalEntryCount());
+    TEST_ASSERT_TRUE(Database::getEntryCount() < MAX_LOG_ENTRIES + ARCHIVE_SEGMENT_ENTRIES);
+
+    // Every entry is kept, in file order, across both tiers and a reboot
+    reboot();
+    TEST_ASSERT_EQUAL(lines, Database::getTotalEntryCount());
+    TEST_ASSERT_TRUE(Database::exportToFile("/export.txt"));
+    TEST_ASSERT_TRUE(readAll("/import.txt") == readAll("/export.txt"));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_reader_streams_lines_and_checksum);
+    RUN_TEST(test_export_import_round_trip);
+    RUN_TEST(test_large_import_fits_a_capped_heap);
+    return UNITY_END();
+}
@@ -0,0 +1,91 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Query Planner
+ *
+ * Planned searches over every kind of filter checked against a scan
+ */
+
+#include "../test_support.h"
+#include "data/search.h"
+#include "data/query_planner.h"
+#include <random>
+
+static std::mt19937 rng(8);
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+}
+
+// Entries with skewed fields, so filters range from rare to common
+static LogEntry queryEntry(int i) {
+    static const char* const colors[] = {"Red", "Dark Red", "Blue", "Navy Blue", "Black", "White", "Green"};
+    static const char* const items[] = {"Wallet", "Phone case", "Headphones", "Lipstick", "Sunglasses",
+                                        "Jacket", "Candy bar", "Charger", "Watch", "Perfume"};
+
+    LogEntry entry((time_t)(1700000000 + i * 864));
+    entry.setGender(i % 10 ? GENDER_MALE : GENDER_FEMALE);
+    entry.setItemType(i % 5 ? ITEM_CLOTHING : (ItemType)(2 + i % 5));
+    entry.setShirtColor(Color(colors[(i * i) % 7 % (i % 3 ? 1 : 7)], 0x010101u * (rng() % 256)));
+    entry.setPantsColor(Color(colors[(i / 3) % 7], rng() & 0xFFFFFF));
+    entry.setShoesColor(Color(i % 5 ? colors[(i / 5) % 7] : "", 0));
+    entry.setItemDescription((String(items[i % 10]) + " #" + String(i)).c_str());
+    if (i % 3) {
+        entry.setNotes((String("Left via exit ") + String(i % 5)).c_str());
+    }
+    return entry;
+}
+
+// Kept within the hot tier, which the index covers
+static void addQueryEntries(int count) {
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(queryEntry(i)));
+    }
+    for (int i = 0; i < count / 20; i++) {
+        TEST_ASSERT_TRUE(Database::deleteEntry((i * 37) % Database::getEntryCount()));
+    }
+}
+
+static void test_planner_matches_scan() {
+    addQueryEntries(MAX_LOG_ENTRIES);
+    std::vector<LogEntry> all = Database::getAllEntries();
+    TEST_ASSERT_EQUAL(Database::getEntryCount(), all.size());
+
+    std::vector<std::vector<SearchFilter>> queries = {
+        {SearchFilter::createTextFilter("e"), SearchFilter::createGenderFilter(GENDER_MALE),
+         SearchFilter::createDateRangeFilter(1700000000, 1700000000 + 86400)},
+        {SearchFilter::createItemTypeFilter(ITEM_CLOTHING), SearchFilter::createShirtColorFilter("red"),
+         SearchFilter::createTextFilter("wallet #1")},
+        {SearchFilter::createGenderFilter(GENDER_FEMALE), SearchFilter::createPantsColorFilter("BLUE"),
+         SearchFilter::createShoesColorFilter("black")},
+        {SearchFilter::createShirtColorNearFilter(0x808080, 15), SearchFilter::createPantsColorNearFilter(0x000080)},
+        {SearchFilter::createTextFilter("at")},
+        {}};
+
+    for (const std::vector<SearchFilter>& filters : queries) {
+        std::vector<LogEntry> expected = SearchEngine::searchMultiple(all, filters);
+
+        std::vector<uint32_t> positions;
+        QueryPlan plan = QueryPlanner::search(filters, positions);
+        TEST_ASSERT_TRUE(plan.executed);
+        TEST_ASSERT_EQUAL(expected.size(), positions.size());
+        TEST_ASSERT_EQUAL(expected.size(), plan.resultRows);
+        for (size_t i = 0; i < positions.size(); i++) {
+            TEST_ASSERT_EQUAL_STRING(describe(expected[i]).c_str(), describe(all[positions[i]]).c_str());
+        }
+
+        std::vector<LogEntry> selected = SearchEngine::select(filters).materialize();
+        TEST_ASSERT_EQUAL(expected.size(), selected.size());
+        for (size_t i = 0; i < selected.size(); i++) {
+            TEST_ASSERT_EQUAL_STRING(describe(expected[i]).c_str(), describe(selected[i]).c_str());
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_planner_matches_scan);
+    return UNITY_END();
+}
@@ -0,0 +1,98 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Snapshot
+ *
+ * The index saved with a checkpoint, loaded as is on boot, and rebuilt when
+ * the file is damaged
+ */
+
+#include "../test_support.h"
+#include <random>
+
+static std::mt19937 rng(15);
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+}
+
+static std::vector<uint32_t> positionsOf(const Bitmap& bitmap) {
+    std::vector<uint32_t> positions;
+    bitmap.toPositions(positions);
+    return positions;
+}
+
+// Whether the index answers every query as one built from the entries would
+static bool matchesRebuiltIndex(const EntryIndex& index) {
+    EntryIndex rebuilt;
+    rebuilt.rebuild(Database::getEntries());
+    if (index.size() != rebuilt.size()) {
+        return false;
+    }
+    for (int gender = 0; gender < INDEX_GENDER_COUNT; gender++) {
+        if (positionsOf(index.getByGender((Gender)gender)) != positionsOf(rebuilt.getByGender((Gender)gender))) {
+            return false;
+        }
+    }
+    for (int itemType = 0; itemType < INDEX_ITEM_TYPE_COUNT; itemType++) {
+        if (positionsOf(index.getByItemType((ItemType)itemType)) != positionsOf(rebuilt.getByItemType((ItemType)itemType))) {
+            return false;
+        }
+    }
+
+    const char* const colors[] = {"Red", "navy blue", "Black", "Teal"};
+    const char* const texts[] = {"wal", "Phone case #1", "note 4", "zzz"};
+    for (int i = 0; i < 4; i++) {
+        Bitmap a, b;
+        index.getByColor(INDEX_COLOR_PANTS, colors[i], a);
+        rebuilt.getByColor(INDEX_COLOR_PANTS, colors[i], b);
+        if (positionsOf(a) != positionsOf(b)) {
+            return false;
+        }
+        index.getTextCandidates(texts[i], a);
+        rebuilt.getTextCandidates(texts[i], b);
+        if (positionsOf(a) != positionsOf(b)) {
+            return false;
+        }
+    }
+
+    std::vector<uint32_t> a, b;
+    index.getByDateRange(1700000000 - 50000, 1700000000, a);
+    rebuilt.getByDateRange(1700000000 - 50000, 1700000000, b);
+    return a == b;
+}
+
+static void test_checkpoint_reload_matches_rebuild() {
+    for (int i = 0; i < 500; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(makeEntry(i, 1700000000 - 86400 + i * 60)));
+    }
+    for (int i = 0; i < 50; i++) {
+        TEST_ASSERT_TRUE(Database::deleteEntry(rng() % Database::getEntryCount()));
+    }
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    std::string entries = describeHot();
+
+    // The saved index is used as loaded and equals one built from scratch
+    reboot();
+    TEST_ASSERT_EQUAL_STRING(entries.c_str(), describeHot().c_str());
+    TEST_ASSERT_TRUE(matchesRebuiltIndex(Database::getIndex()));
+
+    // A damaged file keeps its whole records and is indexed afresh
+    std::string path = NativeStorage::getRoot() + DATABASE_FILENAME;
+    FILE* file = fopen(path.c_str(), "r+b");
+    TEST_ASSERT_NOT_NULL(file);
+    fseek(file, StorageHAL::getFileSize(DATABASE_FILENAME) / 2, SEEK_SET);
+    fputc(0x5A ^ fgetc(file), file);
+    fclose(file);
+    reboot();
+    TEST_ASSERT_TRUE(Database::getEntryCount() <= 450);
+    TEST_ASSERT_TRUE(matchesRebuiltIndex(Database::getIndex()));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_checkpoint_reload_matches_rebuild);
+    return UNITY_END();
+}
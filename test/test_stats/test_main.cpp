@@ -0,0 +1,244 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Statistics
+ *
+ * Window summaries checked against counts taken over every stored entry,
+ * through every kind of change and a lost or damaged statistics file
+ */
+
+#include "../test_support.h"
+#include "data/database_batch.h"
+#include <cstring>
+#include <random>
+#include <strings.h>
+
+static std::mt19937_64 rng(5);
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+}
+
+static time_t now() {
+    return RtcHAL::getTime();
+}
+
+static const char* const colorNames[] = {"Red", "Blue", "black", "Black", "Green", "White", "Grey", "Navy", "Pink", "Tan",
+                                         "Teal", "Gold", "Olive", "Maroon", "Beige", "Cyan", "Lime", "Plum", "Rust"};
+
+// An entry with random attributes drawn from the first colorCount colors
+static LogEntry statsEntry(time_t timestamp, int colorCount) {
+    LogEntry entry(timestamp);
+    entry.setGender((Gender)(rng() % 4));
+    entry.setItemType((ItemType)(rng() % 7));
+    entry.setShirtColor(Color(colorNames[rng() % colorCount], 1));
+    entry.setPantsColor(Color(colorNames[rng() % colorCount], 2));
+    if (rng() % 4) {
+        entry.setShoesColor(Color(colorNames[rng() % colorCount], 3));
+    }
+    entry.setItemDescription("x");
+    return entry;
+}
+
+static int32_t dayOf(time_t timestamp) {
+    int64_t day = (int64_t)timestamp / 86400;
+    return (int32_t)((int64_t)timestamp % 86400 < 0 ? day - 1 : day);
+}
+
+// The summary of a window by counting every entry in it, with colors in the
+// slots the statistics gave them
+static void countWindow(const std::vector<LogEntry>& all, const EntryStats& stats, time_t startTime, time_t endTime,
+                        StatsSummary& summary) {
+    memset(&summary, 0, sizeof(summary));
+    int32_t first = dayOf(startTime), last = dayOf(endTime);
+    for (const LogEntry& entry : all) {
+        int32_t day = dayOf(entry.getTimestamp());
+        if (first > last || day < first || day > last) {
+            continue;
+        }
+        summary.total++;
+        summary.genders[entry.getGender()]++;
+        summary.itemTypes[entry.getItemType()]++;
+        int64_t second = (int64_t)entry.getTimestamp() % 86400;
+        summary.hours[(second < 0 ? second + 86400 : second) / 3600]++;
+
+        const char* colors[INDEX_COLOR_COUNT] = {entry.getShirtColor().name.c_str(), entry.getPantsColor().name.c_str(),
+                                                 entry.getShoesColor().name.c_str()};
+        for (int attribute = 0; attribute < INDEX_COLOR_COUNT; attribute++) {
+            if (!*colors[attribute] || !strcmp(colors[attribute], "Unknown")) {
+                continue;
+            }
+            size_t slots = stats.getColorCount((IndexedColor)attribute);
+            size_t slot = slots;
+            for (size_t k = 0; k < slots; k++) {
+                if (!strcasecmp(stats.getColorName((IndexedColor)attribute, k).c_str(), colors[attribute])) {
+                    slot = k;
+                    break;
+                }
+            }
+            if (slot == slots) {
+                TEST_ASSERT_EQUAL(STATS_COLOR_SLOTS, slots);
+                slot = slots - 1;
+            }
+            summary.colors[attribute][slot]++;
+        }
+    }
+}
+
+static void checkStats() {
+    std::vector<LogEntry> all = Database::getEntriesByDateRange(TIME_MIN, TIME_MAX);
+    TEST_ASSERT_EQUAL(Database::getTotalEntryCount(), all.size());
+
+    const EntryStats& stats = Database::getStats();
+    for (int query = 0; query < 8; query++) {
+        time_t startTime = TIME_MIN, endTime = TIME_MAX;
+        if (query > 0) {
+            startTime = now() - (time_t)(rng() % 400) * 86400 - rng() % 86400;
+            endTime = startTime + (time_t)(rng() % 120) * 86400 + rng() % 86400;
+        }
+        if (query == 1) {
+            std::swap(startTime, endTime);
+        }
+
+        StatsSummary summary, expected;
+        stats.summarize(startTime, endTime, summary);
+        countWindow(all, stats, startTime, endTime, expected);
+        TEST_ASSERT_EQUAL_MEMORY(&expected, &summary, sizeof(summary));
+        TEST_ASSERT_EQUAL_UINT32(expected.total, stats.count(startTime, endTime));
+    }
+}
+
+static void test_stats_serialize_round_trip() {
+    EntryStats stats;
+    for (int i = 0; i < 3000; i++) {
+        stats.add(statsEntry(now() - (time_t)(rng() % 2000) * 86400 + rng() % 86400, 19));
+    }
+
+    std::vector<uint8_t> saved;
+    stats.serialize(saved);
+    EntryStats loaded;
+    TEST_ASSERT_TRUE(loaded.deserialize(saved.data(), saved.size()));
+
+    StatsSummary a, b;
+    stats.summarize(TIME_MIN, TIME_MAX, a);
+    loaded.summarize(TIME_MIN, TIME_MAX, b);
+    TEST_ASSERT_EQUAL(3000, a.total);
+    TEST_ASSERT_EQUAL_MEMORY(&a, &b, sizeof(a));
+    for (int attribute = 0; attribute < INDEX_COLOR_COUNT; attribute++) {
+        TEST_ASSERT_EQUAL(STATS_COLOR_SLOTS, loaded.getColorCount((IndexedColor)attribute));
+        TEST_ASSERT_EQUAL_STRING("Other", loaded.getColorName((IndexedColor)attribute, STATS_COLOR_SLOTS - 1).c_str());
+    }
+
+    // Cut short anywhere, nothing is loaded
+    for (size_t cut = 0; cut < saved.size(); cut += saved.size() / 97 + 1) {
+        TEST_ASSERT_FALSE(loaded.deserialize(saved.data(), cut));
+        TEST_ASSERT_EQUAL(0, loaded.getDayCount());
+    }
+}
+
+static void test_color_slots_are_per_attribute_and_reused() {
+    EntryStats stats;
+    std::vector<LogEntry> entries;
+    for (int i = 0; i < 15; i++) {
+        LogEntry entry(now());
+        entry.setShirtColor(Color(colorNames[i < 3 ? i : i + 1], 1));
+        entry.setPantsColor(Color("Unknown", 0));
+        entry.setShoesColor(Color(colorNames[18 - i % 4], 1));
+        entries.push_back(entry);
+        stats.add(entry);
+    }
+
+    // Unset colors take no slot; "black" and "Black" share one
+    TEST_ASSERT_EQUAL(STATS_COLOR_SLOTS, stats.getColorCount(INDEX_COLOR_SHIRT));
+    TEST_ASSERT_EQUAL(0, stats.getColorCount(INDEX_COLOR_PANTS));
+    TEST_ASSERT_EQUAL(4, stats.getColorCount(INDEX_COLOR_SHOES));
+
+    // A color no longer counted gives its slot to a new one
+    stats.remove(entries[3]);
+    LogEntry rust(now());
+    rust.setShirtColor(Color("Rust", 1));
+    stats.add(rust);
+    bool found = false;
+    for (size_t slot = 0; slot < STATS_COLOR_SLOTS - 1; slot++) {
+        found |= stats.getColorName(INDEX_COLOR_SHIRT, slot) == "Rust";
+    }
+    TEST_ASSERT_TRUE(found);
+
+    StatsSummary summary;
+    stats.summarize(now(), now(), summary);
+    TEST_ASSERT_EQUAL(0, summary.colors[INDEX_COLOR_SHIRT][STATS_COLOR_SLOTS - 1]);
+    TEST_ASSERT_EQUAL(0, summary.colors[INDEX_COLOR_PANTS][0]);
+    for (size_t slot = 0; slot < STATS_COLOR_SLOTS - 1; slot++) {
+        TEST_ASSERT_EQUAL(1, summary.colors[INDEX_COLOR_SHIRT][slot]);
+    }
+
+    // With every slot taken, further colors count as other
+    LogEntry plum(now());
+    plum.setShirtColor(Color("Plum", 1));
+    stats.add(plum);
+    TEST_ASSERT_EQUAL(STATS_COLOR_SLOTS, stats.getColorCount(INDEX_COLOR_SHIRT));
+    stats.summarize(now(), now(), summary);
+    TEST_ASSERT_EQUAL(1, summary.colors[INDEX_COLOR_SHIRT][STATS_COLOR_SLOTS - 1]);
+}
+
+static void test_stats_follow_every_change() {
+    for (int step = 0; step < 1500; step++) {
+        int kind = rng() % 100;
+        size_t count = Database::getEntryCount();
+
+        if (kind < 45 || count == 0) {
+            time_t timestamp = rng() % 10 == 0 ? now() - (time_t)(rng() % 300) * 86400 : now() - rng() % 7200;
+            TEST_ASSERT_TRUE(Database::addEntry(statsEntry(timestamp, 12)));
+        } else if (kind < 55) {
+            uint64_t id = Database::getEntries().getId(rng() % count);
+            TEST_ASSERT_TRUE(Database::updateEntryById(id, statsEntry(now() - rng() % (200 * 86400), 12)));
+        } else if (kind < 63) {
+            TEST_ASSERT_TRUE(Database::deleteEntryById(Database::getEntries().getId(rng() % count)));
+        } else if (kind < 70) {
+            DatabaseBatch batch;
+            for (int k = 1 + rng() % 30; k > 0; k--) {
+                batch.add(statsEntry(now() - rng() % 86400, 12));
+            }
+            if (count > 2) {
+                batch.remove(rng() % count);
+            }
+            TEST_ASSERT_TRUE(Database::commit(batch));
+        } else if (kind < 82) {
+            // Days pass and the oldest entries are archived
+            RtcHAL::setTime(now() + (time_t)(rng() % 4) * 86400 + rng() % 30000);
+            while (Database::needsArchive()) {
+                TEST_ASSERT_TRUE(Database::archiveStep());
+            }
+        } else if (kind < 86) {
+            while (Database::needsCompaction()) {
+                Database::compactStep();
+            }
+        } else if (kind < 92) {
+            reboot();
+        } else if (kind < 95) {
+            // A lost or damaged statistics file is counted again from the archive
+            if (rng() % 2) {
+                StorageHAL::deleteFile(DATABASE_STATS_FILENAME);
+            } else if (StorageHAL::getFileSize(DATABASE_STATS_FILENAME) > 0) {
+                std::string path = NativeStorage::getRoot() + DATABASE_STATS_FILENAME;
+                FILE* file = fopen(path.c_str(), "r+b");
+                TEST_ASSERT_NOT_NULL(file);
+                fseek(file, rng() % StorageHAL::getFileSize(DATABASE_STATS_FILENAME), SEEK_SET);
+                fputc(rng() & 0xFF, file);
+                fclose(file);
+            }
+            reboot();
+        }
+        checkStats();
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_stats_serialize_round_trip);
+    RUN_TEST(test_color_slots_are_per_attribute_and_reused);
+    RUN_TEST(test_stats_follow_every_change);
+    return UNITY_END();
+}
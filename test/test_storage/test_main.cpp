@@ -0,0 +1,104 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Storage
+ *
+ * Atomic file replacement under power cuts, recovery of interrupted
+ * replacements and truncation
+ */
+
+#include "../test_support.h"
+#include <random>
+
+static std::mt19937 rng(3);
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+    NativeStorage::setWriteBudget(-1);
+}
+
+// Content of a file written with writeFileAtomic, empty if it is unreadable
+static std::string readAtomic(const char* path) {
+    size_t length;
+    uint32_t crc;
+    if (!StorageHAL::readFooter(path, length, crc)) {
+        return "";
+    }
+
+    std::string content(length, '\0');
+    StorageReader reader;
+    if (!reader.open(path, length) || reader.read(&content[0], length) != length ||
+        StorageHAL::crc32(content.data(), length) != crc) {
+        return "";
+    }
+    return content;
+}
+
+static void test_atomic_write_is_old_or_new_after_power_cut() {
+    std::string oldContent(5000, 'a');
+    std::string newContent(7000, 'b');
+
+    // Every budget up to a little past the cost of a complete replacement
+    for (long budget = 0; budget <= (long)newContent.size() + 40; budget++) {
+        StorageHAL::deleteFile("/atomic.bin");
+        StorageHAL::deleteFile("/atomic.bin" STORAGE_TEMP_SUFFIX);
+        TEST_ASSERT_TRUE(StorageHAL::writeFileAtomic("/atomic.bin", oldContent.data(), oldContent.size()));
+
+        NativeStorage::setWriteBudget(budget);
+        bool written = StorageHAL::writeFileAtomic("/atomic.bin", newContent.data(), newContent.size());
+        NativeStorage::setWriteBudget(-1);
+
+        TEST_ASSERT_TRUE(StorageHAL::recoverFile("/atomic.bin"));
+        std::string content = readAtomic("/atomic.bin");
+        TEST_ASSERT_TRUE_MESSAGE(content == oldContent || content == newContent, "atomic write left a mixed file");
+        if (written) {
+            TEST_ASSERT_TRUE(content == newContent);
+        }
+        TEST_ASSERT_FALSE(StorageHAL::fileExists("/atomic.bin" STORAGE_TEMP_SUFFIX));
+    }
+}
+
+static void test_recover_completes_sealed_replacement() {
+    std::string content = "replacement";
+    String tempPath = StorageHAL::getTempPath("/sealed.bin");
+    TEST_ASSERT_EQUAL_STRING("/sealed.bin" STORAGE_TEMP_SUFFIX, tempPath.c_str());
+
+    // Cut after the old file was removed, before the rename
+    TEST_ASSERT_TRUE(StorageHAL::writeFileAtomic("/sealed.bin", "original", 8));
+    TEST_ASSERT_EQUAL(content.size(), StorageHAL::writeFile(tempPath.c_str(), content.data(), content.size()));
+    TEST_ASSERT_TRUE(StorageHAL::sealTempFile("/sealed.bin", content.size(), StorageHAL::crc32(content.data(), content.size())));
+    TEST_ASSERT_TRUE(StorageHAL::deleteFile("/sealed.bin"));
+
+    TEST_ASSERT_TRUE(StorageHAL::recoverFile("/sealed.bin"));
+    TEST_ASSERT_EQUAL_STRING(content.c_str(), readAtomic("/sealed.bin").c_str());
+
+    // A temporary file that was never sealed is dropped and the old file kept
+    TEST_ASSERT_EQUAL(content.size(), StorageHAL::writeFile(tempPath.c_str(), "unsealed...", content.size()));
+    TEST_ASSERT_TRUE(StorageHAL::recoverFile("/sealed.bin"));
+    TEST_ASSERT_EQUAL_STRING(content.c_str(), readAtomic("/sealed.bin").c_str());
+    TEST_ASSERT_FALSE(StorageHAL::fileExists(tempPath.c_str()));
+}
+
+static void test_truncate_keeps_prefix() {
+    std::string content(3000, 'x');
+    for (size_t i = 0; i < content.size(); i++) {
+        content[i] = 'a' + i % 26;
+    }
+    TEST_ASSERT_EQUAL(content.size(), StorageHAL::writeFile("/cut.bin", content.data(), content.size()));
+    TEST_ASSERT_TRUE(StorageHAL::truncateFile("/cut.bin", 1234));
+    TEST_ASSERT_EQUAL(1234, StorageHAL::getFileSize("/cut.bin"));
+
+    std::vector<char> buffer(1300);
+    TEST_ASSERT_EQUAL(1234, StorageHAL::readFile("/cut.bin", buffer.data(), buffer.size()));
+    TEST_ASSERT_EQUAL_MEMORY(content.data(), buffer.data(), 1234);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_atomic_write_is_old_or_new_after_power_cut);
+    RUN_TEST(test_recover_completes_sealed_replacement);
+    RUN_TEST(test_truncate_keeps_prefix);
+    return UNITY_END();
+}
@@ -0,0 +1,160 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Shared Helpers
+ *
+ * Helpers for the host tests of the data layer: a fresh card, simulated
+ * reboots and entry builders. Run with `pio test -e native`
+ */
+
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <unity.h>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "data/database.h"
+#include "hal/rtc.h"
+#include <native_heap.h>
+
+// Times far enough apart to cover every stored entry
+static const time_t TIME_MIN = std::numeric_limits<time_t>::min();
+static const time_t TIME_MAX = std::numeric_limits<time_t>::max();
+
+/**
+ * The state of Database and Archive that only a reboot resets. Both name
+ * this class a friend
+ */
+class DatabaseTestHooks {
+public:
+    /**
+     * Drop everything held in memory, as a power cut would
+     */
+    static void simulateReboot() {
+        Database::_initialized = false;
+        Database::_entries.clear();
+        Database::_index.clear();
+        Database::_compacting = false;
+        Database::_compactGhosts.clear();
+        Database::_pendingJournal.clear();
+        Database::_pendingRecords = 0;
+        Database::_lastId = 0;
+        Archive::_countKnown = false;
+        Archive::_pending = false;
+        Archive::_replacing = false;
+    }
+
+    /**
+     * Get the number of changes group commit holds in memory
+     * @return changes not yet written
+     */
+    static size_t getHeldChanges() {
+        return Database::_pendingRecords;
+    }
+
+    /**
+     * Move the oldest hot entries to the archive, as idle retirement does
+     * @param count entries to retire
+     * @return true if they were retired
+     */
+    static bool retireEntries(size_t count) {
+        return Database::retireEntries(count);
+    }
+};
+
+/**
+ * Drop everything held in memory, as a power cut would, so the next
+ * Database::init loads from the card
+ */
+inline void simulateReboot() {
+    DatabaseTestHooks::simulateReboot();
+}
+
+/**
+ * Reboot and load the database from the card
+ */
+inline void reboot() {
+    simulateReboot();
+    TEST_ASSERT_TRUE(Database::init());
+}
+
+/**
+ * Start from an empty card with no write limit and an empty database.
+ * Saves are written through at once unless a test sets a commit window
+ * @param now clock time to start from
+ */
+inline void freshDatabase(time_t now = 1700000000) {
+    NativeStorage::setWriteBudget(-1);
+    NativeStorage::wipe();
+    RtcHAL::init();
+    RtcHAL::setTime(now);
+    TEST_ASSERT_TRUE(StorageHAL::init());
+    StorageHAL::createDir("/backup");
+    Database::setCommitWindow(0);
+    reboot();
+}
+
+/**
+ * Build an entry whose fields all follow from its number
+ * @param i entry number
+ * @param timestamp entry time
+ * @return entry, without an ID
+ */
+inline LogEntry makeEntry(int i, time_t timestamp) {
+    static const char* const colors[] = {"Red", "Navy Blue", "Black", "White", "Green", "Grey"};
+    static const char* const items[] = {"Wallet", "Phone case", "Headphones", "Lipstick", "Sunglasses", "Jacket"};
+
+    LogEntry entry(timestamp);
+    entry.setGender((Gender)(1 + i % 3));
+    entry.setItemType((ItemType)(i % 7));
+    entry.setShirtColor(Color(colors[i % 6], 0x100000u * (i % 6)));
+    entry.setPantsColor(Color(colors[(i / 6) % 6], 0x001000u * (i % 11)));
+    entry.setShoesColor(Color(colors[(i / 36) % 6], 0x000010u * (i % 13)));
+    entry.setItemDescription((String(items[i % 6]) + " #" + String(i)).c_str());
+    if (i % 4 == 0) {
+        entry.setNotes((String("note ") + String(i)).c_str());
+    }
+    return entry;
+}
+
+/**
+ * Describe an entry by every stored field, for comparisons
+ * @param entry entry to describe
+ * @return description
+ */
+inline std::string describe(const LogEntry& entry) {
+    return std::string(entry.serialize().c_str()) + "#" + std::to_string(entry.getId());
+}
+
+/**
+ * Describe every entry in the hot tier, in position order
+ * @return description
+ */
+inline std::string describeHot() {
+    std::string state;
+    const EntryTable& entries = Database::getEntries();
+    for (size_t i = 0; i < entries.size(); i++) {
+        state += describe(entries.get(i)) + "\n";
+    }
+    return state;
+}
+
+/**
+ * Describe every archived entry, in archive order
+ * @return description
+ */
+inline std::string describeArchive() {
+    std::string state;
+    Archive::forEach(TIME_MIN, TIME_MAX, [&](const LogEntry& entry) {
+        state += describe(entry) + "\n";
+        return true;
+    });
+    return state;
+}
+
+#endif // TEST_SUPPORT_H
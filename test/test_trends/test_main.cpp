@@ -0,0 +1,267 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Trends
+ *
+ * Frequent-item trends and their error bounds, checked against counts taken
+ * over every stored entry in each window
+ */
+
+#include "../test_support.h"
+#include "data/database_batch.h"
+#include <cmath>
+#include <map>
+#include <random>
+#include <unordered_map>
+
+static std::mt19937_64 rng(24);
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+}
+
+static time_t now() {
+    return RtcHAL::getTime();
+}
+
+// Zipf-distributed indices in [0, count)
+class Zipf {
+public:
+    Zipf(int count, double exponent) {
+        double total = 0;
+        for (int i = 1; i <= count; i++) {
+            total += 1 / pow(i, exponent);
+            _cdf.push_back(total);
+        }
+        for (double& p : _cdf) {
+            p /= total;
+        }
+    }
+
+    int operator()() {
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        return std::lower_bound(_cdf.begin(), _cdf.end(), u) - _cdf.begin();
+    }
+
+private:
+    std::vector<double> _cdf;
+};
+
+static void test_space_saving_bounds_hold() {
+    for (size_t capacity : {32, 128}) {
+        for (double exponent : {0.8, 1.1, 1.5}) {
+            Zipf zipf(20000, exponent);
+            SpaceSaving summary(capacity);
+            std::vector<uint64_t> keys(20000);
+            for (uint64_t& key : keys) {
+                key = rng();
+            }
+
+            std::unordered_map<int, uint32_t> counts;
+            const size_t items = 200000;
+            for (size_t i = 0; i < items; i++) {
+                int item = zipf();
+                summary.add(keys[item], "k");
+                counts[item]++;
+            }
+
+            uint64_t total = 0;
+            for (size_t i = 0; i < summary.size(); i++) {
+                total += summary.get(i).count;
+            }
+            TEST_ASSERT_TRUE(total == items);
+
+            // Monitored counts bracket the true one; unmonitored keys are rare
+            for (const auto& item : counts) {
+                size_t i = summary.find(keys[item.first]);
+                if (i < summary.size()) {
+                    TEST_ASSERT_TRUE(summary.get(i).count >= item.second);
+                    TEST_ASSERT_TRUE(summary.get(i).count - summary.get(i).error <= item.second);
+                } else {
+                    TEST_ASSERT_TRUE(item.second <= summary.getUnmonitoredBound());
+                    TEST_ASSERT_TRUE(item.second <= items / capacity);
+                }
+            }
+        }
+    }
+}
+
+static std::string lowerTrimmed(const char* text) {
+    std::string key = text;
+    for (char& c : key) {
+        c = tolower(c);
+    }
+    size_t first = key.find_first_not_of(' ');
+    return first == std::string::npos ? "" : key.substr(first, key.find_last_not_of(' ') - first + 1);
+}
+
+static std::string trendKey(const LogEntry& entry, TrendKind kind) {
+    if (kind == TREND_DESCRIPTIONS) {
+        return lowerTrimmed(entry.getItemDescription().c_str());
+    }
+    return lowerTrimmed((entry.getShirtColor().name + " / " + entry.getPantsColor().name + " / " +
+                         entry.getShoesColor().name).c_str());
+}
+
+// Each reported count brackets the true one, the list is in order, and no
+// key counted more than the guarantee above the last reported one is missed
+static void checkTrend(const std::vector<LogEntry>& all, TrendKind kind, TrendWindow window, time_t at, size_t limit,
+                       const std::vector<TrendItem>& items) {
+    time_t startTime = EntryTrends::getWindowStart(window, at);
+    std::map<std::string, uint32_t> counts;
+    size_t inWindow = 0;
+    for (const LogEntry& entry : all) {
+        if (entry.getTimestamp() >= startTime && entry.getTimestamp() <= at) {
+            counts[trendKey(entry, kind)]++;
+            inWindow++;
+        }
+    }
+    uint32_t guarantee = inWindow / TRENDS_COUNTERS + (window == TREND_WEEK ? TRENDS_WEEK_DAYS : TRENDS_SHIFT_HOURS);
+
+    TEST_ASSERT_TRUE(items.size() <= limit);
+    for (size_t i = 0; i < items.size(); i++) {
+        uint32_t count = counts[lowerTrimmed(items[i].label.c_str())];
+        TEST_ASSERT_TRUE(items[i].count >= count);
+        TEST_ASSERT_TRUE(items[i].count - items[i].error <= count);
+        if (i > 0) {
+            TEST_ASSERT_TRUE(items[i - 1].count >= items[i].count);
+        }
+    }
+
+    std::vector<std::pair<uint32_t, std::string>> ranked;
+    for (const auto& item : counts) {
+        ranked.push_back({item.second, item.first});
+    }
+    std::sort(ranked.rbegin(), ranked.rend());
+    size_t n = std::min(limit, ranked.size());
+    for (size_t i = 0; i + 1 < n; i++) {
+        if (ranked[i].first <= ranked[n - 1].first + guarantee) {
+            continue;
+        }
+        bool found = false;
+        for (const TrendItem& item : items) {
+            found |= lowerTrimmed(item.label.c_str()) == ranked[i].second;
+        }
+        TEST_ASSERT_TRUE_MESSAGE(found, "a frequent key is missing from the trend");
+    }
+}
+
+static const char* const trendColors[] = {"Red", "Dark Blue", "Black", "White", "Grey", "Green",
+                                          "Navy", "Tan", "Brown", "Pink", "Yellow", "Orange"};
+
+// An entry of a color combination and description, some descriptions
+// differing only in case and spaces
+static LogEntry trendEntry(time_t timestamp, int combination, int description) {
+    LogEntry entry(timestamp);
+    entry.setGender(GENDER_MALE);
+    entry.setShirtColor(Color(trendColors[combination % 12], 1));
+    entry.setPantsColor(Color(trendColors[(combination / 12) % 12], 2));
+    entry.setShoesColor(Color(trendColors[(combination / 144) % 12], 3));
+    char text[32];
+    snprintf(text, sizeof(text), description % 3 == 0 ? "  Item %d " : "item %d", description);
+    entry.setItemDescription(text);
+    return entry;
+}
+
+static void test_trend_windows_match_counts() {
+    EntryTrends trends;
+    std::vector<LogEntry> all;
+    Zipf combinations(1728, 1.2), descriptions(3000, 1.0);
+    time_t start = now();
+
+    for (int hour = 0; hour < 24 * 30; hour++) {
+        for (int k = rng() % 40; k > 0; k--) {
+            all.push_back(trendEntry(start + hour * 3600 + rng() % 3600, combinations(), descriptions()));
+            trends.add(all.back());
+        }
+        if (rng() % 4 == 0 && all.size() > 50) {
+            size_t i = all.size() - 1 - rng() % 50;
+            trends.remove(all[i]);
+            all.erase(all.begin() + i);
+        }
+
+        time_t at = start + hour * 3600 + 3599;
+        for (int window = 0; window < TREND_WINDOW_COUNT; window++) {
+            for (int kind = 0; kind < TREND_KIND_COUNT; kind++) {
+                std::vector<TrendItem> items;
+                trends.top((TrendKind)kind, (TrendWindow)window, at, items, 10);
+                checkTrend(all, (TrendKind)kind, (TrendWindow)window, at, 10, items);
+            }
+        }
+    }
+}
+
+static void test_database_feeds_trends() {
+    Zipf combinations(1728, 1.3), descriptions(500, 1.2);
+    for (int step = 0; step < 1500; step++) {
+        int kind = rng() % 100;
+        size_t count = Database::getEntryCount();
+
+        if (kind < 55 || count == 0) {
+            TEST_ASSERT_TRUE(Database::addEntry(trendEntry(now() - rng() % 7200, combinations(), descriptions())));
+        } else if (kind < 62) {
+            uint64_t id = Database::getEntries().getId(rng() % count);
+            TEST_ASSERT_TRUE(Database::updateEntryById(id, trendEntry(now() - rng() % 7200, combinations(), descriptions())));
+        } else if (kind < 68) {
+            TEST_ASSERT_TRUE(Database::deleteEntryById(Database::getEntries().getId(rng() % count)));
+        } else if (kind < 75) {
+            DatabaseBatch batch;
+            for (int k = 0; k < 10; k++) {
+                batch.add(trendEntry(now() - rng() % 3600, combinations(), descriptions()));
+            }
+            TEST_ASSERT_TRUE(Database::commit(batch));
+        } else if (kind < 88) {
+            RtcHAL::setTime(now() + rng() % 7200);
+            while (Database::needsArchive()) {
+                TEST_ASSERT_TRUE(Database::archiveStep());
+            }
+        } else if (kind < 90) {
+            reboot();
+        }
+
+        if (step % 10 == 0) {
+            for (int window = 0; window < TREND_WINDOW_COUNT; window++) {
+                std::vector<LogEntry> recent = Database::getEntriesByDateRange(EntryTrends::getWindowStart((TrendWindow)window, now()), now());
+                for (int trend = 0; trend < TREND_KIND_COUNT; trend++) {
+                    std::vector<TrendItem> items;
+                    Database::getTrends().top((TrendKind)trend, (TrendWindow)window, now(), items, 5);
+                    checkTrend(recent, (TrendKind)trend, (TrendWindow)window, now(), 5, items);
+                }
+            }
+        }
+    }
+}
+
+static void test_windows_end_at_the_clock_or_the_newest_entry() {
+    for (int i = 0; i < 50; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(makeEntry(i, now() - 3600 + i * 60)));
+    }
+    time_t newest = now() - 3600 + 49 * 60;
+    time_t clock = now();
+    TEST_ASSERT_TRUE(Database::getWindowTime() == clock);
+
+    // An unset clock, behind every entry, still shows the latest trends
+    RtcHAL::setTime(0);
+    reboot();
+    TEST_ASSERT_TRUE(Database::getWindowTime() == newest);
+    TEST_ASSERT_EQUAL(50, Database::getStats().count(EntryStats::getDayStart(newest), newest));
+    std::vector<TrendItem> items;
+    Database::getTrends().top(TREND_COLORS, TREND_SHIFT, Database::getWindowTime(), items, 5);
+    TEST_ASSERT_FALSE(items.empty());
+
+    // Days start on the same second the counters divide them at
+    TEST_ASSERT_TRUE(EntryStats::getDayStart(clock) % 86400 == 0);
+    TEST_ASSERT_TRUE(EntryStats::getDayStart(clock) <= clock && clock - EntryStats::getDayStart(clock) < 86400);
+    TEST_ASSERT_TRUE(EntryStats::getDayStart(-1) == -86400);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_space_saving_bounds_hold);
+    RUN_TEST(test_trend_windows_match_counts);
+    RUN_TEST(test_database_feeds_trends);
+    RUN_TEST(test_windows_end_at_the_clock_or_the_newest_entry);
+    return UNITY_END();
+}
@@ -0,0 +1,148 @@
+/**
+ * Enhanced Loss Prevention Log
+ * Native Tests - Text Search
+ *
+ * The trigram index checked against a substring scan, and the candidates
+ * and allocations a search takes at 10k entries
+ */
+
+#include "../test_support.h"
+#include <random>
+
+static std::mt19937 rng(7);
+
+static const size_t BENCH_ENTRIES = 10000;
+
+void setUp() {
+    freshDatabase();
+}
+
+void tearDown() {
+}
+
+// Entries with skewed fields, so filters range from rare to common
+static LogEntry queryEntry(int i) {
+    static const char* const colors[] = {"Red", "Dark Red", "Blue", "Navy Blue", "Black", "White", "Green"};
+    static const char* const items[] = {"Wallet", "Phone case", "Headphones", "Lipstick", "Sunglasses",
+                                        "Jacket", "Candy bar", "Charger", "Watch", "Perfume"};
+
+    LogEntry entry((time_t)(1700000000 + i * 864));
+    entry.setGender(i % 10 ? GENDER_MALE : GENDER_FEMALE);
+    entry.setItemType(i % 5 ? ITEM_CLOTHING : (ItemType)(2 + i % 5));
+    entry.setShirtColor(Color(colors[(i * i) % 7 % (i % 3 ? 1 : 7)], 0x010101u * (rng() % 256)));
+    entry.setPantsColor(Color(colors[(i / 3) % 7], rng() & 0xFFFFFF));
+    entry.setShoesColor(Color(i % 5 ? colors[(i / 5) % 7] : "", 0));
+    entry.setItemDescription((String(items[i % 10]) + " #" + String(i)).c_str());
+    if (i % 3) {
+        entry.setNotes((String("Left via exit ") + String(i % 5)).c_str());
+    }
+    return entry;
+}
+
+// Kept within the hot tier, which the index covers
+static void addQueryEntries(int count) {
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(Database::addEntry(queryEntry(i)));
+    }
+    for (int i = 0; i < count / 20; i++) {
+        TEST_ASSERT_TRUE(Database::deleteEntry((i * 37) % Database::getEntryCount()));
+    }
+}
+
+// Text search as it was before the trigram index: a case-insensitive
+// substring test of every text field of every entry
+static std::vector<uint32_t> scanText(const String& text) {
+    String needle = text;
+    needle.toLowerCase();
+    std::vector<uint32_t> positions;
+    const EntryTable& entries = Database::getEntries();
+    for (size_t i = 0; i < entries.size(); i++) {
+        LogEntry entry = entries.get(i);
+        String fields[] = {entry.getItemDescription(), entry.getNotes(), entry.getShirtColor().name,
+                           entry.getPantsColor().name, entry.getShoesColor().name};
+        for (String& field : fields) {
+            field.toLowerCase();
+            if (field.indexOf(needle) >= 0) {
+                positions.push_back(i);
+                break;
+            }
+        }
+    }
+    return positions;
+}
+
+static void test_text_search_matches_scan() {
+    addQueryEntries(MAX_LOG_ENTRIES);
+    const char* const queries[] = {"phone", "PERFUME #12", "exit 3", "navy", "#567", "zz", "re", "x", ""};
+
+    const EntryTable& entries = Database::getEntries();
+    for (const char* query : queries) {
+        std::vector<uint32_t> expected = scanText(query);
+        std::vector<LogEntry> found = Database::searchEntries(query);
+        TEST_ASSERT_EQUAL(expected.size(), found.size());
+        for (size_t i = 0; i < found.size(); i++) {
+            TEST_ASSERT_EQUAL_STRING(describe(entries.get(expected[i])).c_str(), describe(found[i]).c_str());
+        }
+
+        // The index only narrows; matches() decides
+        Bitmap candidates;
+        Database::getIndex().getTextCandidates(query, candidates);
+        for (uint32_t position : expected) {
+            TEST_ASSERT_TRUE(candidates.contains(position));
+            TEST_ASSERT_TRUE(TrigramIndex::matches(entries, position, query));
+        }
+    }
+
+    // Still right after a reload of the saved index
+    TEST_ASSERT_TRUE(Database::checkpoint());
+    reboot();
+    TEST_ASSERT_EQUAL(scanText("exit 3").size(), Database::searchEntries("exit 3").size());
+}
+
+static void test_search_checks_only_candidates_at_10k_entries() {
+    EntryTable entries;
+    for (size_t i = 0; i < BENCH_ENTRIES; i++) {
+        entries.add(queryEntry(i));
+    }
+    EntryIndex index;
+    index.rebuild(entries);
+
+    // A scan lowercases five fields of every entry for every query. The
+    // index hands over little more than the matches, with a few
+    // allocations whatever the table size, and checking them takes none
+    const char* const queries[] = {"perfume #12", "#4567", "exit 3", "navy", "wallet", "zz"};
+    for (const char* query : queries) {
+        Bitmap candidates;
+        NativeHeap::reset();
+        index.getTextCandidates(query, candidates);
+        TEST_ASSERT_LESS_OR_EQUAL(16, NativeHeap::getAllocations());
+
+        std::vector<uint32_t> positions;
+        candidates.toPositions(positions);
+        std::vector<uint32_t> matched;
+        matched.reserve(positions.size());
+        NativeHeap::reset();
+        for (uint32_t position : positions) {
+            if (TrigramIndex::matches(entries, position, query)) {
+                matched.push_back(position);
+            }
+        }
+        TEST_ASSERT_EQUAL(0, NativeHeap::getAllocations());
+
+        TEST_ASSERT_LESS_OR_EQUAL(2 * matched.size() + 10, positions.size());
+        size_t next = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (TrigramIndex::matches(entries, i, query)) {
+                TEST_ASSERT_TRUE(next < matched.size() && matched[next++] == i);
+            }
+        }
+        TEST_ASSERT_EQUAL(matched.size(), next);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_text_search_matches_scan);
+    RUN_TEST(test_search_checks_only_candidates_at_10k_entries);
+    return UNITY_END();
+}